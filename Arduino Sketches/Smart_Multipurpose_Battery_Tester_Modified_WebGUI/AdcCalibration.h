@@ -0,0 +1,215 @@
+#ifndef ADC_CALIBRATION_H
+#define ADC_CALIBRATION_H
+
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
+#include <AdcSampler.h>  // VREF_REFRESH_INTERVAL
+
+// ========================================= ADC CALIBRATION ========================================
+// Converts filtered ADC counts to battery volts in three steps:
+//
+// 1. Counts -> pin millivolts
+//    - eFuse scheme (preferred): ESP-IDF esp_adc_cali curve/line fitting using the
+//      factory calibration burned into eFuse. Absolute, needs no reference channel.
+//    - Vref fallback (no eFuse data): ratiometric against the LM385 on A1.
+//      The reference is re-measured every VREF_REFRESH_INTERVAL, not on every reading.
+// 2. Pin millivolts -> battery volts through the R1/R2 divider
+// 3. User correction (gain/offset) fitted from reference-meter points taken in
+//    the web UI and stored in NVS, so a rack can be calibrated without reflashing.
+
+#define CAL_MAX_POINTS 4  // Reference-meter points per calibration
+
+struct CalibrationPoint {
+    float deviceVoltage;  // Reading before user correction
+    float meterVoltage;   // Reference meter reading
+};
+
+class AdcCalibration {
+private:
+    adc_cali_handle_t handle;
+    bool efuseAvailable;
+
+    // Vref fallback state
+    float vrefMillivolts;    // Nominal LM385 voltage
+    int32_t vrefCounts;      // Last filtered reference reading (Q counts)
+    uint32_t lastVrefRefresh;
+    bool vrefValid;
+    uint8_t fracBits;        // Fractional bits of the filtered counts
+
+    // User correction
+    float gain;
+    float offset;
+    CalibrationPoint points[CAL_MAX_POINTS];
+    uint8_t pointCount;
+
+    // eFuse conversion with linear interpolation between integer counts,
+    // so the extra resolution from oversampling is kept
+    float efuseToMillivolts(int32_t counts) const {
+        int32_t whole = counts >> fracBits;
+        int32_t frac = counts & ((1 << fracBits) - 1);
+        int mv0 = 0;
+        int mv1 = 0;
+        adc_cali_raw_to_voltage(handle, whole, &mv0);
+        if (frac == 0) {
+            return mv0;
+        }
+        adc_cali_raw_to_voltage(handle, whole + 1, &mv1);
+        return mv0 + (mv1 - mv0) * (float)frac / (1 << fracBits);
+    }
+
+    // Fitted correction, kept only if plausible
+    bool applyFit(float newGain, float newOffset) {
+        if (!isValidCorrection(newGain, newOffset)) {
+            return false;
+        }
+        gain = newGain;
+        offset = newOffset;
+        return true;
+    }
+
+public:
+    AdcCalibration() : handle(nullptr), efuseAvailable(false), vrefMillivolts(1260), vrefCounts(0),
+                       lastVrefRefresh(0), vrefValid(false), fracBits(0),
+                       gain(1.0f), offset(0.0f), pointCount(0) {}
+
+    // Create the eFuse calibration scheme for the battery channel.
+    // countFracBits: fractional bits of the counts passed to toPinMillivolts()
+    bool begin(int pin, float vrefVolts, uint8_t countFracBits) {
+        vrefMillivolts = vrefVolts * 1000.0f;
+        fracBits = countFracBits;
+        efuseAvailable = false;
+
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+        adc_cali_curve_fitting_config_t config = {};
+        config.unit_id = ADC_UNIT_1;
+        config.chan = (adc_channel_t)digitalPinToAnalogChannel(pin);
+        config.atten = ADC_ATTEN_DB_12;  // analogRead() default attenuation
+        config.bitwidth = ADC_BITWIDTH_DEFAULT;
+        efuseAvailable = (adc_cali_create_scheme_curve_fitting(&config, &handle) == ESP_OK);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+        (void)pin;
+        adc_cali_line_fitting_config_t config = {};
+        config.unit_id = ADC_UNIT_1;
+        config.atten = ADC_ATTEN_DB_12;
+        config.bitwidth = ADC_BITWIDTH_DEFAULT;
+        efuseAvailable = (adc_cali_create_scheme_line_fitting(&config, &handle) == ESP_OK);
+#else
+        (void)pin;
+#endif
+        return efuseAvailable;
+    }
+
+    bool usesEfuse() const {
+        return efuseAvailable;
+    }
+
+    // True when the fallback path needs a fresh LM385 reading
+    bool needsVrefRefresh() const {
+        return !efuseAvailable && (!vrefValid || millis() - lastVrefRefresh >= VREF_REFRESH_INTERVAL);
+    }
+
+    void setVrefCounts(int32_t counts) {
+        if (counts <= 0) return;  // Keep last good value rather than divide by zero
+        vrefCounts = counts;
+        vrefValid = true;
+        lastVrefRefresh = millis();
+    }
+
+    float getVrefMillivolts() const {
+        return vrefMillivolts;
+    }
+
+    // Filtered counts -> millivolts at the ADC pin
+    float toPinMillivolts(int32_t counts) const {
+        if (efuseAvailable) {
+            return efuseToMillivolts(counts);
+        }
+        if (!vrefValid) {
+            return 0;
+        }
+        return counts * vrefMillivolts / vrefCounts;
+    }
+
+    // Apply the user gain/offset fitted from reference-meter points
+    float correct(float voltage) const {
+        return voltage * gain + offset;
+    }
+
+    float getGain() const {
+        return gain;
+    }
+
+    float getOffset() const {
+        return offset;
+    }
+
+    // A divider and ADC within tolerance never need more than this
+    static bool isValidCorrection(float newGain, float newOffset) {
+        return newGain >= 0.8f && newGain <= 1.2f && newOffset >= -0.5f && newOffset <= 0.5f;
+    }
+
+    void setCorrection(float newGain, float newOffset) {
+        // Reject obviously broken stored values
+        if (!isValidCorrection(newGain, newOffset)) {
+            newGain = 1.0f;
+            newOffset = 0.0f;
+        }
+        gain = newGain;
+        offset = newOffset;
+    }
+
+    bool addPoint(float deviceVoltage, float meterVoltage) {
+        if (pointCount >= CAL_MAX_POINTS || deviceVoltage <= 0 || meterVoltage <= 0) {
+            return false;
+        }
+        points[pointCount].deviceVoltage = deviceVoltage;
+        points[pointCount].meterVoltage = meterVoltage;
+        pointCount++;
+        return true;
+    }
+
+    void clearPoints() {
+        pointCount = 0;
+    }
+
+    uint8_t getPointCount() const {
+        return pointCount;
+    }
+
+    const CalibrationPoint& getPoint(uint8_t index) const {
+        return points[index];
+    }
+
+    // Fit gain/offset from the collected points.
+    // One point: gain only. Two or more: least-squares line.
+    // False (correction unchanged) with no points or a fit outside isValidCorrection().
+    bool fit() {
+        if (pointCount == 0) {
+            return false;
+        }
+        if (pointCount == 1) {
+            return applyFit(points[0].meterVoltage / points[0].deviceVoltage, 0.0f);
+        }
+
+        float sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (uint8_t i = 0; i < pointCount; i++) {
+            sx += points[i].deviceVoltage;
+            sy += points[i].meterVoltage;
+            sxx += points[i].deviceVoltage * points[i].deviceVoltage;
+            sxy += points[i].deviceVoltage * points[i].meterVoltage;
+        }
+        float n = pointCount;
+        float denom = n * sxx - sx * sx;
+        // Points too close together to define a slope: fall back to gain only
+        if (denom < 1e-4f * n * n) {
+            return applyFit(sy / sx, 0.0f);
+        }
+        float newGain = (n * sxy - sx * sy) / denom;
+        return applyFit(newGain, (sy - newGain * sx) / n);
+    }
+};
+
+// Global calibration instance
+AdcCalibration adcCalibration;
+
+#endif // ADC_CALIBRATION_H
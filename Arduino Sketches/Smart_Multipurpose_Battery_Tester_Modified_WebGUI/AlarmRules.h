@@ -0,0 +1,293 @@
+#ifndef ALARM_RULES_H
+#define ALARM_RULES_H
+
+// ========================================= ALARM RULE ENGINE ========================================
+// Declarative event/alarm rules evaluated incrementally on every voltage sample.
+// Rules are "compiled" when added: thresholds are converted once to the integer
+// units the engine tracks, so evaluation is a handful of integer compares per rule.
+//
+// Metrics (integer units):
+//   voltage   mV            battery voltage
+//   dvdt      mV/min        slope over a DVDT_WINDOW_MS baseline
+//   d2vdt2    mV/min^2      change of slope between consecutive baselines
+//   elapsed   s             time since the phase started (its first sample after resetRun)
+//   capacity  mAh           capacity accumulated since the phase started
+//   sag       mV            drop since the previous sample (sudden IR-like sags)
+//
+// Latency: a rule fires on the first sample that satisfies it for `hold`
+// consecutive samples, i.e. within hold x one control tick (~100-150 ms).
+
+#define MAX_ALARM_RULES 8
+#define DVDT_WINDOW_MS 10000  // Baseline for dV/dt; short enough to react, long enough to beat ADC noise
+
+enum RuleMetric : uint8_t {
+    RULE_METRIC_VOLTAGE,
+    RULE_METRIC_DVDT,
+    RULE_METRIC_D2VDT2,
+    RULE_METRIC_ELAPSED,
+    RULE_METRIC_CAPACITY,
+    RULE_METRIC_SAG,
+    RULE_METRIC_COUNT
+};
+
+enum RuleOp : uint8_t {
+    RULE_OP_BELOW,
+    RULE_OP_ABOVE
+};
+
+enum RuleAction : uint8_t {
+    RULE_ACTION_NEXT,    // End the current phase as if its own termination was reached
+    RULE_ACTION_ABORT,   // Stop immediately and return to menu
+    RULE_ACTION_ALARM,   // Audible alarm + web notification, operation continues
+    RULE_ACTION_MARK,    // Record an event in the log only
+    RULE_ACTION_COUNT
+};
+
+// Which operation phases a rule applies to
+#define RULE_SCOPE_CHARGE    0x01
+#define RULE_SCOPE_DISCHARGE 0x02
+#define RULE_SCOPE_ANY       (RULE_SCOPE_CHARGE | RULE_SCOPE_DISCHARGE)
+
+static const char* const RULE_METRIC_NAMES[RULE_METRIC_COUNT] = {
+    "voltage", "dvdt", "d2vdt2", "elapsed", "capacity", "sag"
+};
+static const char* const RULE_ACTION_NAMES[RULE_ACTION_COUNT] = {
+    "next", "abort", "alarm", "mark"
+};
+
+// Stored rule - also the NVS record format, so keep it plain data
+struct AlarmRule {
+    uint8_t metric;
+    uint8_t op;
+    uint8_t action;
+    uint8_t scope;
+    uint8_t hold;        // Consecutive samples required before firing
+    uint8_t reserved[3];
+    int32_t threshold;   // In the metric's integer units
+};
+
+// One sample as seen by the engine
+struct RuleSample {
+    uint32_t timeMs;     // Milliseconds, any origin (millis())
+    int32_t voltageMV;
+    int32_t capacityMAh; // Running capacity; the engine subtracts the phase's starting value
+    uint8_t scope;       // RULE_SCOPE_CHARGE or RULE_SCOPE_DISCHARGE
+};
+
+class AlarmRuleEngine {
+private:
+    AlarmRule rules[MAX_ALARM_RULES];
+    uint8_t ruleCount;
+
+    // Per-run state
+    uint8_t hits[MAX_ALARM_RULES];
+    uint8_t firedMask;
+    int32_t metrics[RULE_METRIC_COUNT];
+    bool haveSample;
+    bool haveSlope;
+    int32_t prevVoltageMV;
+    uint32_t anchorTimeMs;
+    int32_t anchorVoltageMV;
+    uint32_t phaseStartMs;
+    int32_t phaseStartMAh;
+
+    // Evaluation cost statistics
+    uint32_t evalCount;
+    uint32_t evalTotalUs;
+    uint32_t evalMaxUs;
+
+    // Update derived metrics from the new sample
+    void updateMetrics(const RuleSample& s) {
+        if (!haveSample) {
+            phaseStartMs = s.timeMs;
+            phaseStartMAh = s.capacityMAh;
+        }
+        metrics[RULE_METRIC_VOLTAGE] = s.voltageMV;
+        metrics[RULE_METRIC_ELAPSED] = (s.timeMs - phaseStartMs) / 1000;
+        metrics[RULE_METRIC_CAPACITY] = s.capacityMAh - phaseStartMAh;
+
+        if (!haveSample) {
+            anchorTimeMs = s.timeMs;
+            anchorVoltageMV = s.voltageMV;
+            prevVoltageMV = s.voltageMV;
+            metrics[RULE_METRIC_SAG] = 0;
+            haveSample = true;
+            return;
+        }
+
+        metrics[RULE_METRIC_SAG] = prevVoltageMV - s.voltageMV;
+        prevVoltageMV = s.voltageMV;
+
+        // Slope is re-estimated once per baseline window, not per sample
+        uint32_t dt = s.timeMs - anchorTimeMs;
+        if (dt >= DVDT_WINDOW_MS) {
+            int32_t slope = (int32_t)((int64_t)(s.voltageMV - anchorVoltageMV) * 60000 / (int32_t)dt);
+            if (haveSlope) {
+                metrics[RULE_METRIC_D2VDT2] = (int32_t)((int64_t)(slope - metrics[RULE_METRIC_DVDT]) * 60000 / (int32_t)dt);
+            }
+            metrics[RULE_METRIC_DVDT] = slope;
+            haveSlope = true;
+            anchorTimeMs = s.timeMs;
+            anchorVoltageMV = s.voltageMV;
+        }
+    }
+
+    bool metricReady(uint8_t metric) const {
+        if (metric == RULE_METRIC_DVDT) return haveSlope;
+        if (metric == RULE_METRIC_D2VDT2) return haveSlope && metrics[RULE_METRIC_D2VDT2] != INT32_MIN;
+        return true;
+    }
+
+public:
+    AlarmRuleEngine() : ruleCount(0), evalCount(0), evalTotalUs(0), evalMaxUs(0) {
+        resetRun();
+    }
+
+    // Clear per-run state; call when an operation or phase starts
+    void resetRun() {
+        memset(hits, 0, sizeof(hits));
+        firedMask = 0;
+        memset(metrics, 0, sizeof(metrics));
+        metrics[RULE_METRIC_D2VDT2] = INT32_MIN;  // Needs two slope windows
+        haveSample = false;
+        haveSlope = false;
+        prevVoltageMV = 0;
+        anchorTimeMs = 0;
+        anchorVoltageMV = 0;
+        phaseStartMs = 0;
+        phaseStartMAh = 0;
+    }
+
+    // Field checks shared by addRule() and load()
+    static bool isValid(uint8_t metric, uint8_t op, uint8_t action, uint8_t scope) {
+        return metric < RULE_METRIC_COUNT && op <= RULE_OP_ABOVE &&
+               action < RULE_ACTION_COUNT && (scope & RULE_SCOPE_ANY) != 0;
+    }
+
+    // Compile a rule from user units; returns the new rule index or -1 if full/invalid
+    int addRule(uint8_t metric, uint8_t op, float threshold, uint8_t action, uint8_t scope, uint8_t hold) {
+        if (ruleCount >= MAX_ALARM_RULES || !isValid(metric, op ? RULE_OP_ABOVE : RULE_OP_BELOW, action, scope)) {
+            return -1;
+        }
+        AlarmRule& r = rules[ruleCount];
+        memset(&r, 0, sizeof(r));
+        r.metric = metric;
+        r.op = op ? RULE_OP_ABOVE : RULE_OP_BELOW;
+        r.action = action;
+        r.scope = scope & RULE_SCOPE_ANY;
+        r.hold = hold > 0 ? hold : 1;
+        r.threshold = (int32_t)lroundf(threshold);
+        hits[ruleCount] = 0;
+        return ruleCount++;
+    }
+
+    bool removeRule(uint8_t index) {
+        if (index >= ruleCount) return false;
+        for (uint8_t i = index; i + 1 < ruleCount; i++) {
+            rules[i] = rules[i + 1];
+            hits[i] = hits[i + 1];
+        }
+        ruleCount--;
+        // Shift fired bits above the removed rule down by one
+        uint8_t low = firedMask & ((1 << index) - 1);
+        firedMask = low | ((firedMask >> 1) & ~((1 << index) - 1));
+        return true;
+    }
+
+    void clearRules() {
+        ruleCount = 0;
+        firedMask = 0;
+    }
+
+    uint8_t getRuleCount() const {
+        return ruleCount;
+    }
+
+    const AlarmRule& getRule(uint8_t index) const {
+        return rules[index];
+    }
+
+    int32_t getMetric(uint8_t metric) const {
+        return metrics[metric];
+    }
+
+    // Evaluate all rules against a new sample.
+    // Returns a bitmask of the rules that fired on this sample (bit i = rule i).
+    // Each rule fires at most once per run.
+    uint8_t evaluate(const RuleSample& s) {
+        uint32_t t0 = micros();
+
+        updateMetrics(s);
+
+        uint8_t fired = 0;
+        for (uint8_t i = 0; i < ruleCount; i++) {
+            const AlarmRule& r = rules[i];
+            if ((firedMask & (1 << i)) || !(r.scope & s.scope) || !metricReady(r.metric)) {
+                continue;
+            }
+            int32_t value = metrics[r.metric];
+            bool match = (r.op == RULE_OP_BELOW) ? (value < r.threshold) : (value > r.threshold);
+            if (!match) {
+                hits[i] = 0;
+                continue;
+            }
+            if (++hits[i] >= r.hold) {
+                firedMask |= (1 << i);
+                fired |= (1 << i);
+            }
+        }
+
+        uint32_t dt = micros() - t0;
+        evalCount++;
+        evalTotalUs += dt;
+        if (dt > evalMaxUs) evalMaxUs = dt;
+        return fired;
+    }
+
+    float getAverageEvalUs() const {
+        return evalCount ? (float)evalTotalUs / evalCount : 0;
+    }
+
+    uint32_t getMaxEvalUs() const {
+        return evalMaxUs;
+    }
+
+    // Raw access for NVS persistence
+    const AlarmRule* data() const {
+        return rules;
+    }
+
+    // Restore rules from NVS. Records that fail addRule()'s checks (stale or corrupt
+    // data) are dropped, since metric and action index the metric and name tables.
+    void load(const AlarmRule* stored, uint8_t count) {
+        ruleCount = 0;
+        for (uint8_t i = 0; i < count && ruleCount < MAX_ALARM_RULES; i++) {
+            const AlarmRule& r = stored[i];
+            if (!isValid(r.metric, r.op, r.action, r.scope)) continue;
+            rules[ruleCount] = r;
+            rules[ruleCount].scope &= RULE_SCOPE_ANY;
+            if (rules[ruleCount].hold == 0) rules[ruleCount].hold = 1;
+            ruleCount++;
+        }
+        resetRun();
+    }
+
+    static int metricFromName(const char* name) {
+        for (int i = 0; i < RULE_METRIC_COUNT; i++) {
+            if (name && strcmp(name, RULE_METRIC_NAMES[i]) == 0) return i;
+        }
+        return -1;
+    }
+
+    static int actionFromName(const char* name) {
+        for (int i = 0; i < RULE_ACTION_COUNT; i++) {
+            if (name && strcmp(name, RULE_ACTION_NAMES[i]) == 0) return i;
+        }
+        return -1;
+    }
+};
+
+// Global rule engine instance
+AlarmRuleEngine alarmRules;
+
+#endif // ALARM_RULES_H
@@ -0,0 +1,168 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// ========================================= ON-DEVICE BENCHMARK ========================================
+// Times the firmware's per-tick hot paths on the tester itself, so a change can be backed
+// by numbers from the chip it runs on (the sketch registers the cases, see runBenchmarks()).
+//
+//   time      ESP.getCycleCount() around BENCH_BATCHES batches of a case. The fastest batch
+//             is reported: preemption by the WiFi and async_tcp tasks only ever adds time,
+//             so the minimum is the stable figure. The cost of the timing loop itself is
+//             measured once per run and subtracted. ns = cycles / CPU MHz
+//   heap      free heap before and after the whole case, per op. Non-zero means the path
+//             keeps memory; transient allocations are freed inside the op and do not show
+//             (the Arduino core is built without heap tracing)
+//   bytes     output produced per op (JSON text), 0 for compute-only paths
+//   baseline  the last results can be saved in NVS; later runs report each case against
+//             the saved figure with the same name
+//
+// Each batch is capped at BENCH_BATCH_BUDGET_MS so slow cases (ADC blocks) stay short, and
+// the loop task yields between batches so the idle task keeps the task watchdog fed.
+
+#define BENCH_MAX_CASES 12
+#define BENCH_NAME_LEN 16
+#define BENCH_BATCHES 5
+#define BENCH_DEFAULT_ITERATIONS 500   // Per case, over all batches
+#define BENCH_MAX_ITERATIONS 20000
+#define BENCH_BATCH_BUDGET_MS 200
+#define BENCH_CHUNK 16                 // Ops between budget checks
+
+struct BenchResult {
+    char name[BENCH_NAME_LEN];
+    uint32_t iterations;   // Ops actually timed
+    uint32_t cyclesPerOp;
+    float nsPerOp;
+    int32_t heapPerOp;     // Bytes kept per op (negative = released)
+    uint32_t bytesPerOp;   // Output bytes per op
+    float baselineNs;      // Saved figure for this name, 0 if none
+};
+
+// Saved reference for one case - also the NVS record format, so keep it plain data
+struct BenchBaseline {
+    char name[BENCH_NAME_LEN];
+    float nsPerOp;
+};
+
+class Benchmark {
+private:
+    BenchResult results[BENCH_MAX_CASES];
+    uint8_t count;
+    BenchBaseline baseline[BENCH_MAX_CASES];
+    uint8_t baselineCount;
+    uint32_t cpuMhz;
+    float overheadCycles;  // Timing loop cost per op
+    volatile uint32_t sink;
+
+    float findBaseline(const char* name) const {
+        for (uint8_t i = 0; i < baselineCount; i++) {
+            if (strncmp(baseline[i].name, name, BENCH_NAME_LEN) == 0) return baseline[i].nsPerOp;
+        }
+        return 0;
+    }
+
+    // Fastest batch in cycles per op; sets ops to the total timed and bytes to the last op's output
+    template <class Op>
+    float timeBatches(uint32_t iterations, Op& op, uint32_t& ops, size_t& bytes) {
+        uint32_t perBatch = (iterations + BENCH_BATCHES - 1) / BENCH_BATCHES;
+        float best = 0;
+        ops = 0;
+        for (uint8_t b = 0; b < BENCH_BATCHES; b++) {
+            uint32_t batchStart = millis();
+            uint32_t done = 0;
+            uint32_t startCycles = ESP.getCycleCount();
+            while (done < perBatch) {
+                for (uint8_t k = 0; k < BENCH_CHUNK && done < perBatch; k++, done++) {
+                    bytes = op();
+                }
+                if (millis() - batchStart >= BENCH_BATCH_BUDGET_MS) break;
+            }
+            float perOp = (float)(ESP.getCycleCount() - startCycles) / done;
+            if (b == 0 || perOp < best) best = perOp;
+            ops += done;
+            delay(1);  // Idle task and WiFi get a turn
+        }
+        return best;
+    }
+
+public:
+    Benchmark() : count(0), baselineCount(0), cpuMhz(0), overheadCycles(0), sink(0) {}
+
+    // Start a run: clears the results and measures the timing loop on an empty op
+    void begin() {
+        count = 0;
+        cpuMhz = getCpuFrequencyMhz();
+        auto empty = [this]() -> size_t {
+            sink = sink + 1;
+            return 0;
+        };
+        uint32_t ops;
+        size_t bytes;
+        overheadCycles = timeBatches(BENCH_DEFAULT_ITERATIONS, empty, ops, bytes);
+    }
+
+    // Time one case; op returns the bytes it produced (0 for none)
+    template <class Op>
+    void measure(const char* name, uint32_t iterations, Op op) {
+        if (count >= BENCH_MAX_CASES) return;
+        op();  // Warm-up: first-call allocations and cache misses are not counted
+
+        uint32_t heapBefore = ESP.getFreeHeap();
+        uint32_t ops;
+        size_t bytes = 0;
+        float cycles = timeBatches(iterations, op, ops, bytes) - overheadCycles;
+        if (cycles < 0) cycles = 0;
+        int32_t heapDelta = (int32_t)(heapBefore - ESP.getFreeHeap());
+
+        BenchResult& r = results[count++];
+        strncpy(r.name, name, BENCH_NAME_LEN - 1);
+        r.name[BENCH_NAME_LEN - 1] = 0;
+        r.iterations = ops;
+        r.cyclesPerOp = (uint32_t)(cycles + 0.5f);
+        r.nsPerOp = cycles * 1000.0f / cpuMhz;
+        r.heapPerOp = heapDelta / (int32_t)ops;
+        r.bytesPerOp = bytes;
+        r.baselineNs = findBaseline(r.name);
+    }
+
+    // Keep a value alive so the compiler cannot drop the work that produced it
+    void consume(uint32_t value) {
+        sink = sink + value;
+    }
+
+    uint8_t getCount() const {
+        return count;
+    }
+
+    const BenchResult& getResult(uint8_t i) const {
+        return results[i];
+    }
+
+    uint32_t getCpuMhz() const {
+        return cpuMhz;
+    }
+
+    // Current results as the new baseline; returns the record count
+    uint8_t makeBaseline(BenchBaseline* out) {
+        for (uint8_t i = 0; i < count; i++) {
+            memcpy(out[i].name, results[i].name, BENCH_NAME_LEN);
+            out[i].nsPerOp = results[i].nsPerOp;
+            results[i].baselineNs = results[i].nsPerOp;
+        }
+        setBaseline(out, count);
+        return count;
+    }
+
+    void setBaseline(const BenchBaseline* records, uint8_t n) {
+        baselineCount = (n > BENCH_MAX_CASES) ? BENCH_MAX_CASES : n;
+        memcpy(baseline, records, baselineCount * sizeof(BenchBaseline));
+    }
+
+    uint8_t getBaselineCount() const {
+        return baselineCount;
+    }
+};
+
+// Global benchmark instance
+Benchmark benchmark;
+
+#endif // BENCHMARK_H
@@ -0,0 +1,329 @@
+#ifndef CHARGE_ESTIMATOR_H
+#define CHARGE_ESTIMATOR_H
+
+#include <math.h>
+
+// ========================================= CHARGE CURRENT ESTIMATOR ========================================
+// The LP4060's CHRG output cannot be read (A2 is the same pin as D2), so the charge current
+// is inferred from the cell voltage instead of assuming the CC current for the whole charge.
+//
+//   CC      the charger delivers its programmed current until the terminal voltage reaches
+//           its regulation voltage
+//   CV      detected when the mean voltage of a CHARGE_CV_WINDOW_MS window, above
+//           CHARGE_CV_MIN_MV, is less than CHARGE_CV_FLAT_MV above the previous window's
+//           (means, so ADC noise cannot fake a plateau). The current then tapers as the OCV
+//           closes in on the regulation voltage. With a series resistance R and an OCV that is
+//           linear near full it decays as I = I0 * exp(-t / tau), tau = R * dQ/dOCV, and dQ/dOCV
+//           is the CC current over the CC voltage slope just before the plateau
+//   probe   optional: every CHARGE_PROBE_INTERVAL_MS the charger is switched off for
+//           CHARGE_PROBE_MS and the voltage step is I * R. In CC (I known) the step
+//           calibrates R; in CV it measures the current, re-anchors the decay there and
+//           refits tau against the previous anchor
+//   done    the modelled current fell to CHARGE_TAPER_END_MA (taper termination only), the
+//           charger stopped by itself (the LP4060 ends at 1/10 of its CC current: the smoothed
+//           voltage drops below the plateau with the charger on, or a probe shows no step), or
+//           CHARGE_CV_MAX_MS passed in CV
+//
+// Charge is integrated from the modelled current (exactly, across the exponential), so the
+// charge capacity and the coulombic efficiency of an Analyze run mean something. Without
+// taper termination the sketch still stops at the full voltage as before.
+//
+// The estimator has no hardware access: the sketch feeds voltage samples and applies
+// isChargerOn(). Samples taken with the charger off or just after it comes back on are not
+// charge samples (see wasSampleUsable()).
+
+#define CHARGE_SLOPE_MIN_MV 3900        // CC voltage slope is tracked above this
+#define CHARGE_CV_MIN_MV 4100           // Plateau must be above this to count as CV
+#define CHARGE_CV_WINDOW_MS 60000       // Slope / plateau window
+#define CHARGE_CV_FLAT_MV 2             // Rise between window means below which the voltage is flat
+#define CHARGE_SMOOTH_SHIFT 4           // Plateau tracking EMA, alpha 1/16 per sample
+#define CHARGE_PROBE_INTERVAL_MS 60000  // Charger-off probe period
+#define CHARGE_PROBE_MS 500             // Charger off this long per probe
+#define CHARGE_SETTLE_MS 500            // Samples ignored after the charger comes back on
+#define CHARGE_MIN_STEP_MV 2            // Probe step below this = no current
+#define CHARGE_END_DROP_MV 10           // Below the CV plateau by this = charger finished
+#define CHARGE_TAPER_END_MA 100         // Taper termination current (LP4060 ends at C/10)
+#define CHARGE_DEFAULT_R_OHMS 0.15f     // Until a probe has measured it
+#define CHARGE_DEFAULT_TAU_S 1500.0f    // If the CC slope is unusable
+#define CHARGE_TAU_MIN_S 300.0f
+#define CHARGE_TAU_MAX_S 7200.0f
+#define CHARGE_CV_MAX_MS 14400000UL     // 4 hours
+#define CHARGE_CE_EMPTY_MARGIN_MV 150   // Analyze charge must start this close to the cutoff for a CE figure
+
+enum ChargePhase : uint8_t {
+    CHARGE_PHASE_CC,
+    CHARGE_PHASE_CV,
+    CHARGE_PHASE_DONE
+};
+
+static const char* const CHARGE_PHASE_NAMES[] = {
+    "cc", "cv", "done"
+};
+
+class ChargeEstimator {
+private:
+    float ccCurrentMA;        // Charger's programmed current
+    float fullMV;             // Stop voltage without taper termination
+    bool taperEnd;
+    bool probes;
+
+    ChargePhase phase;
+    float currentMA;          // Modelled current now
+    float chargeMAh;
+    uint32_t lastUpdate;
+    bool sampleUsable;
+
+    // CC slope and plateau detection
+    bool windowOpen;
+    uint32_t windowStart;
+    float windowSumMV;
+    uint16_t windowSamples;
+    float lastMeanMV;         // Previous window's mean, 0 if none
+    float slopeMVperS;        // Between the last two CC windows, 0 if none
+    float smoothMV;           // EMA of the charge samples
+    float plateauMV;          // Highest smoothed CV voltage with the charger on
+
+    // Taper model: I = anchorMA * exp(-(t - anchorTime) / tau)
+    float rOhms;
+    bool rMeasured;
+    float tauS;
+    uint32_t cvStart;
+    uint32_t anchorTime;
+    float anchorMA;
+
+    // Probe
+    bool probing;
+    uint32_t probeStart;
+    uint32_t lastProbe;
+    float probeOnMV;
+    uint32_t settleUntil;
+
+    float modelMA(uint32_t t) const {
+        return anchorMA * expf(-(float)(int32_t)(t - anchorTime) / 1000.0f / tauS);
+    }
+
+    // Charge between two times at the modelled current, mAh
+    float chargeBetween(uint32_t from, uint32_t to) const {
+        if (phase == CHARGE_PHASE_CC) {
+            return ccCurrentMA * (to - from) / 3600000.0f;
+        }
+        if (phase == CHARGE_PHASE_CV) {
+            // Integral of the exponential: I0 * tau * (e^(-a/tau) - e^(-b/tau))
+            return (modelMA(from) - modelMA(to)) * tauS / 3600.0f;
+        }
+        return 0;
+    }
+
+    void enterCv(uint32_t now) {
+        // dQ/dOCV from the CC slope: tau = R * I / (dV/dt)
+        tauS = CHARGE_DEFAULT_TAU_S;
+        if (slopeMVperS > 0) {
+            tauS = rOhms * ccCurrentMA / slopeMVperS;
+            if (tauS < CHARGE_TAU_MIN_S) tauS = CHARGE_TAU_MIN_S;
+            if (tauS > CHARGE_TAU_MAX_S) tauS = CHARGE_TAU_MAX_S;
+        }
+
+        // The plateau started at the beginning of the flat window: charge counted there at
+        // the CC current is replaced by the taper from that point
+        chargeMAh -= ccCurrentMA * (now - windowStart) / 3600000.0f;
+        phase = CHARGE_PHASE_CV;
+        cvStart = windowStart;
+        anchorTime = windowStart;
+        anchorMA = ccCurrentMA;
+        chargeMAh += chargeBetween(windowStart, now);
+        currentMA = modelMA(now);
+        plateauMV = smoothMV;
+    }
+
+    void finish() {
+        phase = CHARGE_PHASE_DONE;
+        currentMA = 0;
+    }
+
+    void finishProbe(uint32_t now, float mv) {
+        probing = false;
+        settleUntil = now + CHARGE_SETTLE_MS;
+        float stepMV = probeOnMV - mv;
+
+        if (phase == CHARGE_PHASE_CC) {
+            // Only below CHARGE_CV_MIN_MV is the charger certainly delivering its CC current
+            if (stepMV >= CHARGE_MIN_STEP_MV && probeOnMV < CHARGE_CV_MIN_MV) {
+                float r = stepMV / ccCurrentMA;   // mV/mA = ohms
+                rOhms = rMeasured ? (rOhms + r) / 2 : r;
+                rMeasured = true;
+            }
+            return;
+        }
+
+        // CV: the step is the current through R
+        if (stepMV < CHARGE_MIN_STEP_MV) {
+            finish();   // Charger has stopped by itself
+            return;
+        }
+        float measuredMA = stepMV / rOhms;
+        if (measuredMA > ccCurrentMA) measuredMA = ccCurrentMA;
+        if (measuredMA < anchorMA && now != anchorTime) {
+            tauS = (now - anchorTime) / 1000.0f / logf(anchorMA / measuredMA);
+            if (tauS < CHARGE_TAU_MIN_S) tauS = CHARGE_TAU_MIN_S;
+            if (tauS > CHARGE_TAU_MAX_S) tauS = CHARGE_TAU_MAX_S;
+        }
+        anchorTime = now;
+        anchorMA = measuredMA;
+        currentMA = measuredMA;
+    }
+
+public:
+    ChargeEstimator()
+        : ccCurrentMA(0), fullMV(0), taperEnd(false), probes(false), phase(CHARGE_PHASE_CC),
+          currentMA(0), chargeMAh(0), lastUpdate(0), sampleUsable(false), windowOpen(false),
+          windowStart(0), windowSumMV(0), windowSamples(0), lastMeanMV(0), slopeMVperS(0),
+          smoothMV(0), plateauMV(0), rOhms(CHARGE_DEFAULT_R_OHMS),
+          rMeasured(false), tauS(CHARGE_DEFAULT_TAU_S), cvStart(0), anchorTime(0), anchorMA(0),
+          probing(false), probeStart(0), lastProbe(0), probeOnMV(0), settleUntil(0) {}
+
+    // Charger has just been switched on. taper = end at CHARGE_TAPER_END_MA instead of fullMV,
+    // probes = switch the charger off briefly to measure R and the taper current
+    void begin(uint32_t now, int chargeCurrentMA, float fullVoltageMV, bool taper, bool useProbes) {
+        ccCurrentMA = chargeCurrentMA;
+        fullMV = fullVoltageMV;
+        taperEnd = taper;
+        probes = useProbes;
+        phase = CHARGE_PHASE_CC;
+        currentMA = ccCurrentMA;
+        chargeMAh = 0;
+        lastUpdate = now;
+        sampleUsable = false;
+        windowOpen = false;
+        lastMeanMV = 0;
+        slopeMVperS = 0;
+        smoothMV = 0;
+        plateauMV = 0;
+        rOhms = CHARGE_DEFAULT_R_OHMS;
+        rMeasured = false;
+        tauS = CHARGE_DEFAULT_TAU_S;
+        probing = false;
+        lastProbe = now;
+        settleUntil = now + CHARGE_SETTLE_MS;
+    }
+
+    // One voltage sample (taken with the charger as isChargerOn() said before this call)
+    void update(uint32_t now, float mv) {
+        if (!probing) {
+            chargeMAh += chargeBetween(lastUpdate, now);
+        }
+        lastUpdate = now;
+        sampleUsable = !probing && (int32_t)(now - settleUntil) >= 0;
+
+        if (probing) {
+            if (now - probeStart >= CHARGE_PROBE_MS) {
+                finishProbe(now, mv);
+            }
+            return;
+        }
+        if (phase == CHARGE_PHASE_DONE || !sampleUsable) {
+            return;
+        }
+        smoothMV = (smoothMV == 0) ? mv : smoothMV + (mv - smoothMV) / (1 << CHARGE_SMOOTH_SHIFT);
+
+        if (phase == CHARGE_PHASE_CC) {
+            if (mv < CHARGE_SLOPE_MIN_MV) {
+                windowOpen = false;
+                lastMeanMV = 0;
+            } else if (!windowOpen) {
+                windowOpen = true;
+                windowStart = now;
+                windowSumMV = mv;
+                windowSamples = 1;
+            } else if (now - windowStart < CHARGE_CV_WINDOW_MS) {
+                windowSumMV += mv;
+                windowSamples++;
+            } else {
+                float meanMV = windowSumMV / windowSamples;
+                float riseMV = meanMV - lastMeanMV;
+                if (lastMeanMV > 0 && meanMV >= CHARGE_CV_MIN_MV && riseMV < CHARGE_CV_FLAT_MV) {
+                    enterCv(now);
+                } else {
+                    if (lastMeanMV > 0 && riseMV > 0) {
+                        slopeMVperS = riseMV * 1000.0f / CHARGE_CV_WINDOW_MS;
+                    }
+                    lastMeanMV = meanMV;
+                    windowStart = now;
+                    windowSumMV = mv;
+                    windowSamples = 1;
+                }
+            }
+        } else {
+            currentMA = modelMA(now);
+            if (smoothMV > plateauMV) {
+                plateauMV = smoothMV;
+            }
+            if (smoothMV < plateauMV - CHARGE_END_DROP_MV ||
+                (taperEnd && currentMA <= CHARGE_TAPER_END_MA) ||
+                now - cvStart >= CHARGE_CV_MAX_MS) {
+                finish();
+                return;
+            }
+        }
+
+        if (probes && now - lastProbe >= CHARGE_PROBE_INTERVAL_MS) {
+            probing = true;
+            probeStart = now;
+            lastProbe = now;
+            probeOnMV = mv;
+        }
+    }
+
+    // Charge is over: DONE with taper termination (or the charger stopped), else the full voltage
+    bool isFinished(float mv) const {
+        if (probing) return false;
+        return phase == CHARGE_PHASE_DONE || (!taperEnd && mv >= fullMV);
+    }
+
+    bool isChargerOn() const {
+        return !probing && phase != CHARGE_PHASE_DONE;
+    }
+
+    bool isProbing() const {
+        return probing;
+    }
+
+    // Last sample was taken with the charger on and settled
+    bool wasSampleUsable() const {
+        return sampleUsable;
+    }
+
+    ChargePhase getPhase() const {
+        return phase;
+    }
+
+    const char* getPhaseName() const {
+        return probing ? "probe" : CHARGE_PHASE_NAMES[phase];
+    }
+
+    // Modelled charge current (0 while probing or done)
+    float getCurrentMA() const {
+        return probing ? 0 : currentMA;
+    }
+
+    float getChargeMAh() const {
+        return chargeMAh;
+    }
+
+    float getROhms() const {
+        return rOhms;
+    }
+
+    bool isRMeasured() const {
+        return rMeasured;
+    }
+
+    // Taper time constant (the CC-slope estimate until CV starts)
+    float getTauS() const {
+        return tauS;
+    }
+};
+
+// Global charge estimator instance
+ChargeEstimator chargeEstimator;
+
+#endif // CHARGE_ESTIMATOR_H
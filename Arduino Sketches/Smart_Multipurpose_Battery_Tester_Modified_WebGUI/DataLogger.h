@@ -3,9 +3,17 @@
 
 // ========================================= DATA LOGGER ========================================
 // Circular buffer for storing graph data (1 hour at 1 sample/second = 3600 samples)
+//
+// Every logged sample gets a sequence number (0, 1, 2 ... within an operation) and every
+// operation a random run id, so a web client can keep a cursor: after a reconnect it asks
+// for the samples after its cursor only, and a changed run id tells it to start over.
+// The oldest stored sample is nextSeq - count.
 
 #define MAX_DATA_POINTS 3600  // 1 hour of data at 1 sample per second
 #define DATA_SAMPLE_INTERVAL 1000  // Sample every 1000ms (1 second)
+#define MAX_LOG_EVENTS 16          // Marked events (rule hits etc.) per operation
+#define HISTORY_CHUNK_POINTS 256     // Full-resolution samples per history_chunk frame
+#define HISTORY_OVERVIEW_POINTS 360  // Samples in the overview for clients without a cursor
 
 // Data point structure - optimized for memory
 struct DataPoint {
@@ -15,29 +23,45 @@ struct DataPoint {
     float capacity;      // Accumulated capacity in mAh
 };
 
+// Event marker - shown on the chart at the time it was recorded
+struct LogEvent {
+    uint32_t timestamp;  // Milliseconds since start of operation
+    uint8_t code;        // Source-specific code (e.g. alarm rule index)
+};
+
 class DataLogger {
 private:
     DataPoint buffer[MAX_DATA_POINTS];
+    LogEvent events[MAX_LOG_EVENTS];
+    uint8_t eventCount;
     uint16_t head;           // Next write position
     uint16_t count;          // Number of valid entries
     uint32_t startTime;      // Operation start time
     uint32_t lastSampleTime; // Last sample timestamp
+    uint32_t runId;          // Changes on every reset()
+    uint32_t nextSeq;        // Sequence number of the next sample
 
 public:
-    DataLogger() : head(0), count(0), startTime(0), lastSampleTime(0) {}
+    DataLogger() : eventCount(0), head(0), count(0), startTime(0), lastSampleTime(0), runId(0), nextSeq(0) {}
 
     // Reset the logger for a new operation
     void reset() {
         head = 0;
         count = 0;
+        eventCount = 0;
         startTime = millis();
         lastSampleTime = 0;
+        runId = esp_random();
+        nextSeq = 0;
     }
 
     // Add a data point if enough time has passed
     bool addDataPoint(float voltage, int16_t current, float capacity) {
-        uint32_t now = millis();
+        return addDataPointAt(millis(), voltage, current, capacity);
+    }
 
+    // Same with the clock supplied by the caller (benchmark replays)
+    bool addDataPointAt(uint32_t now, float voltage, int16_t current, float capacity) {
         // Check if enough time has passed since last sample
         if (now - lastSampleTime < DATA_SAMPLE_INTERVAL && lastSampleTime > 0) {
             return false;  // Not time to sample yet
@@ -58,10 +82,30 @@ public:
         if (count < MAX_DATA_POINTS) {
             count++;
         }
+        nextSeq++;
+
+        return true;
+    }
 
+    // Record an event marker; oldest markers are kept if the list is full
+    bool addEvent(uint8_t code) {
+        if (eventCount >= MAX_LOG_EVENTS) {
+            return false;
+        }
+        events[eventCount].timestamp = millis() - startTime;
+        events[eventCount].code = code;
+        eventCount++;
         return true;
     }
 
+    uint8_t getEventCount() const {
+        return eventCount;
+    }
+
+    const LogEvent& getEvent(uint8_t index) const {
+        return events[index];
+    }
+
     // Get number of data points stored
     uint16_t getCount() const {
         return count;
@@ -106,23 +150,41 @@ public:
         return count > 0;
     }
 
-    // Get data for JSON serialization (returns count of points to send)
-    // Use with getDataPoint() to iterate
-    uint16_t getDataForTransmit(uint16_t maxPoints = 360) const {
-        // Limit points for initial transmission (every 10th point for history)
-        if (count <= maxPoints) {
-            return count;
-        }
-        return maxPoints;
+    uint32_t getRunId() const {
+        return runId;
+    }
+
+    // Sequence number of the oldest stored sample
+    uint32_t getFirstSeq() const {
+        return nextSeq - count;
+    }
+
+    // Sequence number the next sample will get (one past the newest)
+    uint32_t getNextSeq() const {
+        return nextSeq;
     }
 
-    // Get downsampled index for transmission
-    uint16_t getDownsampledIndex(uint16_t transmitIndex, uint16_t maxPoints = 360) const {
-        if (count <= maxPoints) {
-            return transmitIndex;
+    // Get a data point by sequence number; false once it has been overwritten
+    bool getBySeq(uint32_t seq, DataPoint& point) const {
+        uint32_t first = getFirstSeq();
+        if (seq < first || seq >= nextSeq) {
+            return false;
         }
-        // Downsample: pick evenly spaced points
-        return (transmitIndex * count) / maxPoints;
+        return getDataPoint(seq - first, point);
+    }
+
+    // A client cursor (run id, first seq it does not have) can be resumed from if it belongs
+    // to this run and is not past the newest sample; otherwise the client starts over
+    bool canResume(uint32_t run, uint32_t since) const {
+        return run == runId && since <= nextSeq;
+    }
+
+    // Cursor moved onto the stored range: samples already overwritten are skipped
+    uint32_t clampSeq(uint32_t seq) const {
+        uint32_t first = getFirstSeq();
+        if (seq < first) return first;
+        if (seq > nextSeq) return nextSeq;
+        return seq;
     }
 };
 
@@ -0,0 +1,222 @@
+#ifndef DISCHARGE_PLAN_H
+#define DISCHARGE_PLAN_H
+
+#include <math.h>
+
+// ========================================= ANALYZE DISCHARGE PLAN ========================================
+// The Analyze discharge as a list of stages, each a load current and the voltage that ends it,
+// optionally followed by a rest with the load off before the next stage starts:
+//
+//   single     one stage at the configured current to the final cutoff
+//   staged     high current to the transition voltage, then low current to the final cutoff
+//   rate sweep up to PLAN_MAX_STAGES currents, highest first, each to the same cutoff with a
+//              rest in between. What a rate can no longer deliver is picked up by the next,
+//              lower one, so the capacity available at a rate is the run total up to and
+//              including its stage - one charge gives the whole rate curve
+//
+// Per stage it records the delivered mAh and mWh, time, the loaded voltage at the start, mean
+// and end, the voltage recovered during the following rest, and the loaded voltage against
+// run mAh as a compact self-decimating series (the voltage-under-load profile).
+//
+// Peukert fit (sweeps): with t = capacity at rate / rate, I^k x t is constant, so k is the
+// negated least-squares slope of ln t against ln I. The rate of a stage is its mean current
+// (mAh / h), which includes derating and the load offset. k = 1 is an ideal cell; healthy
+// Li-ion cells are usually within 1.0-1.1.
+//
+// The plan has no hardware access: the sketch applies getStage() and feeds loaded samples.
+
+#define PLAN_MAX_STAGES 6
+#define PLAN_PROFILE_POINTS 16           // Profile series per stage; spacing doubles when it fills
+#define PLAN_PROFILE_START_STEP_MAH 5.0f
+#define SWEEP_DEFAULT_REST_S 60          // Rest between sweep stages
+#define SWEEP_MAX_REST_S 1800
+
+struct DischargeStage {
+    uint8_t currentIndex;   // Current[] index
+    uint16_t cutoffMV;      // Stage ends at this loaded voltage
+    uint16_t restS;         // Load off this long before the next stage (0 = switch straight over)
+};
+
+struct StageResult {
+    uint16_t currentMA;     // Requested current
+    float mAh;              // Delivered in this stage
+    float mWh;
+    uint32_t seconds;
+    uint16_t startMV;       // First loaded reading
+    uint16_t avgMV;         // Mean loaded voltage (mWh / mAh)
+    uint16_t endMV;
+    uint16_t recoveredMV;   // End of the following rest (0 if none)
+
+    // Loaded voltage against run mAh (capacity since the discharge started)
+    uint8_t profileCount;
+    float profileStepMAh;
+    float profileMAh[PLAN_PROFILE_POINTS];
+    uint16_t profileMV[PLAN_PROFILE_POINTS];
+};
+
+class DischargePlan {
+private:
+    DischargeStage stages[PLAN_MAX_STAGES];
+    StageResult results[PLAN_MAX_STAGES];
+    uint8_t count;
+    uint8_t index;          // Running (or last) stage
+    uint8_t completed;      // Stages with a final result
+    bool sweep;
+
+    // Running stage
+    uint32_t stageStartMs;
+    float stageStartMAh;
+    float lastMAh;
+
+    void decimate(StageResult& r) {
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < r.profileCount; i += 2) {
+            r.profileMAh[kept] = r.profileMAh[i];
+            r.profileMV[kept] = r.profileMV[i];
+            kept++;
+        }
+        r.profileCount = kept;
+        r.profileStepMAh *= 2;
+    }
+
+public:
+    DischargePlan() : count(0), index(0), completed(0), sweep(false), stageStartMs(0), stageStartMAh(0), lastMAh(0) {}
+
+    // New run; stages are copied (at most PLAN_MAX_STAGES)
+    void begin(const DischargeStage* plan, uint8_t n, bool rateSweep) {
+        count = (n > PLAN_MAX_STAGES) ? PLAN_MAX_STAGES : n;
+        memcpy(stages, plan, count * sizeof(DischargeStage));
+        index = 0;
+        completed = 0;
+        sweep = rateSweep;
+    }
+
+    // Load has just been applied for the current stage
+    void startStage(uint32_t now, float capacityMAh, uint16_t currentMA) {
+        StageResult& r = results[index];
+        memset(&r, 0, sizeof(StageResult));
+        r.currentMA = currentMA;
+        r.profileStepMAh = PLAN_PROFILE_START_STEP_MAH;
+        stageStartMs = now;
+        stageStartMAh = capacityMAh;
+        lastMAh = capacityMAh;
+    }
+
+    // One loaded sample: voltage and run capacity so far
+    void addSample(float volts, float capacityMAh) {
+        StageResult& r = results[index];
+        uint16_t mv = (uint16_t)(volts * 1000.0f + 0.5f);
+        if (r.startMV == 0) {
+            r.startMV = mv;
+        }
+        r.mWh += (capacityMAh - lastMAh) * volts;
+        lastMAh = capacityMAh;
+
+        if (r.profileCount > 0 && capacityMAh - r.profileMAh[r.profileCount - 1] < r.profileStepMAh) return;
+        if (r.profileCount == PLAN_PROFILE_POINTS) {
+            decimate(r);
+            if (capacityMAh - r.profileMAh[r.profileCount - 1] < r.profileStepMAh) return;
+        }
+        r.profileMAh[r.profileCount] = capacityMAh;
+        r.profileMV[r.profileCount] = mv;
+        r.profileCount++;
+    }
+
+    // Stage reached its cutoff (or a rule ended it)
+    void endStage(uint32_t now, float volts, float capacityMAh) {
+        StageResult& r = results[index];
+        r.mAh = capacityMAh - stageStartMAh;
+        r.seconds = (now - stageStartMs) / 1000;
+        r.endMV = (uint16_t)(volts * 1000.0f + 0.5f);
+        r.avgMV = (r.mAh > 0) ? (uint16_t)(r.mWh / r.mAh * 1000.0f + 0.5f) : r.endMV;
+        completed = index + 1;
+    }
+
+    // Voltage at the end of the rest that followed the last completed stage
+    void setRecovered(float volts) {
+        if (completed > 0) {
+            results[completed - 1].recoveredMV = (uint16_t)(volts * 1000.0f + 0.5f);
+        }
+    }
+
+    // Move to the next stage; false if the plan is finished
+    bool next() {
+        if (index + 1 >= count) return false;
+        index++;
+        return true;
+    }
+
+    bool isLastStage() const {
+        return index + 1 >= count;
+    }
+
+    const DischargeStage& getStage() const {
+        return stages[index];
+    }
+
+    uint8_t getStageIndex() const {
+        return index;
+    }
+
+    uint8_t getStageCount() const {
+        return count;
+    }
+
+    bool isSweep() const {
+        return sweep;
+    }
+
+    uint8_t getResultCount() const {
+        return completed;
+    }
+
+    const StageResult& getResult(uint8_t i) const {
+        return results[i];
+    }
+
+    // Run capacity up to and including stage i - the capacity available at that stage's rate
+    float getCapacityAt(uint8_t i) const {
+        float total = 0;
+        for (uint8_t s = 0; s <= i && s < completed; s++) {
+            total += results[s].mAh;
+        }
+        return total;
+    }
+
+    // Mean current of stage i in mA (requested current if it delivered nothing)
+    float getMeanCurrentMA(uint8_t i) const {
+        const StageResult& r = results[i];
+        if (r.seconds == 0 || r.mAh <= 0) return r.currentMA;
+        return r.mAh * 3600.0f / r.seconds;
+    }
+
+    // Peukert exponent over the stages; false until every stage has completed (an aborted or
+    // still running sweep has no capacity-at-rate for its lower rates) or with fewer than two
+    // distinct rates
+    bool fitPeukert(float& k) const {
+        if (completed < count) return false;
+        float sx = 0, sy = 0, sxx = 0, sxy = 0;
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < completed; i++) {
+            float capacity = getCapacityAt(i);
+            float currentMA = getMeanCurrentMA(i);
+            if (capacity <= 0 || currentMA <= 0) continue;
+            float x = logf(currentMA);
+            float y = logf(capacity / currentMA);   // Hours at that rate
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+            n++;
+        }
+        float d = n * sxx - sx * sx;
+        if (n < 2 || d < 1e-6f) return false;
+        k = -(n * sxy - sx * sy) / d;
+        return true;
+    }
+};
+
+// Global discharge plan instance
+DischargePlan dischargePlan;
+
+#endif // DISCHARGE_PLAN_H
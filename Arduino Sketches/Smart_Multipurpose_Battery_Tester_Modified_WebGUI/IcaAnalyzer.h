@@ -0,0 +1,248 @@
+#ifndef ICA_ANALYZER_H
+#define ICA_ANALYZER_H
+
+// ========================================= INCREMENTAL CAPACITY ANALYSIS ========================================
+// Streaming dQ/dV of an Analyze discharge. Peaks in dQ/dV mark the cell's phase
+// transitions; their voltage and height shift as the cell ages (lithium inventory loss
+// moves them, active material loss shrinks them), which capacity alone cannot show.
+//
+//   bin      the discharged charge since the last sample goes to the ICA_BIN_MV bucket of
+//            the lowest voltage seen so far (discharge voltage only falls; upward noise
+//            and relaxation don't move it back). Charge is kept in 0.01 mAh, so a bin's
+//            count reads directly as dQ/dV in mAh/V
+//   smooth   5-point quadratic Savitzky-Golay (-3, 12, 17, 12, -3) / 35 in integer maths,
+//            applied to each bin once it and its neighbours are final
+//   peaks    local maxima of the smoothed curve are kept as candidates as they finalise;
+//            the ICA_MAX_PEAKS most prominent ones above ICA_MIN_PROMINENCE_PCT of the
+//            tallest are reported
+//
+// Per sample cost is O(1) plus one kernel evaluation per bin crossed. The sketch feeds
+// IR-compensated voltage so both staged-discharge currents land on the same curve.
+
+#define ICA_BIN_MV 10
+#define ICA_MIN_MV 2500
+#define ICA_MAX_MV 4300
+#define ICA_BINS ((ICA_MAX_MV - ICA_MIN_MV) / ICA_BIN_MV)
+#define ICA_SG_NORM 35
+#define ICA_MAX_PEAKS 4
+#define ICA_MAX_CANDIDATES 12
+#define ICA_MIN_PROMINENCE_PCT 10      // Of the tallest peak
+#define ICA_MIN_MAH 300                // Shorter runs give no summary
+
+static const int8_t ICA_SG_KERNEL[5] = {-3, 12, 17, 12, -3};
+
+struct IcaPeak {
+    uint16_t mv;          // Bin centre
+    uint16_t height;      // Smoothed dQ/dV, mAh/V
+};
+
+// Result of one run - also the NVS record format, so keep it plain data
+struct IcaSummary {
+    float capacityMAh;
+    uint8_t peakCount;
+    uint8_t reserved[3];
+    IcaPeak peaks[ICA_MAX_PEAKS];   // Highest voltage first
+};
+
+class IcaAnalyzer {
+private:
+    bool active;
+    int32_t bins[ICA_BINS];     // Charge per bin, 0.01 mAh
+    int16_t currentBin;         // Bin of the lowest voltage so far (-1 before the first sample)
+    int16_t highBin;            // First bin of the run
+    int16_t nextSmooth;         // Next bin to smooth and check for a peak
+    int32_t lastCmah;
+    int32_t prevSmoothed[2];    // Smoothed values of the two bins above nextSmooth
+
+    IcaPeak candidates[ICA_MAX_CANDIDATES];
+    uint8_t candidateCount;
+
+    int16_t binOf(float mv) const {
+        int16_t b = (int16_t)((mv - ICA_MIN_MV) / ICA_BIN_MV);
+        if (b < 0) return 0;
+        if (b >= ICA_BINS) return ICA_BINS - 1;
+        return b;
+    }
+
+    int32_t rawAt(int16_t b) const {
+        return (b < 0 || b >= ICA_BINS) ? 0 : bins[b];
+    }
+
+    void addCandidate(int16_t bin, int32_t height) {
+        if (height > 65535) height = 65535;
+        IcaPeak peak = {binCentreMV(bin), (uint16_t)height};
+        if (candidateCount < ICA_MAX_CANDIDATES) {
+            candidates[candidateCount++] = peak;
+            return;
+        }
+        // Full: replace the smallest if this one is taller
+        uint8_t smallest = 0;
+        for (uint8_t i = 1; i < candidateCount; i++) {
+            if (candidates[i].height < candidates[smallest].height) smallest = i;
+        }
+        if (peak.height > candidates[smallest].height) {
+            candidates[smallest] = peak;
+        }
+    }
+
+    // Smooth bins down to (and including) lastBin, checking each for a peak one bin above
+    void advance(int16_t lastBin) {
+        while (nextSmooth >= lastBin && nextSmooth >= 0) {
+            int32_t s = smoothedAt(nextSmooth);
+            // Bin above is a local max if it beats both neighbours (ties go to the higher voltage)
+            if (nextSmooth + 1 < highBin && prevSmoothed[0] > s && prevSmoothed[0] >= prevSmoothed[1]) {
+                addCandidate(nextSmooth + 1, prevSmoothed[0]);
+            }
+            prevSmoothed[1] = prevSmoothed[0];
+            prevSmoothed[0] = s;
+            nextSmooth--;
+        }
+    }
+
+    // Prominence: height above the higher of the lowest points between the peak and a
+    // taller candidate (or the curve end) on each side
+    int32_t prominence(const IcaPeak& peak) const {
+        int16_t bin = binOf(peak.mv);
+        int32_t leftMin = peak.height, rightMin = peak.height;
+        for (int16_t b = bin + 1; b <= highBin; b++) {
+            int32_t s = smoothedAt(b);
+            if (s > (int32_t)peak.height) break;
+            if (s < rightMin) rightMin = s;
+        }
+        for (int16_t b = bin - 1; b >= currentBin; b--) {
+            int32_t s = smoothedAt(b);
+            if (s > (int32_t)peak.height) break;
+            if (s < leftMin) leftMin = s;
+        }
+        return peak.height - ((leftMin > rightMin) ? leftMin : rightMin);
+    }
+
+public:
+    IcaAnalyzer() : active(false), currentBin(-1), highBin(-1), nextSmooth(-1), lastCmah(0), candidateCount(0) {
+        memset(bins, 0, sizeof(bins));
+        prevSmoothed[0] = prevSmoothed[1] = 0;
+    }
+
+    // Discharge is starting from zero capacity
+    void begin() {
+        memset(bins, 0, sizeof(bins));
+        currentBin = -1;
+        highBin = -1;
+        nextSmooth = -1;
+        lastCmah = 0;
+        prevSmoothed[0] = prevSmoothed[1] = 0;
+        candidateCount = 0;
+        active = true;
+    }
+
+    void cancel() {
+        active = false;
+    }
+
+    bool isActive() const {
+        return active;
+    }
+
+    bool hasCurve() const {
+        return currentBin >= 0;
+    }
+
+    // One sample: IR-compensated cell voltage and discharged capacity so far
+    void addSample(float volts, float capacityMAh) {
+        if (!active) return;
+        int32_t cmah = (int32_t)(capacityMAh * 100.0f);
+        int16_t bin = binOf(volts * 1000.0f);
+
+        if (currentBin < 0) {
+            currentBin = bin;
+            highBin = bin;
+            nextSmooth = bin + 2;   // Kernel reaches two empty bins above the start
+            lastCmah = cmah;
+            return;
+        }
+        if (bin < currentBin) {
+            currentBin = bin;
+            advance(currentBin + 3);   // Bins more than two above the active one are final
+        }
+        bins[currentBin] += cmah - lastCmah;
+        lastCmah = cmah;
+    }
+
+    // Smoothed dQ/dV of a bin in mAh/V (clamped at 0)
+    int32_t smoothedAt(int16_t b) const {
+        int32_t acc = 0;
+        for (int8_t k = -2; k <= 2; k++) {
+            acc += ICA_SG_KERNEL[k + 2] * rawAt(b + k);
+        }
+        acc = (acc + ICA_SG_NORM / 2) / ICA_SG_NORM;
+        return (acc > 0) ? acc : 0;
+    }
+
+    // Most prominent candidates, highest voltage first. Works mid-run for live display.
+    uint8_t selectPeaks(IcaPeak* out) const {
+        int32_t tallest = 0;
+        for (uint8_t i = 0; i < candidateCount; i++) {
+            if (candidates[i].height > tallest) tallest = candidates[i].height;
+        }
+
+        int32_t prom[ICA_MAX_CANDIDATES];
+        for (uint8_t i = 0; i < candidateCount; i++) {
+            prom[i] = prominence(candidates[i]);
+        }
+
+        uint8_t count = 0;
+        bool used[ICA_MAX_CANDIDATES] = {false};
+        while (count < ICA_MAX_PEAKS) {
+            int8_t best = -1;
+            for (uint8_t i = 0; i < candidateCount; i++) {
+                if (used[i] || prom[i] * 100 < tallest * ICA_MIN_PROMINENCE_PCT) continue;
+                if (best < 0 || prom[i] > prom[best]) best = i;
+            }
+            if (best < 0) break;
+            used[best] = true;
+            out[count++] = candidates[best];
+        }
+
+        // Highest voltage first
+        for (uint8_t i = 1; i < count; i++) {
+            for (uint8_t j = i; j > 0 && out[j].mv > out[j - 1].mv; j--) {
+                IcaPeak t = out[j];
+                out[j] = out[j - 1];
+                out[j - 1] = t;
+            }
+        }
+        return count;
+    }
+
+    // Cutoff reached: smooth the remaining bins and fill the summary.
+    // Returns false if the run is too short to be worth keeping.
+    bool finish(float capacityMAh, IcaSummary& out) {
+        if (!active) return false;
+        active = false;
+        if (currentBin < 0) return false;
+        advance(currentBin - 2);
+
+        memset(&out, 0, sizeof(out));
+        out.capacityMAh = capacityMAh;
+        out.peakCount = selectPeaks(out.peaks);
+        return capacityMAh >= ICA_MIN_MAH;
+    }
+
+    // Curve range for publishing: bins [getLowBin(), getHighBin()]
+    int16_t getLowBin() const {
+        return (currentBin > 2) ? currentBin - 2 : 0;
+    }
+
+    int16_t getHighBin() const {
+        return highBin;
+    }
+
+    uint16_t binCentreMV(int16_t b) const {
+        return ICA_MIN_MV + b * ICA_BIN_MV + ICA_BIN_MV / 2;
+    }
+};
+
+// Global ICA instance
+IcaAnalyzer icaAnalyzer;
+
+#endif // ICA_ANALYZER_H
@@ -0,0 +1,184 @@
+#ifndef OCV_LEARNER_H
+#define OCV_LEARNER_H
+
+#include "OcvTable.h"
+
+// ========================================= OCV TABLE LEARNING ========================================
+// Builds an OCV -> SoC table from one Analyze discharge:
+//
+//   full, rested   OCV at 100% = voltage at the end of the Analyze rest
+//   load step      R = (rested V - loaded V) / I, read OCV_LEARN_IR_DELAY_MS after the step
+//   discharge      OCV estimate = V + I*R against discharged mAh (compact, self-decimating series)
+//   end rest       after cutoff the cell rests OCV_LEARN_END_REST_MS; the relaxed voltage
+//                  replaces the 0% point, where IR compensation alone misses the polarisation
+//
+// SoC of each sample = 100% x (1 - mAh / total mAh). The series is resampled to the
+// 11 table points and forced monotonic. Runs that are aborted, too short or give an
+// implausible resistance are not learned.
+
+#define OCV_LEARN_MAX_POINTS 64        // Series buffer; spacing doubles whenever it fills
+#define OCV_LEARN_START_STEP_MAH 5.0f  // Initial spacing between stored points
+#define OCV_LEARN_IR_DELAY_MS 2000     // Load settle time before the IR step is read
+#define OCV_LEARN_END_REST_MS 180000   // Rest after cutoff (same as the Analyze rest)
+#define OCV_LEARN_MIN_MAH 300          // Shorter discharges are not learned
+
+enum OcvLearnState : uint8_t {
+    OCV_LEARN_IDLE,
+    OCV_LEARN_WAIT_IR,
+    OCV_LEARN_DISCHARGE,
+    OCV_LEARN_END_REST
+};
+
+class OcvLearner {
+private:
+    OcvLearnState state;
+    uint32_t markMs;         // Load start (WAIT_IR) or cutoff time (END_REST)
+    float fullMV;            // Rested OCV before the discharge
+    float emptyMV;           // Relaxed OCV after cutoff (0 until measured)
+    float irOhms;
+    float totalMAh;
+
+    // Discharge series
+    float stepMAh;
+    uint8_t count;
+    float pointMAh[OCV_LEARN_MAX_POINTS];
+    uint16_t pointMV[OCV_LEARN_MAX_POINTS];
+
+    // Keep every other point and double the spacing
+    void decimate() {
+        uint8_t kept = 0;
+        for (uint8_t i = 0; i < count; i += 2) {
+            pointMAh[kept] = pointMAh[i];
+            pointMV[kept] = pointMV[i];
+            kept++;
+        }
+        count = kept;
+        stepMAh *= 2;
+    }
+
+    // OCV estimate at a given discharged capacity (linear between stored points)
+    float ocvAt(float mAh) const {
+        if (mAh <= 0) return fullMV;
+        if (count == 0) return fullMV;
+        if (mAh <= pointMAh[0]) {
+            return fullMV + (pointMV[0] - fullMV) * mAh / pointMAh[0];
+        }
+        for (uint8_t i = 1; i < count; i++) {
+            if (mAh <= pointMAh[i]) {
+                float frac = (mAh - pointMAh[i - 1]) / (pointMAh[i] - pointMAh[i - 1]);
+                return pointMV[i - 1] + frac * (pointMV[i] - pointMV[i - 1]);
+            }
+        }
+        return pointMV[count - 1];
+    }
+
+public:
+    OcvLearner() : state(OCV_LEARN_IDLE), markMs(0), fullMV(0), emptyMV(0), irOhms(0), totalMAh(0),
+                   stepMAh(OCV_LEARN_START_STEP_MAH), count(0) {}
+
+    // Analyze rest finished, load about to be applied
+    void begin(uint32_t now, float restedVolts) {
+        state = OCV_LEARN_WAIT_IR;
+        markMs = now;
+        fullMV = restedVolts * 1000.0f;
+        emptyMV = 0;
+        irOhms = 0;
+        totalMAh = 0;
+        stepMAh = OCV_LEARN_START_STEP_MAH;
+        count = 0;
+    }
+
+    void cancel() {
+        state = OCV_LEARN_IDLE;
+    }
+
+    OcvLearnState getState() const {
+        return state;
+    }
+
+    float getIrOhms() const {
+        return irOhms;
+    }
+
+    // One discharge sample: loaded voltage, load current, discharged capacity so far
+    void addSample(uint32_t now, float volts, float currentMA, float capacityMAh) {
+        float mv = volts * 1000.0f;
+        if (state == OCV_LEARN_WAIT_IR) {
+            if (now - markMs < OCV_LEARN_IR_DELAY_MS) return;
+            float r = (currentMA > 0) ? (fullMV - mv) / currentMA : 0;  // mV / mA = ohms
+            if (r < 0.005f || r > 1.0f) {
+                state = OCV_LEARN_IDLE;  // Not a clean step - don't learn from this run
+                return;
+            }
+            irOhms = r;
+            state = OCV_LEARN_DISCHARGE;
+        }
+        if (state != OCV_LEARN_DISCHARGE) return;
+        if (count > 0 && capacityMAh - pointMAh[count - 1] < stepMAh) return;
+
+        if (count == OCV_LEARN_MAX_POINTS) {
+            decimate();
+            if (capacityMAh - pointMAh[count - 1] < stepMAh) return;
+        }
+        pointMAh[count] = capacityMAh;
+        pointMV[count] = (uint16_t)(mv + currentMA * irOhms);
+        count++;
+    }
+
+    // Cutoff reached: start the end rest
+    void endDischarge(uint32_t now, float capacityMAh) {
+        if (state != OCV_LEARN_DISCHARGE) {
+            state = OCV_LEARN_IDLE;
+            return;
+        }
+        totalMAh = capacityMAh;
+        markMs = now;
+        state = OCV_LEARN_END_REST;
+    }
+
+    // Resting voltage after cutoff; returns true once the rest is complete
+    bool addRestSample(uint32_t now, float volts) {
+        if (state != OCV_LEARN_END_REST) return false;
+        if (now - markMs < OCV_LEARN_END_REST_MS) return false;
+        emptyMV = volts * 1000.0f;
+        return true;
+    }
+
+    // Seconds of end rest still to go (0 when not resting)
+    uint32_t getRestRemaining(uint32_t now) const {
+        if (state != OCV_LEARN_END_REST) return 0;
+        uint32_t elapsed = now - markMs;
+        return (elapsed >= OCV_LEARN_END_REST_MS) ? 0 : (OCV_LEARN_END_REST_MS - elapsed) / 1000;
+    }
+
+    // Build the table. Can be called before the end rest completes, in which case the
+    // 0% point is the IR-compensated cutoff voltage. Returns false if the run is unusable.
+    bool finish(OcvTable& out) {
+        bool usable = (state == OCV_LEARN_END_REST) && totalMAh >= OCV_LEARN_MIN_MAH && count >= 4;
+        state = OCV_LEARN_IDLE;
+        if (!usable) return false;
+
+        for (uint8_t i = 0; i < OCV_TABLE_POINTS; i++) {
+            float soc = i * OCV_SOC_STEP;
+            float mv = ocvAt(totalMAh * (1.0f - soc / 100.0f));
+            out.mv[i] = (uint16_t)(mv + 0.5f);
+        }
+        out.mv[OCV_TABLE_POINTS - 1] = (uint16_t)(fullMV + 0.5f);
+        if (emptyMV > 0 && emptyMV < out.mv[1]) {
+            out.mv[0] = (uint16_t)(emptyMV + 0.5f);
+        }
+
+        // Noise can leave small dips; force strictly rising
+        for (uint8_t i = 1; i < OCV_TABLE_POINTS; i++) {
+            if (out.mv[i] <= out.mv[i - 1]) {
+                out.mv[i] = out.mv[i - 1] + 1;
+            }
+        }
+        return ocvTableValid(out);
+    }
+};
+
+// Global learner instance
+OcvLearner ocvLearner;
+
+#endif // OCV_LEARNER_H
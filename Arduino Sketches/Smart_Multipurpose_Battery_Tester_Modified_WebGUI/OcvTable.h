@@ -0,0 +1,159 @@
+#ifndef OCV_TABLE_H
+#define OCV_TABLE_H
+
+// ========================================= OCV / SOC TABLE ========================================
+// Relaxed open-circuit voltage vs state of charge, 0..100% in 10% steps.
+// Gives an instant SoC estimate from a resting voltage (Bat Check, web UI) and
+// turns a storage target in % SoC into a target OCV. Lookups interpolate linearly
+// between points; SoC -> OCV is O(1), OCV -> SoC binary-searches the voltage column.
+//
+// Tables live in OCV_SLOT_COUNT named slots (one per chemistry/cell type) in NVS.
+// Completed Analyze runs are learned into the active slot (see OcvLearner.h);
+// an unlearned slot uses the generic Li-ion default.
+
+#define OCV_TABLE_POINTS 11  // 0%, 10%, ... 100%
+#define OCV_SOC_STEP 10      // % between points
+#define OCV_SLOT_COUNT 4
+#define OCV_SLOT_NAME_LEN 12
+#define OCV_BLEND_RUNS 8     // Learned table is a running mean over about this many runs
+
+struct OcvTable {
+    uint16_t mv[OCV_TABLE_POINTS];
+};
+
+// Generic Li-ion NMC/graphite 18650 at room temperature
+static const OcvTable OCV_TABLE_LIION_DEFAULT = {
+    {3000, 3450, 3570, 3640, 3700, 3760, 3830, 3920, 4010, 4090, 4190}
+};
+
+// A usable table rises strictly with SoC and stays inside single-cell limits
+inline bool ocvTableValid(const OcvTable& table) {
+    if (table.mv[0] < 2500 || table.mv[OCV_TABLE_POINTS - 1] > 4400) {
+        return false;
+    }
+    for (uint8_t i = 1; i < OCV_TABLE_POINTS; i++) {
+        if (table.mv[i] <= table.mv[i - 1]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// OCV (mV) -> SoC (%), clamped to 0..100
+inline float ocvToSoc(const OcvTable& table, float mv) {
+    if (mv <= table.mv[0]) return 0;
+    if (mv >= table.mv[OCV_TABLE_POINTS - 1]) return 100;
+
+    // Find the segment with mv[lo] <= mv < mv[hi]
+    uint8_t lo = 0;
+    uint8_t hi = OCV_TABLE_POINTS - 1;
+    while (hi - lo > 1) {
+        uint8_t mid = (lo + hi) / 2;
+        if (table.mv[mid] <= mv) lo = mid;
+        else hi = mid;
+    }
+    float frac = (mv - table.mv[lo]) / (float)(table.mv[hi] - table.mv[lo]);
+    return (lo + frac) * OCV_SOC_STEP;
+}
+
+// SoC (%) -> OCV (mV), clamped to the table ends
+inline float socToOcv(const OcvTable& table, float soc) {
+    if (soc <= 0) return table.mv[0];
+    if (soc >= 100) return table.mv[OCV_TABLE_POINTS - 1];
+
+    uint8_t lo = (uint8_t)(soc / OCV_SOC_STEP);
+    float frac = (soc - lo * OCV_SOC_STEP) / OCV_SOC_STEP;
+    return table.mv[lo] + frac * (table.mv[lo + 1] - table.mv[lo]);
+}
+
+// Stored slot - also the NVS record format, so keep it plain data
+struct OcvSlot {
+    char name[OCV_SLOT_NAME_LEN];
+    uint8_t runs;            // Analyze runs learned (0 = default table)
+    uint8_t reserved[3];
+    OcvTable table;
+};
+
+class OcvLibrary {
+private:
+    OcvSlot slots[OCV_SLOT_COUNT];
+    uint8_t active;
+
+public:
+    OcvLibrary() : active(0) {
+        for (uint8_t i = 0; i < OCV_SLOT_COUNT; i++) {
+            resetSlot(i);
+        }
+    }
+
+    // Back to the default table and name
+    void resetSlot(uint8_t index) {
+        if (index >= OCV_SLOT_COUNT) return;
+        memset(&slots[index], 0, sizeof(OcvSlot));
+        snprintf(slots[index].name, OCV_SLOT_NAME_LEN, "Li-ion %u", index + 1);
+        slots[index].table = OCV_TABLE_LIION_DEFAULT;
+    }
+
+    bool rename(uint8_t index, const char* name) {
+        if (index >= OCV_SLOT_COUNT || !name || !name[0]) return false;
+        strncpy(slots[index].name, name, OCV_SLOT_NAME_LEN - 1);
+        slots[index].name[OCV_SLOT_NAME_LEN - 1] = 0;
+        return true;
+    }
+
+    bool select(uint8_t index) {
+        if (index >= OCV_SLOT_COUNT) return false;
+        active = index;
+        return true;
+    }
+
+    uint8_t getActive() const {
+        return active;
+    }
+
+    const OcvSlot& getSlot(uint8_t index) const {
+        return slots[index];
+    }
+
+    const OcvTable& activeTable() const {
+        return slots[active].table;
+    }
+
+    // Merge a table learned from one run into the active slot. The first run replaces
+    // the default; later runs are averaged in, which keeps the table monotonic.
+    bool learn(const OcvTable& learned) {
+        if (!ocvTableValid(learned)) return false;
+        OcvSlot& slot = slots[active];
+        if (slot.runs == 0) {
+            slot.table = learned;
+        } else {
+            uint8_t n = (slot.runs < OCV_BLEND_RUNS) ? slot.runs : OCV_BLEND_RUNS;
+            for (uint8_t i = 0; i < OCV_TABLE_POINTS; i++) {
+                int32_t diff = (int32_t)learned.mv[i] - slot.table.mv[i];
+                slot.table.mv[i] += (diff + (diff >= 0 ? (n + 1) / 2 : -(n + 1) / 2)) / (n + 1);
+            }
+        }
+        if (slot.runs < 255) slot.runs++;
+        return true;
+    }
+
+    // Raw access for NVS persistence
+    const OcvSlot* data() const {
+        return slots;
+    }
+
+    void load(const OcvSlot* stored, uint8_t count, uint8_t activeSlot) {
+        for (uint8_t i = 0; i < count && i < OCV_SLOT_COUNT; i++) {
+            if (ocvTableValid(stored[i].table)) {
+                slots[i] = stored[i];
+                slots[i].name[OCV_SLOT_NAME_LEN - 1] = 0;
+            }
+        }
+        select(activeSlot);
+    }
+};
+
+// Global table library
+OcvLibrary ocvLibrary;
+
+#endif // OCV_TABLE_H
@@ -0,0 +1,178 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <WiFi.h>
+#include <esp_sleep.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
+
+// ========================================= POWER MANAGEMENT ========================================
+// Three levels, chosen every loop pass by the sketch:
+//
+//   active       control states (charge, discharge, analyze, IR, storage): full clock, radio awake
+//   idle         menu, results and monitoring screens: POWER_IDLE_MHZ clock, and WiFi modem
+//                sleep when running as a station only (a softAP cannot sleep). The station
+//                wakes for every DTIM beacon, so buffered WebSocket traffic is delayed by at
+//                most one DTIM period; clients are pinged every POWER_WS_KEEPALIVE_S
+//   light sleep  idle, no clients and no input for POWER_SLEEP_AFTER_MS (the sketch only allows
+//                it in STA-only mode): the CPU sleeps POWER_LIGHT_SLEEP_MS at a time between
+//                loop passes. Any button (active low) wakes it through GPIO wakeup
+//
+// Time in each level is accumulated to report the sleep fraction and an estimated average
+// supply current (datasheet figures, not a measurement). Wake latency is how long after its
+// requested time a timer wake gets back to running code.
+
+#define POWER_ACTIVE_MHZ 160
+#define POWER_IDLE_MHZ 80              // Lowest clock that keeps WiFi running
+#define POWER_SLEEP_AFTER_MS 60000     // No buttons, commands or clients for this long
+#define POWER_LIGHT_SLEEP_MS 1000      // One light sleep period
+#define POWER_WS_KEEPALIVE_S 10        // WebSocket ping period
+#define POWER_MAX_WAKE_PINS 4
+
+// Estimated board supply current per level (ESP32-C3 datasheet + OLED), mA
+#define POWER_ACTIVE_MA 85
+#define POWER_IDLE_MA 35
+#define POWER_SLEEP_MA 12
+
+enum PowerLevel : uint8_t {
+    POWER_LEVEL_ACTIVE,
+    POWER_LEVEL_IDLE,
+    POWER_LEVEL_SLEEP
+};
+
+static const char* const POWER_LEVEL_NAMES[] = {"active", "idle", "sleep"};
+
+class PowerManager {
+private:
+    PowerLevel level;
+    bool modemSleep;
+    uint32_t lastActivityMs;
+
+    // Accumulated time per level (ms)
+    uint64_t levelMs[3];
+    int64_t levelStartUs;
+
+    uint32_t wakeCount;
+    uint32_t buttonWakes;
+    uint32_t lastWakeLatencyUs;
+    uint32_t maxWakeLatencyUs;
+
+    void account(PowerLevel next) {
+        int64_t now = esp_timer_get_time();
+        levelMs[level] += (now - levelStartUs) / 1000;
+        levelStartUs = now;
+        level = next;
+    }
+
+public:
+    PowerManager() : level(POWER_LEVEL_ACTIVE), modemSleep(false), lastActivityMs(0), levelStartUs(0),
+                     wakeCount(0), buttonWakes(0), lastWakeLatencyUs(0), maxWakeLatencyUs(0) {
+        levelMs[0] = levelMs[1] = levelMs[2] = 0;
+    }
+
+    // Buttons that may wake the CPU from light sleep (pressed = low)
+    void begin(const uint8_t* wakePins, uint8_t count) {
+        for (uint8_t i = 0; i < count && i < POWER_MAX_WAKE_PINS; i++) {
+            gpio_wakeup_enable((gpio_num_t)wakePins[i], GPIO_INTR_LOW_LEVEL);
+        }
+        esp_sleep_enable_gpio_wakeup();
+        levelStartUs = esp_timer_get_time();
+        setCpuFrequencyMhz(POWER_ACTIVE_MHZ);
+    }
+
+    // Button press or command: postpones light sleep
+    void noteActivity(uint32_t now) {
+        lastActivityMs = now;
+    }
+
+    // Pick active or idle for this loop pass. Modem sleep only applies in STA-only mode.
+    void setIdle(bool idle) {
+        PowerLevel next = idle ? POWER_LEVEL_IDLE : POWER_LEVEL_ACTIVE;
+        if (next != level) {
+            account(next);
+            setCpuFrequencyMhz(idle ? POWER_IDLE_MHZ : POWER_ACTIVE_MHZ);
+        }
+        bool wantModemSleep = idle && WiFi.getMode() == WIFI_STA;
+        if (wantModemSleep != modemSleep) {
+            WiFi.setSleep(wantModemSleep ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE);
+            modemSleep = wantModemSleep;
+        }
+    }
+
+    // Idle long enough and nothing to serve (busy = clients, radio bring-up, tones)
+    bool canSleep(uint32_t now, bool busy) const {
+        return level == POWER_LEVEL_IDLE && !busy && now - lastActivityMs >= POWER_SLEEP_AFTER_MS;
+    }
+
+    // Sleep one period; a button press ends it early
+    void lightSleep() {
+        account(POWER_LEVEL_SLEEP);
+        int64_t entryUs = levelStartUs;
+        esp_sleep_enable_timer_wakeup((uint64_t)POWER_LIGHT_SLEEP_MS * 1000);
+        esp_light_sleep_start();
+        int64_t wokeUs = esp_timer_get_time();
+
+        uint32_t latency;
+        if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_GPIO) {
+            buttonWakes++;
+            latency = 0;  // Press time unknown; only timer wakes give a latency figure
+        } else {
+            int64_t late = wokeUs - entryUs - (int64_t)POWER_LIGHT_SLEEP_MS * 1000;
+            latency = (late > 0) ? (uint32_t)late : 0;
+        }
+        if (latency > 0) {
+            lastWakeLatencyUs = latency;
+            if (latency > maxWakeLatencyUs) maxWakeLatencyUs = latency;
+        }
+        wakeCount++;
+        account(POWER_LEVEL_IDLE);
+    }
+
+    PowerLevel getLevel() const {
+        return level;
+    }
+
+    const char* getLevelName() const {
+        return POWER_LEVEL_NAMES[level];
+    }
+
+    bool isModemSleep() const {
+        return modemSleep;
+    }
+
+    // Fraction of time since boot spent in light sleep (0..1)
+    float getSleepFraction() const {
+        uint64_t total = levelMs[0] + levelMs[1] + levelMs[2];
+        return total ? (float)levelMs[POWER_LEVEL_SLEEP] / total : 0;
+    }
+
+    // Time-weighted estimate of the average supply current since boot
+    float getAverageMA() const {
+        uint64_t total = levelMs[0] + levelMs[1] + levelMs[2];
+        if (total == 0) return POWER_ACTIVE_MA;
+        return ((float)levelMs[POWER_LEVEL_ACTIVE] * POWER_ACTIVE_MA +
+                (float)levelMs[POWER_LEVEL_IDLE] * POWER_IDLE_MA +
+                (float)levelMs[POWER_LEVEL_SLEEP] * POWER_SLEEP_MA) / total;
+    }
+
+    uint32_t getWakeCount() const {
+        return wakeCount;
+    }
+
+    uint32_t getButtonWakes() const {
+        return buttonWakes;
+    }
+
+    uint32_t getLastWakeLatencyUs() const {
+        return lastWakeLatencyUs;
+    }
+
+    uint32_t getMaxWakeLatencyUs() const {
+        return maxWakeLatencyUs;
+    }
+};
+
+// Global power manager instance
+PowerManager powerManager;
+
+#endif // POWER_MANAGER_H
@@ -0,0 +1,328 @@
+#ifndef SELF_DISCHARGE_TEST_H
+#define SELF_DISCHARGE_TEST_H
+
+#include <math.h>
+
+// ========================================= SELF-DISCHARGE TEST ========================================
+// Screens cells for internal leakage: after an optional charge, the cell sits open circuit
+// for SD hours while the OCV is read every few minutes. The decay slope (mV/day) is fitted
+// incrementally and a cell falling faster than the limit is flagged.
+//
+//   settle     the first SD_SETTLE_MS after the charge are stored but not fitted - that drop
+//              is relaxation, not leakage
+//   fit        least squares on running sums (O(1) per sample). Each sample's residual is
+//              checked against a running robust scale (mean absolute residual, Huber-clipped)
+//              widened by the line's own prediction uncertainty at that time, so an early
+//              line fitted over a short span does not reject later samples for drifting off
+//              it. Samples more than SD_OUTLIER_K of that off are stored but not fitted; their
+//              clipped residual still feeds the scale. After SD_MAX_REJECT_RUN rejections in a
+//              row the line itself is taken to be wrong and is refitted from the stored samples
+//   verdict    pending until SD_MIN_FIT_MS of fitted data, then pass/fail on the slope. A run
+//              that ends still pending (shorter than SD_MIN_HOURS) has no verdict at all
+//
+// Samples are stored as {minutes, 0.1mV} pairs. When the buffer fills, every other sample is
+// dropped and the stored spacing doubles, so any duration fits.
+
+#define SD_MAX_SAMPLES 384
+#define SD_DEFAULT_INTERVAL_MIN 10
+#define SD_DEFAULT_HOURS 48
+#define SD_DEFAULT_LIMIT_MV_DAY 5.0f   // Healthy Li-ion loses well under this after relaxing
+#define SD_SETTLE_MS 7200000UL         // 2 h relaxation after charge
+#define SD_MIN_FIT_MS 43200000UL       // 12 h of fitted data before a verdict
+#define SD_MIN_HOURS ((SD_SETTLE_MS + SD_MIN_FIT_MS) / 3600000UL)  // Shortest run that can give one
+#define SD_OUTLIER_K 4.0f              // Residual limit in robust scales
+#define SD_INITIAL_SCALE_MV 0.5f       // Robust scale before enough samples
+#define SD_MIN_FIT_SAMPLES 6           // Outlier rejection starts after this many fitted samples
+#define SD_MAX_REJECT_RUN 3            // Consecutive rejections that trigger a refit
+
+enum SdPhase : uint8_t {
+    SD_PHASE_CHARGE,
+    SD_PHASE_MONITOR,
+    SD_PHASE_DONE
+};
+
+enum SdVerdict : uint8_t {
+    SD_VERDICT_PENDING,
+    SD_VERDICT_PASS,
+    SD_VERDICT_FAIL
+};
+
+static const char* const SD_PHASE_NAMES[] = {"charge", "monitor", "done"};
+static const char* const SD_VERDICT_NAMES[] = {"pending", "pass", "fail"};
+
+// Stored sample - 4 bytes
+struct SdSample {
+    uint16_t minutes;     // Since monitoring started
+    uint16_t decimv;      // OCV in 0.1 mV
+};
+
+class SelfDischargeTest {
+private:
+    SdPhase phase;
+    SdVerdict verdict;
+    uint16_t intervalMin;
+    uint16_t hours;
+    float limitMvPerDay;
+
+    uint32_t monitorStartMs;
+    uint32_t nextSampleMs;
+
+    SdSample samples[SD_MAX_SAMPLES];
+    uint16_t count;
+    uint16_t keepEvery;   // Store one in this many readings
+    uint32_t readings;    // Total readings taken
+
+    // Regression on (days since first fitted sample, mV relative to it)
+    double sumT, sumV, sumTT, sumTV, sumVV;
+    uint16_t fitCount;
+    uint16_t outliers;
+    uint8_t rejectRun;    // Consecutive rejected samples
+    float t0Days, v0Mv;
+    float scaleMv;        // Running mean absolute residual
+
+    void store(uint16_t minutes, float mv) {
+        if (count == SD_MAX_SAMPLES) {
+            uint16_t kept = 0;
+            for (uint16_t i = 0; i < count; i += 2) {
+                samples[kept++] = samples[i];
+            }
+            count = kept;
+            keepEvery *= 2;
+        }
+        samples[count].minutes = minutes;
+        samples[count].decimv = (uint16_t)(mv * 10.0f + 0.5f);
+        count++;
+    }
+
+    void accumulate(float days, float mv) {
+        if (fitCount == 0) {
+            t0Days = days;
+            v0Mv = mv;
+        }
+        float t = days - t0Days;
+        float v = mv - v0Mv;
+        sumT += t;
+        sumV += v;
+        sumTT += (double)t * t;
+        sumTV += (double)t * v;
+        sumVV += (double)v * v;
+        fitCount++;
+    }
+
+    void clearFit() {
+        sumT = sumV = sumTT = sumTV = sumVV = 0;
+        fitCount = 0;
+        rejectRun = 0;
+    }
+
+    // Prediction variance of the line at t, in units of the residual variance:
+    // 1 + 1/n + (t - mean t)^2 / Sxx
+    float predictionFactor(float t) const {
+        double sxx = denominator() / fitCount;
+        if (sxx <= 0) return 1;
+        double dt = t - sumT / fitCount;
+        return (float)(1.0 + 1.0 / fitCount + dt * dt / sxx);
+    }
+
+    // Rebuild the fit from every stored sample after the settle period, without
+    // rejection, and restart the scale from their mean absolute residual
+    void refit() {
+        clearFit();
+        const uint16_t settleMin = SD_SETTLE_MS / 60000UL;
+        for (uint16_t i = 0; i < count; i++) {
+            if (samples[i].minutes >= settleMin) {
+                accumulate(samples[i].minutes / 1440.0f, samples[i].decimv / 10.0f);
+            }
+        }
+        float sum = 0;
+        for (uint16_t i = 0; i < count; i++) {
+            if (samples[i].minutes >= settleMin) {
+                float t = samples[i].minutes / 1440.0f - t0Days;
+                float v = samples[i].decimv / 10.0f - v0Mv;
+                sum += fabsf(v - (getIntercept() + getSlope() * t));
+            }
+        }
+        scaleMv = fitCount ? sum / fitCount : SD_INITIAL_SCALE_MV;
+        if (scaleMv < 0.05f) scaleMv = 0.05f;
+    }
+
+    void fit(float days, float mv) {
+        if (fitCount >= SD_MIN_FIT_SAMPLES) {
+            float t = days - t0Days;
+            float residual = mv - v0Mv - (getIntercept() + getSlope() * t);
+            float absResidual = fabsf(residual);
+            bool reject = absResidual > SD_OUTLIER_K * scaleMv * sqrtf(predictionFactor(t));
+
+            // Huber-clipped update keeps a single large residual from inflating the scale,
+            // but a run of them (rejected or not) still widens it
+            float clipped = (absResidual > 2.0f * scaleMv) ? 2.0f * scaleMv : absResidual;
+            scaleMv += (clipped - scaleMv) / (fitCount + 1);
+            if (scaleMv < 0.05f) scaleMv = 0.05f;  // Below ADC resolution
+
+            if (reject) {
+                outliers++;
+                if (++rejectRun < SD_MAX_REJECT_RUN) return;
+                // Not isolated spikes: the line is off. Refit, then take this sample too.
+                refit();
+            } else {
+                rejectRun = 0;
+            }
+        }
+        accumulate(days, mv);
+    }
+
+    double denominator() const {
+        return fitCount * sumTT - sumT * sumT;
+    }
+
+    float getIntercept() const {
+        double d = denominator();
+        if (fitCount < 2 || d <= 0) return fitCount ? sumV / fitCount : 0;
+        return (sumV - getSlope() * sumT) / fitCount;
+    }
+
+public:
+    SelfDischargeTest() : phase(SD_PHASE_DONE), verdict(SD_VERDICT_PENDING),
+                          intervalMin(SD_DEFAULT_INTERVAL_MIN), hours(SD_DEFAULT_HOURS),
+                          limitMvPerDay(SD_DEFAULT_LIMIT_MV_DAY), monitorStartMs(0), nextSampleMs(0),
+                          count(0), keepEvery(1), readings(0), sumT(0), sumV(0), sumTT(0), sumTV(0),
+                          sumVV(0), fitCount(0), outliers(0), rejectRun(0), t0Days(0), v0Mv(0),
+                          scaleMv(SD_INITIAL_SCALE_MV) {}
+
+    // Configure and start; with charge the sketch charges first and calls startMonitor()
+    void start(uint16_t interval, uint16_t durationHours, float limit, bool charge) {
+        intervalMin = interval;
+        hours = durationHours;
+        limitMvPerDay = limit;
+        count = 0;
+        keepEvery = 1;
+        readings = 0;
+        clearFit();
+        outliers = 0;
+        scaleMv = SD_INITIAL_SCALE_MV;
+        verdict = SD_VERDICT_PENDING;
+        phase = charge ? SD_PHASE_CHARGE : SD_PHASE_MONITOR;
+    }
+
+    void startMonitor(uint32_t now) {
+        phase = SD_PHASE_MONITOR;
+        monitorStartMs = now;
+        nextSampleMs = now;
+    }
+
+    // True when a reading is due
+    bool sampleDue(uint32_t now) const {
+        return phase == SD_PHASE_MONITOR && (int32_t)(now - nextSampleMs) >= 0;
+    }
+
+    // Add a rested OCV reading; returns true if it was stored (new point for clients)
+    bool addReading(uint32_t now, float volts) {
+        if (phase != SD_PHASE_MONITOR) return false;
+        nextSampleMs += (uint32_t)intervalMin * 60000UL;
+
+        uint32_t elapsed = now - monitorStartMs;
+        float mv = volts * 1000.0f;
+        if (elapsed >= SD_SETTLE_MS) {
+            fit(elapsed / 86400000.0f, mv);
+        }
+
+        bool stored = (readings % keepEvery) == 0;
+        readings++;
+        if (stored) {
+            store((uint16_t)(elapsed / 60000UL), mv);
+        }
+
+        // Verdict only once enough fitted data; a run ending before that stays pending
+        if (elapsed >= (uint32_t)hours * 3600000UL) {
+            phase = SD_PHASE_DONE;
+        }
+        if (fitCount >= 2 && elapsed >= SD_SETTLE_MS + SD_MIN_FIT_MS) {
+            verdict = (-getSlope() > limitMvPerDay) ? SD_VERDICT_FAIL : SD_VERDICT_PASS;
+        }
+        return stored;
+    }
+
+    void stop() {
+        phase = SD_PHASE_DONE;
+    }
+
+    // Decay slope in mV/day (negative = falling)
+    float getSlope() const {
+        double d = denominator();
+        if (fitCount < 2 || d <= 0) return 0;
+        return (fitCount * sumTV - sumT * sumV) / d;
+    }
+
+    // Standard error of the slope in mV/day
+    float getSlopeError() const {
+        double d = denominator();
+        if (fitCount < 3 || d <= 0) return 0;
+        double b = getSlope();
+        double a = getIntercept();
+        double sse = sumVV - 2 * a * sumV - 2 * b * sumTV + a * a * fitCount + 2 * a * b * sumT + b * b * sumTT;
+        if (sse < 0) sse = 0;
+        return sqrt(sse / (fitCount - 2) * fitCount / d);
+    }
+
+    uint32_t getSecondsToNext(uint32_t now) const {
+        if (phase != SD_PHASE_MONITOR || (int32_t)(now - nextSampleMs) >= 0) return 0;
+        return (nextSampleMs - now) / 1000;
+    }
+
+    uint32_t getElapsedMs(uint32_t now) const {
+        return (phase == SD_PHASE_CHARGE) ? 0 : now - monitorStartMs;
+    }
+
+    SdPhase getPhase() const {
+        return phase;
+    }
+
+    const char* getPhaseName() const {
+        return SD_PHASE_NAMES[phase];
+    }
+
+    SdVerdict getVerdict() const {
+        return verdict;
+    }
+
+    const char* getVerdictName() const {
+        return SD_VERDICT_NAMES[verdict];
+    }
+
+    bool isMonitoring() const {
+        return phase == SD_PHASE_MONITOR;
+    }
+
+    uint16_t getIntervalMin() const {
+        return intervalMin;
+    }
+
+    uint16_t getHours() const {
+        return hours;
+    }
+
+    float getLimit() const {
+        return limitMvPerDay;
+    }
+
+    uint16_t getFitCount() const {
+        return fitCount;
+    }
+
+    uint16_t getOutliers() const {
+        return outliers;
+    }
+
+    uint16_t getCount() const {
+        return count;
+    }
+
+    const SdSample& getSample(uint16_t i) const {
+        return samples[i];
+    }
+};
+
+// Global self-discharge test instance
+SelfDischargeTest selfDischargeTest;
+
+#endif // SELF_DISCHARGE_TEST_H
@@ -0,0 +1,286 @@
+#ifndef SERIAL_TELEMETRY_H
+#define SERIAL_TELEMETRY_H
+
+// ========================================= SERIAL TELEMETRY ========================================
+// Framed binary streaming over the USB-CDC serial port for bench logging without WiFi.
+//
+// Wire format (both directions):
+//   0x00 | COBS( payload | CRC16 ) | 0x00
+// The leading delimiter lets the host resynchronise after any debug text printed
+// on the same port. CRC16 is CCITT-FALSE (poly 0x1021, init 0xFFFF), little-endian.
+//
+// Device -> host payload: [type:1][seq:4][body...] (all fields little-endian)
+//   TELEM_FRAME_TICK  body: t_ms:4 state:1 mV:2 mA:2(signed) cap_cmAh:4   (one per control tick)
+//   TELEM_FRAME_ADC   body: t_us:4 channel:1 raw:2                        (one per raw ADC sample)
+//   TELEM_FRAME_ACK   body: accepted:1 cmd:text                           (reply to a command frame)
+//                     cmd is the command's "cmd" value (up to 23 chars), not the raw JSON
+// seq increments for every frame generated, including frames dropped because the
+// TX buffer was full. This is intended: a gap in the sequence seen by the host is a
+// device-side drop (or a frame corrupted on the wire), so drops need no extra counter.
+//
+// Host -> device payload: [TELEM_FRAME_COMMAND][json text]
+// The JSON is the same command format accepted over the WebSocket, e.g.
+//   {"cmd":"telemetry","ticks":true,"raw":false}
+
+#define TELEM_FRAME_TICK    0x01
+#define TELEM_FRAME_ADC     0x02
+#define TELEM_FRAME_ACK     0x11
+#define TELEM_FRAME_COMMAND 0x10
+
+#define TELEM_ADC_CHANNEL_BAT  0
+#define TELEM_ADC_CHANNEL_VREF 1
+
+#define TELEM_MAX_PAYLOAD 64                               // Largest payload before CRC
+#define TELEM_MAX_ENCODED (TELEM_MAX_PAYLOAD + 2 + 2 + 2)  // + CRC, COBS overhead, delimiters
+#define TELEM_RX_BUFFER   256                              // Largest inbound command frame
+
+// Command handler receives the NUL-terminated JSON text of a host command frame
+// and returns true if the command was understood
+typedef bool (*TelemetryCommandHandler)(const char* json, size_t len);
+
+class SerialTelemetry {
+private:
+    Stream* port;
+    uint32_t seq;            // Sequence number of the next frame
+    uint32_t framesSent;     // Frames written to the port
+    uint32_t framesDropped;  // Frames skipped because the TX buffer was full
+    uint32_t rxErrors;       // Inbound frames with bad COBS or CRC
+    uint32_t lastRxMs;       // millis() of the last inbound byte
+    bool streamTicks;
+    bool streamRaw;
+
+    uint8_t rxBuffer[TELEM_RX_BUFFER];
+    uint16_t rxLength;
+    bool rxOverflow;
+
+    // Nibble-wide CRC16-CCITT table: 32 bytes instead of 512 for the byte-wide version
+    static uint16_t crc16(const uint8_t* data, size_t len) {
+        static const uint16_t table[16] = {
+            0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+            0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+        };
+        uint16_t crc = 0xFFFF;
+        for (size_t i = 0; i < len; i++) {
+            crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+            crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+        }
+        return crc;
+    }
+
+    // Standard COBS encoding; output must hold len + len/254 + 1 bytes
+    static size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+        size_t codeIndex = 0;
+        size_t outIndex = 1;
+        uint8_t code = 1;
+        for (size_t i = 0; i < len; i++) {
+            if (in[i] == 0) {
+                out[codeIndex] = code;
+                codeIndex = outIndex++;
+                code = 1;
+            } else {
+                out[outIndex++] = in[i];
+                if (++code == 0xFF) {
+                    out[codeIndex] = code;
+                    codeIndex = outIndex++;
+                    code = 1;
+                }
+            }
+        }
+        out[codeIndex] = code;
+        return outIndex;
+    }
+
+    // In-place COBS decoding; returns decoded length or 0 on malformed input
+    static size_t cobsDecode(uint8_t* buf, size_t len) {
+        size_t in = 0;
+        size_t out = 0;
+        while (in < len) {
+            uint8_t code = buf[in++];
+            if (code == 0 || in + code - 1 > len) {
+                return 0;
+            }
+            for (uint8_t i = 1; i < code; i++) {
+                buf[out++] = buf[in++];
+            }
+            if (code != 0xFF && in < len) {
+                buf[out++] = 0;
+            }
+        }
+        return out;
+    }
+
+    static void putU16(uint8_t* p, uint16_t v) {
+        p[0] = v & 0xFF;
+        p[1] = v >> 8;
+    }
+
+    static void putU32(uint8_t* p, uint32_t v) {
+        p[0] = v & 0xFF;
+        p[1] = (v >> 8) & 0xFF;
+        p[2] = (v >> 16) & 0xFF;
+        p[3] = v >> 24;
+    }
+
+    // Append CRC, COBS-encode and write one frame without blocking
+    void sendFrame(uint8_t* payload, size_t len) {
+        putU32(payload + 1, seq++);
+        putU16(payload + len, crc16(payload, len));
+        len += 2;
+
+        uint8_t encoded[TELEM_MAX_ENCODED];
+        encoded[0] = 0;
+        size_t encodedLen = cobsEncode(payload, len, encoded + 1) + 1;
+        encoded[encodedLen++] = 0;
+
+        // Never stall the control loop on a slow or absent host
+        if (port->availableForWrite() < (int)encodedLen) {
+            framesDropped++;
+            return;
+        }
+        port->write(encoded, encodedLen);
+        framesSent++;
+    }
+
+    // Copy the value of the "cmd" key (e.g. "telemetry") into out; empty if there is none.
+    // Commands are flat objects, so a key scan is enough and avoids a second JSON parse.
+    static void findCommandName(const char* json, char* out, size_t size) {
+        out[0] = 0;
+        const char* p = strstr(json, "\"cmd\"");
+        if (p == nullptr) return;
+        p += 5;
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        if (*p++ != ':') return;
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+        if (*p++ != '"') return;
+        size_t n = 0;
+        while (*p != 0 && *p != '"' && n < size - 1) {
+            out[n++] = *p++;
+        }
+        out[n] = 0;
+    }
+
+    void handleFrame(TelemetryCommandHandler handler) {
+        size_t len = cobsDecode(rxBuffer, rxLength);
+        if (len < 3 || crc16(rxBuffer, len - 2) != (rxBuffer[len - 2] | (rxBuffer[len - 1] << 8))) {
+            rxErrors++;
+            return;
+        }
+        len -= 2;
+        if (rxBuffer[0] != TELEM_FRAME_COMMAND) {
+            rxErrors++;
+            return;
+        }
+
+        // Copy the command name for the ACK before the handler parses the buffer in place.
+        // The terminator overwrites the first CRC byte, so it stays inside the frame poll() bounded.
+        char* json = (char*)rxBuffer + 1;
+        size_t jsonLen = len - 1;
+        json[jsonLen] = 0;
+        char cmdEcho[24];
+        findCommandName(json, cmdEcho, sizeof(cmdEcho));
+
+        bool accepted = handler(json, jsonLen);
+
+        uint8_t payload[TELEM_MAX_PAYLOAD + 2];
+        payload[0] = TELEM_FRAME_ACK;
+        payload[5] = accepted ? 1 : 0;
+        size_t echoLen = strlen(cmdEcho);
+        memcpy(payload + 6, cmdEcho, echoLen);
+        sendFrame(payload, 6 + echoLen);
+    }
+
+public:
+    SerialTelemetry() : port(nullptr), seq(0), framesSent(0), framesDropped(0), rxErrors(0), lastRxMs(0),
+                        streamTicks(false), streamRaw(false), rxLength(0), rxOverflow(false) {}
+
+    void begin(Stream& stream) {
+        port = &stream;
+    }
+
+    void setStreams(bool ticks, bool raw) {
+        streamTicks = ticks;
+        streamRaw = raw;
+    }
+
+    bool isStreaming() const {
+        return streamTicks || streamRaw;
+    }
+
+    bool isStreamingRaw() const {
+        return streamRaw;
+    }
+
+    uint32_t getFramesSent() const {
+        return framesSent;
+    }
+
+    uint32_t getFramesDropped() const {
+        return framesDropped;
+    }
+
+    uint32_t getRxErrors() const {
+        return rxErrors;
+    }
+
+    // Time of the last byte from the host, framed or not (keeps the link awake)
+    uint32_t getLastRxMs() const {
+        return lastRxMs;
+    }
+
+    // One frame per control tick
+    void sendTick(uint8_t state, float voltage, int16_t currentMA, float capacity) {
+        if (!streamTicks || port == nullptr) return;
+
+        uint8_t payload[TELEM_MAX_PAYLOAD + 2];
+        payload[0] = TELEM_FRAME_TICK;
+        putU32(payload + 5, millis());
+        payload[9] = state;
+        putU16(payload + 10, (uint16_t)(voltage * 1000.0f + 0.5f));
+        putU16(payload + 12, (uint16_t)currentMA);
+        putU32(payload + 14, (uint32_t)(capacity * 100.0f + 0.5f));
+        sendFrame(payload, 18);
+    }
+
+    // One frame per raw ADC conversion (high rate - only when explicitly enabled)
+    void sendAdcSample(uint8_t channel, uint16_t raw) {
+        if (!streamRaw || port == nullptr) return;
+
+        uint8_t payload[TELEM_MAX_PAYLOAD + 2];
+        payload[0] = TELEM_FRAME_ADC;
+        putU32(payload + 5, micros());
+        payload[9] = channel;
+        putU16(payload + 10, raw);
+        sendFrame(payload, 12);
+    }
+
+    // Collect inbound bytes and dispatch complete command frames; call once per loop
+    void poll(TelemetryCommandHandler handler) {
+        if (port == nullptr) return;
+
+        while (port->available() > 0) {
+            int c = port->read();
+            if (c < 0) break;
+            lastRxMs = millis();
+
+            if (c == 0) {
+                if (rxLength > 0 && !rxOverflow) {
+                    handleFrame(handler);
+                } else if (rxOverflow) {
+                    rxErrors++;
+                }
+                rxLength = 0;
+                rxOverflow = false;
+            } else if (rxLength < TELEM_RX_BUFFER) {
+                // The only length bound: COBS decoding never grows a frame
+                rxBuffer[rxLength++] = (uint8_t)c;
+            } else {
+                rxOverflow = true;
+            }
+        }
+    }
+};
+
+// Global telemetry instance
+SerialTelemetry telemetry;
+
+#endif // SERIAL_TELEMETRY_H
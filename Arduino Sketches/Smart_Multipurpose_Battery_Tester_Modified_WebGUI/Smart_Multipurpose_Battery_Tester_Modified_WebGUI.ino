@@ -8,27 +8,17 @@
 //
 // CALIBRATION NOTE: Voltage Measurement Accuracy
 // ==================================================
-// The voltage reference (Vref_Voltage) can be adjusted to improve accuracy.
-// This constant represents the LM385-1.2V reference voltage (U6 on PCB).
-// Default value: 1.26V (factory default: 1.227V)
+// ADC counts are converted with the ESP32 factory (eFuse) calibration, so no
+// source edits are needed. Fine calibration is done from the web interface:
+// 1. Open the Cal panel and insert a battery
+// 2. Measure the battery with a calibrated multimeter
+// 3. Enter the meter reading and press "Add Point"
+// 4. Repeat with 1-3 more batteries at different voltages (e.g. 3.0V, 3.7V, 4.1V)
+// 5. Press "Apply & Save" - the gain/offset fit is stored in NVS
 //
-// How to calibrate:
-// 1. Set the constant to a known good value (start with 1.227)
-// 2. Measure a known battery voltage with this device
-// 3. Compare with a calibrated multimeter
-// 4. Calculate the error percentage:
-//    Error% = (Device_Reading - Multimeter_Reading) / Multimeter_Reading * 100
-// 5. Apply proportional adjustment:
-//    If reading is HIGH (positive error):
-//      Correction_Factor = 1 - (Error% / 100)
-//      New_Vref = Old_Vref × Correction_Factor
-//      Example: If 5% high: 1.227 × (1 - 0.05) = 1.227 × 0.95 = 1.166
-//    If reading is LOW (negative error):
-//      Correction_Factor = 1 - (Error% / 100)  [negative error = subtract]
-//      New_Vref = Old_Vref × Correction_Factor
-//      Example: If 3% low: 1.227 × (1 + 0.03) = 1.227 × 1.03 = 1.264
-// 6. Recompile and test with another battery
-// 7. Repeat steps 2-6 until readings match your multimeter (within ±2%)
+// Vref_Voltage (LM385-1.2V, U6 on PCB) is only used on chips without eFuse
+// calibration data, where readings are ratiometric against the reference.
+// Default value: 1.26V (factory default: 1.227V)
 //
 // HARDWARE NOTES:
 // ==================================================
@@ -49,11 +39,26 @@
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 #include <Preferences.h>
+#include <BatteryTesterCore.h>  // Shared with the button-only sketches (Arduino Sketches/libraries)
 
 // Include our header files
 #include "WiFiConfig.h"
 #include "DataLogger.h"
 #include "WebContent.h"
+#include "SerialTelemetry.h"
+#include "AlarmRules.h"
+#include "StateTable.h"
+#include "AdcCalibration.h"
+#include "StorageController.h"
+#include "OcvLearner.h"
+#include "IcaAnalyzer.h"
+#include "ThermalModel.h"
+#include "PowerManager.h"
+#include "SelfDischargeTest.h"
+#include "ChargeEstimator.h"
+#include "DischargePlan.h"
+#include "Benchmark.h"
+#include <new>
 
 // ========================================= OLED DISPLAY ========================================
 #define SCREEN_WIDTH 128
@@ -62,63 +67,50 @@
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
 // ========================================= BUTTONS ========================================
-#define MODE_PIN D3
-#define UP_PIN D6
-#define DOWN_PIN D9
+const uint8_t MODE_PIN = XiaoC3Board::MODE_PIN;
+const uint8_t UP_PIN = XiaoC3Board::UP_PIN;
+const uint8_t DOWN_PIN = XiaoC3Board::DOWN_PIN;
 
-Button Mode_Button(MODE_PIN, 25, false, true);
-Button UP_Button(UP_PIN, 25, false, true);
-Button Down_Button(DOWN_PIN, 25, false, true);
+Button Mode_Button(MODE_PIN, XiaoC3Board::BUTTON_DEBOUNCE_MS, false, true);
+Button UP_Button(UP_PIN, XiaoC3Board::BUTTON_DEBOUNCE_MS, false, true);
+Button Down_Button(DOWN_PIN, XiaoC3Board::BUTTON_DEBOUNCE_MS, false, true);
 
 // ========================================= STATE MACHINE ========================================
-enum DeviceState {
-    STATE_IDLE,
-    STATE_MENU,
-    STATE_SELECT_CUTOFF,
-    STATE_SELECT_CURRENT,
-    STATE_CHARGING,
-    STATE_DISCHARGING,
-    STATE_ANALYZE_CHARGE,
-    STATE_ANALYZE_REST,
-    STATE_ANALYZE_DISCHARGE,
-    STATE_IR_MEASURE,
-    STATE_IR_DISPLAY,
-    STATE_COMPLETE,
-    STATE_WIFI_INFO,
-    STATE_BATTERY_CHECK,            // Real-time voltage monitoring
-    STATE_ANALYZE_CONFIG_TOGGLE,    // Enable/disable staged mode
-    STATE_ANALYZE_CONFIG_STAGE1,    // Stage 1: current + transition voltage
-    STATE_ANALYZE_CONFIG_STAGE2,    // Stage 2: current + final cutoff
-    STATE_STORAGE_PREP              // Storage prep: charge/discharge to 3.8V
-};
+// DeviceState and the descriptor types are in StateTable.h; STATE_TABLE is below the declarations
 
 DeviceState currentState = STATE_MENU;
 DeviceState previousState = STATE_IDLE;
 bool abortRequested = false;  // Flag for abort requests from web GUI
 
 // ========================================= BATTERY SETTINGS ========================================
-float cutoffVoltage = 3.0;  // Default discharge cutoff voltage
-const float Min_BAT_level = 2.8;
-const float Max_BAT_level = 3.2;
-const float FULL_BAT_level = 4.18;
-const float DAMAGE_BAT_level = 2.5;
-const float NO_BAT_level = 0.3;
-
-int Current[] = {0, 50, 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000, 1500, 2000};
-int PWM[] = {0, 4, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 150, 200};
-int Array_Size = sizeof(Current) / sizeof(Current[0]);
-int currentOffset = 25;
-const int HIGH_CURRENT_THRESHOLD = 1000;  // mA - warn user above this
+// Cell limits and the load table are the LiIonCell and Load2A policies (TesterConfig.h)
+float cutoffVoltage = LiIonCell::DEFAULT_CUTOFF_V;  // Default discharge cutoff voltage
+const float Min_BAT_level = LiIonCell::MIN_CUTOFF_V;
+const float Max_BAT_level = LiIonCell::MAX_CUTOFF_V;
+const float FULL_BAT_level = LiIonCell::FULL_V;
+const float DAMAGE_BAT_level = LiIonCell::DAMAGE_V;
+const float NO_BAT_level = LiIonCell::NO_BAT_V;
+
+const int* const Current = Load2A::CURRENT_MA;
+const int* const PWM = Load2A::PWM_DUTY;
+const int Array_Size = Load2A::COUNT;
+int currentOffset = Load2A::OFFSET_MA;
+const int HIGH_CURRENT_THRESHOLD = Load2A::HIGH_CURRENT_MA;  // mA - warn user above this
 int PWM_Value = 0;
-int PWM_Index = 6;  // Default to 500mA
+int PWM_Index = Load2A::DEFAULT_INDEX;  // Default to 500mA
+int loadIndex = 0;  // Current[] index actually applied (PWM_Index after thermal derating)
 
 float Capacity_f = 0;
-float Vref_Voltage = 1.26;  // LM385-1.2V reference voltage ( adjust it for calibration, 1.227 default )
-float Vcc = 3.3;
+float Vref_Voltage = XiaoC3Board::VREF_VOLTS;  // LM385-1.2V reference voltage (fallback when eFuse calibration is missing)
 float BAT_Voltage = 0;
+float uncorrectedVoltage = 0;  // Last reading before user calibration, used for new cal points
 float internalResistance = 0;
 float voltageNoLoad = 0;
 float voltageLoad = 0;
+IcaSummary lastIcaSummary;  // dQ/dV peaks of the last completed Analyze run (saved in NVS)
+bool hasIcaSummary = false;
+bool sampleReady = false;  // Set when a new battery voltage reading is available
+bool sampleLogged = false;  // Set when tickOperation() adds a chart sample, cleared when it is sent
 
 // ========================================= STAGED ANALYZE SETTINGS ========================================
 bool stagedAnalyzeEnabled = false;
@@ -126,48 +118,95 @@ int stage1CurrentIndex = 6;           // Index into Current[] array (default: 50
 float stage1TransitionVoltage = 3.3;  // Voltage to transition to Stage 2
 int stage2CurrentIndex = 4;           // Index into Current[] array (default: 300mA)
 float stage2FinalCutoff = 3.0;        // Final cutoff voltage
-int analyzeDischargeStage = 1;        // Current stage during discharge (1 or 2)
+
+// Rate sweep: the Analyze discharge runs each current to the same cutoff, highest first
+bool sweepEnabled = false;
+uint8_t sweepCurrentIndex[PLAN_MAX_STAGES];  // Current[] indices, descending
+uint8_t sweepCount = 0;
+float sweepCutoff = 3.0;
+uint16_t sweepRestS = SWEEP_DEFAULT_REST_S;
 
 // ========================================= TIMING ========================================
-unsigned long previousMillis = 0;
-const long displayInterval = 50;
 unsigned long startTime = 0;
 unsigned long elapsedTime = 0;
 unsigned long lastCapacityUpdate = 0;
 unsigned long lastWsUpdate = 0;
 unsigned long stateStartTime = 0;
 unsigned long restStartTime = 0;
+uint8_t irStep = 0;                // IR test: 0 = open-circuit reading, 1 = under load
+unsigned long lastIcaPublish = 0;
+const unsigned long ICA_PUBLISH_MS = 30000;  // Live dQ/dV curve update period
 
 // AP disable timer - keep AP on for a period after STA connection so user can see new IP
 unsigned long apDisableTime = 0;
 const unsigned long AP_DISABLE_DELAY = 45000;  // 45 seconds before disabling AP
 bool apDisablePending = false;
 
+// WiFi bring-up state (advanced from loop() by pollWiFi, driven by WiFi events)
+enum NetState {
+    NET_OFF,          // Radio not started yet (first loop pass draws the menu first)
+    NET_AP_STARTING,  // softAP requested, waiting for AP_START
+    NET_READY         // AP up and web server running
+};
+NetState netState = NET_OFF;
+volatile bool wifiApStartEvent = false;    // Set from the WiFi event task
+volatile bool wifiStaGotIpEvent = false;
+bool staConnecting = false;                // STA association in progress
+bool staReportResult = false;              // Connect was requested from the web UI
+unsigned long staConnectStart = 0;
+
+// Boot phase timings (ms since reset), logged to Serial and sent to web clients
+#define MAX_BOOT_PHASES 8
+struct BootPhase {
+    const char* name;
+    uint32_t us;
+};
+BootPhase bootPhases[MAX_BOOT_PHASES];
+uint8_t bootPhaseCount = 0;
+
+// Benchmark requested by a command; run from loop() (iterations per case, 0 = none)
+volatile uint32_t benchPendingIterations = 0;
+
+// WebSocket commands, queued on async_tcp and run from loop(): processCommand() measures the
+// battery and drives the state machine, and the voltage filter must only ever see one task
+#define WS_COMMAND_QUEUE 8
+struct WsCommand {
+    uint32_t clientId;
+    char* json;  // malloc'd copy of the frame, freed by the loop task
+};
+WsCommand wsCommands[WS_COMMAND_QUEUE];
+uint8_t wsCommandHead = 0;   // Next slot to run (loop task)
+uint8_t wsCommandCount = 0;
+portMUX_TYPE wsCommandLock = portMUX_INITIALIZER_UNLOCKED;
+
 int Hour = 0;
 int Minute = 0;
 int Second = 0;
 
 // ========================================= PINS ========================================
-const byte PWM_Pin = D8;
-const byte Buzzer = D7;
-const int BAT_Pin = A0;
-const int Vref_Pin = A1;
-const byte Mosfet_Pin = D2;
-// Note: A2 and D2 are the SAME pin (GPIO4) on XIAO ESP32C3!
-// Cannot use A2 for CHRG reading as it conflicts with Mosfet_Pin
+// XiaoC3Board policy (TesterConfig.h). A2 and D2 are the SAME pin (GPIO4) on XIAO ESP32C3,
+// so the LP4060 CHRG output cannot be read
+const byte PWM_Pin = XiaoC3Board::PWM_PIN;
+const byte Buzzer = XiaoC3Board::BUZZER_PIN;
+const int BAT_Pin = XiaoC3Board::BAT_PIN;
+const int Vref_Pin = XiaoC3Board::VREF_PIN;
+const byte Mosfet_Pin = XiaoC3Board::MOSFET_PIN;
 
 // Charge current set by R7 (1k) on LP4060: I = 1000mA
-const int CHARGE_CURRENT_MA = 1000;
-const int STORAGE_PREP_CURRENT_MA = 400;  // Lower current for storage prep precision
-const float STORAGE_TARGET_VOLTAGE = 3.8;  // Ideal storage voltage for Li-Ion
-const float STORAGE_VOLTAGE_TOLERANCE = 0.05;  // ±0.05V tolerance (3.75-3.85V range)
+const int CHARGE_CURRENT_MA = XiaoC3Board::CHARGE_CURRENT_MA;
+bool chargeTaperEnabled = false;   // End charges on the modelled CV taper, not the full voltage (ChargeEstimator.h)
+bool chargeProbesEnabled = true;   // Charger-off relaxation probes during charges
+float chargeStartVoltage = 0;      // Rested voltage when the last charge started
+float analyzeChargeMAh = 0;        // Charge put in by the Analyze charge phase
+float coulombicEfficiency = 0;     // Analyze discharge / charge capacity, % (0 = none)
+float storageTargetSoc = STORAGE_DEFAULT_SOC;  // Storage prep target (% SoC, see StorageController.h)
 
-// Battery icon animation
-int batteryLevel = 0;
+// OLED layouts shared with the button-only sketches (OperationScreen.h)
+OperationScreen<Adafruit_SSD1306> operationScreen(display);
 
-// Voltage divider resistors
-const float R1 = 200000.0;
-const float R2 = 100000.0;
+// ADC filters, one per channel (VoltageFilter.h)
+VoltageFilter batteryFilter;
+VoltageFilter vrefFilter;
 
 // Menu selection
 int selectedMode = 0;
@@ -176,8 +215,8 @@ int selectedMode = 0;
 // LEDC PWM configuration for tone generation
 const int LEDC_CHANNEL = 0;
 const int LEDC_TIMER = 0;
-const int LEDC_FREQUENCY = 5000;  // 5kHz PWM frequency
-const int LEDC_RESOLUTION = 8;    // 8-bit resolution
+const int LEDC_FREQUENCY = XiaoC3Board::LEDC_FREQUENCY;    // 5kHz PWM frequency
+const int LEDC_RESOLUTION = XiaoC3Board::LEDC_RESOLUTION;  // 8-bit resolution
 
 // ========================================= WEB SERVER ========================================
 AsyncWebServer server(WEB_SERVER_PORT);
@@ -188,44 +227,103 @@ Preferences preferences;
 const char* PREF_NAMESPACE = "wifi";
 const char* PREF_SSID = "ssid";
 const char* PREF_PASS = "password";
+const char* PREF_RULES_NAMESPACE = "rules";
+const char* PREF_RULES_LIST = "list";
+const char* PREF_CAL_NAMESPACE = "adccal";
+const char* PREF_CAL_GAIN = "gain";
+const char* PREF_CAL_OFFSET = "offset";
+const char* PREF_OCV_NAMESPACE = "ocv";
+const char* PREF_OCV_SLOTS = "slots";
+const char* PREF_OCV_ACTIVE = "active";
+const char* PREF_THERMAL_NAMESPACE = "thermal";
+const char* PREF_THERMAL_PARAMS = "params";
+const char* PREF_ICA_NAMESPACE = "ica";
+const char* PREF_ICA_LAST = "last";
+const char* PREF_BENCH_NAMESPACE = "bench";
+const char* PREF_BENCH_BASELINE = "base";
 
 // ========================================= FUNCTION DECLARATIONS ========================================
 void setupWiFi();
 void setupWebServer();
-bool connectToSTAWiFi();
+bool connectToSTAWiFi(bool reportResult);
+void onWiFiEvent(WiFiEvent_t event);
+void pollWiFi();
 void sendWiFiStatus();
+void recordBootPhase(const char* name);
+void sendBootTimings(AsyncWebSocketClient *client);
 void saveWiFiCredentials();
 bool loadWiFiCredentials();
 void clearWiFiCredentials();
-void handleWebSocketMessage(void *arg, uint8_t *data, size_t len);
+void handleWebSocketMessage(AsyncWebSocketClient *client, void *arg, uint8_t *data, size_t len);
+void runWebSocketCommands();
 void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
 void sendStatusUpdate();
+void buildStatusJson(String& output);
 void sendDataPoint();
-void sendHistoryData(AsyncWebSocketClient *client);
+void buildDataPointJson(const DataLogger& logger, String& output);
+void sendHistorySync(AsyncWebSocketClient *client, JsonDocument& doc);
+void addHistoryHeader(const DataLogger& logger, JsonDocument& doc);
+void buildHistoryJson(const DataLogger& logger, String& output);
+void buildHistoryChunkJson(const DataLogger& logger, uint32_t since, String& output);
 void sendError(const char* message);
-void processCommand(JsonDocument& doc);
+void processCommand(JsonDocument& doc, AsyncWebSocketClient *client);
+bool handleSerialCommand(const char* json, size_t len);
+void sendRules();
+void sendRuleEvent(int index);
+void saveAlarmRules();
+void loadAlarmRules();
+void evaluateAlarmRules();
+void sendCalibration();
+void saveAdcCalibration();
+void loadAdcCalibration();
+void sendOcvTables();
+void saveOcvLibrary();
+void loadOcvLibrary();
+void finishOcvLearning();
+void sendThermalConfig();
+void saveThermalParams();
+void loadThermalParams();
+void loadIcaSummary();
+void finishIcaAnalysis();
+void finishCoulombicEfficiency();
+void finishRateSweep();
+void sendRateSweep(AsyncWebSocketClient *client);
+void sendIcaCurve(AsyncWebSocketClient *client);
+void runBenchmarks(uint32_t iterations);
+void sendBenchmark();
+void saveBenchBaseline();
+void loadBenchBaseline();
+void applyThermalDerating();
+void applyRuleAction(int index);
+void finishCurrentPhase();
+void beginAnalyzePlan();
+void startPlanStage();
+void endAnalyzeStage();
+void advanceAnalyzeStage();
 
 void readButtons();
+bool isIdleState(DeviceState state);
+void pollPower();
 void clearButtonStates();
 void resetToIdle();
 void beep(int duration);
-void playTone(int frequency, int duration);
 void playStartupChime();
 void playCompletionChime();
 void playErrorChime();
+void playAbortBeep();
 
-float measureVcc();
+void sampleAdcBlock(int pin, uint8_t channel, uint16_t* raw);
+void refreshVref();
 float measureBatteryVoltage();
 int getCurrentMA();
+int getLoadCurrentMA();
 void updateTiming();
 void updateDisplay();
 
 void handleMenuState();
 void handleSelectCutoffState();
 void handleSelectCurrentState();
-void handleChargingState();
-void handleDischargingState();
-void handleAnalyzeChargeState();
+void handleOperationState();
 void handleAnalyzeRestState();
 void handleAnalyzeDischargeState();
 void handleIRMeasureState();
@@ -237,15 +335,61 @@ void handleAnalyzeConfigToggleState();
 void handleAnalyzeConfigStage1State();
 void handleAnalyzeConfigStage2State();
 void handleStoragePrepState();
+void startStoragePrep(const OcvTable& table);
+void handleSelfDischargeState();
+void handleAnalyzeStageRestState();
+void startSelfDischarge(uint16_t intervalMin, uint16_t hours, float limitMvPerDay, bool charge);
+void sendSelfDischargeSeries(AsyncWebSocketClient *client);
+void sendSelfDischargePoint();
+
+void abortOperation();
+void startChargeEstimate();
+OpResult tickOperation();
+bool runStateExits(const StateDescriptor& desc);
+void enterNextState();
+void stopRig();
+void continueOperation(const char* title);
+
+// ========================================= STATE TABLE ========================================
+// One row per DeviceState, in enum order (field meanings in StateTable.h)
+constexpr StateDescriptor STATE_TABLE[] = {
+    // state                      wire name             OLED title            handler                         rig          integrator        termination       next                     screen            rule scope            flags
+    {STATE_IDLE,                  "idle",               "",                   nullptr,                        RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    0},
+    {STATE_MENU,                  "idle",               "",                   handleMenuState,                RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_SELECT_CUTOFF,         "idle",               "",                   handleSelectCutoffState,        RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_SELECT_CURRENT,        "idle",               "",                   handleSelectCurrentState,       RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_CHARGING,              "charge",             "Charging..",         handleOperationState,           RIG_CHARGER, INTEGRATE_CHARGE, TERMINATE_FULL,   STATE_COMPLETE,          SCREEN_CHARGE,    RULE_SCOPE_CHARGE,    STATE_FLAG_ABORT | STATE_FLAG_LOG},
+    {STATE_DISCHARGING,           "discharge",          "Discharging..",      handleOperationState,           RIG_LOAD,    INTEGRATE_LOAD,   TERMINATE_CUTOFF, STATE_COMPLETE,          SCREEN_DISCHARGE, RULE_SCOPE_DISCHARGE, STATE_FLAG_ABORT | STATE_FLAG_LOG},
+    {STATE_ANALYZE_CHARGE,        "analyze_charge",     "Analyze - Charging", handleOperationState,           RIG_CHARGER, INTEGRATE_CHARGE, TERMINATE_FULL,   STATE_ANALYZE_REST,      SCREEN_CHARGE,    RULE_SCOPE_CHARGE,    STATE_FLAG_ABORT | STATE_FLAG_LOG},
+    {STATE_ANALYZE_REST,          "analyze_rest",       "",                   handleAnalyzeRestState,         RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_ANALYZE_DISCHARGE, SCREEN_HANDLER,   0,                    STATE_FLAG_ABORT},
+    {STATE_ANALYZE_DISCHARGE,     "analyze_discharge",  "Analyzing - D",      handleAnalyzeDischargeState,    RIG_LOAD,    INTEGRATE_LOAD,   TERMINATE_CUTOFF, STATE_COMPLETE,          SCREEN_DISCHARGE, RULE_SCOPE_DISCHARGE, STATE_FLAG_ABORT | STATE_FLAG_LOG},
+    {STATE_IR_MEASURE,            "ir",                 "",                   handleIRMeasureState,           RIG_HANDLER, INTEGRATE_NONE,   TERMINATE_NONE,   STATE_IR_DISPLAY,        SCREEN_HANDLER,   0,                    STATE_FLAG_ABORT},
+    {STATE_IR_DISPLAY,            "ir",                 "",                   handleIRDisplayState,           RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE | STATE_FLAG_DISMISS},
+    {STATE_COMPLETE,              "complete",           "",                   handleCompleteState,            RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_WIFI_INFO,             "idle",               "",                   handleWiFiInfoState,            RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE | STATE_FLAG_DISMISS},
+    {STATE_BATTERY_CHECK,         "batcheck",           "",                   handleBatteryCheckState,        RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE | STATE_FLAG_DISMISS},
+    {STATE_ANALYZE_CONFIG_TOGGLE, "idle",               "",                   handleAnalyzeConfigToggleState, RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_ANALYZE_CONFIG_STAGE1, "idle",               "",                   handleAnalyzeConfigStage1State, RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_ANALYZE_CONFIG_STAGE2, "idle",               "",                   handleAnalyzeConfigStage2State, RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_IDLE},
+    {STATE_STORAGE_PREP,          "storage",            "",                   handleStoragePrepState,         RIG_HANDLER, INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    STATE_FLAG_ABORT},
+    {STATE_SELF_DISCHARGE,        "selfdischarge",      "",                   handleSelfDischargeState,       RIG_HANDLER, INTEGRATE_NONE,   TERMINATE_NONE,   STATE_MENU,              SCREEN_HANDLER,   0,                    0},
+    {STATE_ANALYZE_STAGE_REST,    "analyze_stage_rest", "Analyze - Rest",     handleAnalyzeStageRestState,    RIG_NONE,    INTEGRATE_NONE,   TERMINATE_NONE,   STATE_ANALYZE_DISCHARGE, SCREEN_DISCHARGE, 0,                    STATE_FLAG_ABORT | STATE_FLAG_LOG},
+};
+static_assert(sizeof(STATE_TABLE) / sizeof(STATE_TABLE[0]) == STATE_COUNT, "STATE_TABLE needs one row per DeviceState");
+static_assert(stateTableOrdered(STATE_TABLE, STATE_COUNT), "STATE_TABLE rows must follow DeviceState order");
 
-void drawBatteryOutline();
-void drawBatteryFill(int level);
-void updateBatteryDisplay(bool charging);
+inline const StateDescriptor& describeState(DeviceState state) {
+    return STATE_TABLE[(state < STATE_COUNT) ? state : STATE_IDLE];
+}
 
 // ========================================= SETUP ========================================
+// Only what is needed to show the menu and measure a cell runs here. WiFi, the
+// web server and STA association come up in the background from loop() (pollWiFi).
 void setup() {
     Serial.begin(115200);
     Serial.println("Battery Tester Starting...");
+    telemetry.begin(Serial);
+    recordBootPhase("serial");
 
     // Initialize pins
     pinMode(PWM_Pin, OUTPUT);
@@ -258,54 +402,53 @@ void setup() {
     UP_Button.begin();
     Down_Button.begin();
     Mode_Button.begin();
-    
+
     // Clear any spurious button presses from initialization
-    delay(100);
     clearButtonStates();
 
     // Setup LEDC for tone generation on buzzer pin (new ESP32 API)
     ledcAttach(Buzzer, LEDC_FREQUENCY, LEDC_RESOLUTION);
+    toneSequencer.begin(Buzzer, LEDC_RESOLUTION);
+    storageController.begin(Current, Array_Size, CHARGE_CURRENT_MA);
+    thermalModel.begin(Current, Array_Size);
+    const uint8_t wakePins[] = {MODE_PIN, UP_PIN, DOWN_PIN};
+    powerManager.begin(wakePins, sizeof(wakePins));
+    recordBootPhase("io");
 
     // Initialize OLED
     if (!display.begin(SSD1306_SWITCHCAPVCC, 0x3C)) {
         Serial.println("OLED init failed");
         for (;;);
     }
-
     display.clearDisplay();
     display.setTextColor(SSD1306_WHITE);
     display.setTextSize(1);
-    display.setCursor(10, 20);
-    display.print("Battery Tester");
-    display.setCursor(10, 35);
-    display.print("Starting WiFi...");
-    display.display();
+    recordBootPhase("display");
 
-    // Setup WiFi
-    setupWiFi();
+    // Restore user alarm rules
+    loadAlarmRules();
 
-    // Wait for WiFi stack to fully initialize
-    delay(1000);
-
-    // Setup Web Server
-    setupWebServer();
+    // ADC calibration: eFuse curve for the battery channel, user correction from NVS
+    if (adcCalibration.begin(BAT_Pin, Vref_Voltage, FILTER_FRAC_BITS)) {
+        Serial.println("ADC calibration: eFuse");
+    } else {
+        Serial.println("ADC calibration: LM385 reference fallback");
+    }
+    loadAdcCalibration();
 
-    // Show ready message
-    display.clearDisplay();
-    display.setCursor(10, 20);
-    display.print("WiFi: ");
-    display.print(AP_SSID);
-    display.setCursor(10, 35);
-    display.print("IP: ");
-    display.print(WiFi.softAPIP());
-    display.display();
-    delay(2000);
+    // OCV/SoC tables and heatsink calibration
+    loadOcvLibrary();
+    loadThermalParams();
+    loadIcaSummary();
+    loadBenchBaseline();
+    recordBootPhase("config");
 
-    // Play startup chime
+    // Play startup chime (non-blocking)
     playStartupChime();
 
     // Initialize state
     currentState = STATE_MENU;
+    recordBootPhase("menu");
     Serial.println("Setup complete");
 }
 
@@ -314,65 +457,40 @@ void loop() {
     // Always clean up WebSocket clients
     ws.cleanupClients();
 
+    // Service binary telemetry commands from the USB serial link
+    telemetry.poll(handleSerialCommand);
+
+    // Run commands received from web clients since the last pass
+    runWebSocketCommands();
+
     // Read button states
     readButtons();
 
-    // State machine
-    switch (currentState) {
-        case STATE_MENU:
-            handleMenuState();
-            break;
-        case STATE_SELECT_CUTOFF:
-            handleSelectCutoffState();
-            break;
-        case STATE_SELECT_CURRENT:
-            handleSelectCurrentState();
-            break;
-        case STATE_CHARGING:
-            handleChargingState();
-            break;
-        case STATE_DISCHARGING:
-            handleDischargingState();
-            break;
-        case STATE_ANALYZE_CHARGE:
-            handleAnalyzeChargeState();
-            break;
-        case STATE_ANALYZE_REST:
-            handleAnalyzeRestState();
-            break;
-        case STATE_ANALYZE_DISCHARGE:
-            handleAnalyzeDischargeState();
-            break;
-        case STATE_IR_MEASURE:
-            handleIRMeasureState();
-            break;
-        case STATE_IR_DISPLAY:
-            handleIRDisplayState();
-            break;
-        case STATE_COMPLETE:
-            handleCompleteState();
-            break;
-        case STATE_WIFI_INFO:
-            handleWiFiInfoState();
-            break;
-        case STATE_BATTERY_CHECK:
-            handleBatteryCheckState();
-            break;
-        case STATE_ANALYZE_CONFIG_TOGGLE:
-            handleAnalyzeConfigToggleState();
-            break;
-        case STATE_ANALYZE_CONFIG_STAGE1:
-            handleAnalyzeConfigStage1State();
-            break;
-        case STATE_ANALYZE_CONFIG_STAGE2:
-            handleAnalyzeConfigStage2State();
-            break;
-        case STATE_STORAGE_PREP:
-            handleStoragePrepState();
-            break;
-        default:
-            currentState = STATE_MENU;
-            break;
+    // State machine: each STATE_TABLE row names its handler; its flags' exits come first
+    const StateDescriptor& desc = describeState(currentState);
+    if (!desc.handler) {
+        currentState = STATE_MENU;
+    } else if (!runStateExits(desc)) {
+        desc.handler();
+    }
+
+    // Benchmark from the web UI or serial link: times the hot paths on this task, never async_tcp
+    if (benchPendingIterations > 0) {
+        uint32_t iterations = benchPendingIterations;
+        benchPendingIterations = 0;
+        if (currentState == STATE_MENU) {
+            runBenchmarks(iterations);
+        }
+    }
+
+    // MOSFET temperature model, fed with the load actually applied
+    thermalModel.update(millis(), BAT_Voltage, getLoadCurrentMA());
+
+    // Per-sample processing: alarm rules, then one telemetry frame per measurement
+    if (sampleReady) {
+        evaluateAlarmRules();
+        telemetry.sendTick(currentState, BAT_Voltage, getCurrentMA(), Capacity_f);
+        sampleReady = false;
     }
 
     // Send WebSocket updates periodically
@@ -385,6 +503,9 @@ void loop() {
         lastWsUpdate = millis();
     }
 
+    // Background WiFi bring-up and STA connection
+    pollWiFi();
+
     // Check if it's time to disable AP after STA connection
     if (apDisablePending && millis() >= apDisableTime) {
         if (WiFi.status() == WL_CONNECTED) {
@@ -397,45 +518,75 @@ void loop() {
         }
         apDisablePending = false;
     }
+
+    // Clock, modem sleep and light sleep for the next pass
+    pollPower();
+}
+
+// ========================================= POWER MANAGEMENT ========================================
+// States that only show results or wait for input; everything else keeps full rate
+bool isIdleState(DeviceState state) {
+    if (state == STATE_SELF_DISCHARGE) {
+        // Open-circuit monitoring only reads every few minutes
+        return selfDischargeTest.getPhase() != SD_PHASE_CHARGE;
+    }
+    return describeState(state).flags & STATE_FLAG_IDLE;
+}
+
+// Light sleep only in STA-only mode: a softAP must keep beaconing to stay visible.
+// Light sleep also drops the USB-Serial/JTAG link, so a telemetry stream or a host
+// that has sent anything within POWER_SLEEP_AFTER_MS keeps the CPU awake.
+void pollPower() {
+    powerManager.setIdle(isIdleState(currentState));
+
+    uint32_t now = millis();
+    bool serialBusy = telemetry.isStreaming() || now - telemetry.getLastRxMs() < POWER_SLEEP_AFTER_MS;
+    bool busy = ws.count() > 0 || netState != NET_READY || staConnecting ||
+                WiFi.getMode() != WIFI_STA || toneSequencer.isPlaying() || serialBusy;
+    if (powerManager.canSleep(now, busy)) {
+        Serial.flush();  // UART output would be cut off mid-character
+        powerManager.lightSleep();
+    }
 }
 
 // ========================================= WIFI SETUP ========================================
+// Request the AP (and STA auto-connect if credentials are saved). Returns immediately;
+// completion arrives as WiFi events and is handled in pollWiFi().
 void setupWiFi() {
-    Serial.println("Setting WiFi mode...");
-    WiFi.mode(WIFI_AP);
-
-    Serial.println("Configuring AP...");
-    WiFi.softAPConfig(AP_IP, AP_GATEWAY, AP_SUBNET);
+    WiFi.onEvent(onWiFiEvent);
 
     Serial.println("Starting AP...");
+    WiFi.mode(WIFI_AP);
+    WiFi.softAPConfig(AP_IP, AP_GATEWAY, AP_SUBNET);
     bool result = WiFi.softAP(AP_SSID, AP_PASSWORD, AP_CHANNEL, false, AP_MAX_CONNECTIONS);
-    Serial.print("AP started: ");
+    Serial.print("AP start requested: ");
     Serial.println(result ? "Success" : "Failed");
 
-    // Wait for AP to be fully ready
-    while (WiFi.softAPIP() == IPAddress(0, 0, 0, 0)) {
-        delay(100);
-        Serial.print(".");
-    }
-    Serial.println();
-
-    Serial.print("AP IP address: ");
-    Serial.println(WiFi.softAPIP());
-
     // Check for saved WiFi credentials and attempt auto-connect
     if (loadWiFiCredentials()) {
         Serial.println("Attempting auto-connect to saved network...");
-        if (connectToSTAWiFi()) {
-            Serial.println("Auto-connect successful!");
-        } else {
-            Serial.println("Auto-connect failed, continuing in AP mode");
-        }
+        connectToSTAWiFi(false);
+    }
+}
+
+// Runs in the WiFi event task - only set flags here, loop() does the work
+void onWiFiEvent(WiFiEvent_t event) {
+    switch (event) {
+        case ARDUINO_EVENT_WIFI_AP_START:
+            wifiApStartEvent = true;
+            break;
+        case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+            wifiStaGotIpEvent = true;
+            break;
+        default:
+            break;
     }
 }
 
-// Connect to an existing WiFi network (STA mode)
-// Returns true if connection successful
-bool connectToSTAWiFi() {
+// Start connecting to an existing WiFi network (STA mode), keeping the AP up.
+// Returns false if no SSID is configured; the result is reported by pollWiFi().
+// reportResult: send an error to web clients if the attempt fails
+bool connectToSTAWiFi(bool reportResult) {
     if (sta_ssid.length() == 0) {
         Serial.println("No SSID configured");
         return false;
@@ -452,22 +603,49 @@ bool connectToSTAWiFi() {
     WiFi.softAP(AP_SSID, AP_PASSWORD, AP_CHANNEL, false, AP_MAX_CONNECTIONS);
 
     // Start STA connection
+    wifiStaGotIpEvent = false;
     WiFi.begin(sta_ssid.c_str(), sta_password.c_str());
+    staConnecting = true;
+    staReportResult = reportResult;
+    staConnectStart = millis();
+    return true;
+}
 
-    // Wait for connection with timeout
-    unsigned long startAttempt = millis();
-    while (WiFi.status() != WL_CONNECTED &&
-           millis() - startAttempt < STA_CONNECT_TIMEOUT) {
-        delay(100);
-        Serial.print(".");
+// Advance WiFi bring-up and any STA connection attempt. Called every loop, never blocks.
+void pollWiFi() {
+    switch (netState) {
+        case NET_OFF:
+            setupWiFi();
+            netState = NET_AP_STARTING;
+            break;
+        case NET_AP_STARTING:
+            if (wifiApStartEvent) {
+                wifiApStartEvent = false;
+                recordBootPhase("ap");
+                Serial.print("AP IP address: ");
+                Serial.println(WiFi.softAPIP());
+                setupWebServer();
+                recordBootPhase("web");
+                netState = NET_READY;
+            }
+            break;
+        case NET_READY:
+            wifiApStartEvent = false;  // AP restarts on mode changes need no action
+            break;
     }
-    Serial.println();
 
-    if (WiFi.status() == WL_CONNECTED) {
+    if (!staConnecting) return;
+
+    if (wifiStaGotIpEvent) {
+        wifiStaGotIpEvent = false;
+        staConnecting = false;
         sta_enabled = true;
         wifiMode = CFG_WIFI_BOTH;
         Serial.print("Connected! STA IP: ");
         Serial.println(WiFi.localIP());
+        if (!staReportResult) {
+            recordBootPhase("sta");
+        }
 
         // Save credentials for auto-reconnect on next boot
         saveWiFiCredentials();
@@ -476,10 +654,10 @@ bool connectToSTAWiFi() {
         apDisableTime = millis() + AP_DISABLE_DELAY;
         apDisablePending = true;
         Serial.printf("AP will be disabled in %lu seconds\n", AP_DISABLE_DELAY / 1000);
-
-        return true;
-    } else {
+        sendWiFiStatus();
+    } else if (millis() - staConnectStart >= STA_CONNECT_TIMEOUT) {
         Serial.println("Connection failed");
+        staConnecting = false;
         // Revert to AP-only mode
         WiFi.mode(WIFI_AP);
         WiFi.softAPConfig(AP_IP, AP_GATEWAY, AP_SUBNET);
@@ -487,8 +665,36 @@ bool connectToSTAWiFi() {
         sta_enabled = false;
         wifiMode = CFG_WIFI_AP;
         apDisablePending = false;
-        return false;
+        if (staReportResult) {
+            sendError("WiFi connection failed");
+        }
+        sendWiFiStatus();
+    }
+}
+
+// ========================================= BOOT TIMING ========================================
+void recordBootPhase(const char* name) {
+    if (bootPhaseCount >= MAX_BOOT_PHASES) return;
+    bootPhases[bootPhaseCount].name = name;
+    bootPhases[bootPhaseCount].us = micros();
+    Serial.printf("[boot] %-8s %8.1f ms\n", name, bootPhases[bootPhaseCount].us / 1000.0f);
+    bootPhaseCount++;
+}
+
+// Send boot phase timings to one client (on connect)
+void sendBootTimings(AsyncWebSocketClient *client) {
+    StaticJsonDocument<384> doc;
+    doc["type"] = "boot";
+    JsonArray phases = doc.createNestedArray("phases");
+    for (uint8_t i = 0; i < bootPhaseCount; i++) {
+        JsonObject phase = phases.createNestedObject();
+        phase["name"] = bootPhases[i].name;
+        phase["ms"] = bootPhases[i].us / 1000;
     }
+
+    String output;
+    serializeJson(doc, output);
+    client->text(output);
 }
 
 // Send WiFi status to all connected WebSocket clients
@@ -511,6 +717,7 @@ void sendWiFiStatus() {
     }
 
     // STA status
+    doc["sta_connecting"] = staConnecting;
     if (WiFi.status() == WL_CONNECTED) {
         doc["sta_connected"] = true;
         doc["sta_ssid"] = sta_ssid;
@@ -562,6 +769,239 @@ void clearWiFiCredentials() {
     Serial.println("WiFi credentials cleared from NVS");
 }
 
+// Save alarm rules to non-volatile storage
+void saveAlarmRules() {
+    preferences.begin(PREF_RULES_NAMESPACE, false);
+    preferences.putBytes(PREF_RULES_LIST, alarmRules.data(), alarmRules.getRuleCount() * sizeof(AlarmRule));
+    preferences.end();
+}
+
+// Load alarm rules from non-volatile storage
+void loadAlarmRules() {
+    AlarmRule stored[MAX_ALARM_RULES];
+    preferences.begin(PREF_RULES_NAMESPACE, true);
+    size_t len = preferences.getBytes(PREF_RULES_LIST, stored, sizeof(stored));
+    preferences.end();
+    alarmRules.load(stored, len / sizeof(AlarmRule));
+    Serial.printf("Loaded %u alarm rules\n", alarmRules.getRuleCount());
+}
+
+// Save ADC user correction to non-volatile storage
+void saveAdcCalibration() {
+    preferences.begin(PREF_CAL_NAMESPACE, false);
+    preferences.putFloat(PREF_CAL_GAIN, adcCalibration.getGain());
+    preferences.putFloat(PREF_CAL_OFFSET, adcCalibration.getOffset());
+    preferences.end();
+    Serial.println("ADC calibration saved to NVS");
+}
+
+// Load ADC user correction from non-volatile storage (defaults: gain 1, offset 0)
+void loadAdcCalibration() {
+    preferences.begin(PREF_CAL_NAMESPACE, true);
+    float gain = preferences.getFloat(PREF_CAL_GAIN, 1.0f);
+    float offset = preferences.getFloat(PREF_CAL_OFFSET, 0.0f);
+    preferences.end();
+    adcCalibration.setCorrection(gain, offset);
+    Serial.printf("ADC correction: gain %.4f, offset %.4fV\n", adcCalibration.getGain(), adcCalibration.getOffset());
+}
+
+// Save OCV table slots and the active selection to non-volatile storage
+void saveOcvLibrary() {
+    preferences.begin(PREF_OCV_NAMESPACE, false);
+    preferences.putBytes(PREF_OCV_SLOTS, ocvLibrary.data(), OCV_SLOT_COUNT * sizeof(OcvSlot));
+    preferences.putUChar(PREF_OCV_ACTIVE, ocvLibrary.getActive());
+    preferences.end();
+}
+
+// Load OCV table slots (unset or invalid slots keep the default table)
+void loadOcvLibrary() {
+    OcvSlot stored[OCV_SLOT_COUNT];
+    preferences.begin(PREF_OCV_NAMESPACE, true);
+    size_t len = preferences.getBytes(PREF_OCV_SLOTS, stored, sizeof(stored));
+    uint8_t active = preferences.getUChar(PREF_OCV_ACTIVE, 0);
+    preferences.end();
+    ocvLibrary.load(stored, len / sizeof(OcvSlot), active);
+    Serial.printf("OCV table: %s (%u runs)\n", ocvLibrary.getSlot(ocvLibrary.getActive()).name,
+                  ocvLibrary.getSlot(ocvLibrary.getActive()).runs);
+}
+
+// Save heatsink thermal parameters to non-volatile storage
+void saveThermalParams() {
+    preferences.begin(PREF_THERMAL_NAMESPACE, false);
+    preferences.putBytes(PREF_THERMAL_PARAMS, &thermalModel.getParams(), sizeof(ThermalParams));
+    preferences.end();
+}
+
+// Load heatsink thermal parameters (defaults if unset or invalid)
+void loadThermalParams() {
+    ThermalParams stored;
+    preferences.begin(PREF_THERMAL_NAMESPACE, true);
+    size_t len = preferences.getBytes(PREF_THERMAL_PARAMS, &stored, sizeof(stored));
+    preferences.end();
+    if (len == sizeof(ThermalParams)) {
+        thermalModel.setParams(stored);
+    }
+}
+
+// Peak features of the last completed Analyze run
+void loadIcaSummary() {
+    preferences.begin(PREF_ICA_NAMESPACE, true);
+    size_t len = preferences.getBytes(PREF_ICA_LAST, &lastIcaSummary, sizeof(IcaSummary));
+    preferences.end();
+    hasIcaSummary = (len == sizeof(IcaSummary) && lastIcaSummary.peakCount <= ICA_MAX_PEAKS);
+}
+
+// Saved benchmark figures (compared against by later runs)
+void saveBenchBaseline() {
+    BenchBaseline records[BENCH_MAX_CASES];
+    uint8_t count = benchmark.makeBaseline(records);
+    preferences.begin(PREF_BENCH_NAMESPACE, false);
+    preferences.putBytes(PREF_BENCH_BASELINE, records, count * sizeof(BenchBaseline));
+    preferences.end();
+}
+
+void loadBenchBaseline() {
+    BenchBaseline records[BENCH_MAX_CASES];
+    preferences.begin(PREF_BENCH_NAMESPACE, true);
+    size_t len = preferences.getBytes(PREF_BENCH_BASELINE, records, sizeof(records));
+    preferences.end();
+    if (len > 0 && len % sizeof(BenchBaseline) == 0) {
+        benchmark.setBaseline(records, len / sizeof(BenchBaseline));
+    }
+}
+
+// ========================================= BENCHMARK ========================================
+// Per-tick hot paths timed on the device (Benchmark.h). Runs from loop() at the menu only;
+// a run takes a few seconds with the buttons, screen and web UI frozen. Logger and dQ/dV
+// cases use scratch copies so the last run's graph and curve are kept.
+void runBenchmarks(uint32_t iterations) {
+    Serial.printf("[bench] %lu iterations per case\n", (unsigned long)iterations);
+    powerManager.setIdle(false);  // Time at the clock operations run at
+    benchmark.begin();
+
+    // Synthetic raw block: the filter cost does not depend on the cell
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    for (int i = 0; i < FILTER_RAW_SAMPLES; i++) {
+        raw[i] = 1400 + (i * 7) % 23;
+    }
+    VoltageFilter filter;
+    benchmark.measure("filter", iterations, [&]() -> size_t {
+        benchmark.consume(filter.process(raw));
+        return 0;
+    });
+    benchmark.measure("adc_block", iterations, [&]() -> size_t {
+        readAdcBlock(BAT_Pin, raw);
+        return 0;
+    });
+    benchmark.measure("measure_v", iterations, []() -> size_t {
+        BAT_Voltage = measureBatteryVoltage();
+        return 0;
+    });
+
+    // Logger: one logged second per op, then a full buffer for history
+    DataLogger* logger = new (std::nothrow) DataLogger();
+    if (logger) {
+        uint32_t t = 0;
+        benchmark.measure("log_add", iterations, [&]() -> size_t {
+            t += DATA_SAMPLE_INTERVAL;
+            logger->addDataPointAt(t, 3.7f, 500, t / 7200.0f);
+            return 0;
+        });
+        while (logger->getCount() < MAX_DATA_POINTS) {
+            t += DATA_SAMPLE_INTERVAL;
+            logger->addDataPointAt(t, 3.7f, 500, t / 7200.0f);
+        }
+        benchmark.measure("json_overview", iterations, [&]() -> size_t {
+            String output;
+            buildHistoryJson(*logger, output);
+            return output.length();
+        });
+        benchmark.measure("json_chunk", iterations, [&]() -> size_t {
+            String output;
+            buildHistoryChunkJson(*logger, logger->getFirstSeq(), output);
+            return output.length();
+        });
+        benchmark.measure("json_point", iterations, [&]() -> size_t {
+            String output;
+            buildDataPointJson(*logger, output);
+            return output.length();
+        });
+        delete logger;
+    } else {
+        Serial.println("[bench] no heap for a scratch logger, log cases skipped");
+    }
+
+    benchmark.measure("json_status", iterations, []() -> size_t {
+        String output;
+        buildStatusJson(output);
+        return output.length();
+    });
+
+    // dQ/dV: 1 mAh per sample down a 4.2V-2.5V ramp, restarted at the bottom
+    IcaAnalyzer* ica = new (std::nothrow) IcaAnalyzer();
+    if (ica) {
+        float mah = 0;
+        ica->begin();
+        benchmark.measure("ica_sample", iterations, [&]() -> size_t {
+            mah += 1.0f;
+            float volts = 4.2f - mah * 0.0005f;
+            if (volts < 2.6f) {
+                ica->begin();
+                mah = 0;
+            }
+            ica->addSample(volts, mah);
+            return 0;
+        });
+        delete ica;
+    }
+
+    // One OLED frame: drawing plus the I2C transfer
+    benchmark.measure("oled_frame", iterations, []() -> size_t {
+        operationScreen.showDischarge("Benchmark", false, millis(), Capacity_f, BAT_Voltage);
+        return 0;
+    });
+
+    Serial.printf("[bench] %-12s %8s %10s %6s %6s %10s\n", "case", "cycles", "ns/op", "heap", "bytes", "baseline");
+    for (uint8_t i = 0; i < benchmark.getCount(); i++) {
+        const BenchResult& r = benchmark.getResult(i);
+        Serial.printf("[bench] %-12s %8lu %10.0f %6ld %6lu", r.name, (unsigned long)r.cyclesPerOp,
+                      r.nsPerOp, (long)r.heapPerOp, (unsigned long)r.bytesPerOp);
+        if (r.baselineNs > 0) {
+            Serial.printf(" %+9.1f%%", (r.nsPerOp / r.baselineNs - 1.0f) * 100.0f);
+        }
+        Serial.println();
+    }
+    sendBenchmark();
+}
+
+// Last benchmark results with the saved baseline figure of each case
+void sendBenchmark() {
+    if (ws.count() == 0) return;
+
+    DynamicJsonDocument doc(256 + benchmark.getCount() * 192);
+    doc["type"] = "benchmark";
+    doc["cpu_mhz"] = benchmark.getCpuMhz();
+    doc["baselines"] = benchmark.getBaselineCount();
+    JsonArray cases = doc.createNestedArray("cases");
+    for (uint8_t i = 0; i < benchmark.getCount(); i++) {
+        const BenchResult& r = benchmark.getResult(i);
+        JsonObject c = cases.createNestedObject();
+        c["name"] = r.name;
+        c["n"] = r.iterations;
+        c["cycles"] = r.cyclesPerOp;
+        c["ns"] = r.nsPerOp;
+        c["heap"] = r.heapPerOp;
+        c["bytes"] = r.bytesPerOp;
+        if (r.baselineNs > 0) {
+            c["base_ns"] = r.baselineNs;
+        }
+    }
+
+    String output;
+    serializeJson(doc, output);
+    ws.textAll(output);
+}
+
 // ========================================= WEB SERVER SETUP ========================================
 void setupWebServer() {
     // WebSocket handler
@@ -583,16 +1023,27 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventTyp
     switch (type) {
         case WS_EVT_CONNECT:
             Serial.printf("WebSocket client #%u connected\n", client->id());
-            // Send current status, WiFi status, and history to new client
+            client->keepAlivePeriod(POWER_WS_KEEPALIVE_S);
+            // Send current status and WiFi status to new client; it asks for the chart
+            // history itself (history_sync) with the cursor it has, if any
             sendStatusUpdate();
             sendWiFiStatus();
-            sendHistoryData(client);
+            sendBootTimings(client);
+            if (currentState == STATE_SELF_DISCHARGE) {
+                sendSelfDischargeSeries(client);
+            }
+            if (icaAnalyzer.hasCurve() || hasIcaSummary) {
+                sendIcaCurve(client);
+            }
+            if (dischargePlan.isSweep() && dischargePlan.getResultCount() > 0) {
+                sendRateSweep(client);
+            }
             break;
         case WS_EVT_DISCONNECT:
             Serial.printf("WebSocket client #%u disconnected\n", client->id());
             break;
         case WS_EVT_DATA:
-            handleWebSocketMessage(arg, data, len);
+            handleWebSocketMessage(client, arg, data, len);
             break;
         case WS_EVT_PONG:
         case WS_EVT_ERROR:
@@ -600,24 +1051,65 @@ void onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventTyp
     }
 }
 
-void handleWebSocketMessage(void *arg, uint8_t *data, size_t len) {
+void handleWebSocketMessage(AsyncWebSocketClient *client, void *arg, uint8_t *data, size_t len) {
     AwsFrameInfo *info = (AwsFrameInfo*)arg;
     if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
         data[len] = 0;
         Serial.printf("Received: %s\n", (char*)data);
 
-        StaticJsonDocument<256> doc;
-        DeserializationError error = deserializeJson(doc, (char*)data);
+        // Copy and queue for the loop task; nothing here touches the tester state
+        char* json = (char*)malloc(len + 1);
+        if (!json) return;
+        memcpy(json, data, len + 1);
+
+        bool queued = false;
+        portENTER_CRITICAL(&wsCommandLock);
+        if (wsCommandCount < WS_COMMAND_QUEUE) {
+            WsCommand& slot = wsCommands[(wsCommandHead + wsCommandCount) % WS_COMMAND_QUEUE];
+            slot.clientId = client->id();
+            slot.json = json;
+            wsCommandCount++;
+            queued = true;
+        }
+        portEXIT_CRITICAL(&wsCommandLock);
+
+        if (!queued) {
+            free(json);
+            Serial.println("WebSocket command queue full, dropped");
+        }
+    }
+}
+
+// Loop task side of the queue. The sender may have disconnected since: the command
+// still runs, with a null client (only history_sync needs one)
+void runWebSocketCommands() {
+    while (true) {
+        WsCommand command;
+        portENTER_CRITICAL(&wsCommandLock);
+        bool pending = wsCommandCount > 0;
+        if (pending) {
+            command = wsCommands[wsCommandHead];
+            wsCommandHead = (wsCommandHead + 1) % WS_COMMAND_QUEUE;
+            wsCommandCount--;
+        }
+        portEXIT_CRITICAL(&wsCommandLock);
+        if (!pending) return;
 
+        StaticJsonDocument<512> doc;
+        DeserializationError error = deserializeJson(doc, command.json);
         if (!error) {
-            processCommand(doc);
+            processCommand(doc, ws.client(command.clientId));
         }
+        free(command.json);
     }
 }
 
-void processCommand(JsonDocument& doc) {
+// Runs on the loop task. client is the WebSocket client that sent the command, null for
+// the serial link or a client that has disconnected since
+void processCommand(JsonDocument& doc, AsyncWebSocketClient *client) {
     const char* cmd = doc["cmd"];
     if (!cmd) return;
+    powerManager.noteActivity(millis());
 
     if (strcmp(cmd, "start_charge") == 0) {
         if (currentState != STATE_MENU) {
@@ -638,12 +1130,14 @@ void processCommand(JsonDocument& doc) {
             sendError("Battery already full");
             return;
         }
+        chargeTaperEnabled = doc["taper"] | chargeTaperEnabled;
+        chargeProbesEnabled = doc["probes"] | chargeProbesEnabled;
         Capacity_f = 0;
         dataLogger.reset();
         startTime = millis();
         lastCapacityUpdate = millis();
         analogWrite(PWM_Pin, 0);        // Ensure discharge load is OFF
-        digitalWrite(Mosfet_Pin, HIGH); // Enable charging circuit
+        startChargeEstimate();
         currentState = STATE_CHARGING;
         beep(100);
     }
@@ -683,7 +1177,7 @@ void processCommand(JsonDocument& doc) {
         startTime = millis();
         lastCapacityUpdate = millis();
         digitalWrite(Mosfet_Pin, LOW);
-        analogWrite(PWM_Pin, PWM_Value);
+        applyThermalDerating();  // Sets loadIndex before the first tick integrates it
         currentState = STATE_DISCHARGING;
         beep(100);
     }
@@ -702,10 +1196,60 @@ void processCommand(JsonDocument& doc) {
             return;
         }
 
-        // Parse optional staged discharge parameters
-        stagedAnalyzeEnabled = doc["staged"] | false;
+        chargeTaperEnabled = doc["taper"] | chargeTaperEnabled;
+        chargeProbesEnabled = doc["probes"] | chargeProbesEnabled;
 
-        if (stagedAnalyzeEnabled) {
+        // Parse optional rate sweep / staged discharge parameters
+        sweepEnabled = doc["sweep"] | false;
+        stagedAnalyzeEnabled = !sweepEnabled && (doc["staged"] | false);
+
+        if (sweepEnabled) {
+            JsonArray currents = doc["sweep_currents"];
+            float cutoff = doc["sweep_cutoff"] | 3.0;
+            int rest = doc["sweep_rest"] | SWEEP_DEFAULT_REST_S;
+            if (currents.isNull() || currents.size() < 2 || currents.size() > PLAN_MAX_STAGES) {
+                sendError("Rate sweep needs 2 to 6 currents");
+                return;
+            }
+            if (cutoff < Min_BAT_level || cutoff > Max_BAT_level) {
+                sendError("Sweep cutoff out of range");
+                return;
+            }
+            if (rest < 0 || rest > SWEEP_MAX_REST_S) {
+                sendError("Sweep rest must be 0-1800 s");
+                return;
+            }
+
+            // Match each current to a load setting, then order highest first without repeats
+            uint8_t indices[PLAN_MAX_STAGES];
+            uint8_t n = 0;
+            for (JsonVariant c : currents) {
+                int index = -1;
+                for (int i = 1; i < Array_Size; i++) {
+                    if (Current[i] == c.as<int>()) index = i;
+                }
+                if (index < 0) {
+                    sendError("Sweep current is not a load setting");
+                    return;
+                }
+                indices[n++] = index;
+            }
+            sweepCount = 0;
+            for (int i = Array_Size - 1; i > 0; i--) {
+                for (uint8_t j = 0; j < n; j++) {
+                    if (indices[j] == i) {
+                        sweepCurrentIndex[sweepCount++] = i;
+                        break;
+                    }
+                }
+            }
+            if (sweepCount < 2) {
+                sendError("Rate sweep needs 2 different currents");
+                return;
+            }
+            sweepCutoff = cutoff;
+            sweepRestS = rest;
+        } else if (stagedAnalyzeEnabled) {
             // Stage 1 settings
             int s1Current = doc["stage1_current"] | 500;
             float s1TransV = doc["stage1_transition"] | 3.3;
@@ -742,13 +1286,12 @@ void processCommand(JsonDocument& doc) {
             stage2FinalCutoff = 3.0;
         }
 
-        analyzeDischargeStage = 1;
         Capacity_f = 0;
         dataLogger.reset();
         startTime = millis();
         lastCapacityUpdate = millis();
         analogWrite(PWM_Pin, 0);        // Ensure discharge load is OFF
-        digitalWrite(Mosfet_Pin, HIGH); // Enable charging circuit
+        startChargeEstimate();
         currentState = STATE_ANALYZE_CHARGE;
         beep(100);
     }
@@ -767,6 +1310,7 @@ void processCommand(JsonDocument& doc) {
             return;
         }
         stateStartTime = millis();
+        irStep = 0;
         analogWrite(PWM_Pin, 0);
         digitalWrite(Mosfet_Pin, LOW);
         currentState = STATE_IR_MEASURE;
@@ -794,59 +1338,83 @@ void processCommand(JsonDocument& doc) {
             sendError("Battery damaged (below 2.5V)");
             return;
         }
-        stateStartTime = millis();
-        Hour = Minute = Second = 0;
-        // Start charging or discharging immediately based on current voltage
-        if (BAT_Voltage < (STORAGE_TARGET_VOLTAGE - STORAGE_VOLTAGE_TOLERANCE)) {
-            // Below range: charge
-            digitalWrite(Mosfet_Pin, HIGH);
-            analogWrite(PWM_Pin, 0);  // Charging (0% PWM)
-        } else if (BAT_Voltage > (STORAGE_TARGET_VOLTAGE + STORAGE_VOLTAGE_TOLERANCE)) {
-            // Above range: discharge
-            digitalWrite(Mosfet_Pin, LOW);
-            // Calculate PWM for storage prep current
-            int targetPWM = map(STORAGE_PREP_CURRENT_MA, 0, Current[Array_Size - 1], 0, 255);
-            analogWrite(PWM_Pin, targetPWM);
-        } else {
-            // Already in range: go straight to complete
-            digitalWrite(Mosfet_Pin, LOW);
-            analogWrite(PWM_Pin, 0);
-            playCompletionChime();
-            currentState = STATE_COMPLETE;
+        // Optional target SoC and one-off OCV table (11 points, 0-100% in 10% steps, mV);
+        // without a table the active learned slot is used
+        float soc = doc["soc"] | storageTargetSoc;
+        if (soc < 10 || soc > 90) {
+            sendError("Storage target must be 10-90%");
+            return;
+        }
+        OcvTable table = ocvLibrary.activeTable();
+        JsonArray ocv = doc["ocv"];
+        if (!ocv.isNull()) {
+            if (ocv.size() != OCV_TABLE_POINTS) {
+                sendError("OCV table needs 11 points");
+                return;
+            }
+            for (uint8_t i = 0; i < OCV_TABLE_POINTS; i++) {
+                table.mv[i] = ocv[i] | 0;
+            }
+            if (!ocvTableValid(table)) {
+                sendError("Invalid OCV table");
+                return;
+            }
+        }
+        storageTargetSoc = soc;
+        startStoragePrep(table);
+        beep(100);
+    }
+    else if (strcmp(cmd, "start_selfdischarge") == 0) {
+        if (currentState != STATE_MENU) {
+            sendError("Operation already in progress");
+            return;
+        }
+        BAT_Voltage = measureBatteryVoltage();
+        if (BAT_Voltage < NO_BAT_level) {
+            sendError("No battery detected");
             return;
         }
-        currentState = STATE_STORAGE_PREP;
+        if (BAT_Voltage < DAMAGE_BAT_level) {
+            sendError("Battery damaged (below 2.5V)");
+            return;
+        }
+        int interval = doc["interval"] | SD_DEFAULT_INTERVAL_MIN;
+        int hours = doc["hours"] | SD_DEFAULT_HOURS;
+        float limit = doc["limit"] | SD_DEFAULT_LIMIT_MV_DAY;
+        if (interval < 1 || interval > 60 || hours < (int)SD_MIN_HOURS || hours > 168 || limit <= 0) {
+            // Shorter runs end before SD_MIN_FIT_MS of fitted data and could never give a verdict
+            sendError("Self-discharge: interval 1-60 min, 14-168 h, limit > 0");
+            return;
+        }
+        startSelfDischarge(interval, hours, limit, doc["charge"] | true);
         beep(100);
     }
+    else if (strcmp(cmd, "get_selfdischarge") == 0) {
+        sendSelfDischargeSeries(nullptr);
+    }
     else if (strcmp(cmd, "abort") == 0) {
-        abortRequested = true;  // Set flag so current handler can process abort
-        // For completion state, just set flag and let handler exit
         if (currentState == STATE_COMPLETE) {
-            // Handler will check flag and exit cleanly
+            // The handler checks the flag and exits cleanly
+            abortRequested = true;
         } else if (currentState != STATE_MENU && currentState != STATE_IDLE) {
             // For active operations, reset hardware immediately
-            resetToIdle();
-            beep(100);
-            delay(100);
-            beep(100);
-            currentState = STATE_MENU;
+            abortOperation();
         }
     }
     else if (strcmp(cmd, "wifi_config") == 0) {
         sta_ssid = doc["ssid"].as<String>();
         sta_password = doc["password"].as<String>();
 
-        // Attempt to connect
-        if (connectToSTAWiFi()) {
-            sendWiFiStatus();
-        } else {
+        // Start connecting; pollWiFi() reports the result
+        if (!connectToSTAWiFi(true)) {
             sendError("WiFi connection failed");
-            sendWiFiStatus();
         }
+        sendWiFiStatus();
     }
     else if (strcmp(cmd, "wifi_disconnect") == 0) {
         WiFi.disconnect();
         sta_enabled = false;
+        staConnecting = false;
         apDisablePending = false;  // Cancel any pending AP disable
         WiFi.mode(WIFI_AP);
         WiFi.softAPConfig(AP_IP, AP_GATEWAY, AP_SUBNET);
@@ -858,6 +1426,7 @@ void processCommand(JsonDocument& doc) {
         // Disconnect and clear saved credentials
         WiFi.disconnect();
         sta_enabled = false;
+        staConnecting = false;
         apDisablePending = false;
         clearWiFiCredentials();
         WiFi.mode(WIFI_AP);
@@ -869,104 +1438,598 @@ void processCommand(JsonDocument& doc) {
     else if (strcmp(cmd, "get_wifi_status") == 0) {
         sendWiFiStatus();
     }
-}
-
-void sendStatusUpdate() {
-    if (ws.count() == 0) return;
-
-    StaticJsonDocument<256> doc;
-    doc["type"] = "status";
-
-    // Mode string
-    switch (currentState) {
-        case STATE_MENU: doc["mode"] = "idle"; break;
-        case STATE_CHARGING: doc["mode"] = "charge"; break;
-        case STATE_DISCHARGING: doc["mode"] = "discharge"; break;
-        case STATE_ANALYZE_CHARGE: doc["mode"] = "analyze_charge"; break;
-        case STATE_ANALYZE_REST: doc["mode"] = "analyze_rest"; break;
-        case STATE_ANALYZE_DISCHARGE:
-            if (stagedAnalyzeEnabled) {
-                doc["mode"] = (analyzeDischargeStage == 1) ? "analyze_discharge_s1" : "analyze_discharge_s2";
-            } else {
-                doc["mode"] = "analyze_discharge";
-            }
-            break;
-        case STATE_IR_MEASURE:
-        case STATE_IR_DISPLAY: doc["mode"] = "ir"; break;
-        case STATE_BATTERY_CHECK: doc["mode"] = "batcheck"; break;
-        case STATE_STORAGE_PREP: doc["mode"] = "storage"; break;
-        case STATE_COMPLETE: doc["mode"] = "complete"; break;
-        default: doc["mode"] = "idle"; break;
+    else if (strcmp(cmd, "rule_add") == 0) {
+        int metric = AlarmRuleEngine::metricFromName(doc["metric"]);
+        int action = AlarmRuleEngine::actionFromName(doc["action"] | "alarm");
+        const char* op = doc["op"] | "below";
+        const char* scope = doc["scope"] | "any";
+        uint8_t scopeMask = RULE_SCOPE_ANY;
+        if (strcmp(scope, "charge") == 0) scopeMask = RULE_SCOPE_CHARGE;
+        else if (strcmp(scope, "discharge") == 0) scopeMask = RULE_SCOPE_DISCHARGE;
+
+        if (metric < 0 || action < 0) {
+            sendError("Invalid rule metric or action");
+            return;
+        }
+        if (alarmRules.addRule(metric, strcmp(op, "above") == 0 ? RULE_OP_ABOVE : RULE_OP_BELOW,
+                               doc["value"] | 0.0f, action, scopeMask, doc["hold"] | 1) < 0) {
+            sendError("Rule table full");
+            return;
+        }
+        saveAlarmRules();
+        sendRules();
     }
+    else if (strcmp(cmd, "rule_remove") == 0) {
+        alarmRules.removeRule(doc["id"] | 255);
+        saveAlarmRules();
+        sendRules();
+    }
+    else if (strcmp(cmd, "rule_clear") == 0) {
+        alarmRules.clearRules();
+        saveAlarmRules();
+        sendRules();
+    }
+    else if (strcmp(cmd, "get_rules") == 0) {
+        sendRules();
+    }
+    else if (strcmp(cmd, "cal_add_point") == 0) {
+        // Open circuit only: a point under load or charge would calibrate in the IR drop,
+        // and a reading here would disturb the running operation's filter and voltage
+        if (currentState != STATE_MENU) {
+            sendError("Calibrate from the menu, with no operation running");
+            return;
+        }
+        float meter = doc["meter"] | 0.0f;
+        BAT_Voltage = measureBatteryVoltage();
+        if (uncorrectedVoltage < NO_BAT_level) {
+            sendError("No battery detected");
+            return;
+        }
+        if (!adcCalibration.addPoint(uncorrectedVoltage, meter)) {
+            sendError("Invalid meter reading or too many points");
+            return;
+        }
+        sendCalibration();
+    }
+    else if (strcmp(cmd, "cal_apply") == 0) {
+        if (adcCalibration.getPointCount() == 0) {
+            sendError("Add at least one calibration point");
+            return;
+        }
+        if (!adcCalibration.fit()) {
+            sendError("Calibration out of range (gain 0.8-1.2, offset +/-0.5V): check the points");
+            return;
+        }
+        adcCalibration.clearPoints();
+        saveAdcCalibration();
+        sendCalibration();
+    }
+    else if (strcmp(cmd, "cal_reset") == 0) {
+        adcCalibration.clearPoints();
+        adcCalibration.setCorrection(1.0f, 0.0f);
+        saveAdcCalibration();
+        sendCalibration();
+    }
+    else if (strcmp(cmd, "get_cal") == 0) {
+        // Fresh reading only at the menu; during an operation report the engine's last one
+        if (currentState == STATE_MENU) {
+            BAT_Voltage = measureBatteryVoltage();
+        }
+        sendCalibration();
+    }
+    else if (strcmp(cmd, "get_ica") == 0) {
+        sendIcaCurve(nullptr);
+    }
+    else if (strcmp(cmd, "get_thermal") == 0) {
+        sendThermalConfig();
+    }
+    else if (strcmp(cmd, "thermal_config") == 0) {
+        // Any subset of the parameters; missing ones keep their current value
+        ThermalParams p = thermalModel.getParams();
+        p.ambientC = doc["ambient"] | p.ambientC;
+        p.rJhCW = doc["r_jh"] | p.rJhCW;
+        p.rHaCW = doc["r_ha"] | p.rHaCW;
+        p.cHaJC = doc["c_ha"] | p.cHaJC;
+        p.limitC = doc["limit"] | p.limitC;
+        p.senseOhms = doc["sense"] | p.senseOhms;
+        if (!thermalModel.setParams(p)) {
+            sendError("Invalid thermal parameters");
+            return;
+        }
+        saveThermalParams();
+        sendThermalConfig();
+    }
+    else if (strcmp(cmd, "thermal_reset") == 0) {
+        thermalModel.setParams(THERMAL_DEFAULT_PARAMS);
+        saveThermalParams();
+        sendThermalConfig();
+    }
+    else if (strcmp(cmd, "get_ocv") == 0) {
+        sendOcvTables();
+    }
+    else if (strcmp(cmd, "ocv_select") == 0) {
+        if (currentState == STATE_STORAGE_PREP) {
+            sendError("Cannot change OCV table during storage prep");
+            return;
+        }
+        if (!ocvLibrary.select(doc["slot"] | 255)) {
+            sendError("Invalid OCV slot");
+            return;
+        }
+        saveOcvLibrary();
+        sendOcvTables();
+    }
+    else if (strcmp(cmd, "ocv_rename") == 0) {
+        if (!ocvLibrary.rename(doc["slot"] | 255, doc["name"] | "")) {
+            sendError("Invalid OCV slot or name");
+            return;
+        }
+        saveOcvLibrary();
+        sendOcvTables();
+    }
+    else if (strcmp(cmd, "ocv_reset") == 0) {
+        uint8_t slot = doc["slot"] | 255;
+        if (slot >= OCV_SLOT_COUNT) {
+            sendError("Invalid OCV slot");
+            return;
+        }
+        ocvLibrary.resetSlot(slot);
+        saveOcvLibrary();
+        sendOcvTables();
+    }
+    else if (strcmp(cmd, "benchmark") == 0) {
+        if (currentState != STATE_MENU) {
+            sendError("Benchmark only runs from the menu");
+            return;
+        }
+        uint32_t iterations = doc["iterations"] | BENCH_DEFAULT_ITERATIONS;
+        benchPendingIterations = constrain(iterations, (uint32_t)BENCH_BATCHES, (uint32_t)BENCH_MAX_ITERATIONS);
+    }
+    else if (strcmp(cmd, "bench_baseline") == 0) {
+        if (benchmark.getCount() == 0) {
+            sendError("Run the benchmark first");
+            return;
+        }
+        saveBenchBaseline();
+        sendBenchmark();
+    }
+    else if (strcmp(cmd, "get_benchmark") == 0) {
+        sendBenchmark();
+    }
+    else if (strcmp(cmd, "history_sync") == 0) {
+        // Chart history goes to the asking client only (the serial link has no chart)
+        if (client) {
+            sendHistorySync(client, doc);
+        }
+    }
+    else if (strcmp(cmd, "telemetry") == 0) {
+        // Enable/disable binary streaming on the USB serial link
+        telemetry.setStreams(doc["ticks"] | false, doc["raw"] | false);
+    }
+}
+
+// Commands arriving as telemetry frames on the USB serial link
+bool handleSerialCommand(const char* json, size_t len) {
+    StaticJsonDocument<512> doc;
+    DeserializationError error = deserializeJson(doc, json, len);
+    if (error || !doc["cmd"].is<const char*>()) {
+        return false;
+    }
+    processCommand(doc, nullptr);
+    return true;
+}
+
+void sendStatusUpdate() {
+    if (ws.count() == 0) return;
+
+    String output;
+    buildStatusJson(output);
+    ws.textAll(output);
+}
+
+// Periodic status message (also timed by the benchmark)
+void buildStatusJson(String& output) {
+    StaticJsonDocument<512> doc;
+    doc["type"] = "status";
+
+    // Mode string (multi-stage Analyze reports its stage; a char array is copied into doc)
+    char mode[24];
+    if (currentState == STATE_ANALYZE_DISCHARGE && dischargePlan.getStageCount() > 1) {
+        snprintf(mode, sizeof(mode), "analyze_discharge_s%u", dischargePlan.getStageIndex() + 1);
+        doc["mode"] = mode;
+    } else {
+        doc["mode"] = describeState(currentState).wireName;
+    }
+
+    doc["status"] = (currentState != STATE_MENU) ? "Running" : "Ready";
+    doc["voltage"] = BAT_Voltage;
+    doc["current"] = getCurrentMA();
+    doc["capacity"] = Capacity_f;
+
+    char timeStr[12];
+    sprintf(timeStr, "%02d:%02d:%02d", Hour, Minute, Second);
+    doc["time"] = timeStr;
+    doc["cutoff"] = cutoffVoltage;
 
-    doc["status"] = (currentState != STATE_MENU) ? "Running" : "Ready";
-    doc["voltage"] = BAT_Voltage;
-    doc["current"] = getCurrentMA();
-    doc["capacity"] = Capacity_f;
-
-    char timeStr[12];
-    sprintf(timeStr, "%02d:%02d:%02d", Hour, Minute, Second);
-    doc["time"] = timeStr;
-    doc["cutoff"] = cutoffVoltage;
-
     // Include IR measurement results
     if (currentState == STATE_IR_DISPLAY) {
         doc["ir"] = internalResistance * 1000;  // Send in milliohms
     }
 
+    // Power level, time in light sleep and estimated supply current since boot
+    doc["power"] = powerManager.getLevelName();
+    doc["cpu_mhz"] = getCpuFrequencyMhz();
+    doc["sleep_pct"] = powerManager.getSleepFraction() * 100;
+    doc["supply_ma"] = powerManager.getAverageMA();
+    doc["wake_us"] = powerManager.getLastWakeLatencyUs();
+
+    // Load MOSFET thermal model while the load is on or the heatsink is still warm;
+    // requested current is reported while it is derated
+    if (thermalModel.getPowerW() > 0 ||
+        thermalModel.getHeatsinkC() > thermalModel.getParams().ambientC + THERMAL_HYSTERESIS_C) {
+        doc["mosfet_c"] = thermalModel.getJunctionC();
+        doc["heatsink_c"] = thermalModel.getHeatsinkC();
+        doc["mosfet_w"] = thermalModel.getPowerW();
+    }
+    if ((currentState == STATE_DISCHARGING || currentState == STATE_ANALYZE_DISCHARGE) &&
+        thermalModel.isDerating(PWM_Index)) {
+        doc["requested_ma"] = Current[PWM_Index];
+    }
+
+    // Include SoC estimate from the active OCV table
+    if (currentState == STATE_BATTERY_CHECK) {
+        doc["soc"] = ocvToSoc(ocvLibrary.activeTable(), BAT_Voltage * 1000.0f);
+    }
+
+    // Include storage prep progress
+    if (currentState == STATE_STORAGE_PREP) {
+        doc["storage_phase"] = storageController.getPhaseName();
+        doc["soc"] = storageController.getSocEstimate();
+        doc["target_soc"] = storageController.getTargetSoc();
+        doc["storage_ir"] = storageController.getIrOhms() * 1000;  // Milliohms
+    }
+
+    // Include the charge model: phase, probed resistance and taper time constant
+    if (describeState(currentState).integrator == INTEGRATE_CHARGE) {
+        doc["charge_phase"] = chargeEstimator.getPhaseName();
+        doc["charge_r"] = chargeEstimator.getROhms() * 1000;  // Milliohms
+        doc["charge_tau"] = chargeEstimator.getTauS();
+    }
+
+    // Analyze result: charge put in and coulombic efficiency
+    if (currentState == STATE_COMPLETE && coulombicEfficiency > 0) {
+        doc["charge_mah"] = analyzeChargeMAh;
+        doc["ce"] = coulombicEfficiency;
+    }
+
+    // Include self-discharge progress
+    if (currentState == STATE_SELF_DISCHARGE) {
+        doc["sd_phase"] = selfDischargeTest.getPhaseName();
+        doc["sd_slope"] = selfDischargeTest.getSlope();
+        doc["sd_error"] = selfDischargeTest.getSlopeError();
+        doc["sd_limit"] = selfDischargeTest.getLimit();
+        doc["sd_verdict"] = selfDischargeTest.getVerdictName();
+        doc["sd_next"] = selfDischargeTest.getSecondsToNext(millis());
+    }
+
+    // Include rate sweep progress: stage, its current, and the rest countdown between stages
+    if ((currentState == STATE_ANALYZE_DISCHARGE || currentState == STATE_ANALYZE_STAGE_REST) &&
+        dischargePlan.isSweep()) {
+        doc["stage"] = dischargePlan.getStageIndex() + 1;
+        doc["stages"] = dischargePlan.getStageCount();
+        doc["stage_current"] = Current[dischargePlan.getStage().currentIndex];
+        if (currentState == STATE_ANALYZE_STAGE_REST) {
+            uint32_t restMs = dischargePlan.getStage().restS * 1000UL;
+            uint32_t elapsed = millis() - restStartTime;
+            doc["rest_left"] = (elapsed >= restMs) ? 0 : (restMs - elapsed) / 1000;
+        }
+    }
+
     // Include staged discharge info when in analyze discharge
     if (currentState == STATE_ANALYZE_DISCHARGE && stagedAnalyzeEnabled) {
-        doc["stage"] = analyzeDischargeStage;
+        doc["stage"] = dischargePlan.getStageIndex() + 1;
         doc["stage1_current"] = Current[stage1CurrentIndex];
         doc["stage1_transition"] = stage1TransitionVoltage;
         doc["stage2_current"] = Current[stage2CurrentIndex];
         doc["stage2_cutoff"] = stage2FinalCutoff;
     }
 
-    String output;
     serializeJson(doc, output);
-    ws.textAll(output);
 }
 
+// Newest logged sample to all clients (one per DATA_SAMPLE_INTERVAL, not per reading)
 void sendDataPoint() {
-    if (ws.count() == 0) return;
+    if (ws.count() == 0 || !dataLogger.hasData()) return;
 
-    StaticJsonDocument<128> doc;
+    String output;
+    buildDataPointJson(dataLogger, output);
+    ws.textAll(output);
+}
+
+// Same units as the history frames; seq lets the client spot samples it missed
+void buildDataPointJson(const DataLogger& logger, String& output) {
+    DataPoint pt{};
+    if (!logger.getLatestDataPoint(pt)) {
+        return;  // Nothing logged yet: no frame
+    }
+    StaticJsonDocument<160> doc;
     doc["type"] = "datapoint";
-    doc["t"] = millis() - startTime;
-    doc["v"] = BAT_Voltage;
-    doc["c"] = getCurrentMA();
+    doc["run"] = logger.getRunId();
+    doc["seq"] = logger.getNextSeq() - 1;
+    doc["t"] = pt.timestamp;
+    doc["mv"] = lroundf(pt.voltage * 1000.0f);
+    doc["c"] = pt.current;
+    serializeJson(doc, output);
+}
+
+// Stored self-discharge series (minutes, 0.1mV) to one client, or all when client is null
+void sendSelfDischargeSeries(AsyncWebSocketClient *client) {
+    if (ws.count() == 0) return;
+
+    uint16_t count = selfDischargeTest.getCount();
+    DynamicJsonDocument doc(512 + count * 32);  // Two array slots per sample
+    doc["type"] = "sd_series";
+    doc["interval"] = selfDischargeTest.getIntervalMin();
+    doc["hours"] = selfDischargeTest.getHours();
+    JsonArray t = doc.createNestedArray("t");
+    JsonArray mv = doc.createNestedArray("mv");
+    for (uint16_t i = 0; i < count; i++) {
+        t.add(selfDischargeTest.getSample(i).minutes);
+        mv.add(selfDischargeTest.getSample(i).decimv);
+    }
+
+    String output;
+    serializeJson(doc, output);
+    if (client) {
+        client->text(output);
+    } else {
+        ws.textAll(output);
+    }
+}
+
+// Newest stored self-discharge sample
+void sendSelfDischargePoint() {
+    if (ws.count() == 0 || selfDischargeTest.getCount() == 0) return;
+
+    const SdSample& sample = selfDischargeTest.getSample(selfDischargeTest.getCount() - 1);
+    StaticJsonDocument<96> doc;
+    doc["type"] = "sd_point";
+    doc["t"] = sample.minutes;
+    doc["mv"] = sample.decimv;
 
     String output;
     serializeJson(doc, output);
     ws.textAll(output);
 }
 
-void sendHistoryData(AsyncWebSocketClient *client) {
-    if (!dataLogger.hasData()) return;
+// Chart history for one client. A client that sends the current run id and a cursor
+// ("since", the first seq it does not have) gets the samples from there at full resolution,
+// one history_chunk frame per request: it asks for the next frame when one arrives, so the
+// async_tcp send queue never fills up. Without a cursor, or once a new run has started, it
+// gets the overview first and backfills with chunks from "first".
+void sendHistorySync(AsyncWebSocketClient *client, JsonDocument& doc) {
+    uint32_t run = doc["run"] | 0;
+    bool resume = doc["since"].is<uint32_t>() && dataLogger.canResume(run, doc["since"]);
 
-    uint16_t count = dataLogger.getDataForTransmit(360);
-    if (count == 0) return;
+    String output;
+    if (resume) {
+        buildHistoryChunkJson(dataLogger, doc["since"], output);
+    } else {
+        buildHistoryJson(dataLogger, output);
+    }
+    client->text(output);
+    Serial.printf("[sync] #%u %s, %u bytes\n", client->id(), resume ? "chunk" : "overview", output.length());
+}
+
+// Run id, seq range and event markers, common to both history frames
+void addHistoryHeader(const DataLogger& logger, JsonDocument& doc) {
+    doc["run"] = logger.getRunId();
+    doc["first"] = logger.getFirstSeq();
+    doc["next"] = logger.getNextSeq();
+    JsonArray events = doc.createNestedArray("events");
+    for (uint8_t i = 0; i < logger.getEventCount(); i++) {
+        events.add(logger.getEvent(i).timestamp);
+    }
+}
 
-    // Build JSON array of points
-    DynamicJsonDocument doc(8192);
+// Every stride-th stored sample, at most HISTORY_OVERVIEW_POINTS; sample i is seq first + i * stride.
+// Columns: t in ms since the start, mv, c in mA
+void buildHistoryJson(const DataLogger& logger, String& output) {
+    uint32_t first = logger.getFirstSeq();
+    uint32_t next = logger.getNextSeq();
+    uint32_t stride = (next - first + HISTORY_OVERVIEW_POINTS - 1) / HISTORY_OVERVIEW_POINTS;
+    if (stride == 0) stride = 1;
+
+    DynamicJsonDocument doc(512 + HISTORY_OVERVIEW_POINTS * 48);  // Three array slots per sample
     doc["type"] = "history";
-    JsonArray points = doc.createNestedArray("points");
+    addHistoryHeader(logger, doc);
+    doc["stride"] = stride;
+    JsonArray t = doc.createNestedArray("t");
+    JsonArray mv = doc.createNestedArray("mv");
+    JsonArray c = doc.createNestedArray("c");
+    DataPoint pt;
+    for (uint32_t seq = first; seq < next && logger.getBySeq(seq, pt); seq += stride) {
+        t.add(pt.timestamp);
+        mv.add(lroundf(pt.voltage * 1000.0f));
+        c.add(pt.current);
+    }
+    serializeJson(doc, output);
+}
 
-    for (uint16_t i = 0; i < count; i++) {
-        uint16_t idx = dataLogger.getDownsampledIndex(i, 360);
-        DataPoint pt;
-        if (dataLogger.getDataPoint(idx, pt)) {
-            JsonObject p = points.createNestedObject();
-            p["t"] = pt.timestamp;
-            p["v"] = pt.voltage;
-            p["c"] = pt.current;
+// Up to HISTORY_CHUNK_POINTS consecutive samples from since (moved up to the oldest
+// stored sample if the buffer has wrapped past it); same columns as the overview
+void buildHistoryChunkJson(const DataLogger& logger, uint32_t since, String& output) {
+    uint32_t next = logger.getNextSeq();
+    since = logger.clampSeq(since);
+
+    DynamicJsonDocument doc(512 + HISTORY_CHUNK_POINTS * 48);
+    doc["type"] = "history_chunk";
+    addHistoryHeader(logger, doc);
+    doc["seq"] = since;
+    JsonArray t = doc.createNestedArray("t");
+    JsonArray mv = doc.createNestedArray("mv");
+    JsonArray c = doc.createNestedArray("c");
+    DataPoint pt;
+    for (uint32_t seq = since; seq < next && seq - since < HISTORY_CHUNK_POINTS && logger.getBySeq(seq, pt); seq++) {
+        t.add(pt.timestamp);
+        mv.add(lroundf(pt.voltage * 1000.0f));
+        c.add(pt.current);
+    }
+    serializeJson(doc, output);
+}
+
+// Send the configured alarm rules and their evaluation cost
+void sendRules() {
+    if (ws.count() == 0) return;
+
+    StaticJsonDocument<1024> doc;
+    doc["type"] = "rules";
+    doc["eval_us_avg"] = alarmRules.getAverageEvalUs();
+    doc["eval_us_max"] = alarmRules.getMaxEvalUs();
+    JsonArray list = doc.createNestedArray("rules");
+    for (uint8_t i = 0; i < alarmRules.getRuleCount(); i++) {
+        const AlarmRule& r = alarmRules.getRule(i);
+        JsonObject o = list.createNestedObject();
+        o["metric"] = RULE_METRIC_NAMES[r.metric];
+        o["op"] = (r.op == RULE_OP_ABOVE) ? "above" : "below";
+        o["value"] = r.threshold;
+        o["action"] = RULE_ACTION_NAMES[r.action];
+        o["scope"] = (r.scope == RULE_SCOPE_CHARGE) ? "charge" : (r.scope == RULE_SCOPE_DISCHARGE) ? "discharge" : "any";
+        o["hold"] = r.hold;
+    }
+
+    String output;
+    serializeJson(doc, output);
+    ws.textAll(output);
+}
+
+// Send calibration state, pending points and the latest readings
+void sendCalibration() {
+    if (ws.count() == 0) return;
+
+    StaticJsonDocument<512> doc;
+    doc["type"] = "cal";
+    doc["scheme"] = adcCalibration.usesEfuse() ? "efuse" : "vref";
+    doc["gain"] = adcCalibration.getGain();
+    doc["offset"] = adcCalibration.getOffset();
+    doc["raw_v"] = uncorrectedVoltage;
+    doc["voltage"] = BAT_Voltage;
+    JsonArray pts = doc.createNestedArray("points");
+    for (uint8_t i = 0; i < adcCalibration.getPointCount(); i++) {
+        JsonObject p = pts.createNestedObject();
+        p["d"] = adcCalibration.getPoint(i).deviceVoltage;
+        p["m"] = adcCalibration.getPoint(i).meterVoltage;
+    }
+
+    String output;
+    serializeJson(doc, output);
+    ws.textAll(output);
+}
+
+// Send heatsink thermal parameters to web clients
+void sendThermalConfig() {
+    if (ws.count() == 0) return;
+
+    const ThermalParams& p = thermalModel.getParams();
+    StaticJsonDocument<256> doc;
+    doc["type"] = "thermal";
+    doc["ambient"] = p.ambientC;
+    doc["r_jh"] = p.rJhCW;
+    doc["r_ha"] = p.rHaCW;
+    doc["c_ha"] = p.cHaJC;
+    doc["limit"] = p.limitC;
+    doc["sense"] = p.senseOhms;
+    doc["ceiling_ma"] = thermalModel.getCeilingMA();
+
+    String output;
+    serializeJson(doc, output);
+    ws.textAll(output);
+}
+
+// dQ/dV curve (live or last run) and the saved run summary, to one client or all
+void sendIcaCurve(AsyncWebSocketClient *client) {
+    if (ws.count() == 0) return;
+
+    DynamicJsonDocument doc(4096);
+    doc["type"] = "ica";
+    doc["live"] = icaAnalyzer.isActive();
+    if (icaAnalyzer.hasCurve()) {
+        int16_t low = icaAnalyzer.getLowBin();
+        doc["v0"] = icaAnalyzer.binCentreMV(low);
+        doc["step"] = ICA_BIN_MV;
+        JsonArray q = doc.createNestedArray("q");
+        for (int16_t b = low; b <= icaAnalyzer.getHighBin(); b++) {
+            q.add(icaAnalyzer.smoothedAt(b));
+        }
+        IcaPeak peaks[ICA_MAX_PEAKS];
+        uint8_t count = icaAnalyzer.selectPeaks(peaks);
+        JsonArray p = doc.createNestedArray("peaks");
+        for (uint8_t i = 0; i < count; i++) {
+            JsonObject peak = p.createNestedObject();
+            peak["v"] = peaks[i].mv;
+            peak["h"] = peaks[i].height;
+        }
+    }
+    if (hasIcaSummary) {
+        JsonObject summary = doc.createNestedObject("summary");
+        summary["capacity"] = lastIcaSummary.capacityMAh;
+        JsonArray p = summary.createNestedArray("peaks");
+        for (uint8_t i = 0; i < lastIcaSummary.peakCount; i++) {
+            JsonObject peak = p.createNestedObject();
+            peak["v"] = lastIcaSummary.peaks[i].mv;
+            peak["h"] = lastIcaSummary.peaks[i].height;
         }
     }
 
     String output;
     serializeJson(doc, output);
-    client->text(output);
+    if (client) {
+        client->text(output);
+    } else {
+        ws.textAll(output);
+    }
+}
+
+// Send OCV table slots to web clients
+void sendOcvTables() {
+    if (ws.count() == 0) return;
+
+    DynamicJsonDocument doc(2048);
+    doc["type"] = "ocv";
+    doc["active"] = ocvLibrary.getActive();
+    JsonArray slots = doc.createNestedArray("slots");
+    for (uint8_t i = 0; i < OCV_SLOT_COUNT; i++) {
+        const OcvSlot& slot = ocvLibrary.getSlot(i);
+        JsonObject s = slots.createNestedObject();
+        s["name"] = slot.name;
+        s["runs"] = slot.runs;
+        JsonArray mv = s.createNestedArray("mv");
+        for (uint8_t k = 0; k < OCV_TABLE_POINTS; k++) {
+            mv.add(slot.table.mv[k]);
+        }
+    }
+
+    String output;
+    serializeJson(doc, output);
+    ws.textAll(output);
+}
+
+// Notify web clients that a rule fired
+void sendRuleEvent(int index) {
+    if (ws.count() == 0) return;
+
+    const AlarmRule& r = alarmRules.getRule(index);
+    StaticJsonDocument<192> doc;
+    doc["type"] = "event";
+    doc["rule"] = index;
+    doc["metric"] = RULE_METRIC_NAMES[r.metric];
+    doc["action"] = RULE_ACTION_NAMES[r.action];
+    doc["value"] = alarmRules.getMetric(r.metric);
+    doc["t"] = millis() - startTime;
+
+    String output;
+    serializeJson(doc, output);
+    ws.textAll(output);
 }
 
 void sendError(const char* message) {
@@ -981,11 +2044,140 @@ void sendError(const char* message) {
     ws.textAll(output);
 }
 
+// ========================================= ALARM RULES ========================================
+// Evaluate user rules against the newest sample. Runs once per measurement,
+// only while a charge or discharge phase is active.
+void evaluateAlarmRules() {
+    static DeviceState ruleRunState = STATE_IDLE;
+
+    uint8_t scope = describeState(currentState).ruleScope;
+
+    // Entering a new phase restarts elapsed time, capacity and slope tracking
+    if (currentState != ruleRunState) {
+        alarmRules.resetRun();
+        ruleRunState = currentState;
+    }
+    if (scope == 0 || alarmRules.getRuleCount() == 0) return;
+
+    RuleSample sample;
+    sample.timeMs = millis();
+    sample.voltageMV = (int32_t)(BAT_Voltage * 1000.0f);
+    sample.capacityMAh = (int32_t)Capacity_f;
+    sample.scope = scope;
+
+    // Apply every rule that fired; stop once one of them ends the phase
+    uint8_t fired = alarmRules.evaluate(sample);
+    for (uint8_t i = 0; fired != 0 && i < MAX_ALARM_RULES; i++) {
+        if (fired & (1 << i)) {
+            fired &= ~(1 << i);
+            applyRuleAction(i);
+            if (currentState != ruleRunState) break;
+        }
+    }
+}
+
+void applyRuleAction(int index) {
+    const AlarmRule& rule = alarmRules.getRule(index);
+    Serial.printf("Rule %d fired: %s -> %s\n", index, RULE_METRIC_NAMES[rule.metric], RULE_ACTION_NAMES[rule.action]);
+
+    dataLogger.addEvent(index);
+    sendRuleEvent(index);
+
+    switch (rule.action) {
+        case RULE_ACTION_NEXT:
+            finishCurrentPhase();
+            break;
+        case RULE_ACTION_ABORT:
+            abortOperation();
+            break;
+        case RULE_ACTION_ALARM:
+            playErrorChime();
+            break;
+        case RULE_ACTION_MARK:
+        default:
+            break;
+    }
+}
+
+// End the active phase, from its termination condition or a rule: rig off and on to the
+// row's next state. An Analyze discharge asks its plan (next stage, a rest or the end).
+void finishCurrentPhase() {
+    if (currentState == STATE_ANALYZE_DISCHARGE) {
+        endAnalyzeStage();
+        return;
+    }
+    stopRig();
+    if (describeState(currentState).next == STATE_COMPLETE) {
+        beep(300);
+    }
+    enterNextState();
+}
+
+// Analyze discharge stages from the staged / rate sweep settings (DischargePlan.h)
+void beginAnalyzePlan() {
+    DischargeStage stages[PLAN_MAX_STAGES];
+    uint8_t n = 0;
+    if (sweepEnabled) {
+        for (uint8_t i = 0; i < sweepCount; i++) {
+            stages[n++] = {sweepCurrentIndex[i], (uint16_t)(sweepCutoff * 1000 + 0.5f), sweepRestS};
+        }
+    } else if (stagedAnalyzeEnabled) {
+        stages[n++] = {(uint8_t)stage1CurrentIndex, (uint16_t)(stage1TransitionVoltage * 1000 + 0.5f), 0};
+        stages[n++] = {(uint8_t)stage2CurrentIndex, (uint16_t)(stage2FinalCutoff * 1000 + 0.5f), 0};
+    } else {
+        stages[n++] = {(uint8_t)stage1CurrentIndex, (uint16_t)(stage2FinalCutoff * 1000 + 0.5f), 0};
+    }
+    dischargePlan.begin(stages, n, sweepEnabled);
+}
+
+// Apply the plan's current stage: its cutoff and load current
+void startPlanStage() {
+    const DischargeStage& stage = dischargePlan.getStage();
+    cutoffVoltage = stage.cutoffMV / 1000.0f;
+    PWM_Index = stage.currentIndex;
+    PWM_Value = PWM[PWM_Index];
+    applyThermalDerating();  // Sets loadIndex: rest and stage hand-overs don't pass through continueOperation
+    dischargePlan.startStage(millis(), Capacity_f, Current[PWM_Index]);
+}
+
+// The running stage reached its cutoff (or a rule ended it): next stage, a rest, or done
+void endAnalyzeStage() {
+    dischargePlan.endStage(millis(), BAT_Voltage, Capacity_f);
+    if (dischargePlan.isLastStage()) {
+        stopRig();
+        ocvLearner.endDischarge(millis(), Capacity_f);
+        if (icaAnalyzer.isActive()) {
+            finishIcaAnalysis();
+        }
+        finishCoulombicEfficiency();
+        finishRateSweep();
+        beep(300);
+        currentState = STATE_COMPLETE;
+    } else if (dischargePlan.getStage().restS > 0) {
+        stopRig();
+        sendRateSweep(nullptr);
+        restStartTime = millis();
+        currentState = STATE_ANALYZE_STAGE_REST;
+    } else {
+        advanceAnalyzeStage();
+    }
+}
+
+// Load on at the next stage's current
+void advanceAnalyzeStage() {
+    dischargePlan.next();
+    startPlanStage();
+    beep(100);  // Audible feedback for stage transition
+}
+
 // ========================================= BUTTON HANDLING ========================================
 void readButtons() {
     Mode_Button.read();
     UP_Button.read();
     Down_Button.read();
+    if (Mode_Button.isPressed() || UP_Button.isPressed() || Down_Button.isPressed()) {
+        powerManager.noteActivity(millis());
+    }
 }
 
 void clearButtonStates() {
@@ -1005,90 +2197,58 @@ void resetToIdle() {
     analogWrite(PWM_Pin, 0);
 }
 
-void beep(int duration) {
-    // Simple beep using LEDC at 1000 Hz
-    ledcChangeFrequency(Buzzer, 1000, LEDC_RESOLUTION);
-    ledcWrite(Buzzer, 128);  // 50% duty cycle
-    delay(duration);
-    ledcWrite(Buzzer, 0);    // Stop
-}
-
 // ========================================= TONE GENERATION ========================================
-// Play a single tone at specified frequency and duration
-void playTone(int frequency, int duration) {
-    if (frequency == 0) {
-        // Rest/silence
-        ledcWrite(Buzzer, 0);
-        delay(duration);
-    } else {
-        // Change frequency and set duty cycle to 50% for audible tone
-        ledcChangeFrequency(Buzzer, frequency, LEDC_RESOLUTION);
-        ledcWrite(Buzzer, 128);  // 50% duty cycle = 128 out of 255
-        delay(duration);
-        ledcWrite(Buzzer, 0);    // Stop tone
-    }
+// All tones are queued on toneSequencer and play in the background (see ToneSequencer.h)
+void beep(int duration) {
+    toneSequencer.playTone(1000, duration);
 }
 
 // Play startup chime (ascending pattern)
 void playStartupChime() {
-    // Rising scale: C5 -> D5 -> E5 -> G5 (pleasant ascending pattern)
-    playTone(523, 150);   // C5 (Middle C + 12 semitones)
-    delay(50);
-    playTone(587, 150);   // D5
-    delay(50);
-    playTone(659, 150);   // E5
-    delay(50);
-    playTone(784, 300);   // G5 (held longer for resolution)
-    delay(100);
+    toneSequencer.play(TONE_SEQUENCE(CHIME_STARTUP));
 }
 
 // Play completion chime (descending pattern)
 void playCompletionChime() {
-    // Descending pattern: G5 -> E5 -> D5 -> C5 (pleasant descending resolution)
-    playTone(784, 150);   // G5
-    delay(50);
-    playTone(659, 150);   // E5
-    delay(50);
-    playTone(587, 150);   // D5
-    delay(50);
-    playTone(523, 300);   // C5 (held longer)
-    delay(100);
+    toneSequencer.play(TONE_SEQUENCE(CHIME_COMPLETE));
 }
 
 // Play error chime (warning tone - descending low notes)
 void playErrorChime() {
-    // Warning pattern: Low G -> Low F -> Low G (urgent warning)
-    playTone(392, 100);   // G4 (lower octave)
-    delay(50);
-    playTone(349, 100);   // F4
-    delay(50);
-    playTone(392, 200);   // G4 (held longer)
-    delay(50);
+    toneSequencer.play(TONE_SEQUENCE(CHIME_ERROR));
+}
+
+// Double beep for aborted operations
+void playAbortBeep() {
+    toneSequencer.play(TONE_SEQUENCE(BEEP_ABORT));
 }
 
 // ========================================= VOLTAGE MEASUREMENT ========================================
-float measureVcc() {
-    float vrefSum = 0;
-    for (int i = 0; i < 50; i++) {
-        vrefSum += analogRead(Vref_Pin);
-        delay(1);
-    }
-    float averageVrefReading = vrefSum / 50.0;
-    float vcc = (Vref_Voltage * 4096.0) / averageVrefReading;
-    return vcc;
+// One PWM-synchronous raw block (readAdcBlock in AdcSampler.h), each conversion also
+// streamed as serial telemetry
+void sampleAdcBlock(int pin, uint8_t channel, uint16_t* raw) {
+    readAdcBlock(pin, raw, [channel](uint16_t sample) {
+        telemetry.sendAdcSample(channel, sample);
+    });
+}
+
+// Re-read the LM385 reference (only needed without eFuse calibration)
+void refreshVref() {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    sampleAdcBlock(Vref_Pin, TELEM_ADC_CHANNEL_VREF, raw);
+    adcCalibration.setVrefCounts(vrefFilter.process(raw));  // Q4 counts
 }
 
 float measureBatteryVoltage() {
-    Vcc = measureVcc();
-    float batterySum = 0;
-    for (int i = 0; i < 50; i++) {
-        batterySum += analogRead(BAT_Pin);
-        delay(1);
-    }
-    float averageBatteryReading = batterySum / 50.0;
-    float voltageDividerRatio = (R1 + R2) / R2;
-    float batteryVoltage = (averageBatteryReading * Vcc / 4096.0) * voltageDividerRatio;
-    return batteryVoltage;
+    if (adcCalibration.needsVrefRefresh()) {
+        refreshVref();
+    }
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    sampleAdcBlock(BAT_Pin, TELEM_ADC_CHANNEL_BAT, raw);
+    int32_t batteryCounts = batteryFilter.process(raw);  // Q4 counts
+    uncorrectedVoltage = adcCalibration.toPinMillivolts(batteryCounts) / 1000.0f * XiaoC3Board::DIVIDER_RATIO;
+    sampleReady = true;
+    return adcCalibration.correct(uncorrectedVoltage);
 }
 
 void updateTiming() {
@@ -1103,30 +2263,168 @@ void updateTiming() {
 // Returns estimated current based on mode
 int getCurrentMA() {
     switch (currentState) {
-        case STATE_CHARGING:
-        case STATE_ANALYZE_CHARGE:
-            // Return estimated charge current (set by R7 on LP4060)
-            return CHARGE_CURRENT_MA;
+        case STATE_STORAGE_PREP:
+            return storageController.getCurrentMA();
+        case STATE_SELF_DISCHARGE:
+            return (selfDischargeTest.getPhase() == SD_PHASE_CHARGE) ? CHARGE_CURRENT_MA : 0;
+        default:
+            break;
+    }
+    switch (describeState(currentState).rig) {
+        case RIG_CHARGER:
+            // Modelled CC/CV current (CC level set by R7 on LP4060)
+            return (int)(chargeEstimator.getCurrentMA() + 0.5f);
+        case RIG_LOAD:
+            // Return applied discharge current (after thermal derating)
+            return Current[loadIndex];
+        default:
+            return 0;
+    }
+}
+
+// Current through the load MOSFET (charging current does not heat it)
+int getLoadCurrentMA() {
+    if (currentState == STATE_STORAGE_PREP) {
+        return storageController.isChargerOn() ? 0 : storageController.getCurrentMA();
+    }
+    return (describeState(currentState).rig == RIG_LOAD) ? Current[loadIndex] : 0;
+}
 
-        case STATE_DISCHARGING:
-        case STATE_ANALYZE_DISCHARGE:
-            // Return set discharge current
-            return Current[PWM_Index];
+// Drive the load at the requested current, or lower while the MOSFET model is too hot
+void applyThermalDerating() {
+    loadIndex = thermalModel.limitIndex(PWM_Index);
+    analogWrite(PWM_Pin, PWM[loadIndex]);
+}
+
+// ========================================= OPERATION ENGINE ========================================
+// Per-tick work shared by the charge and discharge states, driven by their STATE_TABLE row
+
+// Leave any running operation: hardware off, learning discarded, back to the menu
+void abortOperation() {
+    resetToIdle();
+    ocvLearner.cancel();
+    icaAnalyzer.cancel();
+    selfDischargeTest.stop();
+    playAbortBeep();
+    abortRequested = false;
+    currentState = STATE_MENU;
+}
+
+// Exits the row's flags describe, before its handler runs; true when the state was left
+bool runStateExits(const StateDescriptor& desc) {
+    if ((desc.flags & STATE_FLAG_ABORT) && Mode_Button.wasReleased()) {
+        abortOperation();
+        return true;
+    }
+    if ((desc.flags & STATE_FLAG_DISMISS) &&
+        (abortRequested || Mode_Button.wasReleased() || UP_Button.wasReleased() || Down_Button.wasReleased())) {
+        abortRequested = false;
+        enterNextState();
+        return true;
+    }
+    return false;
+}
+
+// Move to the current row's next state
+void enterNextState() {
+    stateStartTime = millis();
+    currentState = describeState(currentState).next;
+}
+
+// Charger on with a fresh charge estimate (after Capacity_f and the logger are reset)
+void startChargeEstimate() {
+    chargeStartVoltage = measureBatteryVoltage();
+    analyzeChargeMAh = 0;
+    digitalWrite(Mosfet_Pin, HIGH); // Enable charging circuit
+    chargeEstimator.begin(millis(), CHARGE_CURRENT_MA, FULL_BAT_level * 1000,
+                          chargeTaperEnabled, chargeProbesEnabled);
+}
+
+// Timing, measurement, capacity, logging and the termination check
+OpResult tickOperation() {
+    const StateDescriptor& desc = describeState(currentState);
+    updateTiming();
+    float volts = measureBatteryVoltage();
+
+    unsigned long currentTime = millis();
+    float elapsedTimeInHours = (currentTime - lastCapacityUpdate) / 3600000.0;
+    lastCapacityUpdate = currentTime;
+    if (desc.integrator == INTEGRATE_CHARGE) {
+        // Modelled CC/CV current (ChargeEstimator.h); it may switch the charger off for a probe
+        bool chargerWasOn = chargeEstimator.isChargerOn();
+        chargeEstimator.update(currentTime, volts * 1000);
+        Capacity_f = chargeEstimator.getChargeMAh();
+        if (chargeEstimator.isChargerOn() != chargerWasOn) {
+            digitalWrite(Mosfet_Pin, chargeEstimator.isChargerOn() ? HIGH : LOW);
+            batteryFilter.reset();  // Next reading is the voltage step, unsmoothed
+        }
+        if (!chargeEstimator.wasSampleUsable()) {
+            // Probe or settling reading: not a charge sample, keep it off the chart and alarms
+            sampleReady = false;
+            return OP_RUNNING;
+        }
+    } else if (desc.integrator == INTEGRATE_LOAD) {
+        Capacity_f += (Current[loadIndex] + currentOffset) * elapsedTimeInHours;
+    }
+    BAT_Voltage = volts;
+
+    if ((desc.flags & STATE_FLAG_LOG) && dataLogger.addDataPoint(BAT_Voltage, getCurrentMA(), Capacity_f)) {
+        sampleLogged = true;
+    }
 
+    if ((desc.termination == TERMINATE_FULL && chargeEstimator.isFinished(BAT_Voltage * 1000)) ||
+        (desc.termination == TERMINATE_CUTOFF && BAT_Voltage <= cutoffVoltage)) {
+        return OP_TERMINATED;
+    }
+    return OP_RUNNING;
+}
+
+// Switch off whatever the current row drives
+void stopRig() {
+    switch (describeState(currentState).rig) {
+        case RIG_CHARGER:
+            digitalWrite(Mosfet_Pin, LOW);
+            break;
+        case RIG_LOAD:
+            analogWrite(PWM_Pin, 0);
+            break;
         default:
-            return 0;
+            break;
+    }
+}
+
+// Still running: derate the load, draw the row's screen (title overrides the row's) and publish
+void continueOperation(const char* title) {
+    const StateDescriptor& desc = describeState(currentState);
+    if (desc.rig == RIG_LOAD) {
+        applyThermalDerating();
+    }
+    if (!title) {
+        title = desc.title;
+    }
+
+    if (desc.screen == SCREEN_CHARGE) {
+        operationScreen.showCharge(title, elapsedTime, Capacity_f, BAT_Voltage);
+    } else if (desc.screen == SCREEN_DISCHARGE) {
+        operationScreen.showDischarge(title, thermalModel.isDerating(PWM_Index), elapsedTime, Capacity_f, BAT_Voltage);
+    }
+
+    // Send the newly logged sample to web clients
+    if (sampleLogged) {
+        sendDataPoint();
+        sampleLogged = false;
     }
 }
 
 // ========================================= STATE HANDLERS ========================================
 void handleMenuState() {
-    // Handle button navigation (7 menu items: 0-6)
+    // Handle button navigation (8 menu items: 0-7)
     if (UP_Button.wasReleased()) {
-        selectedMode = (selectedMode == 0) ? 6 : selectedMode - 1;
+        selectedMode = (selectedMode == 0) ? 7 : selectedMode - 1;
         beep(100);
     }
     if (Down_Button.wasReleased()) {
-        selectedMode = (selectedMode == 6) ? 0 : selectedMode + 1;
+        selectedMode = (selectedMode == 7) ? 0 : selectedMode + 1;
         beep(100);
     }
     if (Mode_Button.wasReleased()) {
@@ -1159,7 +2457,7 @@ void handleMenuState() {
             startTime = millis();
             lastCapacityUpdate = millis();
             analogWrite(PWM_Pin, 0);        // Ensure discharge load is OFF
-            digitalWrite(Mosfet_Pin, HIGH); // Enable charging circuit
+            startChargeEstimate();
             currentState = STATE_CHARGING;
         }
         else if (selectedMode == 1) {
@@ -1202,6 +2500,7 @@ void handleMenuState() {
                 return;
             }
             stateStartTime = millis();
+            irStep = 0;
             analogWrite(PWM_Pin, 0);
             digitalWrite(Mosfet_Pin, LOW);
             currentState = STATE_IR_MEASURE;
@@ -1212,29 +2511,23 @@ void handleMenuState() {
         }
         else if (selectedMode == 5) {
             // Storage Prep
-            stateStartTime = millis();
-            Hour = Minute = Second = 0;
-            // Start charging or discharging immediately based on current voltage
-            if (BAT_Voltage < (STORAGE_TARGET_VOLTAGE - STORAGE_VOLTAGE_TOLERANCE)) {
-                // Below range: charge
-                digitalWrite(Mosfet_Pin, HIGH);
-                analogWrite(PWM_Pin, 0);  // Charging (0% PWM)
-            } else if (BAT_Voltage > (STORAGE_TARGET_VOLTAGE + STORAGE_VOLTAGE_TOLERANCE)) {
-                // Above range: discharge
-                digitalWrite(Mosfet_Pin, LOW);
-                // Calculate PWM for storage prep current
-                int targetPWM = map(STORAGE_PREP_CURRENT_MA, 0, Current[Array_Size - 1], 0, 255);
-                analogWrite(PWM_Pin, targetPWM);
-            } else {
-                // Already in range: go straight to complete
-                digitalWrite(Mosfet_Pin, LOW);
-                analogWrite(PWM_Pin, 0);
-                currentState = STATE_COMPLETE;
+            startStoragePrep(ocvLibrary.activeTable());
+        }
+        else if (selectedMode == 6) {
+            // Self-discharge test with default schedule
+            BAT_Voltage = measureBatteryVoltage();
+            if (BAT_Voltage < NO_BAT_level || BAT_Voltage < DAMAGE_BAT_level) {
+                playErrorChime();
+                display.clearDisplay();
+                display.setCursor(15, 25);
+                display.print(BAT_Voltage < NO_BAT_level ? "EMPTY BAT SLOT" : "BAT DAMAGED");
+                display.display();
+                delay(2000);
                 return;
             }
-            currentState = STATE_STORAGE_PREP;
+            startSelfDischarge(SD_DEFAULT_INTERVAL_MIN, SD_DEFAULT_HOURS, SD_DEFAULT_LIMIT_MV_DAY, true);
         }
-        else if (selectedMode == 6) {
+        else if (selectedMode == 7) {
             // WiFi Info
             currentState = STATE_WIFI_INFO;
         }
@@ -1253,9 +2546,9 @@ void handleMenuState() {
     }
     
     // Display up to 4 menu items
-    const char* modes[] = {"Charge", "Discharge", "Analyze", "IR Test", "Bat Check", "Storage", "WiFi Info"};
+    const char* modes[] = {"Charge", "Discharge", "Analyze", "IR Test", "Bat Check", "Storage", "Self-Dis", "WiFi Info"};
     int yPos = 12;
-    for (int i = 0; i < 4 && (scrollOffset + i) < 7; i++) {
+    for (int i = 0; i < 4 && (scrollOffset + i) < 8; i++) {
         int modeIdx = scrollOffset + i;
         display.setCursor(15, yPos);
         if (modeIdx == selectedMode) {
@@ -1308,244 +2601,67 @@ void handleSelectCurrentState() {
     if (Mode_Button.wasReleased()) {
         beep(300);
         PWM_Value = PWM[PWM_Index];
-        Capacity_f = 0;
-        dataLogger.reset();
-        startTime = millis();
-        lastCapacityUpdate = millis();
-        digitalWrite(Mosfet_Pin, LOW);
-        analogWrite(PWM_Pin, PWM_Value);
-        clearButtonStates();
-        currentState = STATE_DISCHARGING;
-    }
-
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setCursor(2, 5);
-    display.print("Select Dischrg Curr:");
-
-    // Show warning for high currents
-    if (Current[PWM_Index] > HIGH_CURRENT_THRESHOLD) {
-        display.setCursor(2, 52);
-        display.print("!! HIGH CURRENT !!");
-    }
-
-    display.setTextSize(2);
-    display.setCursor(15, 25);
-    display.print("I:");
-    display.print(Current[PWM_Index]);
-    display.print("mA");
-    display.display();
-}
-
-void handleChargingState() {
-    // Check for abort
-    if (Mode_Button.wasReleased()) {
-        resetToIdle();
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
-        return;
-    }
-
-    updateTiming();
-    BAT_Voltage = measureBatteryVoltage();
-
-    // Calculate estimated capacity (using known charge current from LP4060)
-    // Note: This is an estimate - actual current tapers during CV phase
-    unsigned long currentTime = millis();
-    float elapsedTimeInHours = (currentTime - lastCapacityUpdate) / 3600000.0;
-    Capacity_f += CHARGE_CURRENT_MA * elapsedTimeInHours;
-    lastCapacityUpdate = currentTime;
-
-    // Log data
-    dataLogger.addDataPoint(BAT_Voltage, getCurrentMA(), Capacity_f);
-
-    // Check if charging complete
-    if (BAT_Voltage >= FULL_BAT_level) {
-        digitalWrite(Mosfet_Pin, LOW);
-        beep(300);
-        currentState = STATE_COMPLETE;
-        return;
-    }
-
-    // Update display
-    display.clearDisplay();
-    updateBatteryDisplay(true);
-    display.setTextSize(1);
-    display.setCursor(5, 5);
-    display.print("Charging..");
-    display.setCursor(5, 18);
-    display.print("Time:");
-    display.print(Hour);
-    display.print(":");
-    display.print(Minute);
-    display.print(":");
-    display.print(Second);
-    display.setCursor(5, 31);
-    display.print("~Cap:");
-    display.print(Capacity_f, 0);
-    display.print("mAh");
-    display.setCursor(5, 48);
-    display.setTextSize(2);
-    display.print("V:");
-    display.print(BAT_Voltage, 2);
-    display.print("V");
-    display.display();
-
-    // Send data point to web clients
-    sendDataPoint();
-}
-
-void handleDischargingState() {
-    // Check for abort
-    if (Mode_Button.wasReleased()) {
-        resetToIdle();
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
-        return;
-    }
-
-    updateTiming();
-    BAT_Voltage = measureBatteryVoltage();
-
-    // Calculate capacity
-    unsigned long currentTime = millis();
-    float elapsedTimeInHours = (currentTime - lastCapacityUpdate) / 3600000.0;
-    Capacity_f += (Current[PWM_Index] + currentOffset) * elapsedTimeInHours;
-    lastCapacityUpdate = currentTime;
-
-    // Log data
-    dataLogger.addDataPoint(BAT_Voltage, Current[PWM_Index], Capacity_f);
-
-    // Check if discharge complete
-    if (BAT_Voltage <= cutoffVoltage) {
-        analogWrite(PWM_Pin, 0);
-        beep(300);
-        currentState = STATE_COMPLETE;
-        return;
-    }
-
-    // Update display
-    display.clearDisplay();
-    updateBatteryDisplay(false);
-    display.setTextSize(1);
-    display.setCursor(15, 5);
-    display.print("Discharging..");
-    display.setCursor(15, 20);
-    display.print("Time: ");
-    display.print(Hour);
-    display.print(":");
-    display.print(Minute);
-    display.print(":");
-    display.print(Second);
-    display.setCursor(15, 35);
-    display.print("Cap:");
-    display.print(Capacity_f, 1);
-    display.print("mAh");
-    display.setCursor(15, 50);
-    display.print("V: ");
-    display.print(BAT_Voltage, 2);
-    display.print("V");
-    display.display();
-
-    // Send data point to web clients
-    sendDataPoint();
-}
-
-void handleAnalyzeChargeState() {
-    // Check for abort
-    if (Mode_Button.wasReleased()) {
-        resetToIdle();
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
-        return;
-    }
-
-    updateTiming();
-    BAT_Voltage = measureBatteryVoltage();
-
-    // Calculate estimated capacity during charge phase
-    unsigned long currentTime = millis();
-    float elapsedTimeInHours = (currentTime - lastCapacityUpdate) / 3600000.0;
-    Capacity_f += CHARGE_CURRENT_MA * elapsedTimeInHours;
-    lastCapacityUpdate = currentTime;
-
-    // Log data
-    dataLogger.addDataPoint(BAT_Voltage, getCurrentMA(), Capacity_f);
-
-    // Check if charging complete
-    if (BAT_Voltage >= FULL_BAT_level) {
+        Capacity_f = 0;
+        dataLogger.reset();
+        startTime = millis();
+        lastCapacityUpdate = millis();
         digitalWrite(Mosfet_Pin, LOW);
-        restStartTime = millis();
-        currentState = STATE_ANALYZE_REST;
-        return;
+        applyThermalDerating();  // Sets loadIndex before the first tick integrates it
+        clearButtonStates();
+        currentState = STATE_DISCHARGING;
     }
 
-    // Update display
     display.clearDisplay();
-    updateBatteryDisplay(true);
     display.setTextSize(1);
-    display.setCursor(5, 5);
-    display.print("Analyze - Charging");
-    display.setCursor(5, 18);
-    display.print("Time:");
-    display.print(Hour);
-    display.print(":");
-    display.print(Minute);
-    display.print(":");
-    display.print(Second);
-    display.setCursor(5, 31);
-    display.print("~Cap:");
-    display.print(Capacity_f, 0);
-    display.print("mAh");
-    display.setCursor(5, 48);
+    display.setCursor(2, 5);
+    display.print("Select Dischrg Curr:");
+
+    // Show warning for high currents
+    if (Current[PWM_Index] > HIGH_CURRENT_THRESHOLD) {
+        display.setCursor(2, 52);
+        display.print("!! HIGH CURRENT !!");
+    }
+
     display.setTextSize(2);
-    display.print("V:");
-    display.print(BAT_Voltage, 2);
-    display.print("V");
+    display.setCursor(15, 25);
+    display.print("I:");
+    display.print(Current[PWM_Index]);
+    display.print("mA");
     display.display();
-
-    sendDataPoint();
 }
 
-void handleAnalyzeRestState() {
-    // Check for abort
-    if (Mode_Button.wasReleased()) {
-        resetToIdle();
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
+// Charge, Discharge and the Analyze charge: run until the row's termination, then its next state
+void handleOperationState() {
+    if (tickOperation() == OP_TERMINATED) {
+        finishCurrentPhase();
         return;
     }
+    continueOperation(nullptr);
+}
 
+void handleAnalyzeRestState() {
     // Wait for 3 minutes
-    if (millis() - restStartTime >= 180000) {
-        // Start discharge with configured values
-        analyzeDischargeStage = 1;
-
-        if (stagedAnalyzeEnabled) {
-            // Use Stage 1 settings first
-            cutoffVoltage = stage1TransitionVoltage;
-            PWM_Index = stage1CurrentIndex;
+    if (millis() - stateStartTime >= 180000) {
+        if (sweepEnabled) {
+            // Rests and rate changes break the single-discharge OCV and dQ/dV curves
+            ocvLearner.cancel();
+            icaAnalyzer.cancel();
         } else {
-            // Single stage: use configured current and final cutoff
-            cutoffVoltage = stage2FinalCutoff;
-            PWM_Index = stage1CurrentIndex;
+            // Rested voltage is the 100% point of the learned OCV table
+            batteryFilter.reset();
+            ocvLearner.begin(millis(), measureBatteryVoltage());
+            icaAnalyzer.begin();
         }
 
-        PWM_Value = PWM[PWM_Index];
+        // Start discharge with the first stage of the plan
+        beginAnalyzePlan();
+        analyzeChargeMAh = Capacity_f;  // Unchanged since the charge ended
         Capacity_f = 0;
         startTime = millis();
         lastCapacityUpdate = millis();
         digitalWrite(Mosfet_Pin, LOW);
-        analogWrite(PWM_Pin, PWM_Value);
-        currentState = STATE_ANALYZE_DISCHARGE;
+        startPlanStage();
+        enterNextState();
         return;
     }
 
@@ -1558,100 +2674,56 @@ void handleAnalyzeRestState() {
 }
 
 void handleAnalyzeDischargeState() {
-    // Check for abort
-    if (Mode_Button.wasReleased()) {
-        resetToIdle();
-        analyzeDischargeStage = 1;  // Reset stage
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
-        return;
-    }
-
-    updateTiming();
-    BAT_Voltage = measureBatteryVoltage();
+    OpResult result = tickOperation();
 
-    // Calculate capacity
     unsigned long currentTime = millis();
-    float elapsedTimeInHours = (currentTime - lastCapacityUpdate) / 3600000.0;
-    Capacity_f += (Current[PWM_Index] + currentOffset) * elapsedTimeInHours;
-    lastCapacityUpdate = currentTime;
-
-    // Log data
-    dataLogger.addDataPoint(BAT_Voltage, Current[PWM_Index], Capacity_f);
-
-    // Check for stage transition (staged mode, stage 1, voltage reached transition point)
-    if (stagedAnalyzeEnabled && analyzeDischargeStage == 1) {
-        if (BAT_Voltage <= stage1TransitionVoltage) {
-            // Transition to Stage 2
-            analyzeDischargeStage = 2;
-            cutoffVoltage = stage2FinalCutoff;
-            PWM_Index = stage2CurrentIndex;
-            PWM_Value = PWM[PWM_Index];
-            analogWrite(PWM_Pin, PWM_Value);
-            beep(100);  // Audible feedback for stage transition
+    ocvLearner.addSample(currentTime, BAT_Voltage, Current[loadIndex] + currentOffset, Capacity_f);
+    dischargePlan.addSample(BAT_Voltage, Capacity_f);
+
+    // dQ/dV on IR-compensated voltage, once the load-step IR has been read (or rejected)
+    if (icaAnalyzer.isActive() && ocvLearner.getState() != OCV_LEARN_WAIT_IR) {
+        float compensated = BAT_Voltage + (Current[loadIndex] + currentOffset) / 1000.0f * ocvLearner.getIrOhms();
+        icaAnalyzer.addSample(compensated, Capacity_f);
+        if (currentTime - lastIcaPublish >= ICA_PUBLISH_MS) {
+            lastIcaPublish = currentTime;
+            sendIcaCurve(nullptr);
         }
     }
 
-    // Check if discharge complete (final cutoff reached)
-    if (BAT_Voltage <= cutoffVoltage) {
-        // In staged mode, only complete if we're in stage 2
-        // In single-stage mode, complete immediately
-        if (!stagedAnalyzeEnabled || analyzeDischargeStage == 2) {
-            analogWrite(PWM_Pin, 0);
-            analyzeDischargeStage = 1;  // Reset for next run
-            beep(300);
-            currentState = STATE_COMPLETE;
-            return;
-        }
+    // Each stage ends at its own cutoff (staged: Stage 1's is the transition voltage)
+    if (result == OP_TERMINATED) {
+        endAnalyzeStage();
+        if (currentState != STATE_ANALYZE_DISCHARGE) return;
     }
 
-    // Update display
-    display.clearDisplay();
-    updateBatteryDisplay(false);
-    display.setTextSize(1);
-    display.setCursor(10, 5);
-    if (stagedAnalyzeEnabled) {
-        display.print("Analyze - S");
-        display.print(analyzeDischargeStage);
+    if (dischargePlan.getStageCount() > 1) {
+        char title[16];
+        snprintf(title, sizeof(title), "Analyze - S%u", dischargePlan.getStageIndex() + 1);
+        continueOperation(title);
     } else {
-        display.print("Analyzing - D");
+        continueOperation(nullptr);
     }
-    display.setCursor(15, 20);
-    display.print("Time: ");
-    display.print(Hour);
-    display.print(":");
-    display.print(Minute);
-    display.print(":");
-    display.print(Second);
-    display.setCursor(15, 35);
-    display.print("Cap:");
-    display.print(Capacity_f, 1);
-    display.print("mAh");
-    display.setCursor(15, 50);
-    display.print("V: ");
-    display.print(BAT_Voltage, 2);
-    display.print("V");
-    display.display();
-
-    sendDataPoint();
 }
 
-void handleIRMeasureState() {
-    static int irStep = 0;
+// Load off between rate sweep stages; the recovered voltage is kept with the stage result
+void handleAnalyzeStageRestState() {
+    tickOperation();
 
-    // Check for abort
-    if (Mode_Button.wasReleased()) {
-        resetToIdle();
-        irStep = 0;
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
+    uint32_t restMs = dischargePlan.getStage().restS * 1000UL;
+    uint32_t elapsed = millis() - restStartTime;
+    if (elapsed >= restMs) {
+        dischargePlan.setRecovered(BAT_Voltage);
+        enterNextState();
+        advanceAnalyzeStage();
         return;
     }
 
+    char title[16];
+    snprintf(title, sizeof(title), "Rest %lus", (unsigned long)((restMs - elapsed) / 1000));
+    continueOperation(title);
+}
+
+void handleIRMeasureState() {
     // Display measuring
     display.clearDisplay();
     display.setTextSize(1);
@@ -1662,6 +2734,7 @@ void handleIRMeasureState() {
     if (irStep == 0) {
         // Wait 500ms for voltage to stabilize
         if (millis() - stateStartTime >= 500) {
+            batteryFilter.reset();  // Unsmoothed reading, independent of earlier samples
             voltageNoLoad = measureBatteryVoltage();
             PWM_Index = 6;  // 500mA
             PWM_Value = PWM[PWM_Index];
@@ -1673,6 +2746,7 @@ void handleIRMeasureState() {
     else if (irStep == 1) {
         // Wait 500ms under load
         if (millis() - stateStartTime >= 500) {
+            batteryFilter.reset();
             voltageLoad = measureBatteryVoltage();
             analogWrite(PWM_Pin, 0);
 
@@ -1685,41 +2759,20 @@ void handleIRMeasureState() {
             }
 
             beep(300);
-            stateStartTime = millis();
-            irStep = 0;
-            currentState = STATE_IR_DISPLAY;
+            enterNextState();
         }
     }
 }
 
 void handleIRDisplayState() {
-    // Check for any button or timeout
-    if (Mode_Button.wasReleased() || UP_Button.wasReleased() || Down_Button.wasReleased()) {
-        currentState = STATE_MENU;
-        return;
-    }
-
-    // Auto-return after 5 seconds
+    // Auto-return after 5 seconds (any button dismisses it earlier)
     if (millis() - stateStartTime >= 5000) {
-        currentState = STATE_MENU;
+        enterNextState();
         return;
     }
 
     // Display IR result
-    display.clearDisplay();
-    display.drawLine(34, 15, 54, 15, SSD1306_WHITE);
-    display.drawLine(54, 15, 59, 20, SSD1306_WHITE);
-    display.drawLine(59, 20, 64, 10, SSD1306_WHITE);
-    display.drawLine(64, 10, 69, 20, SSD1306_WHITE);
-    display.drawLine(69, 20, 74, 15, SSD1306_WHITE);
-    display.drawLine(74, 15, 94, 15, SSD1306_WHITE);
-
-    display.setTextSize(2);
-    display.setCursor(2, 35);
-    display.print("IR:");
-    display.print(internalResistance * 1000, 0);
-    display.print("mOhm");
-    display.display();
+    operationScreen.showInternalResistance(internalResistance);
 }
 
 void handleCompleteState() {
@@ -1730,48 +2783,155 @@ void handleCompleteState() {
         chimePlayedComplete = true;
     }
 
+    // After an Analyze run the cell rests here for the empty-end OCV point
+    bool ocvResting = ocvLearner.getState() == OCV_LEARN_END_REST;
+    if (ocvResting) {
+        BAT_Voltage = measureBatteryVoltage();
+        if (ocvLearner.addRestSample(millis(), BAT_Voltage)) {
+            finishOcvLearning();
+            ocvResting = false;
+        }
+    }
+
     // Reset flag when leaving this state (respond to buttons or abort command)
     if (abortRequested || Mode_Button.wasReleased() || UP_Button.wasReleased() || Down_Button.wasReleased()) {
         abortRequested = false;
         chimePlayedComplete = false;
+        coulombicEfficiency = 0;
+        if (ocvResting) {
+            finishOcvLearning();  // Rest cut short - learn without the relaxed 0% point
+        }
         currentState = STATE_MENU;
         return;
     }
 
-    // Display complete screen
-    display.clearDisplay();
-    display.setTextSize(1);
-    display.setCursor(15, 5);
-    display.print("Complete");
-    display.setCursor(15, 20);
-    display.print("Time: ");
-    display.print(Hour);
-    display.print(":");
-    display.print(Minute);
-    display.print(":");
-    display.print(Second);
-    display.setCursor(15, 35);
-    display.print("Cap:");
-    display.print(Capacity_f, 1);
-    display.print("mAh");
-    display.setCursor(15, 50);
-    display.print("V: ");
-    display.print(BAT_Voltage, 2);
-    display.print("V");
+    // Display complete screen, with the OCV rest countdown after an Analyze run
+    char note[20];
+    if (ocvResting) {
+        snprintf(note, sizeof(note), " OCV %lus", (unsigned long)ocvLearner.getRestRemaining(millis()));
+    }
+    operationScreen.showComplete(ocvResting ? note : nullptr, elapsedTime, Capacity_f, BAT_Voltage, Capacity_f <= 0);
+}
 
-    drawBatteryOutline();
-    drawBatteryFill(Capacity_f > 0 ? 0 : 100);
+// Close the dQ/dV curve at cutoff and keep its peaks as the run summary
+void finishIcaAnalysis() {
+    IcaSummary summary;
+    if (!icaAnalyzer.finish(Capacity_f, summary)) {
+        Serial.println("ICA: run too short for a summary");
+        sendIcaCurve(nullptr);
+        return;
+    }
+    lastIcaSummary = summary;
+    hasIcaSummary = true;
+    preferences.begin(PREF_ICA_NAMESPACE, false);
+    preferences.putBytes(PREF_ICA_LAST, &lastIcaSummary, sizeof(IcaSummary));
+    preferences.end();
 
-    display.display();
+    Serial.printf("ICA: %.0f mAh, peaks:", summary.capacityMAh);
+    for (uint8_t i = 0; i < summary.peakCount; i++) {
+        Serial.printf(" %umV/%umAh/V", summary.peaks[i].mv, summary.peaks[i].height);
+    }
+    Serial.println();
+    sendIcaCurve(nullptr);
 }
 
-void handleWiFiInfoState() {
-    // Return to menu on any button press
-    if (Mode_Button.wasReleased() || UP_Button.wasReleased() || Down_Button.wasReleased()) {
-        currentState = STATE_MENU;
+// Discharge capacity over the modelled charge put in. Only meaningful when the Analyze charge
+// started from an empty cell, i.e. rested within CHARGE_CE_EMPTY_MARGIN_MV of the final cutoff
+// (the last stage's)
+void finishCoulombicEfficiency() {
+    coulombicEfficiency = 0;
+    if (analyzeChargeMAh <= 0) {
+        return;
+    }
+    if (chargeStartVoltage * 1000 > dischargePlan.getStage().cutoffMV + CHARGE_CE_EMPTY_MARGIN_MV) {
+        Serial.printf("Charge: %.0f mAh in, not from empty (%.2fV) - no coulombic efficiency\n",
+                      analyzeChargeMAh, chargeStartVoltage);
+        return;
+    }
+    coulombicEfficiency = Capacity_f / analyzeChargeMAh * 100.0f;
+    Serial.printf("Charge: %.0f mAh in, %.0f mAh out, coulombic efficiency %.1f%%\n",
+                  analyzeChargeMAh, Capacity_f, coulombicEfficiency);
+}
+
+// Rate sweep table on the serial console, and to web clients (sweep runs only)
+void finishRateSweep() {
+    if (!dischargePlan.isSweep()) {
+        return;
+    }
+    Serial.println("Rate sweep: current, stage mAh, capacity at rate, mean loaded V, mWh, time");
+    for (uint8_t i = 0; i < dischargePlan.getResultCount(); i++) {
+        const StageResult& r = dischargePlan.getResult(i);
+        Serial.printf("  %4u mA  %6.0f  %6.0f mAh  %.3f V  %6.0f mWh  %lu s\n", r.currentMA, r.mAh,
+                      dischargePlan.getCapacityAt(i), r.avgMV / 1000.0f, r.mWh, (unsigned long)r.seconds);
+    }
+    float k;
+    if (dischargePlan.fitPeukert(k)) {
+        Serial.printf("  Peukert k = %.3f\n", k);
+    }
+    sendRateSweep(nullptr);
+}
+
+// Completed rate sweep stages with their loaded-voltage profiles, and the Peukert fit
+void sendRateSweep(AsyncWebSocketClient *client) {
+    if (ws.count() == 0) return;
+
+    DynamicJsonDocument doc(6144);
+    doc["type"] = "sweep";
+    doc["live"] = currentState == STATE_ANALYZE_DISCHARGE || currentState == STATE_ANALYZE_STAGE_REST;
+    doc["cutoff"] = dischargePlan.getStage().cutoffMV;
+    JsonArray stages = doc.createNestedArray("stages");
+    for (uint8_t i = 0; i < dischargePlan.getResultCount(); i++) {
+        const StageResult& r = dischargePlan.getResult(i);
+        JsonObject stage = stages.createNestedObject();
+        stage["ma"] = r.currentMA;
+        stage["mean_ma"] = dischargePlan.getMeanCurrentMA(i);
+        stage["mah"] = r.mAh;
+        stage["cap"] = dischargePlan.getCapacityAt(i);
+        stage["mwh"] = r.mWh;
+        stage["s"] = r.seconds;
+        stage["v_start"] = r.startMV;
+        stage["v_avg"] = r.avgMV;
+        stage["v_end"] = r.endMV;
+        stage["v_rec"] = r.recoveredMV;
+        JsonArray q = stage.createNestedArray("q");
+        JsonArray v = stage.createNestedArray("v");
+        for (uint8_t p = 0; p < r.profileCount; p++) {
+            q.add((int)(r.profileMAh[p] + 0.5f));
+            v.add(r.profileMV[p]);
+        }
+    }
+    float k;
+    if (dischargePlan.fitPeukert(k)) {
+        doc["peukert"] = k;
+    }
+
+    String output;
+    serializeJson(doc, output);
+    if (client) {
+        client->text(output);
+    } else {
+        ws.textAll(output);
+    }
+}
+
+// Fold a finished Analyze run into the active OCV table
+void finishOcvLearning() {
+    OcvTable learned;
+    if (!ocvLearner.finish(learned) || !ocvLibrary.learn(learned)) {
+        Serial.println("OCV table: run not usable for learning");
         return;
     }
+    saveOcvLibrary();
+    const OcvSlot& slot = ocvLibrary.getSlot(ocvLibrary.getActive());
+    Serial.printf("OCV table '%s' learned (%u runs):", slot.name, slot.runs);
+    for (uint8_t i = 0; i < OCV_TABLE_POINTS; i++) {
+        Serial.printf(" %u", slot.table.mv[i]);
+    }
+    Serial.println();
+    sendOcvTables();
+}
 
+void handleWiFiInfoState() {
     // Display WiFi information
     display.clearDisplay();
     display.setTextSize(1);
@@ -1815,13 +2975,6 @@ void handleWiFiInfoState() {
 
 // ========================================= BATTERY CHECK HANDLER ========================================
 void handleBatteryCheckState() {
-    // Return to menu on any button press or abort request
-    if (abortRequested || Mode_Button.wasReleased() || UP_Button.wasReleased() || Down_Button.wasReleased()) {
-        abortRequested = false;
-        currentState = STATE_MENU;
-        return;
-    }
-
     // Measure voltage continuously
     BAT_Voltage = measureBatteryVoltage();
 
@@ -1849,9 +3002,9 @@ void handleBatteryCheckState() {
         display.print("Status: Very Low");
     }
 
-    // Display charge percentage with bar graph
-    int batteryPercent = constrain((BAT_Voltage - Min_BAT_level) / (FULL_BAT_level - Min_BAT_level) * 100, 0, 100);
-    
+    // State of charge from the active OCV table (valid for a rested cell)
+    int batteryPercent = (int)(ocvToSoc(ocvLibrary.activeTable(), BAT_Voltage * 1000.0f) + 0.5f);
+
     // Draw battery level bar
     int barWidth = (batteryPercent / 100.0) * 70;
     display.setCursor(0, 38);
@@ -1869,36 +3022,22 @@ void handleBatteryCheckState() {
 }
 
 // ========================================= STORAGE PREP HANDLER ========================================
-void handleStoragePrepState() {
-    // Check for abort from web GUI or MODE button
-    if (abortRequested || Mode_Button.wasReleased()) {
-        abortRequested = false;
-        resetToIdle();
-        beep(100);
-        delay(100);
-        beep(100);
-        currentState = STATE_MENU;
-        return;
-    }
+// Start storage prep towards storageTargetSoc; the controller decides charge or discharge
+void startStoragePrep(const OcvTable& table) {
+    resetToIdle();
+    stateStartTime = millis();
+    Hour = Minute = Second = 0;
+    storageController.start(millis(), storageTargetSoc, table);
+    currentState = STATE_STORAGE_PREP;
+}
 
+void handleStoragePrepState() {
     updateTiming();
     BAT_Voltage = measureBatteryVoltage();
 
-    // Check if battery is in acceptable range (3.75V - 3.85V)
-    if (BAT_Voltage >= (STORAGE_TARGET_VOLTAGE - STORAGE_VOLTAGE_TOLERANCE) &&
-        BAT_Voltage <= (STORAGE_TARGET_VOLTAGE + STORAGE_VOLTAGE_TOLERANCE)) {
-        // Target reached! Stop charging/discharging
-        digitalWrite(Mosfet_Pin, LOW);
-        analogWrite(PWM_Pin, 0);
-        beep(100);
-        delay(50);
-        beep(100);
-        currentState = STATE_COMPLETE;
-        return;
-    }
-
     // Check for battery errors
     if (BAT_Voltage < NO_BAT_level) {
+        resetToIdle();
         playErrorChime();
         display.clearDisplay();
         display.setTextSize(1);
@@ -1908,12 +3047,12 @@ void handleStoragePrepState() {
         display.print("Detected!");
         display.display();
         delay(2000);
-        resetToIdle();
         currentState = STATE_MENU;
         return;
     }
     
     if (BAT_Voltage < DAMAGE_BAT_level) {
+        resetToIdle();
         playErrorChime();
         display.clearDisplay();
         display.setTextSize(1);
@@ -1923,34 +3062,32 @@ void handleStoragePrepState() {
         display.print("DAMAGED!");
         display.display();
         delay(2000);
-        resetToIdle();
         currentState = STATE_MENU;
         return;
     }
 
-    // Adjust charging/discharging based on current voltage
-    if (BAT_Voltage < (STORAGE_TARGET_VOLTAGE - STORAGE_VOLTAGE_TOLERANCE)) {
-        // Below range: charge
-        digitalWrite(Mosfet_Pin, HIGH);
-        analogWrite(PWM_Pin, 0);  // Charging (0% PWM)
-    } else {
-        // Above range: discharge
-        digitalWrite(Mosfet_Pin, LOW);
-        // Calculate PWM for storage prep current
-        int targetPWM = map(STORAGE_PREP_CURRENT_MA, 0, Current[Array_Size - 1], 0, 255);
-        analogWrite(PWM_Pin, targetPWM);
+    // Run the controller and apply its outputs (charger and load are never on together)
+    storageController.update(millis(), BAT_Voltage);
+    if (storageController.isDone()) {
+        resetToIdle();
+        if (storageController.hasLanded()) {
+            toneSequencer.play(TONE_SEQUENCE(BEEP_TARGET));
+        } else {
+            playErrorChime();  // Gave up outside tolerance
+        }
+        currentState = STATE_COMPLETE;
+        return;
     }
+    analogWrite(PWM_Pin, PWM[storageController.getLoadIndex()]);
+    digitalWrite(Mosfet_Pin, storageController.isChargerOn() ? HIGH : LOW);
 
     // Update display
     display.clearDisplay();
-    updateBatteryDisplay(true);
+    operationScreen.drawBatteryAnimation(storageController.isChargerOn());
     display.setTextSize(1);
     display.setCursor(5, 5);
-    if (BAT_Voltage < (STORAGE_TARGET_VOLTAGE - STORAGE_VOLTAGE_TOLERANCE)) {
-        display.print("Storage: Charging");
-    } else {
-        display.print("Storage: Discharging");
-    }
+    display.print("Storage: ");
+    display.print(storageController.getPhaseName());
     display.setCursor(5, 18);
     display.print("Time:");
     display.print(Hour);
@@ -1959,7 +3096,11 @@ void handleStoragePrepState() {
     display.print(":");
     display.print(Second);
     display.setCursor(5, 31);
-    display.print("Target: 3.8V");
+    display.print("SoC:");
+    display.print(storageController.getSocEstimate(), 0);
+    display.print("% > ");
+    display.print(storageController.getTargetSoc(), 0);
+    display.print("%");
     display.setCursor(5, 48);
     display.setTextSize(2);
     display.print("V:");
@@ -1968,6 +3109,130 @@ void handleStoragePrepState() {
     display.display();
 }
 
+// ========================================= SELF-DISCHARGE HANDLER ========================================
+// Optionally charge to full, then read the open-circuit voltage every intervalMin minutes
+void startSelfDischarge(uint16_t intervalMin, uint16_t hours, float limitMvPerDay, bool charge) {
+    resetToIdle();
+    selfDischargeTest.start(intervalMin, hours, limitMvPerDay, charge);
+    if (charge) {
+        digitalWrite(Mosfet_Pin, HIGH);
+    } else {
+        selfDischargeTest.startMonitor(millis());
+    }
+    Capacity_f = 0;
+    dataLogger.reset();
+    startTime = millis();
+    lastCapacityUpdate = millis();
+    currentState = STATE_SELF_DISCHARGE;
+    sendSelfDischargeSeries(nullptr);
+}
+
+void handleSelfDischargeState() {
+    // Finished: show the result until a button press
+    if (selfDischargeTest.getPhase() == SD_PHASE_DONE) {
+        if (abortRequested || Mode_Button.wasReleased() || UP_Button.wasReleased() || Down_Button.wasReleased()) {
+            abortRequested = false;
+            currentState = STATE_MENU;
+            return;
+        }
+    } else if (Mode_Button.wasReleased()) {
+        abortOperation();
+        return;
+    }
+
+    updateTiming();
+
+    if (selfDischargeTest.getPhase() == SD_PHASE_CHARGE) {
+        BAT_Voltage = measureBatteryVoltage();
+        if (BAT_Voltage >= FULL_BAT_level) {
+            digitalWrite(Mosfet_Pin, LOW);
+            selfDischargeTest.startMonitor(millis());
+            beep(100);
+        }
+    } else if (selfDischargeTest.sampleDue(millis())) {
+        // One unsmoothed reading per interval; nothing is measured in between
+        batteryFilter.reset();
+        BAT_Voltage = measureBatteryVoltage();
+        if (BAT_Voltage < NO_BAT_level) {
+            selfDischargeTest.stop();
+            playErrorChime();
+            sendError("Self-discharge: battery removed");
+            currentState = STATE_MENU;
+            return;
+        }
+        if (selfDischargeTest.addReading(millis(), BAT_Voltage)) {
+            sendSelfDischargePoint();
+        }
+        if (selfDischargeTest.getPhase() == SD_PHASE_DONE) {
+            SdVerdict verdict = selfDischargeTest.getVerdict();
+            if (verdict == SD_VERDICT_PENDING) {
+                Serial.printf("Self-discharge: insufficient data (%u fitted readings), no verdict\n",
+                              selfDischargeTest.getFitCount());
+            } else {
+                Serial.printf("Self-discharge: %.2f +/- %.2f mV/day over %u readings (%u outliers): %s\n",
+                              selfDischargeTest.getSlope(), selfDischargeTest.getSlopeError(),
+                              selfDischargeTest.getFitCount(), selfDischargeTest.getOutliers(),
+                              selfDischargeTest.getVerdictName());
+            }
+            if (verdict == SD_VERDICT_PASS) {
+                playCompletionChime();
+            } else {
+                playErrorChime();
+            }
+        }
+    }
+
+    // Update display
+    display.clearDisplay();
+    display.setTextSize(1);
+    display.setCursor(5, 5);
+    if (selfDischargeTest.getPhase() == SD_PHASE_CHARGE) {
+        display.print("Self-Dis: Charging");
+    } else {
+        uint32_t minutes = selfDischargeTest.getElapsedMs(millis()) / 60000;
+        display.print("Self-Dis ");
+        display.print(minutes / 60);
+        display.print("h");
+        display.print(minutes % 60);
+        display.print("m/");
+        display.print(selfDischargeTest.getHours());
+        display.print("h");
+    }
+    display.setCursor(5, 20);
+    display.print("V: ");
+    display.print(BAT_Voltage, 3);
+    display.print("V");
+    if (selfDischargeTest.getPhase() != SD_PHASE_CHARGE) {
+        display.setCursor(5, 35);
+        if (selfDischargeTest.getFitCount() >= 2) {
+            display.print(selfDischargeTest.getSlope(), 1);
+            display.print(" mV/day");
+        } else {
+            display.print("Settling...");
+        }
+        display.setCursor(5, 50);
+        if (selfDischargeTest.getPhase() == SD_PHASE_DONE) {
+            switch (selfDischargeTest.getVerdict()) {
+                case SD_VERDICT_PASS:
+                    display.print("PASS");
+                    break;
+                case SD_VERDICT_FAIL:
+                    display.print("FAIL - leaky cell");
+                    break;
+                default:
+                    display.print("INSUFFICIENT DATA");
+                    break;
+            }
+        } else {
+            display.print("Next: ");
+            display.print(selfDischargeTest.getSecondsToNext(millis()));
+            display.print("s ");
+            display.print(selfDischargeTest.getVerdictName());
+        }
+    }
+    display.display();
+}
+
 // ========================================= ANALYZE CONFIG HANDLERS ========================================
 void handleAnalyzeConfigToggleState() {
     // UP/DOWN toggles staged mode
@@ -1988,13 +3253,13 @@ void handleAnalyzeConfigToggleState() {
             // Start analyze with defaults (single-stage: 500mA, 3.0V cutoff)
             stage1CurrentIndex = 6;  // 500mA
             stage2FinalCutoff = 3.0;
-            analyzeDischargeStage = 1;
+            sweepEnabled = false;
             Capacity_f = 0;
             dataLogger.reset();
             startTime = millis();
             lastCapacityUpdate = millis();
             analogWrite(PWM_Pin, 0);
-            digitalWrite(Mosfet_Pin, HIGH);
+            startChargeEstimate();
             currentState = STATE_ANALYZE_CHARGE;
         }
         return;
@@ -2144,13 +3409,13 @@ void handleAnalyzeConfigStage2State() {
         } else {
             configField = 0;  // Reset for next time
             // Start the analyze operation
-            analyzeDischargeStage = 1;
+            sweepEnabled = false;
             Capacity_f = 0;
             dataLogger.reset();
             startTime = millis();
             lastCapacityUpdate = millis();
             analogWrite(PWM_Pin, 0);
-            digitalWrite(Mosfet_Pin, HIGH);
+            startChargeEstimate();
             currentState = STATE_ANALYZE_CHARGE;
         }
         return;
@@ -2189,33 +3454,3 @@ void handleAnalyzeConfigStage2State() {
 
     display.display();
 }
-
-// ========================================= DISPLAY HELPERS ========================================
-void drawBatteryOutline() {
-    display.drawRect(100, 15, 12, 20, SSD1306_WHITE);
-    display.drawRect(102, 12, 8, 3, SSD1306_WHITE);
-}
-
-void drawBatteryFill(int level) {
-    int fillHeight = map(level, 0, 100, 0, 18);
-    display.fillRect(102, 33 - fillHeight, 8, fillHeight, SSD1306_WHITE);
-}
-
-void updateBatteryDisplay(bool charging) {
-    unsigned long currentMillis = millis();
-
-    if (currentMillis - previousMillis >= displayInterval) {
-        previousMillis = currentMillis;
-
-        if (charging) {
-            batteryLevel += 4;
-            if (batteryLevel > 100) batteryLevel = 0;
-        } else {
-            batteryLevel -= 4;
-            if (batteryLevel < 0) batteryLevel = 100;
-        }
-
-        drawBatteryOutline();
-        drawBatteryFill(batteryLevel);
-    }
-}
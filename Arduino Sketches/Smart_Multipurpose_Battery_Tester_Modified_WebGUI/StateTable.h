@@ -0,0 +1,102 @@
+#ifndef STATE_TABLE_H
+#define STATE_TABLE_H
+
+// ========================================= STATE DESCRIPTORS ========================================
+// Every device state is described by one constexpr StateDescriptor row (the table itself
+// is in the sketch, next to the handlers it points at). The row says what drives the cell,
+// how capacity is counted, when the operation ends, where it goes next, which OLED layout
+// it uses and what the web UI calls it, so the loop dispatch, status reporting, power
+// level and alarm-rule scope are lookups instead of per-state switches.
+//
+// The loop dispatch handles the exits the flags describe (Mode aborts, any button
+// dismisses) before the handler runs. Charge and discharge style states run on the shared
+// operation engine in the sketch (tickOperation / continueOperation / finishCurrentPhase):
+// timing, ADC read, capacity integration, logging, the termination check and the move to
+// the row's next state happen in routines driven by the row; the state's handler only adds
+// what is specific to it. Plain Charge, Discharge and the Analyze charge share one handler.
+
+enum DeviceState {
+    STATE_IDLE,
+    STATE_MENU,
+    STATE_SELECT_CUTOFF,
+    STATE_SELECT_CURRENT,
+    STATE_CHARGING,
+    STATE_DISCHARGING,
+    STATE_ANALYZE_CHARGE,
+    STATE_ANALYZE_REST,
+    STATE_ANALYZE_DISCHARGE,
+    STATE_IR_MEASURE,
+    STATE_IR_DISPLAY,
+    STATE_COMPLETE,
+    STATE_WIFI_INFO,
+    STATE_BATTERY_CHECK,            // Real-time voltage monitoring
+    STATE_ANALYZE_CONFIG_TOGGLE,    // Enable/disable staged mode
+    STATE_ANALYZE_CONFIG_STAGE1,    // Stage 1: current + transition voltage
+    STATE_ANALYZE_CONFIG_STAGE2,    // Stage 2: current + final cutoff
+    STATE_STORAGE_PREP,             // Storage prep: charge/discharge to a target SoC
+    STATE_SELF_DISCHARGE,           // Leakage screen: charge, then sparse OCV readings for hours
+    STATE_ANALYZE_STAGE_REST,       // Load off between Analyze discharge stages (rate sweep)
+    STATE_COUNT
+};
+
+// What drives the cell while the state runs
+enum StateRig : uint8_t {
+    RIG_NONE,        // Open circuit
+    RIG_CHARGER,     // LP4060 enabled through Mosfet_Pin
+    RIG_LOAD,        // Electronic load at Current[loadIndex]
+    RIG_HANDLER      // The handler switches charger and load itself
+};
+
+// How Capacity_f is accumulated each tick
+enum StateIntegrator : uint8_t {
+    INTEGRATE_NONE,
+    INTEGRATE_CHARGE,    // Modelled CC/CV current, ChargeEstimator.h (LP4060 current can't be read)
+    INTEGRATE_LOAD       // Applied load current plus currentOffset
+};
+
+// Condition that ends the operation
+enum StateTermination : uint8_t {
+    TERMINATE_NONE,
+    TERMINATE_FULL,      // chargeEstimator.isFinished(): FULL_BAT_level, or the CV taper end
+    TERMINATE_CUTOFF     // BAT_Voltage <= cutoffVoltage
+};
+
+// OLED layout
+enum StateDisplay : uint8_t {
+    SCREEN_HANDLER,      // Drawn by the handler
+    SCREEN_CHARGE,       // Title, time, ~capacity, large voltage
+    SCREEN_DISCHARGE     // Title (+ HOT while derated), time, capacity, voltage
+};
+
+// Flags
+#define STATE_FLAG_IDLE 0x01     // Power manager may drop to the idle level
+#define STATE_FLAG_ABORT 0x02    // Mode button aborts: hardware off, back to the menu
+#define STATE_FLAG_LOG 0x04      // Samples go to the data logger and web chart
+#define STATE_FLAG_DISMISS 0x08  // Any button (or a web abort) goes to the row's next state
+
+struct StateDescriptor {
+    DeviceState state;           // Must match the row index
+    const char* wireName;        // Status "mode" sent to the web UI
+    const char* title;           // OLED title for the engine layouts
+    void (*handler)();           // Called once per loop pass (nullptr = back to menu)
+    StateRig rig;
+    StateIntegrator integrator;
+    StateTermination termination;
+    DeviceState next;            // Entered when the state finishes or is dismissed
+    StateDisplay screen;
+    uint8_t ruleScope;           // RULE_SCOPE_* bits the alarm rules run in (0 = none)
+    uint8_t flags;
+};
+
+// Row i describes state i, for every row (checked at compile time by the sketch)
+constexpr bool stateTableOrdered(const StateDescriptor* table, uint8_t count, uint8_t i = 0) {
+    return i == count || (table[i].state == i && stateTableOrdered(table, count, i + 1));
+}
+
+// Operation engine tick result
+enum OpResult : uint8_t {
+    OP_RUNNING,
+    OP_TERMINATED        // Termination condition met; the handler decides what follows
+};
+
+#endif // STATE_TABLE_H
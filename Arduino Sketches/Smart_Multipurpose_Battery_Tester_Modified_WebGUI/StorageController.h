@@ -0,0 +1,413 @@
+#ifndef STORAGE_CONTROLLER_H
+#define STORAGE_CONTROLLER_H
+
+#include "OcvTable.h"
+
+// ========================================= STORAGE PREP CONTROLLER ========================================
+// Brings a cell to a target state of charge and verifies it at rest.
+//
+//   PROBE_REST   outputs off, read open-circuit voltage
+//   PROBE_LOAD   brief load step -> internal resistance R = dV / I
+//   CHARGE       charger duty-cycled (it has a fixed current), duty tapers with the error
+//   DISCHARGE    load current tapers from STORAGE_MAX_CURRENT_MA to STORAGE_MIN_CURRENT_MA
+//   RELAX        outputs off until the voltage stops moving, then compare OCV with target
+//   DONE         landed (or gave up after STORAGE_MAX_PASSES)
+//
+// While current flows the controller works on an IR-compensated OCV estimate
+// (V + I*R discharging, V - I*R charging), so it stops when the cell - not the
+// loaded terminal voltage - reaches the target. The taper works on the SoC error,
+// not the voltage error, so the flat middle of the OCV curve does not stall it.
+//
+// IR compensation does not cover polarisation, so the first pass stops a little
+// short. The relax check measures the remaining error. The charge moved in the first
+// pass against its SoC change gives the cell's capacity. Correction passes then
+// move exactly the missing charge (coulomb counted) instead of chasing the voltage.
+// The voltage checks stay armed in correction passes too, so a wrong capacity cannot
+// drive the cell past the target: a pass also ends when the IR-compensated OCV is
+// beyond the target by more than STORAGE_GUARD_MARGIN_MV, and every pass ends when the
+// terminal voltage reaches the table's empty (discharge) or full (charge) OCV.
+//
+// The controller has no hardware access: the sketch feeds it voltage samples and
+// applies isChargerOn() / getLoadIndex(). Currents come from the sketch's Current[] table.
+
+#define STORAGE_DEFAULT_SOC 50          // % SoC target
+#define STORAGE_OCV_TOLERANCE_MV 10     // Relaxed OCV must land within this of the target
+#define STORAGE_PROBE_REST_MS 1000      // Open-circuit settle before the probe
+#define STORAGE_PROBE_LOAD_MS 1000      // Load step duration
+#define STORAGE_PROBE_INDEX 6           // Current[] index for the probe (500mA)
+#define STORAGE_MAX_CURRENT_MA 1000     // Discharge current far from target
+#define STORAGE_MIN_CURRENT_MA 200      // Discharge current at the target
+#define STORAGE_TAPER_BAND_SOC 5.0f     // SoC error (%) below which current/duty tapers
+#define STORAGE_SETTLE_MS 500           // Ignore samples this long after an output change
+#define STORAGE_CHARGE_PERIOD_MS 10000  // Charger duty-cycle period
+#define STORAGE_MIN_DUTY 0.2f           // Charger on-time fraction at the target
+#define STORAGE_RELAX_MIN_MS 60000      // Minimum rest before reading OCV
+#define STORAGE_RELAX_MAX_MS 600000     // Take the reading anyway after this
+#define STORAGE_RELAX_WINDOW_MS 30000   // Settled when the voltage moves less than...
+#define STORAGE_RELAX_SETTLED_MV 1      // ...this over one window
+#define STORAGE_MAX_PASSES 4            // Correction passes before giving up
+#define STORAGE_DEFAULT_IR 0.1f         // Ohms, used if the probe result is implausible
+#define STORAGE_MIN_LEARN_SOC 2.0f      // SoC change (%) needed to trust a capacity estimate
+#define STORAGE_GUARD_MARGIN_MV 25      // Correction pass: OCV estimate may pass the target by this much
+                                        // (polarisation the IR probe misses, ~20 mV at 200mA)
+
+enum StoragePhase : uint8_t {
+    STORAGE_PHASE_PROBE_REST,
+    STORAGE_PHASE_PROBE_LOAD,
+    STORAGE_PHASE_CHARGE,
+    STORAGE_PHASE_DISCHARGE,
+    STORAGE_PHASE_RELAX,
+    STORAGE_PHASE_DONE
+};
+
+static const char* const STORAGE_PHASE_NAMES[] = {
+    "probe", "probe", "charge", "discharge", "relax", "done"
+};
+
+class StorageController {
+private:
+    const int* currents;      // Current[] table (mA), index 0 = off
+    uint8_t currentCount;
+    int chargeCurrentMA;      // Charger's fixed current
+    OcvTable table;
+
+    StoragePhase phase;
+    uint32_t phaseStart;
+    uint32_t settleUntil;
+    float targetSoc;
+    float targetMV;
+
+    // Outputs
+    bool chargerOn;
+    uint8_t loadIndex;
+
+    // Estimates
+    float irOhms;
+    float ocvEstimateMV;
+    float probeOcvMV;
+
+    // Charge duty cycle
+    uint32_t cycleStart;
+    float duty;
+
+    // Relax / verification
+    uint32_t relaxAnchorMs;
+    float relaxAnchorMV;
+    uint8_t passes;
+    bool landed;
+
+    // Coulomb counting (mAh, positive = discharged)
+    uint32_t lastUpdateMs;
+    float passStartOcvMV;     // Relaxed OCV the current pass started from
+    float passMAh;            // Charge moved in the current pass
+    float passBudgetMAh;      // Correction pass: stop after this much (0 = voltage-terminated)
+    float capacityMAh;        // Learned from the first pass (0 = unknown)
+
+    void setOutputs(uint32_t now, bool charger, uint8_t index) {
+        if (charger != chargerOn || index != loadIndex) {
+            settleUntil = now + STORAGE_SETTLE_MS;
+        }
+        chargerOn = charger;
+        loadIndex = index;
+    }
+
+    void enterPhase(uint32_t now, StoragePhase next) {
+        phase = next;
+        phaseStart = now;
+    }
+
+    // Largest table entry not above mA (at least the smallest non-zero one)
+    uint8_t indexFor(float mA) const {
+        uint8_t index = 1;
+        for (uint8_t i = 1; i < currentCount; i++) {
+            if (currents[i] <= mA) index = i;
+        }
+        return index;
+    }
+
+    // Fraction of full rate for an OCV estimate: 1 outside the taper band, linear inside
+    float taperFraction(float ocvMV) const {
+        float fraction = fabsf(ocvToSoc(table, ocvMV) - targetSoc) / STORAGE_TAPER_BAND_SOC;
+        return (fraction > 1) ? 1 : fraction;
+    }
+
+    float taperCurrent(float ocvMV) const {
+        return STORAGE_MIN_CURRENT_MA + (STORAGE_MAX_CURRENT_MA - STORAGE_MIN_CURRENT_MA) * taperFraction(ocvMV);
+    }
+
+    float taperDuty(float ocvMV) const {
+        return STORAGE_MIN_DUTY + (1 - STORAGE_MIN_DUTY) * taperFraction(ocvMV);
+    }
+
+    // Start a charge or discharge pass from the current (relaxed) OCV estimate.
+    // With a known capacity the pass is a coulomb-counted correction at the lowest rate.
+    void beginPass(uint32_t now) {
+        passStartOcvMV = ocvEstimateMV;
+        passMAh = 0;
+        passBudgetMAh = 0;
+        if (capacityMAh > 0) {
+            passBudgetMAh = fabsf(ocvToSoc(table, ocvEstimateMV) - targetSoc) / 100.0f * capacityMAh;
+        }
+
+        if (ocvEstimateMV > targetMV) {
+            enterPhase(now, STORAGE_PHASE_DISCHARGE);
+            setOutputs(now, false, indexFor(passBudgetMAh > 0 ? STORAGE_MIN_CURRENT_MA : taperCurrent(ocvEstimateMV)));
+        } else {
+            enterPhase(now, STORAGE_PHASE_CHARGE);
+            duty = (passBudgetMAh > 0) ? STORAGE_MIN_DUTY : taperDuty(ocvEstimateMV);
+            cycleStart = now;
+            setOutputs(now, true, 0);
+        }
+    }
+
+    // Correction passes end on charge moved, not on voltage
+    bool budgetReached() const {
+        return passBudgetMAh > 0 && fabsf(passMAh) >= passBudgetMAh;
+    }
+
+    // Terminal voltage limits for any pass: the active table's empty and full OCV
+    bool belowFloor(float mv) const {
+        return mv <= table.mv[0];
+    }
+
+    bool aboveCeiling(float mv) const {
+        return mv >= table.mv[OCV_TABLE_POINTS - 1];
+    }
+
+    // OCV estimate has reached the target (voltage-terminated pass) or gone past it by
+    // more than the guard margin (correction pass - the charge budget should have ended it)
+    bool pastTarget(float ocvMV, bool discharging) const {
+        float margin = (passBudgetMAh > 0) ? STORAGE_GUARD_MARGIN_MV : 0;
+        return discharging ? (ocvMV <= targetMV - margin) : (ocvMV >= targetMV + margin);
+    }
+
+    // Capacity from the first voltage-terminated pass: charge moved / SoC change
+    void learnCapacity(float relaxedMV) {
+        if (capacityMAh > 0 || passBudgetMAh > 0) return;
+        float socChange = ocvToSoc(table, passStartOcvMV) - ocvToSoc(table, relaxedMV);
+        if (fabsf(socChange) >= STORAGE_MIN_LEARN_SOC && socChange * passMAh > 0) {
+            capacityMAh = passMAh / socChange * 100.0f;
+        }
+    }
+
+    void beginRelax(uint32_t now, float mv) {
+        enterPhase(now, STORAGE_PHASE_RELAX);
+        setOutputs(now, false, 0);
+        relaxAnchorMs = now;
+        relaxAnchorMV = mv;
+    }
+
+    void updateDischarge(uint32_t now, float mv) {
+        if (budgetReached() || belowFloor(mv)) {
+            beginRelax(now, mv);
+            return;
+        }
+        if ((int32_t)(now - settleUntil) < 0) return;
+        ocvEstimateMV = mv + irOhms * currents[loadIndex];
+        if (pastTarget(ocvEstimateMV, true)) {
+            beginRelax(now, mv);
+            return;
+        }
+        if (passBudgetMAh > 0) return;
+        // Only ever step the current down within a pass
+        uint8_t index = indexFor(taperCurrent(ocvEstimateMV));
+        if (index < loadIndex) {
+            setOutputs(now, false, index);
+        }
+    }
+
+    void updateCharge(uint32_t now, float mv) {
+        if (budgetReached() || (chargerOn && aboveCeiling(mv))) {
+            beginRelax(now, mv);
+            return;
+        }
+        uint32_t elapsed = now - cycleStart;
+        if (elapsed >= STORAGE_CHARGE_PERIOD_MS) {
+            cycleStart = now;
+            setOutputs(now, true, 0);
+            return;
+        }
+        if (!chargerOn) return;
+        if (elapsed >= duty * STORAGE_CHARGE_PERIOD_MS) {
+            setOutputs(now, false, 0);
+            return;
+        }
+        if ((int32_t)(now - settleUntil) < 0) return;
+
+        ocvEstimateMV = mv - irOhms * chargeCurrentMA;
+        if (pastTarget(ocvEstimateMV, false)) {
+            beginRelax(now, mv);
+            return;
+        }
+        if (passBudgetMAh > 0) return;
+        duty = taperDuty(ocvEstimateMV);
+    }
+
+    void updateRelax(uint32_t now, float mv) {
+        ocvEstimateMV = mv;
+        uint32_t resting = now - phaseStart;
+        bool settled = false;
+        if (now - relaxAnchorMs >= STORAGE_RELAX_WINDOW_MS) {
+            float moved = mv - relaxAnchorMV;
+            if (moved < 0) moved = -moved;
+            settled = (moved <= STORAGE_RELAX_SETTLED_MV) && resting >= STORAGE_RELAX_MIN_MS;
+            relaxAnchorMs = now;
+            relaxAnchorMV = mv;
+        }
+        if (!settled && resting < STORAGE_RELAX_MAX_MS) return;
+
+        learnCapacity(mv);
+        float error = mv - targetMV;
+        if (error < 0) error = -error;
+        if (error <= STORAGE_OCV_TOLERANCE_MV) {
+            landed = true;
+            enterPhase(now, STORAGE_PHASE_DONE);
+        } else if (passes >= STORAGE_MAX_PASSES) {
+            enterPhase(now, STORAGE_PHASE_DONE);
+        } else {
+            passes++;
+            beginPass(now);
+        }
+    }
+
+public:
+    StorageController() : currents(nullptr), currentCount(0), chargeCurrentMA(0),
+                          table(OCV_TABLE_LIION_DEFAULT), phase(STORAGE_PHASE_DONE), phaseStart(0),
+                          settleUntil(0), targetSoc(STORAGE_DEFAULT_SOC), targetMV(0), chargerOn(false),
+                          loadIndex(0), irOhms(STORAGE_DEFAULT_IR), ocvEstimateMV(0), probeOcvMV(0),
+                          cycleStart(0), duty(1), relaxAnchorMs(0), relaxAnchorMV(0), passes(0), landed(false),
+                          lastUpdateMs(0), passStartOcvMV(0), passMAh(0), passBudgetMAh(0), capacityMAh(0) {}
+
+    void begin(const int* currentTable, uint8_t count, int chargerMA) {
+        currents = currentTable;
+        currentCount = count;
+        chargeCurrentMA = chargerMA;
+    }
+
+    // Start a new storage prep run towards socPercent using the given OCV table
+    void start(uint32_t now, float socPercent, const OcvTable& ocvTable) {
+        table = ocvTable;
+        targetSoc = socPercent;
+        targetMV = socToOcv(table, socPercent);
+        irOhms = STORAGE_DEFAULT_IR;
+        ocvEstimateMV = 0;
+        probeOcvMV = 0;
+        passes = 0;
+        landed = false;
+        chargerOn = false;
+        loadIndex = 0;
+        settleUntil = now;
+        lastUpdateMs = now;
+        passMAh = 0;
+        passBudgetMAh = 0;
+        capacityMAh = 0;
+        enterPhase(now, STORAGE_PHASE_PROBE_REST);
+    }
+
+    // Feed one battery voltage sample (V)
+    void update(uint32_t now, float voltage) {
+        float mv = voltage * 1000.0f;
+
+        // Integrate the current applied since the previous sample
+        int signedMA = chargerOn ? -chargeCurrentMA : (loadIndex ? currents[loadIndex] : 0);
+        passMAh += signedMA * (float)(now - lastUpdateMs) / 3600000.0f;
+        lastUpdateMs = now;
+
+        switch (phase) {
+            case STORAGE_PHASE_PROBE_REST:
+                ocvEstimateMV = mv;
+                if (now - phaseStart >= STORAGE_PROBE_REST_MS) {
+                    probeOcvMV = mv;
+                    enterPhase(now, STORAGE_PHASE_PROBE_LOAD);
+                    setOutputs(now, false, STORAGE_PROBE_INDEX < currentCount ? STORAGE_PROBE_INDEX : currentCount - 1);
+                }
+                break;
+            case STORAGE_PHASE_PROBE_LOAD:
+                if (now - phaseStart >= STORAGE_PROBE_LOAD_MS) {
+                    float r = (probeOcvMV - mv) / currents[loadIndex];  // mV / mA = ohms
+                    irOhms = (r > 0.01f && r < 1.0f) ? r : STORAGE_DEFAULT_IR;
+                    ocvEstimateMV = probeOcvMV;
+                    if (fabsf(probeOcvMV - targetMV) <= STORAGE_OCV_TOLERANCE_MV) {
+                        beginRelax(now, mv);  // Already close - just verify at rest
+                    } else {
+                        beginPass(now);
+                    }
+                }
+                break;
+            case STORAGE_PHASE_CHARGE:
+                updateCharge(now, mv);
+                break;
+            case STORAGE_PHASE_DISCHARGE:
+                updateDischarge(now, mv);
+                break;
+            case STORAGE_PHASE_RELAX:
+                updateRelax(now, mv);
+                break;
+            case STORAGE_PHASE_DONE:
+                setOutputs(now, false, 0);
+                break;
+        }
+    }
+
+    bool isChargerOn() const {
+        return chargerOn;
+    }
+
+    uint8_t getLoadIndex() const {
+        return loadIndex;
+    }
+
+    int getCurrentMA() const {
+        return chargerOn ? chargeCurrentMA : (loadIndex ? currents[loadIndex] : 0);
+    }
+
+    StoragePhase getPhase() const {
+        return phase;
+    }
+
+    const char* getPhaseName() const {
+        return STORAGE_PHASE_NAMES[phase];
+    }
+
+    bool isDone() const {
+        return phase == STORAGE_PHASE_DONE;
+    }
+
+    bool hasLanded() const {
+        return landed;
+    }
+
+    float getTargetSoc() const {
+        return targetSoc;
+    }
+
+    float getTargetMV() const {
+        return targetMV;
+    }
+
+    float getOcvEstimateMV() const {
+        return ocvEstimateMV;
+    }
+
+    float getSocEstimate() const {
+        return ocvToSoc(table, ocvEstimateMV);
+    }
+
+    float getIrOhms() const {
+        return irOhms;
+    }
+
+    uint8_t getPasses() const {
+        return passes;
+    }
+
+    // Learned capacity in mAh (0 until the first pass has relaxed)
+    float getCapacityMAh() const {
+        return capacityMAh;
+    }
+};
+
+// Global storage prep controller
+StorageController storageController;
+
+#endif // STORAGE_CONTROLLER_H
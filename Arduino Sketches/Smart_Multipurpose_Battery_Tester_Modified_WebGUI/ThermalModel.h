@@ -0,0 +1,159 @@
+#ifndef THERMAL_MODEL_H
+#define THERMAL_MODEL_H
+
+#include <math.h>
+
+// ========================================= LOAD MOSFET THERMAL MODEL ========================================
+// Lumped RC model of the discharge MOSFET (IRL540) on its heatsink:
+//
+//   P   = I x (V_bat - I x R_sense)                       MOSFET dissipation
+//   T_h : C_h dT_h/dt = P - (T_h - T_amb) / R_ha           heatsink node, stepped exactly each tick
+//   T_j = T_h + P x R_jh                                   junction (die/case time constant ignored)
+//
+// The model sets a ceiling on the Current[] index the discharge modes may use. The
+// ceiling starts at the top of the table, so a cold heatsink's thermal mass is used
+// in full. When T_j passes the limit, the ceiling drops one step below the load in use.
+// It only rises again if the next step would be safe in steady state, which stops the
+// load hunting between two settings. The sketch keeps the user's PWM_Index and applies
+// min(PWM_Index, ceiling); capacity is integrated with the current actually applied.
+//
+// Parameters are per heatsink and are set with the thermal_config web command (saved in NVS).
+
+#define THERMAL_TICK_MS 100             // Model update period
+#define THERMAL_DERATE_STEP_MS 2000     // Min time between downward steps (lets T_j respond)
+#define THERMAL_RECOVER_STEP_MS 10000   // Min time between upward steps
+#define THERMAL_HYSTERESIS_C 5.0f       // Step up only with this much margin below the limit
+
+// Calibration for one heatsink - also the NVS record format, so keep it plain data
+struct ThermalParams {
+    float ambientC;     // Air temperature around the heatsink
+    float rJhCW;        // Junction -> heatsink (R_thJC + interface), C/W
+    float rHaCW;        // Heatsink -> ambient, C/W
+    float cHaJC;        // Heatsink heat capacity, J/C
+    float limitC;       // Junction temperature the derating holds below
+    float senseOhms;    // Current sense resistor in series with the MOSFET
+};
+
+// Small clip-on heatsink: 1A is sustainable, 1.5A and 2A derate after a few minutes
+static const ThermalParams THERMAL_DEFAULT_PARAMS = {25.0f, 1.5f, 15.0f, 15.0f, 100.0f, 0.5f};
+
+class ThermalModel {
+private:
+    ThermalParams params;
+    const int* currents;    // Current[] table from the sketch (mA)
+    uint8_t currentCount;
+    uint8_t ceiling;        // Highest Current[] index allowed now
+
+    float heatsinkC;
+    float junctionC;
+    float powerW;
+    float loadMA;
+    uint32_t lastTickMs;
+    uint32_t lastStepMs;
+
+    float mosfetPower(float mA, float volts) const {
+        float amps = mA / 1000.0f;
+        float p = amps * (volts - amps * params.senseOhms);
+        return (p > 0) ? p : 0;
+    }
+
+public:
+    ThermalModel() : params(THERMAL_DEFAULT_PARAMS), currents(nullptr), currentCount(0), ceiling(0),
+                     heatsinkC(THERMAL_DEFAULT_PARAMS.ambientC), junctionC(THERMAL_DEFAULT_PARAMS.ambientC),
+                     powerW(0), loadMA(0), lastTickMs(0), lastStepMs(0) {}
+
+    void begin(const int* currentTable, uint8_t count) {
+        currents = currentTable;
+        currentCount = count;
+        ceiling = count - 1;
+        heatsinkC = params.ambientC;
+        junctionC = params.ambientC;
+    }
+
+    // Reject values that would make the model meaningless
+    static bool paramsValid(const ThermalParams& p) {
+        return p.ambientC > -20 && p.ambientC < 60 &&
+               p.rJhCW >= 0 && p.rJhCW < 20 &&
+               p.rHaCW > 0.5f && p.rHaCW < 200 &&
+               p.cHaJC > 0.1f && p.cHaJC < 1000 &&
+               p.limitC > p.ambientC + 10 && p.limitC <= 175 &&
+               p.senseOhms >= 0 && p.senseOhms < 10;
+    }
+
+    bool setParams(const ThermalParams& p) {
+        if (!paramsValid(p)) return false;
+        params = p;
+        return true;
+    }
+
+    const ThermalParams& getParams() const {
+        return params;
+    }
+
+    // Advance the model with the load current actually applied (0 when the load is off)
+    void update(uint32_t now, float volts, float mA) {
+        if (now - lastTickMs < THERMAL_TICK_MS) return;
+        float dt = (now - lastTickMs) / 1000.0f;
+        lastTickMs = now;
+
+        loadMA = mA;
+        powerW = mosfetPower(mA, volts);
+        float steadyC = params.ambientC + powerW * params.rHaCW;
+        heatsinkC = steadyC + (heatsinkC - steadyC) * expf(-dt / (params.rHaCW * params.cHaJC));
+        junctionC = heatsinkC + powerW * params.rJhCW;
+
+        if (junctionC > params.limitC) {
+            // Over the limit: one step below the load in use
+            if (mA > 0 && now - lastStepMs >= THERMAL_DERATE_STEP_MS) {
+                uint8_t next = ceiling;
+                while (next > 1 && currents[next] >= mA) next--;
+                if (next < ceiling) {
+                    ceiling = next;
+                    lastStepMs = now;
+                }
+            }
+        } else if (ceiling < currentCount - 1 && now - lastStepMs >= THERMAL_RECOVER_STEP_MS) {
+            // Next step up must be safe indefinitely, not just while the heatsink is cool
+            float p = mosfetPower(currents[ceiling + 1], volts);
+            float steadyJunctionC = params.ambientC + p * (params.rHaCW + params.rJhCW);
+            if (steadyJunctionC < params.limitC - THERMAL_HYSTERESIS_C) {
+                ceiling++;
+                lastStepMs = now;
+            }
+        }
+    }
+
+    // Index to apply for a requested Current[] index
+    uint8_t limitIndex(uint8_t requested) const {
+        return (requested > ceiling) ? ceiling : requested;
+    }
+
+    bool isDerating(uint8_t requested) const {
+        return requested > ceiling;
+    }
+
+    float getJunctionC() const {
+        return junctionC;
+    }
+
+    float getHeatsinkC() const {
+        return heatsinkC;
+    }
+
+    float getPowerW() const {
+        return powerW;
+    }
+
+    float getLoadMA() const {
+        return loadMA;
+    }
+
+    int getCeilingMA() const {
+        return currents ? currents[ceiling] : 0;
+    }
+};
+
+// Global thermal model instance
+ThermalModel thermalModel;
+
+#endif // THERMAL_MODEL_H
@@ -113,7 +113,7 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             background: #1a1a2e;
             border-radius: 8px;
         }
-        #chart { width: 100%; height: 100%; }
+        #chart, #sdChart, #icaChart { width: 100%; height: 100%; }
 
         .settings-row {
             display: flex;
@@ -282,6 +282,11 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 <span id="wifiName">Connecting...</span><br>
                 <span class="ip" id="ipAddress">---.---.---.---</span>
                 <button class="wifi-btn" onclick="toggleWifiPanel()">WiFi</button>
+                <button class="wifi-btn" onclick="toggleRulesPanel()">Rules</button>
+                <button class="wifi-btn" onclick="toggleCalPanel()">Cal</button>
+                <button class="wifi-btn" onclick="toggleOcvPanel()">OCV</button>
+                <button class="wifi-btn" onclick="toggleThermalPanel()">Thermal</button>
+                <button class="wifi-btn" onclick="toggleBenchPanel()">Bench</button>
             </div>
         </header>
 
@@ -292,6 +297,7 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             <button class="mode-btn ir" onclick="selectMode('ir')" id="btnIR">IR Test</button>
             <button class="mode-btn" onclick="selectMode('batcheck')" id="btnBatCheck" style="border-left: 3px solid #9b59b6;">Bat Check</button>
             <button class="mode-btn" onclick="selectMode('storage')" id="btnStorage" style="border-left: 3px solid #1abc9c;">Storage</button>
+            <button class="mode-btn" onclick="selectMode('selfdischarge')" id="btnSelfDischarge" style="border-left: 3px solid #e67e22;">Self-Dis</button>
         </div>
 
         <div class="card" id="dischargeSettings" style="display:none;">
@@ -322,7 +328,73 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 </div>
             </div>
             <div id="highCurrentWarning" style="display:none; background:#e74c3c; color:white; padding:8px; border-radius:5px; margin-top:10px; text-align:center;">
-                ⚠ HIGH CURRENT - May cause MOSFET overheating! Ensure adequate cooling.
+                ⚠ HIGH CURRENT - Current is reduced automatically if the MOSFET model gets too hot. Ensure adequate cooling.
+            </div>
+        </div>
+
+        <div class="card" id="chargeSettings" style="display:none;">
+            <div class="card-title">Charge Settings</div>
+            <div class="settings-row">
+                <span class="settings-label">End on CV Taper</span>
+                <div class="settings-input">
+                    <label class="toggle-switch">
+                        <input type="checkbox" id="chargeTaper">
+                        <span class="toggle-slider"></span>
+                    </label>
+                </div>
+            </div>
+            <div class="settings-row">
+                <span class="settings-label">Relaxation Probes</span>
+                <div class="settings-input">
+                    <label class="toggle-switch">
+                        <input type="checkbox" id="chargeProbes" checked>
+                        <span class="toggle-slider"></span>
+                    </label>
+                </div>
+            </div>
+            <div style="color:#888; font-size:0.85em; margin-top:8px;">
+                Charge current is modelled from the voltage (CC, then CV taper). Probes switch the charger off for 0.5 s every minute to measure it.
+            </div>
+        </div>
+
+        <div class="card" id="storageSettings" style="display:none;">
+            <div class="card-title">Storage Settings</div>
+            <div class="settings-row">
+                <span class="settings-label">Target State of Charge</span>
+                <div class="settings-input">
+                    <input type="number" id="storageSoc" value="50" min="10" max="90" step="5"> %
+                </div>
+            </div>
+        </div>
+
+        <div class="card" id="selfDischargeSettings" style="display:none;">
+            <div class="card-title">Self-Discharge Settings</div>
+            <div class="settings-row">
+                <span class="settings-label">Reading Interval</span>
+                <div class="settings-input">
+                    <input type="number" id="sdInterval" value="10" min="1" max="60" step="1"> min
+                </div>
+            </div>
+            <div class="settings-row">
+                <span class="settings-label">Duration</span>
+                <div class="settings-input">
+                    <input type="number" id="sdHours" value="48" min="14" max="168" step="1"> h
+                </div>
+            </div>
+            <div class="settings-row">
+                <span class="settings-label">Fail Above</span>
+                <div class="settings-input">
+                    <input type="number" id="sdLimit" value="5" min="0.5" max="100" step="0.5"> mV/day
+                </div>
+            </div>
+            <div class="settings-row">
+                <span class="settings-label">Charge to Full First</span>
+                <div class="settings-input">
+                    <label class="toggle-switch">
+                        <input type="checkbox" id="sdCharge" checked>
+                        <span class="toggle-slider"></span>
+                    </label>
+                </div>
             </div>
         </div>
 
@@ -403,7 +475,41 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 <div id="stagedValidationError" style="display:none; background:#e74c3c; color:white; padding:8px; border-radius:5px; margin-top:10px; text-align:center;">
                 </div>
                 <div id="analyzeHighCurrentWarning" style="display:none; background:#e74c3c; color:white; padding:8px; border-radius:5px; margin-top:10px; text-align:center;">
-                    ⚠ HIGH CURRENT - May cause MOSFET overheating! Ensure adequate cooling.
+                    ⚠ HIGH CURRENT - Current is reduced automatically if the MOSFET model gets too hot. Ensure adequate cooling.
+                </div>
+            </div>
+
+            <div class="settings-row">
+                <span class="settings-label">Rate Sweep Mode</span>
+                <div class="settings-input">
+                    <label class="toggle-switch">
+                        <input type="checkbox" id="sweepMode" onchange="toggleSweepSettings()">
+                        <span class="toggle-slider"></span>
+                    </label>
+                </div>
+            </div>
+
+            <div id="sweepSettings" style="display:none;">
+                <div class="settings-row">
+                    <span class="settings-label">Currents</span>
+                    <div class="settings-input">
+                        <input type="text" id="sweepCurrents" value="2000,1000,500,200" style="width:140px;"> mA
+                    </div>
+                </div>
+                <div class="settings-row">
+                    <span class="settings-label">Cutoff Voltage</span>
+                    <div class="settings-input">
+                        <input type="number" id="sweepCutoff" value="3.0" min="2.8" max="3.2" step="0.1"> V
+                    </div>
+                </div>
+                <div class="settings-row">
+                    <span class="settings-label">Rest Between Stages</span>
+                    <div class="settings-input">
+                        <input type="number" id="sweepRest" value="60" min="0" max="1800" step="10"> s
+                    </div>
+                </div>
+                <div style="color: #888; font-size: 0.85em; margin-top: 8px;">
+                    Each current runs to the cutoff, highest first. OCV learning and dQ/dV are skipped.
                 </div>
             </div>
         </div>
@@ -423,7 +529,7 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 </div>
                 <div class="stat-item">
                     <div class="stat-value current" id="current">--</div>
-                    <div class="stat-label">Current (mA)</div>
+                    <div class="stat-label" id="currentLabel">Current (mA)</div>
                 </div>
                 <div class="stat-item">
                     <div class="stat-value capacity" id="capacity">--</div>
@@ -433,10 +539,22 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                     <div class="stat-value time" id="elapsed">--:--:--</div>
                     <div class="stat-label">Elapsed Time</div>
                 </div>
+                <div class="stat-item" id="socStatItem" style="display:none;">
+                    <div class="stat-value" id="socValue" style="color: #1abc9c;">--</div>
+                    <div class="stat-label" id="socLabel">SoC (%)</div>
+                </div>
                 <div class="stat-item" id="irStatItem" style="display:none;">
                     <div class="stat-value ir" id="irValue">--</div>
                     <div class="stat-label">Internal R (mΩ)</div>
                 </div>
+                <div class="stat-item" id="ceStatItem" style="display:none;">
+                    <div class="stat-value" id="ceValue" style="color: #3498db;">--</div>
+                    <div class="stat-label" id="ceLabel">Coulombic Eff. (%)</div>
+                </div>
+                <div class="stat-item" id="mosfetStatItem" style="display:none;">
+                    <div class="stat-value" id="mosfetValue" style="color: #e67e22;">--</div>
+                    <div class="stat-label" id="mosfetLabel">MOSFET (°C)</div>
+                </div>
             </div>
         </div>
 
@@ -451,6 +569,31 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             </div>
         </div>
 
+        <div class="card" id="sdCard" style="display:none;">
+            <div class="card-title">Self-Discharge OCV</div>
+            <div class="chart-container">
+                <canvas id="sdChart"></canvas>
+            </div>
+            <div id="sdInfo" style="color: #888; font-size: 0.85em; margin-top: 8px; text-align: center;">--</div>
+        </div>
+
+        <div class="card" id="icaCard" style="display:none;">
+            <div class="card-title">Incremental Capacity (dQ/dV)</div>
+            <div class="chart-container">
+                <canvas id="icaChart"></canvas>
+            </div>
+            <div id="icaInfo" style="color: #888; font-size: 0.85em; margin-top: 8px; text-align: center;">--</div>
+        </div>
+
+        <div class="card" id="sweepCard" style="display:none;">
+            <div class="card-title">Rate Sweep</div>
+            <div class="chart-container">
+                <canvas id="sweepChart"></canvas>
+            </div>
+            <div id="sweepTable" style="font-size: 0.85em; margin-top: 8px;"></div>
+            <div id="sweepInfo" style="color: #888; font-size: 0.85em; margin-top: 8px; text-align: center;">--</div>
+        </div>
+
         <div class="control-buttons">
             <button class="start-btn" onclick="startOperation()" id="startBtn">START</button>
             <button class="stop-btn" onclick="stopOperation()" id="stopBtn" disabled>STOP</button>
@@ -467,6 +610,18 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                     <span style="color: #888;">Network:</span>
                     <span id="staInfo" style="color: #888;">Not connected</span>
                 </div>
+                <div style="margin-top: 8px; font-size: 0.8em;">
+                    <span style="color: #888;">Boot:</span>
+                    <span id="bootInfo" style="color: #888;">--</span>
+                </div>
+                <div style="font-size: 0.8em;">
+                    <span style="color: #888;">Power:</span>
+                    <span id="powerInfo" style="color: #888;">--</span>
+                </div>
+                <div style="font-size: 0.8em;">
+                    <span style="color: #888;">History sync:</span>
+                    <span id="syncInfo" style="color: #888;">--</span>
+                </div>
             </div>
             <div class="input-group">
                 <label>Network Name (SSID)</label>
@@ -480,6 +635,136 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             <button class="submit-btn" onclick="disconnectWifi()" id="wifiDisconnectBtn" style="display:none; background:#e74c3c; margin-top:5px;">Disconnect from Network</button>
             <button class="submit-btn" onclick="forgetWifi()" id="wifiForgetBtn" style="display:none; background:#95a5a6; margin-top:5px;">Forget Network (Clear Saved)</button>
         </div>
+
+        <div class="card wifi-panel" id="rulesPanel">
+            <div class="card-title">Alarm Rules</div>
+            <div id="rulesList" style="margin-bottom: 10px; font-size: 0.85em; color: #888;">No rules</div>
+            <div class="settings-row">
+                <span class="settings-label">When</span>
+                <div class="settings-input">
+                    <select id="ruleMetric">
+                        <option value="voltage">Voltage (mV)</option>
+                        <option value="dvdt">dV/dt (mV/min)</option>
+                        <option value="d2vdt2">d&sup2;V/dt&sup2; (mV/min&sup2;)</option>
+                        <option value="elapsed">Elapsed (s)</option>
+                        <option value="capacity">Capacity (mAh)</option>
+                        <option value="sag">Sag (mV)</option>
+                    </select>
+                    <select id="ruleOp">
+                        <option value="below">&lt;</option>
+                        <option value="above">&gt;</option>
+                    </select>
+                    <input type="number" id="ruleValue" value="0">
+                </div>
+            </div>
+            <div class="settings-row">
+                <span class="settings-label">During</span>
+                <div class="settings-input">
+                    <select id="ruleScope">
+                        <option value="any">Any phase</option>
+                        <option value="charge">Charge</option>
+                        <option value="discharge">Discharge</option>
+                    </select>
+                </div>
+            </div>
+            <div class="settings-row">
+                <span class="settings-label">Then</span>
+                <div class="settings-input">
+                    <select id="ruleAction">
+                        <option value="alarm">Alarm</option>
+                        <option value="mark">Mark in log</option>
+                        <option value="next">End phase</option>
+                        <option value="abort">Abort</option>
+                    </select>
+                    <input type="number" id="ruleHold" value="1" min="1" max="20" title="Consecutive samples">
+                </div>
+            </div>
+            <button class="submit-btn" onclick="addRule()">Add Rule</button>
+            <button class="submit-btn" onclick="sendCommand({ cmd: 'rule_clear' })" style="background:#95a5a6; margin-top:5px;">Clear All Rules</button>
+            <div id="rulesCost" style="margin-top: 10px; font-size: 0.8em; color: #888;"></div>
+        </div>
+
+        <div class="card wifi-panel" id="calPanel">
+            <div class="card-title">Voltage Calibration</div>
+            <div style="margin-bottom: 15px; padding: 10px; background: #1a1a2e; border-radius: 5px; font-size: 0.9em;">
+                <div><span style="color: #888;">Scheme:</span> <span id="calScheme">--</span></div>
+                <div><span style="color: #888;">Correction:</span> <span id="calCorrection">--</span></div>
+                <div><span style="color: #888;">Reading:</span> <span id="calReading">--</span></div>
+                <div id="calPoints" style="margin-top: 8px; color: #888;"></div>
+            </div>
+            <div class="input-group">
+                <label>Multimeter Reading (V)</label>
+                <input type="number" id="calMeter" step="0.001" placeholder="e.g. 3.987">
+            </div>
+            <button class="submit-btn" onclick="addCalPoint()">Add Point</button>
+            <button class="submit-btn" onclick="sendCommand({ cmd: 'cal_apply' })" style="margin-top:5px;">Apply &amp; Save</button>
+            <button class="submit-btn" onclick="resetCal()" style="background:#95a5a6; margin-top:5px;">Reset Calibration</button>
+        </div>
+
+        <div class="card wifi-panel" id="thermalPanel">
+            <div class="card-title">Load MOSFET Thermal Model</div>
+            <div style="margin-bottom: 15px; padding: 10px; background: #1a1a2e; border-radius: 5px; font-size: 0.9em;">
+                <div><span style="color: #888;">Allowed current now:</span> <span id="thermalCeiling">--</span></div>
+            </div>
+            <div class="input-group">
+                <label>Ambient (°C)</label>
+                <input type="number" id="thermalAmbient" step="1">
+            </div>
+            <div class="input-group">
+                <label>Junction Limit (°C)</label>
+                <input type="number" id="thermalLimit" step="1">
+            </div>
+            <div class="input-group">
+                <label>Junction → Heatsink (°C/W)</label>
+                <input type="number" id="thermalRjh" step="0.1">
+            </div>
+            <div class="input-group">
+                <label>Heatsink → Ambient (°C/W)</label>
+                <input type="number" id="thermalRha" step="0.5">
+            </div>
+            <div class="input-group">
+                <label>Heatsink Heat Capacity (J/°C)</label>
+                <input type="number" id="thermalCha" step="0.5">
+            </div>
+            <div class="input-group">
+                <label>Sense Resistor (Ω)</label>
+                <input type="number" id="thermalSense" step="0.01">
+            </div>
+            <button class="submit-btn" onclick="saveThermal()">Save</button>
+            <button class="submit-btn" onclick="sendCommand({ cmd: 'thermal_reset' })" style="background:#95a5a6; margin-top:5px;">Reset to Defaults</button>
+        </div>
+
+        <div class="card wifi-panel" id="benchPanel">
+            <div class="card-title">Firmware Benchmark</div>
+            <div style="margin-bottom: 15px; padding: 10px; background: #1a1a2e; border-radius: 5px; font-size: 0.8em;">
+                <div id="benchInfo" style="color: #888;">Runs from the menu only; the tester is unresponsive for a few seconds.</div>
+                <div id="benchCases" style="margin-top: 8px; font-family: monospace; white-space: pre;"></div>
+            </div>
+            <div class="input-group">
+                <label>Iterations per Case</label>
+                <input type="number" id="benchIterations" value="500" min="5" max="20000" step="100">
+            </div>
+            <button class="submit-btn" onclick="runBenchmark()">Run</button>
+            <button class="submit-btn" onclick="sendCommand({ cmd: 'bench_baseline' })" style="background:#95a5a6; margin-top:5px;">Save as Baseline</button>
+        </div>
+
+        <div class="card wifi-panel" id="ocvPanel">
+            <div class="card-title">OCV / SoC Tables</div>
+            <div class="input-group">
+                <label>Active Table (learned from completed Analyze runs)</label>
+                <select id="ocvSlot" onchange="sendCommand({ cmd: 'ocv_select', slot: parseInt(this.value) })"></select>
+            </div>
+            <div style="margin-bottom: 15px; padding: 10px; background: #1a1a2e; border-radius: 5px; font-size: 0.9em;">
+                <div><span style="color: #888;">Learned from:</span> <span id="ocvRuns">--</span></div>
+                <div id="ocvPoints" style="margin-top: 8px; color: #888;"></div>
+            </div>
+            <div class="input-group">
+                <label>Name</label>
+                <input type="text" id="ocvName" maxlength="11" placeholder="e.g. 30Q">
+            </div>
+            <button class="submit-btn" onclick="renameOcv()">Rename</button>
+            <button class="submit-btn" onclick="resetOcv()" style="background:#95a5a6; margin-top:5px;">Reset to Default Table</button>
+        </div>
     </div>
 
     <script>
@@ -490,7 +775,14 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
         const voltageData = [];
         const currentData = [];
         const timeData = [];
+        const seqData = [];      // Device sequence number of each sample
+        const eventTimes = [];
         const maxPoints = 3600;
+
+        // History sync. The device numbers logged samples per run; fullNext is the first seq
+        // not held at full resolution yet (older ones may only be overview samples)
+        let histRun = null, fullNext = 0, deviceNext = 0, syncBusy = false;
+        const syncStats = { start: 0, overviewMs: 0, bytes: 0, frames: 0 };
         const voltageMin = 2.5, voltageMax = 4.5;
         const currentMin = 0, currentMax = 1100;
 
@@ -545,13 +837,14 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             }
 
             if (voltageData.length < 2) return;
-            const xScale = chartW / (timeData.length - 1 || 1);
+            // x follows time: overview and full-resolution samples are not evenly spaced
+            const xOf = t => padding.left + chartW * t / Math.max(timeData[timeData.length - 1], 1);
 
             ctx.strokeStyle = '#3498db';
             ctx.lineWidth = 2;
             ctx.beginPath();
             for (let i = 0; i < voltageData.length; i++) {
-                const x = padding.left + i * xScale;
+                const x = xOf(timeData[i]);
                 const y = padding.top + chartH - ((voltageData[i] - voltageMin) / (voltageMax - voltageMin)) * chartH;
                 if (i === 0) ctx.moveTo(x, y); else ctx.lineTo(x, y);
             }
@@ -561,33 +854,318 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             ctx.lineWidth = 2;
             ctx.beginPath();
             for (let i = 0; i < currentData.length; i++) {
-                const x = padding.left + i * xScale;
+                const x = xOf(timeData[i]);
                 const y = padding.top + chartH - ((currentData[i] - currentMin) / (currentMax - currentMin)) * chartH;
                 if (i === 0) ctx.moveTo(x, y); else ctx.lineTo(x, y);
             }
             ctx.stroke();
+
+            // Rule event markers
+            ctx.strokeStyle = '#f39c12';
+            ctx.lineWidth = 1;
+            eventTimes.forEach(t => {
+                const x = xOf(Math.min(t, timeData[timeData.length - 1]));
+                ctx.beginPath();
+                ctx.moveTo(x, padding.top);
+                ctx.lineTo(x, padding.top + chartH);
+                ctx.stroke();
+            });
+        }
+
+        // Put samples (ascending seq) into the chart, replacing held samples in their seq range,
+        // so overview samples give way as the full-resolution ones arrive
+        function mergeSamples(seqs, t, mv, c) {
+            if (seqs.length === 0) return;
+            let a = 0;
+            while (a < seqData.length && seqData[a] < seqs[0]) a++;
+            let b = a;
+            while (b < seqData.length && seqData[b] <= seqs[seqs.length - 1]) b++;
+            seqData.splice(a, b - a, ...seqs);
+            timeData.splice(a, b - a, ...t);
+            voltageData.splice(a, b - a, ...mv.map(x => x / 1000));
+            currentData.splice(a, b - a, ...c);
+
+            // Keep what the device still holds
+            let old = 0;
+            while (old < seqData.length && seqData[old] < deviceNext - maxPoints) old++;
+            if (old > 0) {
+                seqData.splice(0, old); timeData.splice(0, old);
+                voltageData.splice(0, old); currentData.splice(0, old);
+            }
         }
 
+        // Live sample, one per logged second
         function addDataPoint(data) {
-            if (voltageData.length >= maxPoints) {
-                voltageData.shift(); currentData.shift(); timeData.shift();
+            if (data.run !== histRun) {
+                // A new run started: drop the old chart and follow this one
+                clearChart();
+                histRun = data.run;
+                fullNext = 0;
+                deviceNext = 0;
+            }
+            deviceNext = Math.max(deviceNext, data.seq + 1);
+            mergeSamples([data.seq], [data.t], [data.mv], [data.c]);
+            if (data.seq === fullNext) {
+                fullNext++;
+            } else if (data.seq > fullNext && !syncBusy) {
+                requestHistory();  // Missed samples (joined mid-run or frames were lost)
             }
-            voltageData.push(data.v);
-            currentData.push(data.c);
-            timeData.push(data.t);
             drawChart();
         }
 
-        function loadHistory(points) {
-            voltageData.length = 0; currentData.length = 0; timeData.length = 0;
-            points.forEach(p => {
-                voltageData.push(p.v); currentData.push(p.c); timeData.push(p.t);
-            });
+        // Resume from the cursor when this run's samples are held, otherwise start with the overview
+        function requestHistory() {
+            syncBusy = true;
+            sendCommand(histRun === null ? { cmd: 'history_sync' } : { cmd: 'history_sync', run: histRun, since: fullNext });
+        }
+
+        // Overview: every stride-th sample of the run, sample i is seq first + i * stride
+        function loadHistory(data) {
+            clearChart();
+            histRun = data.run;
+            fullNext = data.first;
+            deviceNext = data.next;
+            mergeSamples(data.t.map((_, i) => data.first + i * data.stride), data.t, data.mv, data.c);
+            data.events.forEach(t => eventTimes.push(t));
+            syncStats.overviewMs = performance.now() - syncStats.start;
+            drawChart();
+            continueSync(data.t.length > 0);
+        }
+
+        // Full-resolution samples from seq on
+        function loadHistoryChunk(data) {
+            if (data.run !== histRun) {
+                histRun = null;  // New run since the request
+                requestHistory();
+                return;
+            }
+            deviceNext = Math.max(deviceNext, data.next);
+            mergeSamples(data.t.map((_, i) => data.seq + i), data.t, data.mv, data.c);
+            fullNext = Math.max(fullNext, data.seq + data.t.length);
+            eventTimes.length = 0;
+            data.events.forEach(t => eventTimes.push(t));
             drawChart();
+            continueSync(data.t.length > 0);
+        }
+
+        // Ask for the next frame until the chart is current, then report what the sync cost
+        function continueSync(progress) {
+            syncBusy = false;
+            if (progress && fullNext < deviceNext) {
+                requestHistory();
+                return;
+            }
+            if (syncStats.start > 0) {
+                const ms = performance.now() - syncStats.start;
+                document.getElementById('syncInfo').textContent =
+                    (syncStats.overviewMs > 0 ? 'overview ' + syncStats.overviewMs.toFixed(0) + ' ms, ' : '') +
+                    'current ' + ms.toFixed(0) + ' ms, ' + syncStats.frames + ' frames, ' +
+                    (syncStats.bytes / 1024).toFixed(1) + ' kB';
+                syncStats.start = 0;
+            }
+        }
+
+        // Self-discharge series: minutes since monitoring started, OCV in 0.1 mV
+        const sdTimes = [];
+        const sdDecimv = [];
+
+        function loadSelfDischarge(data) {
+            sdTimes.length = 0; sdDecimv.length = 0;
+            sdTimes.push(...data.t);
+            sdDecimv.push(...data.mv);
+            document.getElementById('sdCard').style.display = 'block';
+            drawSelfDischarge();
+        }
+
+        function addSelfDischargePoint(data) {
+            sdTimes.push(data.t);
+            sdDecimv.push(data.mv);
+            drawSelfDischarge();
+        }
+
+        // OCV against hours, auto-scaled to the stored range (a few mV over days)
+        function drawSelfDischarge() {
+            const canvas = document.getElementById('sdChart');
+            const ctx = canvas.getContext('2d');
+            const rect = canvas.parentElement.getBoundingClientRect();
+            canvas.width = rect.width;
+            canvas.height = rect.height;
+
+            const w = canvas.width, h = canvas.height;
+            const padding = { top: 20, right: 20, bottom: 30, left: 60 };
+            const chartW = w - padding.left - padding.right;
+            const chartH = h - padding.top - padding.bottom;
+
+            ctx.fillStyle = '#1a1a2e';
+            ctx.fillRect(0, 0, w, h);
+            if (sdDecimv.length < 2) return;
+
+            let lo = Math.min(...sdDecimv), hi = Math.max(...sdDecimv);
+            if (hi - lo < 20) { const mid = (hi + lo) / 2; lo = mid - 10; hi = mid + 10; }
+            const tMax = Math.max(sdTimes[sdTimes.length - 1], 1);
+
+            ctx.font = '11px sans-serif';
+            ctx.fillStyle = '#e67e22';
+            for (let i = 0; i <= 4; i++) {
+                const y = padding.top + (chartH / 4) * i;
+                ctx.fillText(((hi - (hi - lo) * i / 4) / 10000).toFixed(4), 5, y + 4);
+            }
+            ctx.fillStyle = '#888';
+            for (let i = 0; i <= 4; i++) {
+                const x = padding.left + (chartW / 4) * i;
+                ctx.fillText((tMax * i / 4 / 60).toFixed(1) + 'h', x - 10, h - 10);
+            }
+
+            ctx.strokeStyle = '#e67e22';
+            ctx.lineWidth = 2;
+            ctx.beginPath();
+            for (let i = 0; i < sdDecimv.length; i++) {
+                const x = padding.left + chartW * sdTimes[i] / tMax;
+                const y = padding.top + chartH * (hi - sdDecimv[i]) / (hi - lo);
+                if (i === 0) ctx.moveTo(x, y); else ctx.lineTo(x, y);
+            }
+            ctx.stroke();
+        }
+
+        // dQ/dV curve: q[i] in mAh/V at v0 + i * step mV
+        let icaData = null;
+
+        function formatPeaks(peaks) {
+            return peaks.map(p => (p.v / 1000).toFixed(2) + ' V (' + p.h + ')').join(', ');
+        }
+
+        function updateIca(data) {
+            icaData = data.q ? data : null;
+            const parts = [];
+            if (data.peaks) parts.push((data.live ? 'Peaks so far: ' : 'Peaks: ') + (formatPeaks(data.peaks) || 'none'));
+            if (data.summary) parts.push('Last run ' + data.summary.capacity.toFixed(0) + ' mAh: ' +
+                (formatPeaks(data.summary.peaks) || 'no peaks'));
+            document.getElementById('icaInfo').textContent = parts.join(' | ') + ' (mAh/V)';
+            document.getElementById('icaCard').style.display = 'block';
+            drawIca();
+        }
+
+        function drawIca() {
+            const canvas = document.getElementById('icaChart');
+            const ctx = canvas.getContext('2d');
+            const rect = canvas.parentElement.getBoundingClientRect();
+            canvas.width = rect.width;
+            canvas.height = rect.height;
+
+            const w = canvas.width, h = canvas.height;
+            const padding = { top: 20, right: 20, bottom: 30, left: 50 };
+            const chartW = w - padding.left - padding.right;
+            const chartH = h - padding.top - padding.bottom;
+
+            ctx.fillStyle = '#1a1a2e';
+            ctx.fillRect(0, 0, w, h);
+            if (!icaData || icaData.q.length < 2) return;
+
+            // Voltage rises left to right
+            const vLo = icaData.v0, vHi = icaData.v0 + (icaData.q.length - 1) * icaData.step;
+            const qMax = Math.max(...icaData.q, 1);
+            const xOf = v => padding.left + chartW * (v - vLo) / (vHi - vLo);
+            const yOf = q => padding.top + chartH * (1 - q / qMax);
+
+            ctx.font = '11px sans-serif';
+            ctx.fillStyle = '#9b59b6';
+            for (let i = 0; i <= 4; i++) {
+                ctx.fillText((qMax * (4 - i) / 4).toFixed(0), 5, padding.top + (chartH / 4) * i + 4);
+            }
+            ctx.fillStyle = '#888';
+            for (let i = 0; i <= 4; i++) {
+                const v = vLo + (vHi - vLo) * i / 4;
+                ctx.fillText((v / 1000).toFixed(2) + 'V', xOf(v) - 12, h - 10);
+            }
+
+            ctx.strokeStyle = '#9b59b6';
+            ctx.lineWidth = 2;
+            ctx.beginPath();
+            icaData.q.forEach((q, i) => {
+                const x = xOf(icaData.v0 + i * icaData.step), y = yOf(q);
+                if (i === 0) ctx.moveTo(x, y); else ctx.lineTo(x, y);
+            });
+            ctx.stroke();
+
+            ctx.strokeStyle = '#f39c12';
+            ctx.setLineDash([4, 4]);
+            (icaData.peaks || []).forEach(p => {
+                ctx.beginPath();
+                ctx.moveTo(xOf(p.v), yOf(p.h));
+                ctx.lineTo(xOf(p.v), padding.top + chartH);
+                ctx.stroke();
+            });
+            ctx.setLineDash([]);
+        }
+
+        // Rate sweep stages: loaded voltage against run mAh, one line per current
+        let sweepData = null;
+        const sweepColors = ['#e74c3c', '#f39c12', '#f1c40f', '#2ecc71', '#3498db', '#9b59b6'];
+
+        function updateSweep(data) {
+            sweepData = data;
+            let html = '<table style="width:100%; border-collapse:collapse; text-align:right;">' +
+                '<tr style="color:#888;"><td style="text-align:left;">Rate</td><td>Stage mAh</td><td>At rate</td>' +
+                '<td>Mean V</td><td>mWh</td><td>Recovered</td></tr>';
+            data.stages.forEach((s, i) => {
+                html += '<tr><td style="text-align:left; color:' + sweepColors[i] + ';">' + s.ma + ' mA (' +
+                    s.mean_ma.toFixed(0) + ')</td><td>' + s.mah.toFixed(0) + '</td><td>' + s.cap.toFixed(0) +
+                    '</td><td>' + (s.v_avg / 1000).toFixed(3) + '</td><td>' + s.mwh.toFixed(0) + '</td><td>' +
+                    (s.v_rec ? (s.v_rec / 1000).toFixed(3) : '--') + '</td></tr>';
+            });
+            document.getElementById('sweepTable').innerHTML = html + '</table>';
+            document.getElementById('sweepInfo').textContent = (data.live ? 'Running, ' : '') +
+                'cutoff ' + (data.cutoff / 1000).toFixed(2) + ' V' +
+                (data.peukert !== undefined ? ' | Peukert k ' + data.peukert.toFixed(3) : '');
+            document.getElementById('sweepCard').style.display = 'block';
+            drawSweep();
+        }
+
+        function drawSweep() {
+            const canvas = document.getElementById('sweepChart');
+            const ctx = canvas.getContext('2d');
+            const rect = canvas.parentElement.getBoundingClientRect();
+            canvas.width = rect.width;
+            canvas.height = rect.height;
+
+            const w = canvas.width, h = canvas.height;
+            const padding = { top: 20, right: 20, bottom: 30, left: 50 };
+            const chartW = w - padding.left - padding.right;
+            const chartH = h - padding.top - padding.bottom;
+
+            ctx.fillStyle = '#1a1a2e';
+            ctx.fillRect(0, 0, w, h);
+            if (!sweepData || sweepData.stages.length === 0) return;
+
+            const points = sweepData.stages.flatMap(s => s.v);
+            const qMax = Math.max(...sweepData.stages.map(s => s.cap), 1);
+            const vLo = Math.min(...points, sweepData.cutoff) - 50;
+            const vHi = Math.max(...points) + 50;
+            const xOf = q => padding.left + chartW * q / qMax;
+            const yOf = v => padding.top + chartH * (1 - (v - vLo) / (vHi - vLo));
+
+            ctx.font = '11px sans-serif';
+            ctx.fillStyle = '#888';
+            for (let i = 0; i <= 4; i++) {
+                const v = vHi - (vHi - vLo) * i / 4;
+                ctx.fillText((v / 1000).toFixed(2) + 'V', 5, padding.top + (chartH / 4) * i + 4);
+                ctx.fillText((qMax * i / 4).toFixed(0), padding.left + (chartW / 4) * i - 10, h - 10);
+            }
+
+            ctx.lineWidth = 2;
+            sweepData.stages.forEach((s, i) => {
+                ctx.strokeStyle = sweepColors[i];
+                ctx.beginPath();
+                s.q.forEach((q, p) => {
+                    if (p === 0) ctx.moveTo(xOf(q), yOf(s.v[p])); else ctx.lineTo(xOf(q), yOf(s.v[p]));
+                });
+                ctx.stroke();
+            });
         }
 
         function clearChart() {
-            voltageData.length = 0; currentData.length = 0; timeData.length = 0;
+            voltageData.length = 0; currentData.length = 0; timeData.length = 0; seqData.length = 0;
+            eventTimes.length = 0;
             drawChart();
         }
 
@@ -600,18 +1178,29 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 document.getElementById('wsStatus').classList.add('connected');
                 document.getElementById('wifiName').textContent = 'Connected';
                 document.getElementById('ipAddress').textContent = host;
+                // Chart history from our cursor (only the missed samples after a reconnect)
+                syncStats.start = performance.now();
+                syncStats.overviewMs = 0;
+                syncStats.bytes = 0;
+                syncStats.frames = 0;
+                requestHistory();
             };
 
             ws.onclose = function() {
                 document.getElementById('wsStatus').classList.remove('connected');
                 document.getElementById('wsStatus').classList.add('disconnected');
                 document.getElementById('wifiName').textContent = 'Disconnected';
+                syncBusy = false;
                 setTimeout(connectWebSocket, 2000);
             };
 
             ws.onmessage = function(event) {
                 try {
                     const data = JSON.parse(event.data);
+                    if (data.type === 'history' || data.type === 'history_chunk') {
+                        syncStats.bytes += event.data.length;
+                        syncStats.frames++;
+                    }
                     handleMessage(data);
                 } catch (e) { console.error('Parse error:', e); }
             };
@@ -622,9 +1211,21 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
         function handleMessage(data) {
             if (data.type === 'status') updateStatus(data);
             else if (data.type === 'datapoint') addDataPoint(data);
-            else if (data.type === 'history') loadHistory(data.points);
+            else if (data.type === 'history') loadHistory(data);
+            else if (data.type === 'history_chunk') loadHistoryChunk(data);
+            else if (data.type === 'rules') updateRules(data);
+            else if (data.type === 'event') handleRuleEvent(data);
+            else if (data.type === 'cal') updateCal(data);
+            else if (data.type === 'ocv') updateOcv(data);
+            else if (data.type === 'thermal') updateThermal(data);
+            else if (data.type === 'sd_series') loadSelfDischarge(data);
+            else if (data.type === 'sd_point') addSelfDischargePoint(data);
+            else if (data.type === 'ica') updateIca(data);
+            else if (data.type === 'sweep') updateSweep(data);
             else if (data.type === 'error') showError(data.message);
             else if (data.type === 'wifi_status') updateWifiStatus(data);
+            else if (data.type === 'boot') updateBoot(data);
+            else if (data.type === 'benchmark') updateBenchmark(data);
         }
 
         function updateWifiStatus(data) {
@@ -648,7 +1249,11 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             const disconnectBtn = document.getElementById('wifiDisconnectBtn');
             const forgetBtn = document.getElementById('wifiForgetBtn');
 
-            if (data.sta_connected) {
+            if (data.sta_connecting) {
+                staInfo.textContent = 'Connecting to ' + data.sta_ssid + '...';
+                staInfo.style.color = '#f39c12';
+                disconnectBtn.style.display = 'block';
+            } else if (data.sta_connected) {
                 staInfo.textContent = data.sta_ssid + ' (' + data.sta_ip + ')';
                 staInfo.style.color = '#2ecc71';
                 disconnectBtn.style.display = 'block';
@@ -666,6 +1271,13 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             }
         }
 
+        function updateBoot(data) {
+            // Boot phase timings, e.g. "menu 180 ms, ap 420 ms, web 425 ms"
+            document.getElementById('bootInfo').textContent = data.phases
+                .filter(p => ['menu', 'ap', 'web', 'sta'].includes(p.name))
+                .map(p => p.name + ' ' + p.ms + ' ms').join(', ');
+        }
+
         function showError(message) {
             // Update status display to show error
             document.getElementById('currentState').textContent = message;
@@ -686,11 +1298,20 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 'analyze_discharge': 'ANALYZE (Discharging)',
                 'analyze_discharge_s1': 'ANALYZE (Stage 1)',
                 'analyze_discharge_s2': 'ANALYZE (Stage 2)',
+                'analyze_stage_rest': 'ANALYZE (Stage Rest)',
                 'ir': 'IR TEST',
+                'selfdischarge': 'SELF-DISCHARGE',
                 'complete': 'COMPLETE'
             };
 
-            document.getElementById('currentMode').textContent = modeNames[data.mode] || data.mode;
+            let modeName = modeNames[data.mode] ||
+                (data.mode.startsWith('analyze_discharge_s') ? 'ANALYZE (Stage ' + data.mode.substring(19) + ')' : data.mode);
+            // Rate sweep, e.g. "RATE SWEEP 2/4 (1000 mA, rest 45 s)"
+            if (data.stages !== undefined) {
+                modeName = 'RATE SWEEP ' + data.stage + '/' + data.stages + ' (' + data.stage_current + ' mA' +
+                    (data.rest_left !== undefined ? ', rest ' + data.rest_left + ' s' : '') + ')';
+            }
+            document.getElementById('currentMode').textContent = modeName;
             document.getElementById('currentState').textContent = data.status || 'Ready';
             document.getElementById('voltage').textContent = data.voltage ? data.voltage.toFixed(2) : '--';
             document.getElementById('current').textContent = data.current || '0';
@@ -698,10 +1319,60 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             document.getElementById('elapsed').textContent = data.time || '00:00:00';
 
             // Hide non-essential stats for Battery Check and Storage modes
-            const isBatCheckOrStorage = data.mode === 'batcheck' || data.mode === 'storage';
-            document.getElementById('current').parentElement.style.display = isBatCheckOrStorage ? 'none' : 'block';
+            const isBatCheckOrStorage = data.mode === 'batcheck' || data.mode === 'storage' || data.mode === 'selfdischarge';
+            document.getElementById('current').parentElement.style.display = data.mode === 'batcheck' ? 'none' : 'block';
             document.getElementById('capacity').parentElement.style.display = isBatCheckOrStorage ? 'none' : 'block';
-            document.getElementById('elapsed').parentElement.style.display = isBatCheckOrStorage ? 'none' : 'block';
+            document.getElementById('elapsed').parentElement.style.display = data.mode === 'batcheck' ? 'none' : 'block';
+
+            // Power level, e.g. "idle 80 MHz, asleep 62% since boot, ~24 mA, wake 850 us"
+            if (data.power !== undefined) {
+                document.getElementById('powerInfo').textContent = data.power + ' ' + data.cpu_mhz + ' MHz, asleep ' +
+                    data.sleep_pct.toFixed(0) + '% since boot, ~' + data.supply_ma.toFixed(0) + ' mA' +
+                    (data.wake_us > 0 ? ', wake ' + data.wake_us + ' us' : '');
+            }
+
+            // Charge model phase and taper time constant, e.g. "Current mA (cv, τ 766 s)"
+            document.getElementById('currentLabel').textContent = data.charge_phase !== undefined ?
+                'Current mA (' + data.charge_phase + (data.charge_phase === 'cv' ? ', τ ' + data.charge_tau.toFixed(0) + ' s' : '') + ')' :
+                'Current (mA)';
+
+            // Analyze result: discharge capacity over the modelled charge put in
+            if (data.ce !== undefined) {
+                document.getElementById('ceValue').textContent = data.ce.toFixed(1);
+                document.getElementById('ceLabel').textContent = 'Coulombic Eff. % (' + data.charge_mah.toFixed(0) + ' mAh in)';
+                document.getElementById('ceStatItem').style.display = 'block';
+            } else {
+                document.getElementById('ceStatItem').style.display = 'none';
+            }
+
+            // Modelled MOSFET junction temperature (sent while the load is on or still warm)
+            if (data.mosfet_c !== undefined) {
+                document.getElementById('mosfetValue').textContent = data.mosfet_c.toFixed(0);
+                document.getElementById('mosfetLabel').textContent = data.requested_ma !== undefined ?
+                    'MOSFET °C (derated from ' + data.requested_ma + ' mA)' : 'MOSFET (°C)';
+                document.getElementById('mosfetStatItem').style.display = 'block';
+            } else {
+                document.getElementById('mosfetStatItem').style.display = 'none';
+            }
+
+            // SoC estimate; storage prep also shows the target and controller phase
+            if (data.soc !== undefined) {
+                const storage = data.target_soc !== undefined;
+                document.getElementById('socValue').textContent = data.soc.toFixed(0) +
+                    (storage ? ' → ' + data.target_soc.toFixed(0) : '');
+                document.getElementById('socLabel').textContent = storage ? 'SoC % (' + data.storage_phase + ')' : 'SoC (%)';
+                document.getElementById('socStatItem').style.display = 'block';
+            } else {
+                document.getElementById('socStatItem').style.display = 'none';
+            }
+
+            // Self-discharge slope and verdict, e.g. "-1.2 ± 0.1 mV/day (limit 5), pending, next in 412 s"
+            if (data.sd_phase !== undefined) {
+                document.getElementById('sdInfo').textContent = data.sd_phase === 'charge' ? 'Charging to full...' :
+                    data.sd_slope.toFixed(2) + ' ± ' + data.sd_error.toFixed(2) + ' mV/day (limit ' + data.sd_limit +
+                    '), ' + (data.sd_phase === 'done' && data.sd_verdict === 'pending' ? 'insufficient data' : data.sd_verdict) + (data.sd_next > 0 ? ', next in ' + data.sd_next + ' s' : '');
+                document.getElementById('sdCard').style.display = 'block';
+            }
 
             // Show IR result when available (persists until new operation starts)
             if (data.ir !== undefined) {
@@ -716,7 +1387,7 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             document.getElementById('stopBtn').disabled = !isRunning;
 
             // Disable mode selection while running
-            ['btnCharge', 'btnDischarge', 'btnAnalyze', 'btnIR', 'btnBatCheck', 'btnStorage'].forEach(id => {
+            ['btnCharge', 'btnDischarge', 'btnAnalyze', 'btnIR', 'btnBatCheck', 'btnStorage', 'btnSelfDischarge'].forEach(id => {
                 document.getElementById(id).disabled = isRunning;
             });
 
@@ -735,6 +1406,8 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                 document.getElementById('btnBatCheck').classList.add('active');
             } else if (data.mode === 'storage') {
                 document.getElementById('btnStorage').classList.add('active');
+            } else if (data.mode === 'selfdischarge') {
+                document.getElementById('btnSelfDischarge').classList.add('active');
             }
         }
 
@@ -756,12 +1429,19 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             else if (mode === 'ir') document.getElementById('btnIR').classList.add('selected');
             else if (mode === 'batcheck') document.getElementById('btnBatCheck').classList.add('selected');
             else if (mode === 'storage') document.getElementById('btnStorage').classList.add('selected');
+            else if (mode === 'selfdischarge') document.getElementById('btnSelfDischarge').classList.add('selected');
 
             // Show/hide settings panels
             document.getElementById('dischargeSettings').style.display =
                 (mode === 'discharge') ? 'block' : 'none';
             document.getElementById('analyzeSettings').style.display =
                 (mode === 'analyze') ? 'block' : 'none';
+            document.getElementById('chargeSettings').style.display =
+                (mode === 'charge' || mode === 'analyze') ? 'block' : 'none';
+            document.getElementById('storageSettings').style.display =
+                (mode === 'storage') ? 'block' : 'none';
+            document.getElementById('selfDischargeSettings').style.display =
+                (mode === 'selfdischarge') ? 'block' : 'none';
         }
 
         // Start the selected operation
@@ -769,19 +1449,41 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             clearChart();
             // Hide previous IR result when starting new operation
             document.getElementById('irStatItem').style.display = 'none';
+            document.getElementById('sdCard').style.display = 'none';
+            document.getElementById('sweepCard').style.display = 'none';
+
+            const taper = document.getElementById('chargeTaper').checked;
+            const probes = document.getElementById('chargeProbes').checked;
 
-            if (selectedMode === 'discharge') {
+            if (selectedMode === 'charge') {
+                sendCommand({ cmd: 'start_charge', taper: taper, probes: probes });
+            } else if (selectedMode === 'discharge') {
                 const cutoff = parseFloat(document.getElementById('cutoffVoltage').value);
                 const current = parseInt(document.getElementById('dischargeCurrent').value);
                 sendCommand({ cmd: 'start_discharge', cutoff: cutoff, current: current });
             } else if (selectedMode === 'analyze') {
                 const staged = document.getElementById('stagedMode').checked;
-                if (staged) {
+                const sweep = document.getElementById('sweepMode').checked;
+                if (sweep) {
+                    const currents = document.getElementById('sweepCurrents').value.split(',')
+                        .map(c => parseInt(c)).filter(c => !isNaN(c));
+                    sendCommand({
+                        cmd: 'start_analyze',
+                        taper: taper,
+                        probes: probes,
+                        sweep: true,
+                        sweep_currents: currents,
+                        sweep_cutoff: parseFloat(document.getElementById('sweepCutoff').value),
+                        sweep_rest: parseInt(document.getElementById('sweepRest').value)
+                    });
+                } else if (staged) {
                     if (!validateStagedSettings()) {
                         return;  // Don't start if validation fails
                     }
                     sendCommand({
                         cmd: 'start_analyze',
+                        taper: taper,
+                        probes: probes,
                         staged: true,
                         stage1_current: parseInt(document.getElementById('stage1Current').value),
                         stage1_transition: parseFloat(document.getElementById('stage1Transition').value),
@@ -789,8 +1491,18 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
                         stage2_cutoff: parseFloat(document.getElementById('stage2Cutoff').value)
                     });
                 } else {
-                    sendCommand({ cmd: 'start_analyze' });
+                    sendCommand({ cmd: 'start_analyze', taper: taper, probes: probes });
                 }
+            } else if (selectedMode === 'storage') {
+                sendCommand({ cmd: 'start_storage', soc: parseFloat(document.getElementById('storageSoc').value) });
+            } else if (selectedMode === 'selfdischarge') {
+                sendCommand({
+                    cmd: 'start_selfdischarge',
+                    interval: parseInt(document.getElementById('sdInterval').value),
+                    hours: parseInt(document.getElementById('sdHours').value),
+                    limit: parseFloat(document.getElementById('sdLimit').value),
+                    charge: document.getElementById('sdCharge').checked
+                });
             } else {
                 sendCommand({ cmd: 'start_' + selectedMode });
             }
@@ -831,6 +1543,174 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             }
         }
 
+        function toggleRulesPanel() {
+            const panel = document.getElementById('rulesPanel');
+            panel.classList.toggle('show');
+            if (panel.classList.contains('show')) sendCommand({ cmd: 'get_rules' });
+        }
+
+        function addRule() {
+            sendCommand({
+                cmd: 'rule_add',
+                metric: document.getElementById('ruleMetric').value,
+                op: document.getElementById('ruleOp').value,
+                value: parseFloat(document.getElementById('ruleValue').value),
+                scope: document.getElementById('ruleScope').value,
+                action: document.getElementById('ruleAction').value,
+                hold: parseInt(document.getElementById('ruleHold').value)
+            });
+        }
+
+        function updateRules(data) {
+            const list = document.getElementById('rulesList');
+            list.innerHTML = '';
+            if (data.rules.length === 0) list.textContent = 'No rules';
+            data.rules.forEach((r, i) => {
+                const row = document.createElement('div');
+                row.style.marginBottom = '4px';
+                row.textContent = (i + 1) + '. ' + r.metric + (r.op === 'above' ? ' > ' : ' < ') + r.value +
+                    ' (' + r.scope + ', ' + r.hold + 'x) \u2192 ' + r.action + ' ';
+                const del = document.createElement('button');
+                del.className = 'wifi-btn';
+                del.textContent = '\u2715';
+                del.onclick = () => sendCommand({ cmd: 'rule_remove', id: i });
+                row.appendChild(del);
+                list.appendChild(row);
+            });
+            document.getElementById('rulesCost').textContent =
+                'Evaluation cost: ' + data.eval_us_avg.toFixed(1) + ' \u00b5s avg, ' + data.eval_us_max + ' \u00b5s max per sample';
+        }
+
+        function handleRuleEvent(data) {
+            eventTimes.push(data.t);
+            drawChart();
+            if (data.action !== 'mark') {
+                showError('Rule ' + (data.rule + 1) + ' (' + data.metric + ' = ' + data.value + '): ' + data.action);
+            }
+        }
+
+        function toggleCalPanel() {
+            const panel = document.getElementById('calPanel');
+            panel.classList.toggle('show');
+            if (panel.classList.contains('show')) sendCommand({ cmd: 'get_cal' });
+        }
+
+        function addCalPoint() {
+            const meter = parseFloat(document.getElementById('calMeter').value);
+            if (!(meter > 0)) {
+                alert('Enter the multimeter reading in volts');
+                return;
+            }
+            sendCommand({ cmd: 'cal_add_point', meter: meter });
+        }
+
+        function resetCal() {
+            if (confirm('Reset voltage calibration to factory (eFuse) values?')) {
+                sendCommand({ cmd: 'cal_reset' });
+            }
+        }
+
+        function updateCal(data) {
+            document.getElementById('calScheme').textContent =
+                data.scheme === 'efuse' ? 'Factory eFuse curve' : 'LM385 reference (no eFuse data)';
+            document.getElementById('calCorrection').textContent =
+                'gain ' + data.gain.toFixed(4) + ', offset ' + (data.offset * 1000).toFixed(1) + ' mV';
+            document.getElementById('calReading').textContent =
+                data.voltage.toFixed(3) + ' V (uncorrected ' + data.raw_v.toFixed(3) + ' V)';
+            document.getElementById('calPoints').textContent = data.points.length === 0 ? 'No pending points' :
+                data.points.map((p, i) => (i + 1) + ': ' + p.d.toFixed(3) + ' V \u2192 ' + p.m.toFixed(3) + ' V').join(', ');
+        }
+
+        function toggleThermalPanel() {
+            const panel = document.getElementById('thermalPanel');
+            panel.classList.toggle('show');
+            if (panel.classList.contains('show')) sendCommand({ cmd: 'get_thermal' });
+        }
+
+        function saveThermal() {
+            sendCommand({
+                cmd: 'thermal_config',
+                ambient: parseFloat(document.getElementById('thermalAmbient').value),
+                limit: parseFloat(document.getElementById('thermalLimit').value),
+                r_jh: parseFloat(document.getElementById('thermalRjh').value),
+                r_ha: parseFloat(document.getElementById('thermalRha').value),
+                c_ha: parseFloat(document.getElementById('thermalCha').value),
+                sense: parseFloat(document.getElementById('thermalSense').value)
+            });
+        }
+
+        function updateThermal(data) {
+            document.getElementById('thermalAmbient').value = data.ambient;
+            document.getElementById('thermalLimit').value = data.limit;
+            document.getElementById('thermalRjh').value = data.r_jh;
+            document.getElementById('thermalRha').value = data.r_ha;
+            document.getElementById('thermalCha').value = data.c_ha;
+            document.getElementById('thermalSense').value = data.sense;
+            document.getElementById('thermalCeiling').textContent = data.ceiling_ma + ' mA';
+        }
+
+        function toggleBenchPanel() {
+            const panel = document.getElementById('benchPanel');
+            panel.classList.toggle('show');
+            if (panel.classList.contains('show')) sendCommand({ cmd: 'get_benchmark' });
+        }
+
+        function runBenchmark() {
+            document.getElementById('benchInfo').textContent = 'Running...';
+            sendCommand({ cmd: 'benchmark', iterations: parseInt(document.getElementById('benchIterations').value) });
+        }
+
+        function updateBenchmark(data) {
+            if (data.cases.length === 0) return;
+            document.getElementById('benchInfo').textContent = data.cpu_mhz + ' MHz, ' +
+                (data.baselines > 0 ? 'compared with the saved baseline' : 'no baseline saved');
+            // One row per case: ns/op, heap kept per op, output bytes, change from baseline
+            document.getElementById('benchCases').textContent = data.cases.map(c =>
+                c.name.padEnd(13) + (c.ns.toFixed(0) + ' ns').padStart(12) + (c.heap + ' B').padStart(8) +
+                (c.bytes > 0 ? (c.bytes + ' out').padStart(10) : ''.padStart(10)) +
+                (c.base_ns ? ((c.ns / c.base_ns - 1) * 100).toFixed(1).padStart(8) + '%' : '')).join('\n');
+        }
+
+        let ocvData = null;
+
+        function toggleOcvPanel() {
+            const panel = document.getElementById('ocvPanel');
+            panel.classList.toggle('show');
+            if (panel.classList.contains('show')) sendCommand({ cmd: 'get_ocv' });
+        }
+
+        function renameOcv() {
+            const name = document.getElementById('ocvName').value.trim();
+            if (!ocvData || !name) return;
+            sendCommand({ cmd: 'ocv_rename', slot: ocvData.active, name: name });
+        }
+
+        function resetOcv() {
+            if (ocvData && confirm('Forget learned runs for "' + ocvData.slots[ocvData.active].name + '"?')) {
+                sendCommand({ cmd: 'ocv_reset', slot: ocvData.active });
+            }
+        }
+
+        function updateOcv(data) {
+            ocvData = data;
+            const select = document.getElementById('ocvSlot');
+            select.innerHTML = '';
+            data.slots.forEach((slot, i) => {
+                const opt = document.createElement('option');
+                opt.value = i;
+                opt.textContent = slot.name + (slot.runs > 0 ? ' (' + slot.runs + ' runs)' : ' (default)');
+                select.appendChild(opt);
+            });
+            select.value = data.active;
+
+            const slot = data.slots[data.active];
+            document.getElementById('ocvRuns').textContent =
+                slot.runs > 0 ? slot.runs + ' Analyze run' + (slot.runs === 1 ? '' : 's') : 'none (generic Li-ion table)';
+            document.getElementById('ocvPoints').textContent =
+                slot.mv.map((mv, i) => (i * 10) + '%: ' + (mv / 1000).toFixed(3)).join(', ');
+            document.getElementById('ocvName').value = slot.name;
+        }
+
         function checkHighCurrent() {
             const current = parseInt(document.getElementById('dischargeCurrent').value);
             const warning = document.getElementById('highCurrentWarning');
@@ -841,10 +1721,21 @@ const char INDEX_HTML[] PROGMEM = R"rawliteral(
             const staged = document.getElementById('stagedMode').checked;
             document.getElementById('stagedSettings').style.display = staged ? 'block' : 'none';
             if (staged) {
+                document.getElementById('sweepMode').checked = false;
+                document.getElementById('sweepSettings').style.display = 'none';
                 validateStagedSettings();
             }
         }
 
+        function toggleSweepSettings() {
+            const sweep = document.getElementById('sweepMode').checked;
+            document.getElementById('sweepSettings').style.display = sweep ? 'block' : 'none';
+            if (sweep) {
+                document.getElementById('stagedMode').checked = false;
+                toggleStagedSettings();
+            }
+        }
+
         function validateStagedSettings() {
             const s1Current = parseInt(document.getElementById('stage1Current').value);
             const s1Transition = parseFloat(document.getElementById('stage1Transition').value);
@@ -0,0 +1,84 @@
+#ifndef ADC_SAMPLER_H
+#define ADC_SAMPLER_H
+
+#include <Arduino.h>
+#include "VoltageFilter.h"
+
+// ========================================= ADC SAMPLING ========================================
+// readAdcBlock() captures one raw block for VoltageFilter, phase-locked to the load PWM:
+// median groups are one PWM period apart, each group shifted by 1/8 period. An optional
+// per-sample hook sees every conversion (the WebGUI streams them as serial telemetry).
+//
+// CellMeter is the ratiometric battery meter of the button-only sketches: the battery
+// channel is read against the LM385 reference, so supply drift cancels out. The reference
+// only moves with temperature, so it is re-read every VREF_REFRESH_INTERVAL rather than on
+// every reading (the old loop spent 200 conversions and 400 ms of delay() per reading).
+
+#define VREF_REFRESH_INTERVAL 60000  // ms between LM385 reference readings
+
+struct NoSampleHook {
+    void operator()(uint16_t) const {}
+};
+
+template <class Hook>
+void readAdcBlock(uint8_t pin, uint16_t* raw, Hook onSample) {
+    uint32_t next = micros();
+    int n = 0;
+    for (int g = 0; g < FILTER_DECIMATION; g++) {
+        for (int m = 0; m < FILTER_MEDIAN_N; m++) {
+            int32_t wait = (int32_t)(next - micros());
+            if (wait > 0) {
+                delayMicroseconds(wait);
+            }
+            raw[n] = analogRead(pin);
+            onSample(raw[n]);
+            n++;
+            next += ADC_SAMPLE_SPACING_US;
+        }
+        next += ADC_PHASE_STEP_US;
+    }
+}
+
+inline void readAdcBlock(uint8_t pin, uint16_t* raw) {
+    readAdcBlock(pin, raw, NoSampleHook());
+}
+
+template <class Board>
+class CellMeter {
+private:
+    VoltageFilter batteryFilter;
+    VoltageFilter vrefFilter;
+    uint32_t lastVrefRefresh;
+    bool vrefValid;
+
+    void refreshVref() {
+        uint16_t raw[FILTER_RAW_SAMPLES];
+        readAdcBlock(Board::VREF_PIN, raw);
+        vrefFilter.process(raw);
+        lastVrefRefresh = millis();
+        vrefValid = true;
+    }
+
+public:
+    CellMeter() : lastVrefRefresh(0), vrefValid(false) {}
+
+    // Next reading is taken unsmoothed (before step measurements such as IR)
+    void reset() {
+        batteryFilter.reset();
+    }
+
+    // Battery volts at the terminals
+    float measure() {
+        if (!vrefValid || millis() - lastVrefRefresh >= VREF_REFRESH_INTERVAL) {
+            refreshVref();
+        }
+        uint16_t raw[FILTER_RAW_SAMPLES];
+        readAdcBlock(Board::BAT_PIN, raw);
+        int32_t batteryCounts = batteryFilter.process(raw);  // Q4 counts
+        int32_t vrefCounts = vrefFilter.getFiltered();
+        if (vrefCounts <= 0) return 0;
+        return (float)batteryCounts / vrefCounts * Board::VREF_VOLTS * Board::DIVIDER_RATIO;
+    }
+};
+
+#endif // ADC_SAMPLER_H
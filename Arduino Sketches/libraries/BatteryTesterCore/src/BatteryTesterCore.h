@@ -0,0 +1,21 @@
+#ifndef BATTERY_TESTER_CORE_H
+#define BATTERY_TESTER_CORE_H
+
+// ========================================= BATTERY TESTER CORE ========================================
+// Code shared by every sketch in this repo:
+//
+//   TesterConfig.h     board, cell and load table policies
+//   VoltageFilter.h    median + CIC + adaptive IIR filter for ADC blocks
+//   AdcSampler.h       PWM-synchronous ADC block capture, ratiometric CellMeter
+//   ToneSequencer.h    non-blocking buzzer
+//   OperationScreen.h  OLED layouts of the running and finished operations
+//   CoreTester.h       non-blocking engine of the button-only firmware
+
+#include "TesterConfig.h"
+#include "VoltageFilter.h"
+#include "AdcSampler.h"
+#include "ToneSequencer.h"
+#include "OperationScreen.h"
+#include "CoreTester.h"
+
+#endif // BATTERY_TESTER_CORE_H
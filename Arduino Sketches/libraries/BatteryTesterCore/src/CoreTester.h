@@ -0,0 +1,445 @@
+#ifndef CORE_TESTER_H
+#define CORE_TESTER_H
+
+#include <Arduino.h>
+#include <JC_Button.h>
+#include "TesterConfig.h"
+#include "AdcSampler.h"
+#include "ToneSequencer.h"
+#include "OperationScreen.h"
+
+// ========================================= CORE TESTER ========================================
+// Non-blocking engine of the button-only firmware: Charge, Discharge, Analyze and IR Test
+// as a state machine advanced by poll() from loop(). Nothing waits in a loop - every
+// pass reads the buttons, runs one step of the current state and returns, so the Mode
+// button aborts any operation within one pass and the sample rate is set by the ADC
+// block (~25 ms), not by delay().
+//
+//   CoreTester<Board, Load, Display, Cell>
+//     Board    pins, divider, reference and charge current   (XiaoC3Board)
+//     Load     discharge current table                       (Load1A, Load2A)
+//     Display  OLED driver                                   (Adafruit_SSD1306)
+//     Cell     voltage limits                                (LiIonCell)
+//
+// The sketch only creates the display and the tester and calls begin() and poll().
+// The Web GUI sketch does not use this engine: it runs its own STATE_TABLE machine.
+
+#define CORE_MENU_ITEMS 4
+#define CORE_ANALYZE_REST_MS 180000UL  // Rest between Analyze charge and discharge
+#define CORE_ANALYZE_CUTOFF_V 3.0f
+#define CORE_IR_SETTLE_MS 500          // Settling time before each IR reading
+#define CORE_IR_DISPLAY_MS 5000        // IR result auto-return
+#define CORE_MESSAGE_MS 3000           // Error message auto-return
+
+enum CoreState : uint8_t {
+    CORE_MENU,
+    CORE_SELECT_CUTOFF,
+    CORE_SELECT_CURRENT,
+    CORE_CHARGING,
+    CORE_DISCHARGING,
+    CORE_ANALYZE_CHARGE,
+    CORE_ANALYZE_REST,
+    CORE_ANALYZE_DISCHARGE,
+    CORE_IR_MEASURE,
+    CORE_IR_DISPLAY,
+    CORE_COMPLETE,
+    CORE_MESSAGE       // Error text, back to the menu after CORE_MESSAGE_MS
+};
+
+// Engine tick result
+enum CoreTick : uint8_t {
+    CORE_TICK_RUNNING,
+    CORE_TICK_ABORTED,  // State already left
+    CORE_TICK_DONE      // End condition met; the caller decides what follows
+};
+
+template <class Board, class Load, class Display, class Cell = LiIonCell>
+class CoreTester {
+private:
+    Display& display;
+    OperationScreen<Display> screen;
+    CellMeter<Board> meter;
+    Button modeButton;
+    Button upButton;
+    Button downButton;
+
+    CoreState state;
+    uint8_t selectedMode;
+    float cutoffVoltage;
+    uint8_t currentIndex;     // Load::CURRENT_MA index chosen for Discharge
+    uint8_t loadIndex;        // Index applied now (0 = load off)
+
+    float volts;
+    float capacityMAh;
+    float voltageNoLoad;
+    float internalResistance;
+    bool chargeResult;        // Result screen shows a full icon
+    const char* message;
+
+    unsigned long startTime;
+    unsigned long elapsedTime;
+    unsigned long lastCapacityUpdate;
+    unsigned long stateStartTime;
+
+    void enter(CoreState next) {
+        state = next;
+        stateStartTime = millis();
+    }
+
+    void beep(uint16_t duration) {
+        toneSequencer.playTone(1000, duration);
+    }
+
+    void setLoad(uint8_t index) {
+        loadIndex = index;
+        analogWrite(Board::PWM_PIN, Load::PWM_DUTY[index]);
+    }
+
+    void resetToIdle() {
+        digitalWrite(Board::MOSFET_PIN, LOW);
+        setLoad(0);
+    }
+
+    void abortOperation() {
+        resetToIdle();
+        toneSequencer.play(TONE_SEQUENCE(BEEP_ABORT));
+        enter(CORE_MENU);
+    }
+
+    void showError(const char* text) {
+        message = text;
+        toneSequencer.play(TONE_SEQUENCE(CHIME_ERROR));
+        enter(CORE_MESSAGE);
+    }
+
+    // Slot check before charging or loading a cell; false (and an error screen) if unusable
+    bool checkCell() {
+        meter.reset();
+        volts = meter.measure();
+        if (volts < Cell::NO_BAT_V) {
+            showError("EMPTY BAT SLOT");
+            return false;
+        }
+        if (volts < Cell::DAMAGE_V) {
+            showError("BAT DAMAGED");
+            return false;
+        }
+        return true;
+    }
+
+    void startRun() {
+        capacityMAh = 0;
+        startTime = millis();
+        elapsedTime = 0;
+        lastCapacityUpdate = startTime;
+    }
+
+    void startCharge(CoreState next) {
+        setLoad(0);
+        digitalWrite(Board::MOSFET_PIN, HIGH);
+        startRun();
+        enter(next);
+    }
+
+    void startDischarge(CoreState next, uint8_t index, float cutoff) {
+        digitalWrite(Board::MOSFET_PIN, LOW);
+        cutoffVoltage = cutoff;
+        setLoad(index);
+        startRun();
+        enter(next);
+    }
+
+    // Abort check, timing, measurement, capacity and the end condition of a charge or discharge
+    CoreTick tickOperation(bool charging) {
+        if (modeButton.wasReleased()) {
+            abortOperation();
+            return CORE_TICK_ABORTED;
+        }
+
+        unsigned long now = millis();
+        elapsedTime = now - startTime;
+        volts = meter.measure();
+
+        float elapsedHours = (now - lastCapacityUpdate) / 3600000.0f;
+        lastCapacityUpdate = now;
+        int mA = charging ? Board::CHARGE_CURRENT_MA : Load::CURRENT_MA[loadIndex] + Load::OFFSET_MA;
+        capacityMAh += mA * elapsedHours;  // Charge is an estimate - the CV phase tapers
+
+        if (charging ? volts >= Cell::FULL_V : volts <= cutoffVoltage) {
+            return CORE_TICK_DONE;
+        }
+        return CORE_TICK_RUNNING;
+    }
+
+    void finish(bool charged) {
+        resetToIdle();
+        chargeResult = charged;
+        beep(300);
+        toneSequencer.play(TONE_SEQUENCE(CHIME_COMPLETE));
+        enter(CORE_COMPLETE);
+    }
+
+    // ---- State handlers ----
+
+    void handleMenu() {
+        if (upButton.wasReleased()) {
+            selectedMode = (selectedMode == 0) ? CORE_MENU_ITEMS - 1 : selectedMode - 1;
+            beep(100);
+        }
+        if (downButton.wasReleased()) {
+            selectedMode = (selectedMode == CORE_MENU_ITEMS - 1) ? 0 : selectedMode + 1;
+            beep(100);
+        }
+        if (modeButton.wasReleased()) {
+            beep(300);
+            if (selectedMode == 0) {
+                if (checkCell()) startCharge(CORE_CHARGING);
+            } else if (selectedMode == 1) {
+                enter(CORE_SELECT_CUTOFF);
+            } else if (selectedMode == 2) {
+                if (checkCell()) startCharge(CORE_ANALYZE_CHARGE);
+            } else {
+                if (checkCell()) {
+                    resetToIdle();
+                    enter(CORE_IR_MEASURE);
+                }
+            }
+            return;
+        }
+
+        static const char* const modes[CORE_MENU_ITEMS] = {"Charge", "Discharge", "Analyze", "IR Test"};
+        display.clearDisplay();
+        display.setTextSize(1);
+        display.setCursor(25, 0);
+        display.print("Select Mode:");
+        for (uint8_t i = 0; i < CORE_MENU_ITEMS; i++) {
+            display.setCursor(25, 12 + i * 14);
+            display.print((i == selectedMode) ? "> " : "  ");
+            display.print(modes[i]);
+        }
+        display.display();
+    }
+
+    void handleSelectCutoff() {
+        if (upButton.wasReleased() && cutoffVoltage < Cell::MAX_CUTOFF_V) {
+            cutoffVoltage += 0.1f;
+            beep(100);
+        }
+        if (downButton.wasReleased() && cutoffVoltage > Cell::MIN_CUTOFF_V) {
+            cutoffVoltage -= 0.1f;
+            beep(100);
+        }
+        if (modeButton.wasReleased()) {
+            beep(300);
+            enter(CORE_SELECT_CURRENT);
+            return;
+        }
+
+        display.clearDisplay();
+        display.setTextSize(1);
+        display.setCursor(2, 10);
+        display.print("Select Cutoff Volt:");
+        display.setTextSize(2);
+        display.setCursor(20, 30);
+        display.print("V:");
+        display.print(cutoffVoltage, 1);
+        display.print("V");
+        display.display();
+    }
+
+    void handleSelectCurrent() {
+        if (upButton.wasReleased() && currentIndex < Load::COUNT - 1) {
+            currentIndex++;
+            beep(100);
+        }
+        if (downButton.wasReleased() && currentIndex > 0) {
+            currentIndex--;
+            beep(100);
+        }
+        if (modeButton.wasReleased()) {
+            beep(300);
+            startDischarge(CORE_DISCHARGING, currentIndex, cutoffVoltage);
+            return;
+        }
+
+        display.clearDisplay();
+        display.setTextSize(1);
+        display.setCursor(2, 5);
+        display.print("Select Dischrg Curr:");
+        if (Load::CURRENT_MA[currentIndex] > Load::HIGH_CURRENT_MA) {
+            display.setCursor(2, 52);
+            display.print("!! HIGH CURRENT !!");
+        }
+        display.setTextSize(2);
+        display.setCursor(15, 25);
+        display.print("I:");
+        display.print(Load::CURRENT_MA[currentIndex]);
+        display.print("mA");
+        display.display();
+    }
+
+    void handleCharging(const char* title, bool analyze) {
+        CoreTick tick = tickOperation(true);
+        if (tick == CORE_TICK_ABORTED) return;
+        if (tick == CORE_TICK_DONE) {
+            if (analyze) {
+                digitalWrite(Board::MOSFET_PIN, LOW);
+                enter(CORE_ANALYZE_REST);
+            } else {
+                finish(true);
+            }
+            return;
+        }
+        screen.showCharge(title, elapsedTime, capacityMAh, volts);
+    }
+
+    void handleDischarging(const char* title) {
+        CoreTick tick = tickOperation(false);
+        if (tick == CORE_TICK_ABORTED) return;
+        if (tick == CORE_TICK_DONE) {
+            finish(false);
+            return;
+        }
+        screen.showDischarge(title, false, elapsedTime, capacityMAh, volts);
+    }
+
+    void handleAnalyzeRest() {
+        if (modeButton.wasReleased()) {
+            abortOperation();
+            return;
+        }
+        if (millis() - stateStartTime >= CORE_ANALYZE_REST_MS) {
+            startDischarge(CORE_ANALYZE_DISCHARGE, Load::DEFAULT_INDEX, CORE_ANALYZE_CUTOFF_V);
+            return;
+        }
+
+        display.clearDisplay();
+        display.setTextSize(2);
+        display.setCursor(5, 25);
+        display.print("Resting..");
+        display.display();
+    }
+
+    // Open-circuit reading, then one under the default load; each after CORE_IR_SETTLE_MS
+    void handleIRMeasure() {
+        if (modeButton.wasReleased()) {
+            abortOperation();
+            return;
+        }
+        screen.showMessage(20, 25, "Measuring IR...");
+        if (millis() - stateStartTime < CORE_IR_SETTLE_MS) return;
+
+        meter.reset();  // Unsmoothed reading, independent of earlier samples
+        if (loadIndex == 0) {
+            voltageNoLoad = meter.measure();
+            setLoad(Load::DEFAULT_INDEX);
+            stateStartTime = millis();
+            return;
+        }
+
+        float voltageLoad = meter.measure();
+        float amps = Load::CURRENT_MA[loadIndex] / 1000.0f;
+        setLoad(0);
+        internalResistance = (voltageNoLoad - voltageLoad) / amps;
+        beep(300);
+        enter(CORE_IR_DISPLAY);
+    }
+
+    void handleIRDisplay() {
+        if (anyButtonReleased() || millis() - stateStartTime >= CORE_IR_DISPLAY_MS) {
+            enter(CORE_MENU);
+            return;
+        }
+        screen.showInternalResistance(internalResistance);
+    }
+
+    void handleComplete() {
+        if (anyButtonReleased()) {
+            enter(CORE_MENU);
+            return;
+        }
+        screen.showComplete(nullptr, elapsedTime, capacityMAh, volts, chargeResult);
+    }
+
+    void handleMessage() {
+        if (anyButtonReleased() || millis() - stateStartTime >= CORE_MESSAGE_MS) {
+            enter(CORE_MENU);
+            return;
+        }
+        screen.showMessage(15, 25, message);
+    }
+
+    bool anyButtonReleased() {
+        // Evaluate all three so no release is left pending for the next state
+        bool mode = modeButton.wasReleased();
+        bool up = upButton.wasReleased();
+        bool down = downButton.wasReleased();
+        return mode || up || down;
+    }
+
+public:
+    explicit CoreTester(Display& oled)
+        : display(oled), screen(oled),
+          modeButton(Board::MODE_PIN, Board::BUTTON_DEBOUNCE_MS, false, true),
+          upButton(Board::UP_PIN, Board::BUTTON_DEBOUNCE_MS, false, true),
+          downButton(Board::DOWN_PIN, Board::BUTTON_DEBOUNCE_MS, false, true),
+          state(CORE_MENU), selectedMode(0), cutoffVoltage(Cell::DEFAULT_CUTOFF_V),
+          currentIndex(Load::DEFAULT_INDEX), loadIndex(0), volts(0), capacityMAh(0),
+          voltageNoLoad(0), internalResistance(0), chargeResult(false), message(""),
+          startTime(0), elapsedTime(0), lastCapacityUpdate(0), stateStartTime(0) {}
+
+    // Load and charger off, buttons and buzzer ready (the display is the sketch's)
+    void begin() {
+        pinMode(Board::PWM_PIN, OUTPUT);
+        pinMode(Board::MOSFET_PIN, OUTPUT);
+        resetToIdle();
+
+        modeButton.begin();
+        upButton.begin();
+        downButton.begin();
+
+        ledcAttach(Board::BUZZER_PIN, Board::LEDC_FREQUENCY, Board::LEDC_RESOLUTION);
+        toneSequencer.begin(Board::BUZZER_PIN, Board::LEDC_RESOLUTION);
+        enter(CORE_MENU);
+    }
+
+    // One pass of the state machine; call from every loop()
+    void poll() {
+        modeButton.read();
+        upButton.read();
+        downButton.read();
+
+        switch (state) {
+            case CORE_MENU:              handleMenu(); break;
+            case CORE_SELECT_CUTOFF:     handleSelectCutoff(); break;
+            case CORE_SELECT_CURRENT:    handleSelectCurrent(); break;
+            case CORE_CHARGING:          handleCharging("Charging..", false); break;
+            case CORE_DISCHARGING:       handleDischarging("Discharging.."); break;
+            case CORE_ANALYZE_CHARGE:    handleCharging("Analyze - Charging", true); break;
+            case CORE_ANALYZE_REST:      handleAnalyzeRest(); break;
+            case CORE_ANALYZE_DISCHARGE: handleDischarging("Analyzing - D"); break;
+            case CORE_IR_MEASURE:        handleIRMeasure(); break;
+            case CORE_IR_DISPLAY:        handleIRDisplay(); break;
+            case CORE_COMPLETE:          handleComplete(); break;
+            case CORE_MESSAGE:           handleMessage(); break;
+        }
+    }
+
+    CoreState getState() const {
+        return state;
+    }
+
+    float getVoltage() const {
+        return volts;
+    }
+
+    float getCapacityMAh() const {
+        return capacityMAh;
+    }
+
+    float getInternalResistance() const {
+        return internalResistance;
+    }
+};
+
+#endif // CORE_TESTER_H
@@ -0,0 +1,158 @@
+#ifndef OPERATION_SCREEN_H
+#define OPERATION_SCREEN_H
+
+#include <Adafruit_GFX.h>
+#include <Adafruit_SSD1306.h>
+
+// ========================================= OPERATION SCREENS ========================================
+// OLED layouts shared by all sketches: running charge/discharge, the result screen and
+// the IR result. Every call draws a whole frame (clear ... display). Templated on the
+// display so any Adafruit_GFX panel with a display() method can be used.
+//
+// The battery icon animates every ICON_STEP_MS but is drawn on every frame, so it no
+// longer disappears on frames that fall between animation steps.
+
+#define ICON_STEP_MS 50     // Battery icon animation step
+#define ICON_STEP_PCT 4     // Fill change per step
+
+template <class Display>
+class OperationScreen {
+private:
+    Display& display;
+    int batteryLevel;
+    unsigned long lastIconStep;
+
+    void printTime(unsigned long elapsedMs) {
+        unsigned long seconds = elapsedMs / 1000;
+        display.print(seconds / 3600);
+        display.print(":");
+        display.print((seconds / 60) % 60);
+        display.print(":");
+        display.print(seconds % 60);
+    }
+
+    // Time, capacity and voltage lines of the discharge and result screens
+    void printResultLines(unsigned long elapsedMs, float capacityMAh, float volts) {
+        display.setCursor(15, 20);
+        display.print("Time: ");
+        printTime(elapsedMs);
+        display.setCursor(15, 35);
+        display.print("Cap:");
+        display.print(capacityMAh, 1);
+        display.print("mAh");
+        display.setCursor(15, 50);
+        display.print("V: ");
+        display.print(volts, 2);
+        display.print("V");
+    }
+
+public:
+    explicit OperationScreen(Display& d) : display(d), batteryLevel(0), lastIconStep(0) {}
+
+    void drawBatteryOutline() {
+        display.drawRect(100, 15, 12, 20, SSD1306_WHITE);
+        display.drawRect(102, 12, 8, 3, SSD1306_WHITE);
+    }
+
+    void drawBatteryFill(int level) {
+        int fillHeight = map(level, 0, 100, 0, 18);
+        display.fillRect(102, 33 - fillHeight, 8, fillHeight, SSD1306_WHITE);
+    }
+
+    // Animated icon: fills while charging, empties while discharging
+    void drawBatteryAnimation(bool charging) {
+        unsigned long now = millis();
+        if (now - lastIconStep >= ICON_STEP_MS) {
+            lastIconStep = now;
+            if (charging) {
+                batteryLevel += ICON_STEP_PCT;
+                if (batteryLevel > 100) batteryLevel = 0;
+            } else {
+                batteryLevel -= ICON_STEP_PCT;
+                if (batteryLevel < 0) batteryLevel = 100;
+            }
+        }
+        drawBatteryOutline();
+        drawBatteryFill(batteryLevel);
+    }
+
+    // Title, time, ~capacity (estimate), large voltage
+    void showCharge(const char* title, unsigned long elapsedMs, float capacityMAh, float volts) {
+        display.clearDisplay();
+        drawBatteryAnimation(true);
+        display.setTextSize(1);
+        display.setCursor(5, 5);
+        display.print(title);
+        display.setCursor(5, 18);
+        display.print("Time:");
+        printTime(elapsedMs);
+        display.setCursor(5, 31);
+        display.print("~Cap:");
+        display.print(capacityMAh, 0);
+        display.print("mAh");
+        display.setCursor(5, 48);
+        display.setTextSize(2);
+        display.print("V:");
+        display.print(volts, 2);
+        display.print("V");
+        display.display();
+    }
+
+    // Title (+ HOT while the load is derated), time, capacity, voltage
+    void showDischarge(const char* title, bool hot, unsigned long elapsedMs, float capacityMAh, float volts) {
+        display.clearDisplay();
+        drawBatteryAnimation(false);
+        display.setTextSize(1);
+        display.setCursor(10, 5);
+        display.print(title);
+        if (hot) {
+            display.print(" HOT");
+        }
+        printResultLines(elapsedMs, capacityMAh, volts);
+        display.display();
+    }
+
+    // Result screen; note is printed after "Complete" (nullptr for none)
+    void showComplete(const char* note, unsigned long elapsedMs, float capacityMAh, float volts, bool full) {
+        display.clearDisplay();
+        display.setTextSize(1);
+        display.setCursor(15, 5);
+        display.print("Complete");
+        if (note) {
+            display.print(note);
+        }
+        printResultLines(elapsedMs, capacityMAh, volts);
+        drawBatteryOutline();
+        drawBatteryFill(full ? 100 : 0);
+        display.display();
+    }
+
+    // Resistor symbol and the result in milliohms
+    void showInternalResistance(float ohms) {
+        display.clearDisplay();
+        display.drawLine(34, 15, 54, 15, SSD1306_WHITE);
+        display.drawLine(54, 15, 59, 20, SSD1306_WHITE);
+        display.drawLine(59, 20, 64, 10, SSD1306_WHITE);
+        display.drawLine(64, 10, 69, 20, SSD1306_WHITE);
+        display.drawLine(69, 20, 74, 15, SSD1306_WHITE);
+        display.drawLine(74, 15, 94, 15, SSD1306_WHITE);
+
+        display.setTextSize(2);
+        display.setCursor(2, 35);
+        display.print("IR:");
+        display.print(ohms * 1000, 0);
+        display.print("mOhm");
+        display.display();
+    }
+
+    // One line of size 1 text (errors, "Measuring IR...")
+    void showMessage(int16_t x, int16_t y, const char* text) {
+        display.clearDisplay();
+        display.setTextSize(1);
+        display.setCursor(x, y);
+        display.print(text);
+        display.display();
+    }
+};
+
+#endif // OPERATION_SCREEN_H
@@ -0,0 +1,79 @@
+#ifndef TESTER_CONFIG_H
+#define TESTER_CONFIG_H
+
+#include <Arduino.h>
+
+// ========================================= BUILD POLICIES ========================================
+// Compile-time configuration shared by every sketch in the repo. Each struct is a policy
+// passed as a template argument (CoreTester, CellMeter), so a variant with other pins, a
+// recalibrated reference or a different load table only defines its own struct:
+//
+//   struct MyBoard : XiaoC3Board {
+//       static constexpr float VREF_VOLTS = 1.227f;   // hides the base value
+//   };
+//
+// Nothing here costs RAM or code unless it is used.
+
+// XIAO ESP32-C3 tester PCB
+struct XiaoC3Board {
+    // Control pins
+    static constexpr uint8_t PWM_PIN = D8;       // Discharge load MOSFET gate
+    static constexpr uint8_t BUZZER_PIN = D7;
+    static constexpr uint8_t BAT_PIN = A0;       // Battery through the R1/R2 divider
+    static constexpr uint8_t VREF_PIN = A1;      // LM385-1.2V (U6)
+    static constexpr uint8_t MOSFET_PIN = D2;    // LP4060 charger enable
+    // Note: A2 and D2 are the SAME pin (GPIO4), so the LP4060 CHRG output cannot be read
+
+    // Buttons (active low, internal pull-up not used)
+    static constexpr uint8_t MODE_PIN = D3;
+    static constexpr uint8_t UP_PIN = D6;
+    static constexpr uint8_t DOWN_PIN = D9;
+    static constexpr uint8_t BUTTON_DEBOUNCE_MS = 25;
+
+    // Measurement
+    static constexpr float DIVIDER_RATIO = (200000.0f + 100000.0f) / 100000.0f;  // (R1 + R2) / R2
+    static constexpr float VREF_VOLTS = 1.26f;   // LM385 calibration (factory default: 1.227V)
+
+    // Charge current set by R7 (1k) on LP4060: I = 1000mA
+    static constexpr int CHARGE_CURRENT_MA = 1000;
+
+    // Buzzer LEDC setup
+    static constexpr uint32_t LEDC_FREQUENCY = 5000;
+    static constexpr uint8_t LEDC_RESOLUTION = 8;
+};
+
+// Single-cell Li-Ion limits
+struct LiIonCell {
+    static constexpr float FULL_V = 4.18f;       // Charge termination (typical 4.2V)
+    static constexpr float DAMAGE_V = 2.5f;      // Below this the cell is treated as damaged
+    static constexpr float NO_BAT_V = 0.3f;      // Empty slot
+    static constexpr float MIN_CUTOFF_V = 2.8f;  // Selectable discharge cutoff range
+    static constexpr float MAX_CUTOFF_V = 3.2f;
+    static constexpr float DEFAULT_CUTOFF_V = 3.0f;
+};
+
+// ---- Discharge load tables ----
+// CURRENT_MA[i] is drawn at analogWrite duty PWM_DUTY[i]. OFFSET_MA is the measured
+// current the table does not include (added when integrating capacity).
+
+// Up to 1A: stock heatsink
+struct Load1A {
+    static constexpr uint8_t COUNT = 12;
+    static constexpr int CURRENT_MA[COUNT] = {0, 50, 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000};
+    static constexpr int PWM_DUTY[COUNT] = {0, 4, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100};
+    static constexpr uint8_t DEFAULT_INDEX = 6;   // 500mA - also the Analyze and IR load
+    static constexpr int OFFSET_MA = 25;
+    static constexpr int HIGH_CURRENT_MA = 1000;  // Warn above this
+};
+
+// Up to 2A: 1500mA and 2000mA need a heatsink and airflow
+struct Load2A {
+    static constexpr uint8_t COUNT = 14;
+    static constexpr int CURRENT_MA[COUNT] = {0, 50, 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000, 1500, 2000};
+    static constexpr int PWM_DUTY[COUNT] = {0, 4, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 150, 200};
+    static constexpr uint8_t DEFAULT_INDEX = 6;
+    static constexpr int OFFSET_MA = 25;
+    static constexpr int HIGH_CURRENT_MA = 1000;
+};
+
+#endif // TESTER_CONFIG_H
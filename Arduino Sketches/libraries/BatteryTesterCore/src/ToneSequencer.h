@@ -0,0 +1,192 @@
+#ifndef TONE_SEQUENCER_H
+#define TONE_SEQUENCER_H
+
+#include "esp_timer.h"
+
+// ========================================= TONE SEQUENCER ========================================
+// Non-blocking buzzer playback. Note sequences live in static tables; an esp_timer
+// one-shot advances to the next note, so nothing in the control loop ever waits
+// for a tone to finish (and long delay()s elsewhere do not stretch notes either).
+//
+// Sequences queue up behind the one that is playing (e.g. the cutoff beep is followed
+// by the completion chime), up to TONE_QUEUE_SIZE; when the queue is full the oldest
+// pending sequence is dropped.
+
+#define TONE_QUEUE_SIZE 4
+
+// One note; frequency 0 = rest
+struct ToneNote {
+    uint16_t frequency;  // Hz
+    uint16_t duration;   // ms
+};
+
+// ---- Static sequences ----
+// Startup chime: C5 -> D5 -> E5 -> G5 (pleasant ascending pattern)
+static const ToneNote CHIME_STARTUP[] = {
+    {523, 150}, {0, 50}, {587, 150}, {0, 50}, {659, 150}, {0, 50}, {784, 300}, {0, 100}
+};
+// Completion chime: G5 -> E5 -> D5 -> C5 (descending resolution)
+static const ToneNote CHIME_COMPLETE[] = {
+    {784, 150}, {0, 50}, {659, 150}, {0, 50}, {587, 150}, {0, 50}, {523, 300}, {0, 100}
+};
+// Error chime: G4 -> F4 -> G4 (urgent warning)
+static const ToneNote CHIME_ERROR[] = {
+    {392, 100}, {0, 50}, {349, 100}, {0, 50}, {392, 200}, {0, 50}
+};
+// Abort: double beep
+static const ToneNote BEEP_ABORT[] = {
+    {1000, 100}, {0, 100}, {1000, 100}
+};
+// Storage target reached: quick double beep
+static const ToneNote BEEP_TARGET[] = {
+    {1000, 100}, {0, 50}, {1000, 100}
+};
+
+#define TONE_SEQUENCE(table) table, (uint8_t)(sizeof(table) / sizeof(table[0]))
+
+class ToneSequencer {
+private:
+    struct Pending {
+        const ToneNote* notes;
+        uint8_t length;
+    };
+
+    uint8_t pin;
+    uint8_t resolution;
+    esp_timer_handle_t timer;
+    portMUX_TYPE lock;
+
+    // Current sequence
+    const ToneNote* notes;
+    uint8_t length;
+    uint8_t position;  // Next note to output
+
+    // Pending sequences (ring buffer)
+    Pending queue[TONE_QUEUE_SIZE];
+    uint8_t queueHead;
+    uint8_t queueCount;
+
+    // Single-note buffers for beep(); one per queue slot plus the playing note
+    ToneNote singles[TONE_QUEUE_SIZE + 1];
+    uint8_t nextSingle;
+
+    static void onTimer(void* arg) {
+        static_cast<ToneSequencer*>(arg)->nextNote();
+    }
+
+    // Output the note at `position` and advance, moving to the next queued sequence at
+    // the end. Only the esp_timer task runs this (play() starts a sequence by arming the
+    // timer), so note output never races with itself; the lock covers the sequence
+    // state and single-note buffers that play(), playTone() and stop() change from
+    // whichever task makes the sound.
+    void nextNote() {
+        ToneNote note = {0, 0};
+        bool playing = false;
+        portENTER_CRITICAL(&lock);
+        if (notes != nullptr && position >= length) {
+            notes = nullptr;
+            if (queueCount > 0) {
+                notes = queue[queueHead].notes;
+                length = queue[queueHead].length;
+                position = 0;
+                queueHead = (queueHead + 1) % TONE_QUEUE_SIZE;
+                queueCount--;
+            }
+        }
+        if (notes != nullptr) {
+            note = notes[position++];
+            playing = true;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        if (!playing) {
+            ledcWrite(pin, 0);
+            return;
+        }
+
+        if (note.frequency == 0) {
+            ledcWrite(pin, 0);
+        } else {
+            ledcChangeFrequency(pin, note.frequency, resolution);
+            ledcWrite(pin, 1 << (resolution - 1));  // 50% duty cycle
+        }
+        esp_timer_start_once(timer, (uint64_t)note.duration * 1000);
+    }
+
+public:
+    ToneSequencer() : pin(0), resolution(8), timer(nullptr), lock(portMUX_INITIALIZER_UNLOCKED),
+                      notes(nullptr), length(0), position(0), queueHead(0), queueCount(0), nextSingle(0) {}
+
+    // LEDC must already be attached to the pin
+    void begin(uint8_t buzzerPin, uint8_t ledcResolution) {
+        pin = buzzerPin;
+        resolution = ledcResolution;
+        esp_timer_create_args_t args = {};
+        args.callback = &ToneSequencer::onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "tone";
+        esp_timer_create(&args, &timer);
+    }
+
+    // Queue a sequence; starts immediately if the buzzer is idle
+    void play(const ToneNote* sequence, uint8_t count) {
+        if (timer == nullptr || count == 0) return;
+
+        bool startNow = false;
+        portENTER_CRITICAL(&lock);
+        if (notes == nullptr) {
+            notes = sequence;
+            length = count;
+            position = 0;
+            startNow = true;
+        } else {
+            if (queueCount == TONE_QUEUE_SIZE) {
+                queueHead = (queueHead + 1) % TONE_QUEUE_SIZE;  // Drop the oldest pending
+                queueCount--;
+            }
+            uint8_t tail = (queueHead + queueCount) % TONE_QUEUE_SIZE;
+            queue[tail].notes = sequence;
+            queue[tail].length = count;
+            queueCount++;
+        }
+        portEXIT_CRITICAL(&lock);
+
+        // First note is output from the timer task, like every other note
+        if (startNow) {
+            esp_timer_start_once(timer, 0);
+        }
+    }
+
+    // Queue a single tone. The buffer is claimed and filled under the lock, so two
+    // callers never share one and nextNote() never reads a half-written note.
+    void playTone(uint16_t frequency, uint16_t duration) {
+        portENTER_CRITICAL(&lock);
+        ToneNote& note = singles[nextSingle];
+        nextSingle = (nextSingle + 1) % (TONE_QUEUE_SIZE + 1);
+        note.frequency = frequency;
+        note.duration = duration;
+        portEXIT_CRITICAL(&lock);
+        play(&note, 1);
+    }
+
+    // Silence the buzzer and drop everything queued
+    void stop() {
+        if (timer == nullptr) return;
+        esp_timer_stop(timer);
+        portENTER_CRITICAL(&lock);
+        notes = nullptr;
+        queueCount = 0;
+        portEXIT_CRITICAL(&lock);
+        ledcWrite(pin, 0);
+    }
+
+    bool isPlaying() const {
+        return notes != nullptr;
+    }
+};
+
+// Global sequencer instance
+ToneSequencer toneSequencer;
+
+#endif // TONE_SEQUENCER_H
@@ -0,0 +1,99 @@
+#ifndef VOLTAGE_FILTER_H
+#define VOLTAGE_FILTER_H
+
+// ========================================= VOLTAGE FILTER ========================================
+// Integer-only filter pipeline for ADC channels (battery sense and Vref).
+//
+//   raw block (24 samples, PWM-synchronous)
+//     -> median-of-3 per group        rejects single-sample spikes
+//     -> CIC decimation (order 1, /8) sum of 8 medians, +1.5 bits, ripple averaged out
+//     -> adaptive IIR low-pass        alpha 1/8 .. 1/2 depending on error, snaps on steps
+//     -> output in Q4 ADC counts (counts x 16)
+//
+// Sampling (done by the caller, see readAdcBlock() in AdcSampler.h):
+// samples inside a median group are taken exactly one load-PWM period apart, so
+// they see the same ripple phase and only spikes differ. Each group starts a further
+// 1/8 period later, so the 8 group medians cover the whole ripple cycle and the
+// CIC sum cancels it instead of aliasing it into the reading.
+//
+// Output rate: one reading per call, 24 conversions over ~25 ms (was 100 conversions
+// over ~100 ms including the Vref channel).
+// Noise floor (expected, from ~2 LSB rms raw ADC noise on the ESP32-C3):
+//   after CIC ~0.7 LSB rms, after IIR in steady state ~0.2 LSB rms,
+//   i.e. below 1 mV at the battery through the 3:1 divider.
+
+#define LOAD_PWM_FREQUENCY 1000  // analogWrite() default on the ESP32 Arduino core
+#define FILTER_MEDIAN_N 3
+#define FILTER_DECIMATION 8
+#define FILTER_RAW_SAMPLES (FILTER_MEDIAN_N * FILTER_DECIMATION)
+#define FILTER_FRAC_BITS 4       // Output is Q4 ADC counts
+
+#define ADC_SAMPLE_SPACING_US (1000000UL / LOAD_PWM_FREQUENCY)       // Same PWM phase
+#define ADC_PHASE_STEP_US (ADC_SAMPLE_SPACING_US / FILTER_DECIMATION)  // Phase advance per group
+
+// Adaptive IIR thresholds in Q4 counts
+#define FILTER_NOISE_BAND (3 << FILTER_FRAC_BITS)   // Within noise: slowest smoothing
+#define FILTER_TRACK_BAND (12 << FILTER_FRAC_BITS)  // Drift: faster tracking
+#define FILTER_SNAP_BAND (24 << FILTER_FRAC_BITS)   // Step (load switched): jump straight to input
+
+class VoltageFilter {
+private:
+    int32_t state;  // Q4 counts
+    bool primed;
+
+    static inline uint16_t median3(uint16_t a, uint16_t b, uint16_t c) {
+        if (a > b) { uint16_t t = a; a = b; b = t; }
+        if (b > c) { b = c; }
+        return (a > b) ? a : b;
+    }
+
+public:
+    VoltageFilter() : state(0), primed(false) {}
+
+    // Forget history - next reading is taken unsmoothed (use before step measurements)
+    void reset() {
+        primed = false;
+    }
+
+    // Median + CIC stage: raw block -> Q4 counts
+    static int32_t decimate(const uint16_t* raw) {
+        uint32_t sum = 0;
+        for (int g = 0; g < FILTER_DECIMATION; g++) {
+            const uint16_t* s = raw + g * FILTER_MEDIAN_N;
+            sum += median3(s[0], s[1], s[2]);
+        }
+        // sum carries log2(8) = 3 fractional bits; scale up to Q4
+        return (int32_t)(sum << (FILTER_FRAC_BITS - 3));
+    }
+
+    // Adaptive IIR stage
+    int32_t update(int32_t x) {
+        if (!primed) {
+            state = x;
+            primed = true;
+            return state;
+        }
+        int32_t e = x - state;
+        int32_t mag = (e < 0) ? -e : e;
+        if (mag >= FILTER_SNAP_BAND) {
+            state = x;
+        } else {
+            int shift = (mag < FILTER_NOISE_BAND) ? 3 : (mag < FILTER_TRACK_BAND) ? 2 : 1;
+            // Symmetric rounding so rising and falling inputs settle alike
+            int32_t half = 1 << (shift - 1);
+            state += (e >= 0) ? ((e + half) >> shift) : -((-e + half) >> shift);
+        }
+        return state;
+    }
+
+    // Full pipeline on one raw block
+    int32_t process(const uint16_t* raw) {
+        return update(decimate(raw));
+    }
+
+    int32_t getFiltered() const {
+        return state;
+    }
+};
+
+#endif // VOLTAGE_FILTER_H
@@ -0,0 +1,24 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <benchmark/benchmark.h>
+#include <stdint.h>
+
+// Heap allocations seen by the replaced global operator new (AllocCounter.cpp)
+uint64_t allocCount();
+
+// Counts the allocations between construction and report() and adds them to the case
+// as allocs/op. Construct it right before the timed loop.
+class AllocScope {
+private:
+    uint64_t start;
+
+public:
+    AllocScope() : start(allocCount()) {}
+
+    void report(benchmark::State& state) const {
+        state.counters["allocs/op"] = benchmark::Counter((double)(allocCount() - start), benchmark::Counter::kAvgIterations);
+    }
+};
+
+#endif // ALLOC_COUNTER_H
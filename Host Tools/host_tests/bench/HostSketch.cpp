@@ -0,0 +1,70 @@
+// The Web GUI sketch compiled as one host translation unit, plus the entry points
+// bench_sketch.cpp calls. The two cannot share a translation unit: the sketch's global
+// `benchmark` (Benchmark.h) hides Google Benchmark's namespace.
+
+#include <Arduino.h>
+#include "Smart_Multipurpose_Battery_Tester_Modified_WebGUI.ino"
+
+// Boot the sketch once, with the battery channel reading a 3.7V cell
+void sketchBegin() {
+    host::setAnalogRead([](uint8_t pin) { return (pin == BAT_Pin) ? 1530 : 1560; });
+    setup();
+    ws.setClientCount(1);
+}
+
+// Scratch logger with a full hour of samples
+DataLogger* sketchFilledLogger() {
+    DataLogger* logger = new DataLogger();
+    uint32_t t = 0;
+    while (logger->getCount() < MAX_DATA_POINTS) {
+        t += DATA_SAMPLE_INTERVAL;
+        logger->addDataPointAt(t, 3.7f, 500, t / 7200.0f);
+    }
+    return logger;
+}
+
+void sketchFreeLogger(DataLogger* logger) {
+    delete logger;
+}
+
+size_t sketchStatusJson() {
+    String output;
+    buildStatusJson(output);
+    return output.length();
+}
+
+size_t sketchDataPointJson(const DataLogger* logger) {
+    String output;
+    buildDataPointJson(*logger, output);
+    return output.length();
+}
+
+size_t sketchHistoryJson(const DataLogger* logger) {
+    String output;
+    buildHistoryJson(*logger, output);
+    return output.length();
+}
+
+size_t sketchHistoryChunkJson(const DataLogger* logger) {
+    String output;
+    buildHistoryChunkJson(*logger, logger->getFirstSeq(), output);
+    return output.length();
+}
+
+float sketchMeasureVoltage() {
+    return measureBatteryVoltage();
+}
+
+// Discharge at 500 mA to 3.0V, started through the web command; the 3.7V cell never reaches it
+bool sketchStartDischarge() {
+    StaticJsonDocument<128> doc;
+    deserializeJson(doc, "{\"cmd\":\"start_discharge\",\"cutoff\":3.0,\"current\":500}");
+    processCommand(doc, nullptr);
+    return currentState == STATE_DISCHARGING;
+}
+
+// One engine tick of the running operation: measurement, capacity, logging, termination check
+float sketchTickOperation() {
+    tickOperation();
+    return BAT_Voltage;
+}
@@ -0,0 +1,262 @@
+// Host microbenchmarks of the firmware's per-tick hot paths (Google Benchmark).
+//
+// Each case reports ns/op (Time), allocs/op (heap allocations made inside the timed
+// loop) and, where the path produces output, bytes/op. The numbers are x86 numbers:
+// compare a change against the checked-in baseline from the same machine class, and use
+// the on-device runner (Benchmark.h, the "benchmark" command) for ESP32-C3 cycles.
+//
+// The sketch-level JSON builders are in bench_sketch.cpp (needs ArduinoJson).
+
+#include <Arduino.h>
+#include <benchmark/benchmark.h>
+
+#include "AllocCounter.h"
+#include "VoltageFilter.h"
+#include "DataLogger.h"
+#include "IcaAnalyzer.h"
+#include "ChargeEstimator.h"
+#include "ThermalModel.h"
+#include "StorageController.h"
+#include "SelfDischargeTest.h"
+#include "DischargePlan.h"
+#include "AlarmRules.h"
+
+static const int LOAD_TABLE[] = {0, 50, 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000, 1500, 2000};
+static const uint8_t LOAD_COUNT = sizeof(LOAD_TABLE) / sizeof(LOAD_TABLE[0]);
+
+// Raw ADC block with ripple and one spike per block, as in runBenchmarks()
+static void fillRawBlock(uint16_t* raw) {
+    for (int i = 0; i < FILTER_RAW_SAMPLES; i++) {
+        raw[i] = 1400 + (i * 7) % 23;
+    }
+    raw[5] = 4095;
+}
+
+static void BM_FilterProcess(benchmark::State& state) {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    fillRawBlock(raw);
+    VoltageFilter filter;
+    AllocScope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(filter.process(raw));
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_FilterProcess);
+
+// One logged second per op into a full ring
+static void BM_LoggerAdd(benchmark::State& state) {
+    static DataLogger logger;
+    uint32_t t = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        t += DATA_SAMPLE_INTERVAL;
+        benchmark::DoNotOptimize(logger.addDataPointAt(t, 3.7f, 500, t / 7200.0f));
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_LoggerAdd);
+
+// Cursor reads as a history_chunk frame does them
+static void BM_LoggerGetBySeq(benchmark::State& state) {
+    static DataLogger logger;
+    uint32_t t = 0;
+    while (logger.getCount() < MAX_DATA_POINTS) {
+        t += DATA_SAMPLE_INTERVAL;
+        logger.addDataPointAt(t, 3.7f, 500, t / 7200.0f);
+    }
+    uint32_t seq = logger.getFirstSeq();
+    DataPoint point;
+    AllocScope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(logger.getBySeq(seq, point));
+        if (++seq == logger.getNextSeq()) seq = logger.getFirstSeq();
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_LoggerGetBySeq);
+
+// Overview pass: every stored point, oldest first
+static void BM_LoggerScan(benchmark::State& state) {
+    static DataLogger logger;
+    uint32_t t = 0;
+    while (logger.getCount() < MAX_DATA_POINTS) {
+        t += DATA_SAMPLE_INTERVAL;
+        logger.addDataPointAt(t, 3.7f, 500, t / 7200.0f);
+    }
+    DataPoint point;
+    AllocScope allocs;
+    for (auto _ : state) {
+        float sum = 0;
+        for (uint16_t i = 0; i < logger.getCount(); i++) {
+            logger.getDataPoint(i, point);
+            sum += point.voltage;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_LoggerScan)->Unit(benchmark::kMicrosecond);
+
+// Capacity integration of one 50 ms discharge tick (tickOperation's float math)
+static void BM_CapacityIntegrate(benchmark::State& state) {
+    float capacity = 0;
+    uint32_t last = 0;
+    uint32_t now = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        now += 50;
+        float hours = (now - last) / 3600000.0f;
+        last = now;
+        capacity += (LOAD_TABLE[6] + 25) * hours;
+        benchmark::DoNotOptimize(capacity);
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_CapacityIntegrate);
+
+// dQ/dV: 1 mAh per sample down a 4.2V-2.6V ramp, restarted at the bottom
+static void BM_IcaSample(benchmark::State& state) {
+    IcaAnalyzer ica;
+    ica.begin();
+    float mah = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        mah += 1.0f;
+        float volts = 4.2f - mah * 0.0005f;
+        if (volts < 2.6f) {
+            ica.begin();
+            mah = 0;
+        }
+        ica.addSample(volts, mah);
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_IcaSample);
+
+// Charge model in CC with probes enabled, one 50 ms sample per op
+static void BM_ChargeEstimatorUpdate(benchmark::State& state) {
+    ChargeEstimator estimator;
+    estimator.begin(0, 1000, 4180, true, true);
+    uint32_t now = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        now += 50;
+        float mv = 3700.0f + (now % 3600000) / 10000.0f;
+        estimator.update(now, mv);
+        benchmark::DoNotOptimize(estimator.getCurrentMA());
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_ChargeEstimatorUpdate);
+
+static void BM_ThermalUpdate(benchmark::State& state) {
+    ThermalModel model;
+    model.begin(LOAD_TABLE, LOAD_COUNT);
+    uint32_t now = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        now += THERMAL_TICK_MS;
+        model.update(now, 3.7f, 2000);
+        benchmark::DoNotOptimize(model.limitIndex(13));
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_ThermalUpdate);
+
+static void BM_StorageUpdate(benchmark::State& state) {
+    StorageController controller;
+    controller.begin(LOAD_TABLE, LOAD_COUNT, 1000);
+    controller.start(0, 50, OCV_TABLE_LIION_DEFAULT);
+    uint32_t now = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        now += 50;
+        controller.update(now, 4.0f);
+        benchmark::DoNotOptimize(controller.getLoadIndex());
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_StorageUpdate);
+
+static void BM_SelfDischargeReading(benchmark::State& state) {
+    SelfDischargeTest test;
+    uint32_t now = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        if (!test.isMonitoring() || test.getCount() >= SD_MAX_SAMPLES) {
+            state.PauseTiming();
+            test.start(10, 72, 5.0f, false);
+            test.startMonitor(now);
+            state.ResumeTiming();
+        }
+        now += 600000;
+        benchmark::DoNotOptimize(test.addReading(now, 4.15f - now / 86400000.0f * 0.002f));
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_SelfDischargeReading);
+
+static void BM_DischargePlanSample(benchmark::State& state) {
+    DischargePlan plan;
+    const DischargeStage stage = {6, 3000, 0};
+    plan.begin(&stage, 1, false);
+    plan.startStage(0, 0, 500);
+    float mah = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        mah += 0.007f;
+        if (mah > 3000) {
+            plan.startStage(0, 0, 500);
+            mah = 0;
+        }
+        plan.addSample(4.1f - mah * 0.0003f, mah);
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_DischargePlanSample);
+
+// Full rule table (every metric, both scopes) on one-hour discharge phases sampled every
+// 100 ms; no rule fires, so every sample compares all MAX_ALARM_RULES rules
+static void BM_AlarmEvaluate(benchmark::State& state) {
+    AlarmRuleEngine engine;
+    engine.addRule(RULE_METRIC_VOLTAGE, RULE_OP_BELOW, 2500, RULE_ACTION_NEXT, RULE_SCOPE_DISCHARGE, 3);
+    engine.addRule(RULE_METRIC_VOLTAGE, RULE_OP_ABOVE, 4250, RULE_ACTION_ABORT, RULE_SCOPE_CHARGE, 1);
+    engine.addRule(RULE_METRIC_DVDT, RULE_OP_BELOW, -500, RULE_ACTION_ALARM, RULE_SCOPE_ANY, 2);
+    engine.addRule(RULE_METRIC_D2VDT2, RULE_OP_BELOW, -1000, RULE_ACTION_MARK, RULE_SCOPE_DISCHARGE, 1);
+    engine.addRule(RULE_METRIC_ELAPSED, RULE_OP_ABOVE, 18000, RULE_ACTION_ABORT, RULE_SCOPE_ANY, 1);
+    engine.addRule(RULE_METRIC_CAPACITY, RULE_OP_ABOVE, 5000, RULE_ACTION_NEXT, RULE_SCOPE_DISCHARGE, 1);
+    engine.addRule(RULE_METRIC_SAG, RULE_OP_ABOVE, 200, RULE_ACTION_ALARM, RULE_SCOPE_DISCHARGE, 1);
+    engine.addRule(RULE_METRIC_SAG, RULE_OP_ABOVE, 100, RULE_ACTION_MARK, RULE_SCOPE_CHARGE, 1);
+    if (engine.getRuleCount() != MAX_ALARM_RULES) {
+        state.SkipWithError("rule table not full");
+        return;
+    }
+
+    RuleSample sample;
+    sample.timeMs = 0;
+    sample.scope = RULE_SCOPE_DISCHARGE;
+    uint32_t phaseMs = 0;
+    uint8_t fired = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        if (phaseMs >= 3600000) {
+            state.PauseTiming();
+            engine.resetRun();
+            phaseMs = 0;
+            state.ResumeTiming();
+        }
+        phaseMs += 100;
+        sample.timeMs += 100;
+        sample.voltageMV = 4100 - (int32_t)(phaseMs / 4000);
+        sample.capacityMAh = (int32_t)(phaseMs / 7200);
+        fired |= engine.evaluate(sample);
+    }
+    if (fired) {
+        state.SkipWithError("a rule fired; thresholds no longer match the samples");
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_AlarmEvaluate);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,94 @@
+// Host microbenchmarks of the sketch-level paths: the JSON frames sent to web clients,
+// the battery voltage reading (ADC block + filter + calibration) and one tick of the
+// operation engine driven by a STATE_TABLE row. The sketch is
+// compiled in HostSketch.cpp; bytes/op is the length of the JSON text produced.
+
+#include <benchmark/benchmark.h>
+#include <stddef.h>
+
+#include "AllocCounter.h"
+
+class DataLogger;
+
+void sketchBegin();
+DataLogger* sketchFilledLogger();
+void sketchFreeLogger(DataLogger* logger);
+size_t sketchStatusJson();
+size_t sketchDataPointJson(const DataLogger* logger);
+size_t sketchHistoryJson(const DataLogger* logger);
+size_t sketchHistoryChunkJson(const DataLogger* logger);
+float sketchMeasureVoltage();
+bool sketchStartDischarge();
+float sketchTickOperation();
+
+// JSON case: bytes/op from the builder's output length
+template <class Build>
+static void runJsonCase(benchmark::State& state, Build build) {
+    size_t bytes = 0;
+    AllocScope allocs;
+    for (auto _ : state) {
+        bytes = build();
+        benchmark::DoNotOptimize(bytes);
+    }
+    allocs.report(state);
+    state.counters["bytes/op"] = (double)bytes;
+}
+
+static void BM_JsonStatus(benchmark::State& state) {
+    runJsonCase(state, []() { return sketchStatusJson(); });
+}
+BENCHMARK(BM_JsonStatus);
+
+static void BM_JsonPoint(benchmark::State& state) {
+    DataLogger* logger = sketchFilledLogger();
+    runJsonCase(state, [logger]() { return sketchDataPointJson(logger); });
+    sketchFreeLogger(logger);
+}
+BENCHMARK(BM_JsonPoint);
+
+static void BM_JsonOverview(benchmark::State& state) {
+    DataLogger* logger = sketchFilledLogger();
+    runJsonCase(state, [logger]() { return sketchHistoryJson(logger); });
+    sketchFreeLogger(logger);
+}
+BENCHMARK(BM_JsonOverview)->Unit(benchmark::kMicrosecond);
+
+static void BM_JsonChunk(benchmark::State& state) {
+    DataLogger* logger = sketchFilledLogger();
+    runJsonCase(state, [logger]() { return sketchHistoryChunkJson(logger); });
+    sketchFreeLogger(logger);
+}
+BENCHMARK(BM_JsonChunk)->Unit(benchmark::kMicrosecond);
+
+// CPU cost only: the ADC waits run on the simulated clock
+static void BM_MeasureVoltage(benchmark::State& state) {
+    AllocScope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sketchMeasureVoltage());
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_MeasureVoltage);
+
+// tickOperation() in a discharge: the measurement above plus capacity, logging and cutoff check
+static void BM_TickOperation(benchmark::State& state) {
+    if (!sketchStartDischarge()) {
+        state.SkipWithError("start_discharge was rejected");
+        return;
+    }
+    AllocScope allocs;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sketchTickOperation());
+    }
+    allocs.report(state);
+}
+BENCHMARK(BM_TickOperation);
+
+int main(int argc, char** argv) {
+    sketchBegin();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""Compare a Google Benchmark JSON run against a baseline file.
+
+Usage: compare_bench.py baseline.json new.json [--fail-above PCT]
+
+Uses the median aggregate of each case when the run has repetitions, otherwise the
+single result. Prints ns/op for both, the change, and the allocs/op and bytes/op
+counters of the new run. With --fail-above the exit status is 1 when any case got
+slower by more than PCT percent.
+"""
+
+import argparse
+import json
+import sys
+
+UNIT_NS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path):
+    with open(path) as f:
+        runs = json.load(f)["benchmarks"]
+    cases = {}
+    for run in runs:
+        if run.get("run_type") == "aggregate" and run.get("aggregate_name") != "median":
+            continue
+        name = run.get("run_name", run["name"])
+        if run.get("run_type") == "aggregate" or name not in cases:
+            cases[name] = run
+    return cases
+
+
+def ns_per_op(run):
+    return run["real_time"] * UNIT_NS[run.get("time_unit", "ns")]
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("baseline")
+    parser.add_argument("new")
+    parser.add_argument("--fail-above", type=float, default=None)
+    args = parser.parse_args()
+
+    base = load(args.baseline)
+    new = load(args.new)
+    worst = 0.0
+    print(f"{'case':28} {'base ns':>11} {'new ns':>11} {'change':>8} {'allocs/op':>10} {'bytes/op':>9}")
+    for name, run in new.items():
+        ns = ns_per_op(run)
+        allocs = run.get("allocs/op", 0)
+        nbytes = run.get("bytes/op", 0)
+        if name in base:
+            base_ns = ns_per_op(base[name])
+            change = (ns / base_ns - 1) * 100 if base_ns > 0 else 0.0
+            worst = max(worst, change)
+            print(f"{name:28} {base_ns:11.1f} {ns:11.1f} {change:+7.1f}% {allocs:10.1f} {nbytes:9.0f}")
+        else:
+            print(f"{name:28} {'-':>11} {ns:11.1f} {'new':>8} {allocs:10.1f} {nbytes:9.0f}")
+
+    if args.fail_above is not None and worst > args.fail_above:
+        print(f"slowest change {worst:+.1f}% is above {args.fail_above}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
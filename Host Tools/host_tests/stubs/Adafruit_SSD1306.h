@@ -0,0 +1,39 @@
+#ifndef HOST_ADAFRUIT_SSD1306_H
+#define HOST_ADAFRUIT_SSD1306_H
+
+#include <Arduino.h>
+#include "Wire.h"
+
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define BLACK SSD1306_BLACK
+#define WHITE SSD1306_WHITE
+#define SSD1306_SWITCHCAPVCC 2
+
+// Draws nothing; counts frames so tests can see the screen was refreshed
+class Adafruit_SSD1306 : public Print {
+private:
+    uint32_t frames;
+
+public:
+    Adafruit_SSD1306(int, int, TwoWire*, int) : frames(0) {}
+
+    bool begin(int, int) { return true; }
+    void clearDisplay() {}
+    void display() { frames++; }
+    void setTextColor(int) {}
+    void setTextSize(int) {}
+    void setCursor(int, int) {}
+    void drawPixel(int, int, int) {}
+    void drawLine(int, int, int, int, int) {}
+    void drawFastHLine(int, int, int, int) {}
+    void drawFastVLine(int, int, int, int) {}
+    void drawRect(int, int, int, int, int) {}
+    void fillRect(int, int, int, int, int) {}
+    size_t write(uint8_t) override { return 1; }
+    using Print::write;
+
+    uint32_t getFrames() const { return frames; }
+};
+
+#endif // HOST_ADAFRUIT_SSD1306_H
@@ -0,0 +1,266 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// ========================================= HOST ARDUINO STUBS ========================================
+// Just enough of the Arduino-ESP32 core to compile the firmware headers on Linux.
+//
+//   clock     millis()/micros() read a simulated clock; delay(), delayMicroseconds() and
+//             host::advanceMicros() move it (and fire due esp_timer callbacks)
+//   pins      digitalWrite()/analogWrite()/ledcWrite() levels are kept per pin for the tests to read;
+//             analogRead() asks host::setAnalogRead()'s function (0 when none is set)
+//   Serial    output is counted and dropped; availableForWrite() always has room
+//   ESP       getCycleCount() is 0 - host timings come from Google Benchmark
+//
+// Everything a test drives lives in namespace host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define DEC 10
+#define HEX 16
+#define RISING 1
+#define FALLING 2
+#define CHANGE 3
+
+// XIAO ESP32-C3 pin names (GPIO numbers)
+#define A0 2
+#define A1 3
+#define A2 4
+#define D2 4
+#define D3 5
+#define D6 21
+#define D7 20
+#define D8 8
+#define D9 9
+
+#define HOST_PIN_COUNT 32
+
+namespace host {
+    typedef std::function<int(uint8_t pin)> AnalogReadFn;
+
+    uint64_t getMicros();
+    void setMicros(uint64_t us);
+    void advanceMicros(uint64_t us);   // Also runs esp_timer callbacks that fall due
+    void setAnalogRead(AnalogReadFn fn);
+    int getPinLevel(uint8_t pin);
+    int getPwmDuty(uint8_t pin);       // analogWrite() or ledcWrite() duty
+    uint32_t getLedcFrequency(uint8_t pin);
+    size_t getSerialBytes();
+    void reset();                      // Clock to 0, pins low, no analog source, timers cleared
+}
+
+template <class T, class L, class H>
+auto constrain(T x, L low, H high) -> decltype(x + low + high) {
+    return x < low ? low : (x > high ? high : x);
+}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// ---- String ----
+class String {
+private:
+    std::string s;
+
+public:
+    String() {}
+    String(const char* c) : s(c ? c : "") {}
+    String(const std::string& x) : s(x) {}
+    String(char c) : s(1, c) {}
+    String(int v) : s(std::to_string(v)) {}
+    String(unsigned v) : s(std::to_string(v)) {}
+    String(long v) : s(std::to_string(v)) {}
+    String(unsigned long v) : s(std::to_string(v)) {}
+    String(double v, int decimals = 2) {
+        char b[32];
+        snprintf(b, sizeof(b), "%.*f", decimals, v);
+        s = b;
+    }
+
+    size_t length() const { return s.size(); }
+    const char* c_str() const { return s.c_str(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(size_t n) { s.reserve(n); return true; }
+    bool concat(const char* c) { s += c; return true; }
+    bool concat(const char* c, size_t n) { s.append(c, n); return true; }
+    bool concat(char c) { s += c; return true; }
+    int toInt() const { return atoi(s.c_str()); }
+    float toFloat() const { return (float)atof(s.c_str()); }
+    String substring(size_t from) const { return String(s.substr(from)); }
+    String substring(size_t from, size_t to) const { return String(s.substr(from, to - from)); }
+    char operator[](size_t i) const { return s[i]; }
+
+    String& operator+=(const String& o) { s += o.s; return *this; }
+    String& operator+=(const char* o) { s += o; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    String operator+(const String& o) const { return String(s + o.s); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+    bool operator==(const String& o) const { return s == o.s; }
+    bool operator!=(const String& o) const { return s != o.s; }
+};
+
+// Type of `a + b` on Arduino Strings; ArduinoJson adapts it like String
+class StringSumHelper : public String {
+public:
+    using String::String;
+};
+
+class IPAddress {
+private:
+    uint8_t b[4];
+
+public:
+    IPAddress() : b{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t c, uint8_t d, uint8_t e) : b{a, c, d, e} {}
+    bool operator==(const IPAddress& o) const { return memcmp(b, o.b, 4) == 0; }
+    bool operator!=(const IPAddress& o) const { return !(*this == o); }
+    String toString() const {
+        char t[16];
+        snprintf(t, sizeof(t), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+        return String(t);
+    }
+};
+
+// ---- Print / Stream / Serial ----
+class Print {
+private:
+    size_t printFormatted(const char* format, ...) {
+        char b[64];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(b, sizeof(b), format, args);
+        va_end(args);
+        return write((const uint8_t*)b, n < (int)sizeof(b) ? n : sizeof(b) - 1);
+    }
+
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        for (size_t i = 0; i < size; i++) write(buffer[i]);
+        return size;
+    }
+    size_t write(const char* text) { return write((const uint8_t*)text, strlen(text)); }
+    virtual int availableForWrite() { return 0; }
+
+    size_t print(const char* text) { return write(text); }
+    size_t print(const String& text) { return write(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v, int base = DEC) { return printFormatted(base == HEX ? "%x" : "%d", v); }
+    size_t print(unsigned v, int base = DEC) { return printFormatted(base == HEX ? "%x" : "%u", v); }
+    size_t print(long v, int base = DEC) { return printFormatted(base == HEX ? "%lx" : "%ld", v); }
+    size_t print(unsigned long v, int base = DEC) { return printFormatted(base == HEX ? "%lx" : "%lu", v); }
+    size_t print(double v, int decimals = 2) { return printFormatted("%.*f", decimals, v); }
+    size_t print(const IPAddress& ip) { return print(ip.toString()); }
+
+    size_t println() { return write("\r\n"); }
+    template <class T>
+    size_t println(const T& v) { return print(v) + println(); }
+    template <class T>
+    size_t println(const T& v, int format) { return print(v, format) + println(); }
+
+    size_t printf(const char* format, ...) {
+        char b[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(b, sizeof(b), format, args);
+        va_end(args);
+        return write((const uint8_t*)b, n < (int)sizeof(b) ? n : sizeof(b) - 1);
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    size_t readBytes(uint8_t* buffer, size_t length) {
+        size_t n = 0;
+        while (n < length && available() > 0) buffer[n++] = (uint8_t)read();
+        return n;
+    }
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    void flush() {}
+    void setTxBufferSize(size_t) {}
+    void setRxBufferSize(size_t) {}
+    operator bool() const { return true; }
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+    int availableForWrite() override { return 4096; }
+};
+
+extern HardwareSerial Serial;
+
+// ---- Pins, ADC, LEDC ----
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int duty);
+int analogRead(uint8_t pin);
+inline uint32_t analogReadMilliVolts(uint8_t pin) { return (uint32_t)analogRead(pin) * 3300 / 4095; }
+inline void analogReadResolution(int) {}
+inline void analogWriteFrequency(uint32_t) {}
+inline void analogWriteResolution(int) {}
+inline int8_t digitalPinToAnalogChannel(uint8_t pin) { return (pin == A0 || pin == A1 || pin == A2) ? pin : -1; }
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void detachInterrupt(uint8_t) {}
+
+inline bool ledcAttach(uint8_t, uint32_t, uint8_t) { return true; }
+uint32_t ledcChangeFrequency(uint8_t pin, uint32_t frequency, uint8_t resolution);
+bool ledcWrite(uint8_t pin, uint32_t duty);
+inline uint32_t ledcWriteTone(uint8_t, uint32_t frequency) { return frequency; }
+
+// ---- Time ----
+inline unsigned long millis() { return (unsigned long)(host::getMicros() / 1000); }
+inline unsigned long micros() { return (unsigned long)(uint32_t)host::getMicros(); }
+inline void delay(uint32_t ms) { host::advanceMicros((uint64_t)ms * 1000); }
+inline void delayMicroseconds(uint32_t us) { host::advanceMicros(us); }
+inline void yield() {}
+
+// ---- Chip ----
+uint32_t getCpuFrequencyMhz();
+bool setCpuFrequencyMhz(uint32_t mhz);
+
+struct EspClass {
+    uint32_t getFreeHeap() { return 200000; }
+    uint32_t getMinFreeHeap() { return 200000; }
+    uint32_t getCycleCount() { return 0; }
+    void restart() {}
+};
+
+extern EspClass ESP;
+
+// No second core to race against on the host
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+
+uint32_t esp_random();
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,76 @@
+#ifndef HOST_ESP_ASYNC_WEB_SERVER_H
+#define HOST_ESP_ASYNC_WEB_SERVER_H
+
+#include <Arduino.h>
+#include <functional>
+
+// WebSocket with a settable client count; sent text is counted, not delivered
+
+typedef enum { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA } AwsEventType;
+typedef enum { HTTP_GET = 1, HTTP_POST = 2 } WebRequestMethod;
+
+#define WS_TEXT 1
+#define WS_BINARY 2
+
+typedef struct {
+    uint8_t message_opcode;
+    uint32_t num;
+    uint8_t final;
+    uint8_t masked;
+    uint8_t opcode;
+    uint64_t len;
+    uint8_t mask[4];
+    uint64_t index;
+} AwsFrameInfo;
+
+class AsyncWebServerRequest {
+public:
+    void send(int, const char*, const String&) {}
+    void send_P(int, const char*, const char*) {}
+};
+
+class AsyncWebSocketClient {
+public:
+    uint32_t id() { return 1; }
+    void keepAlivePeriod(uint16_t) {}
+    bool ping(const uint8_t* = nullptr, size_t = 0) { return true; }
+    bool canSend() { return true; }
+    bool queueIsFull() { return false; }
+    void text(const String&) {}
+    void text(const char*, size_t) {}
+    void binary(const uint8_t*, size_t) {}
+};
+
+class AsyncWebSocket;
+typedef std::function<void(AsyncWebSocket*, AsyncWebSocketClient*, AwsEventType, void*, uint8_t*, size_t)> AwsEventHandler;
+
+class AsyncWebSocket {
+private:
+    size_t clients;
+    size_t sentBytes;
+
+public:
+    explicit AsyncWebSocket(const char*) : clients(0), sentBytes(0) {}
+
+    void onEvent(AwsEventHandler) {}
+    void cleanupClients() {}
+    AsyncWebSocketClient* client(uint32_t) { return nullptr; }
+    bool availableForWriteAll() { return true; }
+    size_t count() { return clients; }
+    void textAll(const String& text) { sentBytes += text.length(); }
+    void textAll(const char*, size_t length) { sentBytes += length; }
+    void binaryAll(const uint8_t*, size_t length) { sentBytes += length; }
+
+    void setClientCount(size_t n) { clients = n; }
+    size_t getSentBytes() const { return sentBytes; }
+};
+
+class AsyncWebServer {
+public:
+    explicit AsyncWebServer(int) {}
+    void addHandler(AsyncWebSocket*) {}
+    void on(const char*, int, std::function<void(AsyncWebServerRequest*)>) {}
+    void begin() {}
+};
+
+#endif // HOST_ESP_ASYNC_WEB_SERVER_H
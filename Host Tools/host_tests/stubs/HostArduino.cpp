@@ -0,0 +1,179 @@
+// Host implementations of the stubbed Arduino-ESP32 calls (see Arduino.h)
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include <vector>
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool armed;
+    uint64_t due;
+    uint64_t period;  // 0 = one-shot
+};
+
+namespace {
+    uint64_t clockUs = 0;
+    host::AnalogReadFn analogSource;
+    int pinLevel[HOST_PIN_COUNT];
+    int pwmDuty[HOST_PIN_COUNT];
+    uint32_t ledcFrequency[HOST_PIN_COUNT];
+    size_t serialBytes = 0;
+    uint32_t cpuMhz = 160;
+    uint32_t randomState = 1;
+    std::vector<esp_timer*> timers;
+
+    // Earliest armed timer due at or before `until`, nullptr if none
+    esp_timer* nextDue(uint64_t until) {
+        esp_timer* next = nullptr;
+        for (esp_timer* t : timers) {
+            if (t->armed && t->due <= until && (next == nullptr || t->due < next->due)) next = t;
+        }
+        return next;
+    }
+}
+
+HardwareSerial Serial;
+EspClass ESP;
+
+namespace host {
+    uint64_t getMicros() {
+        return clockUs;
+    }
+
+    void setMicros(uint64_t us) {
+        clockUs = us;
+    }
+
+    void advanceMicros(uint64_t us) {
+        uint64_t until = clockUs + us;
+        while (esp_timer* t = nextDue(until)) {
+            clockUs = t->due;
+            if (t->period > 0) {
+                t->due += t->period;
+            } else {
+                t->armed = false;
+            }
+            t->callback(t->arg);
+        }
+        clockUs = until;
+    }
+
+    void setAnalogRead(AnalogReadFn fn) {
+        analogSource = fn;
+    }
+
+    int getPinLevel(uint8_t pin) {
+        return pinLevel[pin];
+    }
+
+    int getPwmDuty(uint8_t pin) {
+        return pwmDuty[pin];
+    }
+
+    uint32_t getLedcFrequency(uint8_t pin) {
+        return ledcFrequency[pin];
+    }
+
+    size_t getSerialBytes() {
+        return serialBytes;
+    }
+
+    void reset() {
+        clockUs = 0;
+        analogSource = nullptr;
+        memset(pinLevel, 0, sizeof(pinLevel));
+        memset(pwmDuty, 0, sizeof(pwmDuty));
+        memset(ledcFrequency, 0, sizeof(ledcFrequency));
+        serialBytes = 0;
+        for (esp_timer* t : timers) t->armed = false;
+    }
+}
+
+size_t HardwareSerial::write(uint8_t) {
+    serialBytes++;
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t*, size_t size) {
+    serialBytes += size;
+    return size;
+}
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    pinLevel[pin] = level;
+}
+
+int digitalRead(uint8_t pin) {
+    return pinLevel[pin];
+}
+
+void analogWrite(uint8_t pin, int duty) {
+    pwmDuty[pin] = duty;
+}
+
+uint32_t ledcChangeFrequency(uint8_t pin, uint32_t frequency, uint8_t) {
+    ledcFrequency[pin] = frequency;
+    return frequency;
+}
+
+bool ledcWrite(uint8_t pin, uint32_t duty) {
+    pwmDuty[pin] = (int)duty;
+    return true;
+}
+
+int analogRead(uint8_t pin) {
+    return analogSource ? analogSource(pin) : 0;
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return cpuMhz;
+}
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+    cpuMhz = mhz;
+    return true;
+}
+
+uint32_t esp_random() {
+    randomState = randomState * 1103515245u + 12345u;
+    return randomState;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* handle) {
+    esp_timer* t = new esp_timer{args->callback, args->arg, false, 0, 0};
+    timers.push_back(t);
+    *handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+    timer->armed = true;
+    timer->due = clockUs + timeoutUs;
+    timer->period = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+    timer->armed = true;
+    timer->due = clockUs + periodUs;
+    timer->period = periodUs;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    timers.erase(std::remove(timers.begin(), timers.end(), timer), timers.end());
+    delete timer;
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)clockUs;
+}
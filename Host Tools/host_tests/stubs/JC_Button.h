@@ -0,0 +1,45 @@
+#ifndef HOST_JC_BUTTON_H
+#define HOST_JC_BUTTON_H
+
+#include <Arduino.h>
+
+// Buttons are pressed by the test: host::releaseButton(pin) makes the next read() of
+// that pin's Button report one wasReleased()
+
+namespace host {
+    inline bool pendingRelease[HOST_PIN_COUNT];
+
+    inline void releaseButton(uint8_t pin) {
+        pendingRelease[pin] = true;
+    }
+}
+
+class Button {
+private:
+    uint8_t pin;
+    bool released;
+
+public:
+    Button(uint8_t buttonPin, uint32_t = 25, uint8_t = true, uint8_t = true) : pin(buttonPin), released(false) {}
+
+    void begin() {}
+
+    bool read() {
+        released = host::pendingRelease[pin];
+        host::pendingRelease[pin] = false;
+        return false;
+    }
+
+    bool isPressed() { return false; }
+    bool isReleased() { return true; }
+    bool wasPressed() { return false; }
+    bool pressedFor(uint32_t) { return false; }
+
+    bool wasReleased() {
+        bool r = released;
+        released = false;
+        return r;
+    }
+};
+
+#endif // HOST_JC_BUTTON_H
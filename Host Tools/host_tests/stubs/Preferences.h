@@ -0,0 +1,93 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// NVS in memory: every Preferences object sees the same store, keyed "namespace/key",
+// so a value written through one instance is read back through another (host::clearNvs()
+// empties it)
+
+namespace host {
+    inline std::map<std::string, std::vector<uint8_t>> nvs;
+
+    inline void clearNvs() {
+        nvs.clear();
+    }
+}
+
+class Preferences {
+private:
+    std::string space;
+
+    std::string keyOf(const char* key) const {
+        return space + "/" + key;
+    }
+
+    size_t put(const char* key, const void* value, size_t length) {
+        const uint8_t* bytes = (const uint8_t*)value;
+        host::nvs[keyOf(key)].assign(bytes, bytes + length);
+        return length;
+    }
+
+    template <class T>
+    T get(const char* key, T defaultValue) const {
+        auto it = host::nvs.find(keyOf(key));
+        if (it == host::nvs.end() || it->second.size() != sizeof(T)) return defaultValue;
+        T value;
+        memcpy(&value, it->second.data(), sizeof(T));
+        return value;
+    }
+
+public:
+    bool begin(const char* name, bool = false) {
+        space = name;
+        return true;
+    }
+
+    void end() {}
+
+    bool clear() {
+        std::string prefix = space + "/";
+        for (auto it = host::nvs.begin(); it != host::nvs.end();) {
+            it = (it->first.compare(0, prefix.size(), prefix) == 0) ? host::nvs.erase(it) : std::next(it);
+        }
+        return true;
+    }
+
+    bool remove(const char* key) { return host::nvs.erase(keyOf(key)) > 0; }
+    bool isKey(const char* key) const { return host::nvs.count(keyOf(key)) > 0; }
+
+    size_t putBytes(const char* key, const void* value, size_t length) { return put(key, value, length); }
+    size_t getBytesLength(const char* key) const {
+        auto it = host::nvs.find(keyOf(key));
+        return (it == host::nvs.end()) ? 0 : it->second.size();
+    }
+    size_t getBytes(const char* key, void* buffer, size_t maxLength) const {
+        auto it = host::nvs.find(keyOf(key));
+        if (it == host::nvs.end() || it->second.size() > maxLength) return 0;
+        memcpy(buffer, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    size_t putString(const char* key, const String& value) { return put(key, value.c_str(), value.length() + 1); }
+    String getString(const char* key, const String& defaultValue = String()) const {
+        auto it = host::nvs.find(keyOf(key));
+        return (it == host::nvs.end()) ? defaultValue : String((const char*)it->second.data());
+    }
+
+    size_t putFloat(const char* key, float value) { return put(key, &value, sizeof(value)); }
+    float getFloat(const char* key, float defaultValue = 0) const { return get(key, defaultValue); }
+    size_t putInt(const char* key, int32_t value) { return put(key, &value, sizeof(value)); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) const { return get(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) const { return get(key, defaultValue); }
+    size_t putUChar(const char* key, uint8_t value) { return put(key, &value, sizeof(value)); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) const { return get(key, defaultValue); }
+    size_t putBool(const char* key, bool value) { return putUChar(key, value ? 1 : 0); }
+    bool getBool(const char* key, bool defaultValue = false) const { return getUChar(key, defaultValue ? 1 : 0) != 0; }
+};
+
+#endif // HOST_PREFERENCES_H
@@ -0,0 +1,60 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+#include "esp_err.h"
+
+// Radio that never connects: STA stays disconnected, the AP has no stations
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+typedef enum {
+    WL_IDLE_STATUS, WL_NO_SSID_AVAIL, WL_SCAN_COMPLETED, WL_CONNECTED,
+    WL_CONNECT_FAILED, WL_CONNECTION_LOST, WL_DISCONNECTED
+} wl_status_t;
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+typedef enum {
+    ARDUINO_EVENT_WIFI_READY = 0,
+    ARDUINO_EVENT_WIFI_STA_START,
+    ARDUINO_EVENT_WIFI_STA_CONNECTED,
+    ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+    ARDUINO_EVENT_WIFI_STA_GOT_IP,
+    ARDUINO_EVENT_WIFI_STA_LOST_IP,
+    ARDUINO_EVENT_WIFI_AP_START,
+    ARDUINO_EVENT_WIFI_AP_STOP,
+    ARDUINO_EVENT_WIFI_AP_STACONNECTED,
+    ARDUINO_EVENT_WIFI_AP_STADISCONNECTED
+} arduino_event_id_t;
+typedef arduino_event_id_t WiFiEvent_t;
+typedef struct { int unused; } arduino_event_info_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+
+inline esp_err_t esp_wifi_set_ps(wifi_ps_type_t) { return ESP_OK; }
+
+class WiFiClass {
+private:
+    wifi_mode_t currentMode = WIFI_OFF;
+
+public:
+    bool mode(wifi_mode_t m) { currentMode = m; return true; }
+    wifi_mode_t getMode() { return currentMode; }
+    int begin(const char*, const char*) { return WL_DISCONNECTED; }
+    wl_status_t status() { return WL_DISCONNECTED; }
+    bool disconnect(bool = false) { return true; }
+    bool reconnect() { return true; }
+    bool setAutoReconnect(bool) { return true; }
+    IPAddress localIP() { return IPAddress(); }
+    int RSSI() { return 0; }
+    bool softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+    bool softAP(const char*, const char*, int = 1, int = 0, int = 4) { return true; }
+    bool softAPdisconnect(bool = false) { return true; }
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+    uint8_t softAPgetStationNum() { return 0; }
+    bool setSleep(bool) { return true; }
+    bool setSleep(wifi_ps_type_t) { return true; }
+    int onEvent(std::function<void(WiFiEvent_t, WiFiEventInfo_t)>, WiFiEvent_t = ARDUINO_EVENT_WIFI_READY) { return 0; }
+    int onEvent(void (*)(WiFiEvent_t), WiFiEvent_t = ARDUINO_EVENT_WIFI_READY) { return 0; }
+};
+
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,13 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+class TwoWire {
+public:
+    bool begin() { return true; }
+    bool begin(int, int) { return true; }
+    void setClock(uint32_t) {}
+};
+
+inline TwoWire Wire;
+
+#endif // HOST_WIRE_H
@@ -0,0 +1,19 @@
+#ifndef HOST_ADC_CALI_H
+#define HOST_ADC_CALI_H
+
+#include "esp_err.h"
+
+// No eFuse data on the host: scheme creation fails, so AdcCalibration falls back to Vref
+
+typedef enum { ADC_UNIT_1, ADC_UNIT_2 } adc_unit_t;
+typedef enum { ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3, ADC_CHANNEL_4 } adc_channel_t;
+typedef enum { ADC_ATTEN_DB_0, ADC_ATTEN_DB_2_5, ADC_ATTEN_DB_6, ADC_ATTEN_DB_12 } adc_atten_t;
+typedef enum { ADC_BITWIDTH_DEFAULT = 0, ADC_BITWIDTH_12 = 12 } adc_bitwidth_t;
+typedef struct adc_cali_scheme_t* adc_cali_handle_t;
+
+inline esp_err_t adc_cali_raw_to_voltage(adc_cali_handle_t, int raw, int* mv) {
+    *mv = raw * 3300 / 4095;
+    return ESP_OK;
+}
+
+#endif // HOST_ADC_CALI_H
@@ -0,0 +1,19 @@
+#ifndef HOST_ADC_CALI_SCHEME_H
+#define HOST_ADC_CALI_SCHEME_H
+
+#include "adc_cali.h"
+
+#define ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED 1
+
+typedef struct {
+    adc_unit_t unit_id;
+    adc_channel_t chan;
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+} adc_cali_curve_fitting_config_t;
+
+inline esp_err_t adc_cali_create_scheme_curve_fitting(const adc_cali_curve_fitting_config_t*, adc_cali_handle_t*) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // HOST_ADC_CALI_SCHEME_H
@@ -0,0 +1,22 @@
+#ifndef HOST_ESP_SLEEP_H
+#define HOST_ESP_SLEEP_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Light sleep returns at once with a timer wake-up; the clock does not move
+
+typedef enum {
+    ESP_SLEEP_WAKEUP_UNDEFINED = 0,
+    ESP_SLEEP_WAKEUP_TIMER = 4,
+    ESP_SLEEP_WAKEUP_GPIO = 7,
+    ESP_SLEEP_WAKEUP_UART = 8
+} esp_sleep_wakeup_cause_t;
+
+inline esp_err_t esp_sleep_enable_timer_wakeup(uint64_t) { return ESP_OK; }
+inline esp_err_t esp_sleep_enable_gpio_wakeup() { return ESP_OK; }
+inline esp_err_t esp_sleep_enable_uart_wakeup(int) { return ESP_OK; }
+inline esp_err_t esp_light_sleep_start() { return ESP_OK; }
+inline esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() { return ESP_SLEEP_WAKEUP_TIMER; }
+
+#endif // HOST_ESP_SLEEP_H
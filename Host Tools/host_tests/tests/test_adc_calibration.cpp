@@ -0,0 +1,61 @@
+// AdcCalibration user correction: reference-meter points fitted the way cal_apply does,
+// with implausible fits rejected so the web UI reports them instead of applying them
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "AdcCalibration.h"
+
+TEST(AdcCalibration, NoPointsIsRejected) {
+    AdcCalibration cal;
+    EXPECT_FALSE(cal.fit());
+    EXPECT_FLOAT_EQ(cal.getGain(), 1.0f);
+    EXPECT_FLOAT_EQ(cal.getOffset(), 0.0f);
+}
+
+TEST(AdcCalibration, SinglePointFitsGainOnly) {
+    AdcCalibration cal;
+    ASSERT_TRUE(cal.addPoint(4.000f, 4.080f));
+    ASSERT_TRUE(cal.fit());
+    EXPECT_NEAR(cal.getGain(), 1.02f, 1e-5f);
+    EXPECT_FLOAT_EQ(cal.getOffset(), 0.0f);
+    EXPECT_NEAR(cal.correct(3.0f), 3.06f, 1e-5f);
+}
+
+TEST(AdcCalibration, TwoPointsFitGainAndOffset) {
+    AdcCalibration cal;
+    // meter = 0.98 * device + 0.05
+    ASSERT_TRUE(cal.addPoint(3.000f, 2.990f));
+    ASSERT_TRUE(cal.addPoint(4.200f, 4.166f));
+    ASSERT_TRUE(cal.fit());
+    EXPECT_NEAR(cal.getGain(), 0.98f, 1e-4f);
+    EXPECT_NEAR(cal.getOffset(), 0.05f, 1e-4f);
+}
+
+TEST(AdcCalibration, OutOfRangeGainKeepsPreviousCorrection) {
+    AdcCalibration cal;
+    cal.setCorrection(1.01f, 0.02f);
+
+    // A mistyped meter reading (4.2 entered as 2.4) is far outside any real divider error
+    ASSERT_TRUE(cal.addPoint(4.200f, 2.400f));
+    EXPECT_FALSE(cal.fit());
+    EXPECT_FLOAT_EQ(cal.getGain(), 1.01f);
+    EXPECT_FLOAT_EQ(cal.getOffset(), 0.02f);
+}
+
+TEST(AdcCalibration, OutOfRangeOffsetIsRejected) {
+    AdcCalibration cal;
+    // Unit slope but a 1 V offset
+    ASSERT_TRUE(cal.addPoint(3.000f, 4.000f));
+    ASSERT_TRUE(cal.addPoint(4.000f, 5.000f));
+    EXPECT_FALSE(cal.fit());
+    EXPECT_FLOAT_EQ(cal.getGain(), 1.0f);
+    EXPECT_FLOAT_EQ(cal.getOffset(), 0.0f);
+}
+
+TEST(AdcCalibration, StoredBadCorrectionResetsToIdentity) {
+    AdcCalibration cal;
+    cal.setCorrection(1.5f, 0.0f);
+    EXPECT_FLOAT_EQ(cal.getGain(), 1.0f);
+    EXPECT_FLOAT_EQ(cal.getOffset(), 0.0f);
+}
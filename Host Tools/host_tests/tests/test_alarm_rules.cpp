@@ -0,0 +1,142 @@
+// AlarmRuleEngine: NVS record validation, rule matching per metric and scope, per-phase
+// metrics and hold counts
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "AlarmRules.h"
+
+static RuleSample sampleAt(uint32_t timeMs, int32_t mv, int32_t mah, uint8_t scope = RULE_SCOPE_DISCHARGE) {
+    RuleSample s;
+    s.timeMs = timeMs;
+    s.voltageMV = mv;
+    s.capacityMAh = mah;
+    s.scope = scope;
+    return s;
+}
+
+static AlarmRule storedRule(uint8_t metric, uint8_t op, uint8_t action, uint8_t scope, int32_t threshold) {
+    AlarmRule r;
+    memset(&r, 0, sizeof(r));
+    r.metric = metric;
+    r.op = op;
+    r.action = action;
+    r.scope = scope;
+    r.hold = 1;
+    r.threshold = threshold;
+    return r;
+}
+
+TEST(AlarmRules, LoadDropsInvalidRecords) {
+    AlarmRule stored[6] = {
+        storedRule(RULE_METRIC_VOLTAGE, RULE_OP_BELOW, RULE_ACTION_NEXT, RULE_SCOPE_DISCHARGE, 3100),
+        storedRule(RULE_METRIC_COUNT, RULE_OP_BELOW, RULE_ACTION_NEXT, RULE_SCOPE_ANY, 0),      // metric
+        storedRule(RULE_METRIC_SAG, 7, RULE_ACTION_ALARM, RULE_SCOPE_ANY, 50),                   // op
+        storedRule(RULE_METRIC_SAG, RULE_OP_ABOVE, 200, RULE_SCOPE_ANY, 50),                     // action
+        storedRule(RULE_METRIC_DVDT, RULE_OP_BELOW, RULE_ACTION_MARK, 0x04, -50),                // scope
+        storedRule(RULE_METRIC_ELAPSED, RULE_OP_ABOVE, RULE_ACTION_ABORT, 0xFF, 3600),
+    };
+    stored[5].hold = 0;
+
+    AlarmRuleEngine engine;
+    engine.load(stored, 6);
+
+    ASSERT_EQ(engine.getRuleCount(), 2);
+    EXPECT_EQ(engine.getRule(0).metric, RULE_METRIC_VOLTAGE);
+    EXPECT_EQ(engine.getRule(1).metric, RULE_METRIC_ELAPSED);
+    EXPECT_EQ(engine.getRule(1).scope, RULE_SCOPE_ANY);
+    EXPECT_EQ(engine.getRule(1).hold, 1);
+}
+
+TEST(AlarmRules, LoadCapsAtMaxRules) {
+    AlarmRule stored[MAX_ALARM_RULES + 3];
+    for (auto& r : stored) r = storedRule(RULE_METRIC_VOLTAGE, RULE_OP_BELOW, RULE_ACTION_MARK, RULE_SCOPE_ANY, 3000);
+    stored[0].action = RULE_ACTION_COUNT;
+
+    AlarmRuleEngine engine;
+    engine.load(stored, MAX_ALARM_RULES + 3);
+    EXPECT_EQ(engine.getRuleCount(), MAX_ALARM_RULES);
+}
+
+TEST(AlarmRules, AddRuleRejectsInvalidFields) {
+    AlarmRuleEngine engine;
+    EXPECT_EQ(engine.addRule(RULE_METRIC_COUNT, 0, 1, RULE_ACTION_MARK, RULE_SCOPE_ANY, 1), -1);
+    EXPECT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, 0, 1, RULE_ACTION_COUNT, RULE_SCOPE_ANY, 1), -1);
+    EXPECT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, 0, 1, RULE_ACTION_MARK, 0, 1), -1);
+    EXPECT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, 5, 1, RULE_ACTION_MARK, RULE_SCOPE_ANY, 1), 0);
+    EXPECT_EQ(engine.getRule(0).op, RULE_OP_ABOVE);
+}
+
+// Elapsed time and capacity count from the first sample after resetRun()
+TEST(AlarmRules, ElapsedAndCapacityRestartPerPhase) {
+    AlarmRuleEngine engine;
+    ASSERT_EQ(engine.addRule(RULE_METRIC_ELAPSED, RULE_OP_ABOVE, 60, RULE_ACTION_NEXT, RULE_SCOPE_ANY, 1), 0);
+    ASSERT_EQ(engine.addRule(RULE_METRIC_CAPACITY, RULE_OP_ABOVE, 100, RULE_ACTION_MARK, RULE_SCOPE_ANY, 1), 1);
+
+    // First phase starts at 1000 s on the device clock with 40 mAh already counted
+    engine.resetRun();
+    EXPECT_EQ(engine.evaluate(sampleAt(1000000, 3700, 40)), 0);
+    EXPECT_EQ(engine.evaluate(sampleAt(1050000, 3690, 120)), 0);
+    EXPECT_EQ(engine.getMetric(RULE_METRIC_ELAPSED), 50);
+    EXPECT_EQ(engine.getMetric(RULE_METRIC_CAPACITY), 80);
+    EXPECT_EQ(engine.evaluate(sampleAt(1061000, 3680, 141)), 0x03);
+
+    // Next phase: both rules are armed again and count from its own start
+    engine.resetRun();
+    EXPECT_EQ(engine.evaluate(sampleAt(2000000, 3600, 141)), 0);
+    EXPECT_EQ(engine.evaluate(sampleAt(2059000, 3590, 200)), 0);
+    EXPECT_EQ(engine.getMetric(RULE_METRIC_ELAPSED), 59);
+    EXPECT_EQ(engine.evaluate(sampleAt(2061000, 3580, 242)), 0x03);
+}
+
+TEST(AlarmRules, HoldNeedsConsecutiveSamples) {
+    AlarmRuleEngine engine;
+    ASSERT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, RULE_OP_BELOW, 3000, RULE_ACTION_ABORT, RULE_SCOPE_DISCHARGE, 3), 0);
+
+    EXPECT_EQ(engine.evaluate(sampleAt(0, 2990, 0)), 0);
+    EXPECT_EQ(engine.evaluate(sampleAt(100, 2990, 0)), 0);
+    EXPECT_EQ(engine.evaluate(sampleAt(200, 3010, 0)), 0);   // Spike back above resets the count
+    EXPECT_EQ(engine.evaluate(sampleAt(300, 2990, 0)), 0);
+    EXPECT_EQ(engine.evaluate(sampleAt(400, 2990, 0, RULE_SCOPE_CHARGE)), 0);  // Out of scope
+    EXPECT_EQ(engine.evaluate(sampleAt(500, 2990, 0)), 0);
+    EXPECT_EQ(engine.evaluate(sampleAt(600, 2990, 0)), 0x01);
+    EXPECT_EQ(engine.evaluate(sampleAt(700, 2990, 0)), 0);   // Fires once per run
+}
+
+// Each rule fires on the sample its own metric crosses, and only in its scope
+TEST(AlarmRules, RulesMatchTheirMetricAndScope) {
+    AlarmRuleEngine engine;
+    ASSERT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, RULE_OP_BELOW, 3650, RULE_ACTION_NEXT, RULE_SCOPE_DISCHARGE, 1), 0);
+    ASSERT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, RULE_OP_ABOVE, 4150, RULE_ACTION_NEXT, RULE_SCOPE_CHARGE, 1), 1);
+    ASSERT_EQ(engine.addRule(RULE_METRIC_SAG, RULE_OP_ABOVE, 50, RULE_ACTION_ALARM, RULE_SCOPE_ANY, 1), 2);
+    ASSERT_EQ(engine.addRule(RULE_METRIC_DVDT, RULE_OP_BELOW, -30, RULE_ACTION_MARK, RULE_SCOPE_DISCHARGE, 1), 3);
+    ASSERT_EQ(engine.addRule(RULE_METRIC_VOLTAGE, RULE_OP_BELOW, 3650, RULE_ACTION_ABORT, RULE_SCOPE_CHARGE, 1), 4);
+
+    // Discharge at -1 mV/s (-60 mV/min), with an 80 mV sag at 20 s
+    uint32_t firedAt[MAX_ALARM_RULES] = {};
+    engine.resetRun();
+    for (uint32_t t = 0; t <= 30; t++) {
+        int32_t mv = 3700 - (int32_t)t - (t >= 20 ? 80 : 0);
+        uint8_t fired = engine.evaluate(sampleAt(t * 1000, mv, t));
+        for (uint8_t i = 0; i < MAX_ALARM_RULES; i++) {
+            if (fired & (1 << i)) firedAt[i] = t;
+        }
+    }
+    EXPECT_EQ(firedAt[3], 10u);   // First dV/dt baseline: -60 mV/min
+    EXPECT_EQ(firedAt[2], 20u);   // Sag of 81 mV
+    EXPECT_EQ(firedAt[0], 20u);   // Same sample takes the voltage below 3650
+    EXPECT_EQ(firedAt[1], 0u);    // Charge scope: never evaluated here
+    EXPECT_EQ(firedAt[4], 0u);
+
+    // Charge phase rising through 4150 mV: only the charge-scoped voltage rule
+    engine.resetRun();
+    uint8_t firedMask = 0;
+    uint32_t chargeFiredAt = 0;
+    for (uint32_t t = 0; t <= 60; t++) {
+        uint8_t fired = engine.evaluate(sampleAt(100000 + t * 1000, 4100 + (int32_t)t, t, RULE_SCOPE_CHARGE));
+        if (fired & 0x02) chargeFiredAt = t;
+        firedMask |= fired;
+    }
+    EXPECT_EQ(firedMask, 0x02);
+    EXPECT_EQ(chargeFiredAt, 51u);
+}
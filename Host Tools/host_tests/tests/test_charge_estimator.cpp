@@ -0,0 +1,124 @@
+// ChargeEstimator against a simulated LP4060 charge: CC at 1000 mA, CV at 4.20 V until the
+// current falls under 100 mA, into a cell with an OCV curve, R0 and one RC polarisation pair.
+// The estimator only sees the terminal voltage (0.6 mV noise, ~50 ms loop) and switches the
+// simulated charger through isChargerOn() for its probes, as the sketch does with Mosfet_Pin.
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+#include <random>
+
+#include "ChargeEstimator.h"
+
+static float ocvAt(float soc) {
+    static const float POINTS[][2] = {{0, 3.00f}, {0.05f, 3.40f}, {0.10f, 3.55f}, {0.30f, 3.68f}, {0.50f, 3.75f},
+                                      {0.70f, 3.90f}, {0.85f, 4.02f}, {0.95f, 4.12f}, {1.0f, 4.19f}, {1.05f, 4.25f}};
+    if (soc <= 0) return 3.0f;
+    for (int i = 1; i < 10; i++) {
+        if (soc <= POINTS[i][0]) {
+            float f = (soc - POINTS[i - 1][0]) / (POINTS[i][0] - POINTS[i - 1][0]);
+            return POINTS[i - 1][1] + f * (POINTS[i][1] - POINTS[i - 1][1]);
+        }
+    }
+    return 4.25f;
+}
+
+struct ChargeCase {
+    const char* name;
+    double capacityMAh;
+    double startSoc;
+    double r0;
+    double r1;
+    double tau1S;
+    bool taper;
+    bool probes;
+    double maxErrorPct;     // Estimated vs true charge
+    double maxCurrentRms;   // mA, over usable CC/CV samples
+};
+
+struct ChargeResult {
+    double trueMAh;
+    double estimatedMAh;
+    double currentRms;
+    double hours;
+    bool finished;
+};
+
+static ChargeResult runCharge(const ChargeCase& c, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0, 0.6f);
+    const double V_REG = 4.20, I_CC = 1000, I_TERM = 100, DT_S = 0.01;
+
+    ChargeEstimator estimator;
+    estimator.begin(0, 1000, 4180, c.taper, c.probes);
+    double soc = c.startSoc, vrc = 0, trueMAh = 0, current = 0, errSq = 0;
+    long errCount = 0;
+    bool chargerDone = false;
+    uint32_t t = 0, nextSample = 40;
+    ChargeResult r = {};
+    for (long step = 0; step < 10L * 3600 * 100; step++) {
+        double ocv = ocvAt(soc);
+        current = 0;
+        if (estimator.isChargerOn() && !chargerDone) {
+            double cv = (V_REG - ocv - vrc) / c.r0 * 1000;
+            current = std::min(I_CC, std::max(0.0, cv));
+            if (current < I_TERM && cv < I_CC) {
+                chargerDone = true;   // LP4060 terminates on its own
+                current = 0;
+            }
+        }
+        vrc += DT_S * (current / 1000 * c.r1 - vrc) / c.tau1S;
+        soc += current * DT_S / 3600 / c.capacityMAh;
+        trueMAh += current * DT_S / 3600;
+        t += 10;
+
+        if (t >= nextSample) {
+            nextSample = t + 40 + rng() % 20;   // 25 ms ADC block plus the rest of the loop
+            float mv = (float)((ocv + vrc + current / 1000 * c.r0) * 1000) + noise(rng);
+            estimator.update(t, mv);
+            if (estimator.wasSampleUsable() && estimator.getPhase() != CHARGE_PHASE_DONE) {
+                double e = estimator.getCurrentMA() - current;
+                errSq += e * e;
+                errCount++;
+            }
+            if (estimator.isFinished(mv)) {
+                r.finished = true;
+                break;
+            }
+        }
+    }
+    r.trueMAh = trueMAh;
+    r.estimatedMAh = estimator.getChargeMAh();
+    r.currentRms = errCount ? sqrt(errSq / errCount) : 0;
+    r.hours = t / 3600000.0;
+    return r;
+}
+
+class ChargeEstimatorSim : public ::testing::TestWithParam<ChargeCase> {};
+
+TEST_P(ChargeEstimatorSim, ChargeMatchesSimulatedCell) {
+    const ChargeCase& c = GetParam();
+    ChargeResult r = runCharge(c, 1);
+    ASSERT_TRUE(r.finished);
+    EXPECT_NEAR(r.estimatedMAh, r.trueMAh, r.trueMAh * c.maxErrorPct / 100)
+        << "true " << r.trueMAh << " mAh in " << r.hours << " h";
+    EXPECT_LT(r.currentRms, c.maxCurrentRms);
+}
+
+// A fixed 1000 mA assumption over-counts the CV phase by 12-30% on these cells
+INSTANTIATE_TEST_SUITE_P(Cells, ChargeEstimatorSim, ::testing::Values(
+    ChargeCase{"EmptyVoltageEnd", 2500, 0.0, 0.08, 0.04, 30, false, true, 1, 50},
+    ChargeCase{"EmptyTaperProbes", 2500, 0.0, 0.08, 0.04, 30, true, true, 1, 50},
+    ChargeCase{"EmptyTaperNoProbes", 2500, 0.0, 0.08, 0.04, 30, true, false, 8, 160},
+    ChargeCase{"HalfTaperProbes", 3000, 0.5, 0.06, 0.03, 40, true, true, 1, 50},
+    ChargeCase{"AgedTaperProbes", 2000, 0.0, 0.18, 0.08, 60, true, true, 1, 50},
+    ChargeCase{"AgedTaperNoProbes", 2000, 0.0, 0.18, 0.08, 60, true, false, 4, 50}),
+    [](const ::testing::TestParamInfo<ChargeCase>& info) { return std::string(info.param.name); });
+
+// A top-up from 95% is mostly CV: too short to fit R well, but the error stays small in mAh
+TEST(ChargeEstimator, TopUpWithProbesStaysClose) {
+    ChargeCase c = {"TopUp", 2500, 0.95, 0.08, 0.04, 30, true, true, 0, 0};
+    ChargeResult r = runCharge(c, 1);
+    ASSERT_TRUE(r.finished);
+    EXPECT_NEAR(r.estimatedMAh, r.trueMAh, 25);
+    EXPECT_LT(r.hours, 0.5);
+}
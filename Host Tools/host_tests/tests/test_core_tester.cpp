@@ -0,0 +1,130 @@
+// CoreTester (the button-only firmware engine) on a simulated cell: OCV falling linearly
+// with time, series resistance under the load, ADC blocks on the host clock
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+#include <Adafruit_SSD1306.h>
+#include <BatteryTesterCore.h>
+
+typedef XiaoC3Board Board;
+typedef CoreTester<Board, Load1A, Adafruit_SSD1306> Tester;
+
+static const float R_CELL = 0.1f;
+
+class CoreTesterTest : public ::testing::Test {
+protected:
+    Adafruit_SSD1306 display{128, 64, &Wire, -1};
+    Tester tester{display};
+    float ocv = 4.0f;
+
+    void SetUp() override {
+        host::reset();
+        host::setAnalogRead([this](uint8_t pin) {
+            float pinVolts = (pin == Board::VREF_PIN) ? Board::VREF_VOLTS : terminalVolts() / Board::DIVIDER_RATIO;
+            return (int)(pinVolts / 3.3f * 4096 + 0.5f);
+        });
+        tester.begin();
+    }
+
+    void TearDown() override {
+        toneSequencer.stop();
+    }
+
+    // Load current follows the PWM duty through the Load1A table
+    float loadAmps() const {
+        int duty = host::getPwmDuty(Board::PWM_PIN);
+        for (uint8_t i = 0; i < Load1A::COUNT; i++) {
+            if (Load1A::PWM_DUTY[i] == duty) return Load1A::CURRENT_MA[i] / 1000.0f;
+        }
+        return 0;
+    }
+
+    float terminalVolts() const {
+        return ocv - loadAmps() * R_CELL;
+    }
+
+    void press(uint8_t pin) {
+        host::releaseButton(pin);
+        tester.poll();
+    }
+};
+
+TEST_F(CoreTesterTest, DischargeRunsToCutoff) {
+    press(Board::DOWN_PIN);   // Menu item 1: Discharge
+    press(Board::MODE_PIN);
+    ASSERT_EQ(tester.getState(), CORE_SELECT_CUTOFF);
+    press(Board::MODE_PIN);   // Default 3.0 V cutoff
+    ASSERT_EQ(tester.getState(), CORE_SELECT_CURRENT);
+    press(Board::MODE_PIN);   // Default 500 mA
+    ASSERT_EQ(tester.getState(), CORE_DISCHARGING);
+    EXPECT_EQ(host::getPwmDuty(Board::PWM_PIN), Load1A::PWM_DUTY[Load1A::DEFAULT_INDEX]);
+    EXPECT_EQ(host::getPinLevel(Board::MOSFET_PIN), LOW);
+
+    // OCV 4.0 V falling 0.5 V/h, 50 mV under load: the terminal reaches 3.0 V at 1.9 h
+    uint64_t startUs = host::getMicros();
+    long passes = 0;
+    while (tester.getState() == CORE_DISCHARGING && host::getMicros() - startUs < 3 * 3600000000ULL) {
+        ocv = 4.0f - (host::getMicros() - startUs) / 3.6e9f * 0.5f;
+        tester.poll();
+        passes++;
+    }
+    float hours = (host::getMicros() - startUs) / 3.6e9f;
+    ASSERT_EQ(tester.getState(), CORE_COMPLETE);
+    EXPECT_NEAR(hours, 1.9f, 0.02f);
+    EXPECT_NEAR(tester.getCapacityMAh(), (500 + Load1A::OFFSET_MA) * hours, 2.0f);
+    EXPECT_NEAR(tester.getVoltage(), 3.0f, 0.01f);
+    EXPECT_EQ(host::getPwmDuty(Board::PWM_PIN), 0);
+
+    // One ADC block per pass, not a blocking delay()
+    EXPECT_LT(hours * 3600000 / passes, 50.0f);
+
+    press(Board::UP_PIN);
+    EXPECT_EQ(tester.getState(), CORE_MENU);
+}
+
+TEST_F(CoreTesterTest, IrTestMeasuresSeriesResistance) {
+    ocv = 3.7f;
+    press(Board::UP_PIN);     // Menu wraps to item 3: IR Test
+    press(Board::MODE_PIN);
+    ASSERT_EQ(tester.getState(), CORE_IR_MEASURE);
+
+    uint64_t startUs = host::getMicros();
+    while (tester.getState() == CORE_IR_MEASURE && host::getMicros() - startUs < 5000000) {
+        tester.poll();
+        host::advanceMicros(10000);
+    }
+    ASSERT_EQ(tester.getState(), CORE_IR_DISPLAY);
+    EXPECT_NEAR(tester.getInternalResistance(), R_CELL, 0.015f);
+    EXPECT_EQ(host::getPwmDuty(Board::PWM_PIN), 0);
+
+    // Result screen returns to the menu by itself
+    host::advanceMicros(CORE_IR_DISPLAY_MS * 1000ULL);
+    tester.poll();
+    EXPECT_EQ(tester.getState(), CORE_MENU);
+}
+
+TEST_F(CoreTesterTest, ModeButtonAbortsCharge) {
+    ocv = 3.7f;
+    press(Board::MODE_PIN);   // Menu item 0: Charge
+    ASSERT_EQ(tester.getState(), CORE_CHARGING);
+    EXPECT_EQ(host::getPinLevel(Board::MOSFET_PIN), HIGH);
+    EXPECT_EQ(host::getPwmDuty(Board::PWM_PIN), 0);
+
+    for (int i = 0; i < 40; i++) tester.poll();
+    EXPECT_GT(tester.getCapacityMAh(), 0);
+
+    press(Board::MODE_PIN);   // Within one pass
+    EXPECT_EQ(tester.getState(), CORE_MENU);
+    EXPECT_EQ(host::getPinLevel(Board::MOSFET_PIN), LOW);
+}
+
+TEST_F(CoreTesterTest, EmptySlotShowsErrorThenMenu) {
+    ocv = 0;
+    press(Board::MODE_PIN);
+    ASSERT_EQ(tester.getState(), CORE_MESSAGE);
+    EXPECT_EQ(host::getPinLevel(Board::MOSFET_PIN), LOW);
+
+    host::advanceMicros(CORE_MESSAGE_MS * 1000ULL);
+    tester.poll();
+    EXPECT_EQ(tester.getState(), CORE_MENU);
+}
@@ -0,0 +1,100 @@
+// DataLogger history cursor: a web client keeps (run id, next seq) and asks for the samples
+// after it on reconnect; history_sync resumes only when canResume() agrees
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "DataLogger.h"
+
+// `n` samples one interval apart, after `t`
+static uint32_t logSamples(DataLogger& logger, uint32_t n, uint32_t t = 0) {
+    for (uint32_t i = 0; i < n; i++) {
+        t += DATA_SAMPLE_INTERVAL;
+        EXPECT_TRUE(logger.addDataPointAt(t, 3.7f + i * 1e-4f, 500, t / 7200.0f));
+    }
+    return t;
+}
+
+TEST(DataLogger, ResumesAfterReconnect) {
+    static DataLogger logger;
+    logger.reset();
+    uint32_t t = logSamples(logger, 100);
+
+    // Client saw everything so far, then dropped off while 50 more were logged
+    uint32_t run = logger.getRunId();
+    uint32_t cursor = logger.getNextSeq();
+    logSamples(logger, 50, t);
+
+    ASSERT_TRUE(logger.canResume(run, cursor));
+    uint32_t seq = logger.clampSeq(cursor);
+    EXPECT_EQ(seq, 100u);
+    EXPECT_EQ(logger.getNextSeq() - seq, 50u);
+
+    // The first missed sample is the one logged right after the cursor
+    DataPoint pt{};
+    ASSERT_TRUE(logger.getBySeq(seq, pt));
+    EXPECT_EQ(pt.timestamp, 101u * DATA_SAMPLE_INTERVAL);
+    EXPECT_NEAR(pt.voltage, 3.7f, 1e-3f);
+
+    // An up-to-date client resumes with nothing to fetch
+    EXPECT_TRUE(logger.canResume(run, logger.getNextSeq()));
+    EXPECT_FALSE(logger.getBySeq(logger.getNextSeq(), pt));
+}
+
+TEST(DataLogger, OverwrittenCursorResumesAtOldestSample) {
+    static DataLogger logger;
+    logger.reset();
+    uint32_t run = logger.getRunId();
+    uint32_t t = logSamples(logger, 10);
+    uint32_t cursor = logger.getNextSeq();
+
+    // Away long enough for the ring to wrap past the cursor
+    logSamples(logger, MAX_DATA_POINTS + 20, t);
+
+    ASSERT_TRUE(logger.canResume(run, cursor));
+    EXPECT_EQ(logger.getFirstSeq(), 30u);
+    EXPECT_EQ(logger.clampSeq(cursor), logger.getFirstSeq());
+
+    DataPoint pt{};
+    EXPECT_FALSE(logger.getBySeq(cursor, pt));
+    ASSERT_TRUE(logger.getBySeq(logger.getFirstSeq(), pt));
+    EXPECT_EQ(pt.timestamp, 31u * DATA_SAMPLE_INTERVAL);
+}
+
+TEST(DataLogger, RunChangeForcesFullSync) {
+    static DataLogger logger;
+    logger.reset();
+    logSamples(logger, 100);
+    uint32_t oldRun = logger.getRunId();
+    uint32_t cursor = logger.getNextSeq();
+
+    // A new operation restarts the sequence under a new run id
+    logger.reset();
+    logSamples(logger, 200);
+    EXPECT_NE(logger.getRunId(), oldRun);
+    EXPECT_EQ(logger.getFirstSeq(), 0u);
+
+    // Same seq numbers exist again, but they are different samples: start over
+    EXPECT_FALSE(logger.canResume(oldRun, cursor));
+    EXPECT_TRUE(logger.canResume(logger.getRunId(), 0));
+}
+
+TEST(DataLogger, CursorAheadOfRunIsRejected) {
+    static DataLogger logger;
+    logger.reset();
+    logSamples(logger, 10);
+
+    EXPECT_FALSE(logger.canResume(logger.getRunId(), logger.getNextSeq() + 1));
+    EXPECT_EQ(logger.clampSeq(logger.getNextSeq() + 100), logger.getNextSeq());
+}
+
+TEST(DataLogger, LatestPointNeedsData) {
+    static DataLogger logger;
+    logger.reset();
+    DataPoint pt{};
+    EXPECT_FALSE(logger.getLatestDataPoint(pt));
+
+    logSamples(logger, 3);
+    ASSERT_TRUE(logger.getLatestDataPoint(pt));
+    EXPECT_EQ(pt.timestamp, 3u * DATA_SAMPLE_INTERVAL);
+}
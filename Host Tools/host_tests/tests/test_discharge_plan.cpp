@@ -0,0 +1,112 @@
+// DischargePlan rate sweeps on a Peukert cell: the capacity available at current I is
+// C(I) = C_ref (I / I_ref)^(1 - k), and each stage delivers what the previous, higher rate left
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "DischargePlan.h"
+
+static const float C_REF_MAH = 3000;
+static const float I_REF_MA = 500;
+
+static float capacityAtRate(float currentMA, float k) {
+    return C_REF_MAH * powf(currentMA / I_REF_MA, 1 - k);
+}
+
+// Runs one stage at constant current from the run capacity so far up to `endMAh`,
+// one loaded sample per second; returns the time after the stage
+static uint32_t runStage(DischargePlan& plan, uint32_t now, float startMAh, float endMAh, uint16_t currentMA) {
+    plan.startStage(now, startMAh, currentMA);
+    uint32_t seconds = (uint32_t)((endMAh - startMAh) / currentMA * 3600 + 0.5f);
+    float volts = 4.1f;
+    for (uint32_t s = 1; s <= seconds; s++) {
+        float mah = startMAh + (endMAh - startMAh) * s / seconds;
+        volts = 4.1f - 1.1f * mah / C_REF_MAH;
+        plan.addSample(volts, mah);
+    }
+    now += seconds * 1000;
+    plan.endStage(now, volts, endMAh);
+    return now;
+}
+
+// Sweep 2000 / 1000 / 500 mA; the plan only needs the stage count, the sketch applies currents
+static const DischargeStage SWEEP[] = {{13, 3000, 60}, {11, 3000, 60}, {6, 3000, 0}};
+static const uint16_t SWEEP_MA[] = {2000, 1000, 500};
+
+TEST(DischargePlan, SweepFitsPeukertExponentOnceComplete) {
+    const float k = 1.05f;
+    DischargePlan plan;
+    plan.begin(SWEEP, 3, true);
+
+    uint32_t now = 0;
+    float mah = 0;
+    float k_fit = 0;
+    for (uint8_t i = 0; i < 3; i++) {
+        float capacity = capacityAtRate(SWEEP_MA[i], k);
+        now = runStage(plan, now, mah, capacity, SWEEP_MA[i]);
+        mah = capacity;
+        if (i < 2) {
+            // No fit while the sweep is still running, even with two rates done
+            EXPECT_FALSE(plan.fitPeukert(k_fit)) << "after stage " << (int)i;
+            EXPECT_TRUE(plan.next());
+            now += SWEEP[i].restS * 1000;
+        }
+    }
+    EXPECT_FALSE(plan.next());
+
+    ASSERT_EQ(plan.getResultCount(), 3u);
+    for (uint8_t i = 0; i < 3; i++) {
+        EXPECT_NEAR(plan.getCapacityAt(i), capacityAtRate(SWEEP_MA[i], k), 0.5f);
+        EXPECT_NEAR(plan.getMeanCurrentMA(i), SWEEP_MA[i], SWEEP_MA[i] * 0.002f);
+    }
+    ASSERT_TRUE(plan.fitPeukert(k_fit));
+    EXPECT_NEAR(k_fit, k, 0.005f);
+}
+
+TEST(DischargePlan, AbortedSweepHasNoFit) {
+    DischargePlan plan;
+    plan.begin(SWEEP, 3, true);
+    uint32_t now = runStage(plan, 0, 0, capacityAtRate(2000, 1.1f), 2000);
+    plan.next();
+    runStage(plan, now, plan.getCapacityAt(0), capacityAtRate(1000, 1.1f), 1000);
+
+    float k;
+    EXPECT_EQ(plan.getResultCount(), 2u);
+    EXPECT_FALSE(plan.fitPeukert(k));
+}
+
+TEST(DischargePlan, SingleRateHasNoFit) {
+    const DischargeStage single = {6, 3000, 0};
+    DischargePlan plan;
+    plan.begin(&single, 1, false);
+    runStage(plan, 0, 0, 3000, 500);
+
+    float k;
+    EXPECT_FALSE(plan.fitPeukert(k));
+}
+
+TEST(DischargePlan, StageResultAndProfile) {
+    const DischargeStage single = {6, 3000, 0};
+    DischargePlan plan;
+    plan.begin(&single, 1, false);
+    runStage(plan, 0, 0, 3000, 500);
+
+    const StageResult& r = plan.getResult(0);
+    EXPECT_EQ(r.currentMA, 500u);
+    EXPECT_NEAR(r.mAh, 3000, 0.01f);
+    EXPECT_EQ(r.seconds, 21600u);
+    EXPECT_NEAR(r.startMV, 4100, 1);
+    EXPECT_NEAR(r.endMV, 3000, 1);
+    EXPECT_NEAR(r.avgMV, 3550, 2);     // Linear fall: mean of start and end
+    EXPECT_NEAR(r.mWh, 3000 * 3.55f, 10);
+
+    // Spacing doubled as the series filled, so it still spans the whole stage
+    EXPECT_LE(r.profileCount, PLAN_PROFILE_POINTS);
+    EXPECT_GE(r.profileCount, PLAN_PROFILE_POINTS / 2);
+    EXPECT_LT(r.profileMAh[0], r.profileStepMAh);
+    EXPECT_GT(r.profileMAh[r.profileCount - 1], 3000 - 2 * r.profileStepMAh);
+    for (uint8_t p = 1; p < r.profileCount; p++) {
+        EXPECT_GE(r.profileMAh[p] - r.profileMAh[p - 1], r.profileStepMAh / 2);
+        EXPECT_LT(r.profileMV[p], r.profileMV[p - 1]);
+    }
+}
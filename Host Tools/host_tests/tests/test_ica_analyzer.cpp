@@ -0,0 +1,103 @@
+// IcaAnalyzer on a synthetic discharge whose OCV curve is a sum of sigmoids, so the true
+// dQ/dV peaks are known: a sigmoid of charge q and width w peaks at q / 4w mAh/V
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+#include <random>
+
+#include "IcaAnalyzer.h"
+
+struct Phase {
+    double volts;
+    double width;
+    double mah;
+};
+
+// Three sharp transitions and one broad shoulder well under the prominence floor
+static const Phase PHASES[] = {{3.95, 0.03, 600}, {3.70, 0.04, 1500}, {3.45, 0.05, 700}, {3.20, 0.15, 200}};
+static const double R_CELL = 0.08;
+
+// Charge discharged by the time OCV falls to v
+static double dischargedAt(double v) {
+    double q = 0;
+    for (const Phase& p : PHASES) q += p.mah / (1 + exp((v - p.volts) / p.width));
+    return q;
+}
+
+static double ocvAt(double mah) {
+    double lo = 2.8, hi = 4.3;
+    for (int i = 0; i < 36; i++) {
+        double mid = (lo + hi) / 2;
+        if (dischargedAt(mid) > mah) lo = mid;
+        else hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+// 10 Hz loop to a 3.0 V terminal cutoff with 1.5 mV read noise. The analyzer gets the
+// IR-compensated voltage as the sketch feeds it. `switchMAh` drops the current part way.
+static bool runDischarge(uint32_t seed, double amps, IcaSummary& out, double switchMAh = 0, double lowAmps = 0) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0, 0.0015);
+    IcaAnalyzer ica;
+    ica.begin();
+    double mah = 0;
+    while (true) {
+        double current = (switchMAh > 0 && mah >= switchMAh) ? lowAmps : amps;
+        double terminal = ocvAt(mah) - current * R_CELL + noise(rng);
+        if (terminal < 3.0) break;
+        ica.addSample(terminal + current * R_CELL, mah);
+        mah += current * 1000 * 0.1 / 3600;
+    }
+    return ica.finish(mah, out);
+}
+
+static void expectTruePeaks(const IcaSummary& s) {
+    ASSERT_EQ(s.peakCount, 3u);
+    for (int i = 0; i < 3; i++) {
+        const Phase& p = PHASES[i];
+        double height = p.mah / (4 * p.width);
+        EXPECT_NEAR(s.peaks[i].mv, p.volts * 1000, 2 * ICA_BIN_MV) << "peak " << i;
+        EXPECT_NEAR(s.peaks[i].height, height, 0.15 * height) << "peak " << i;
+    }
+}
+
+TEST(IcaAnalyzer, FindsSigmoidPeaksUnderNoise) {
+    for (uint32_t seed = 0; seed < 3; seed++) {
+        IcaSummary s;
+        ASSERT_TRUE(runDischarge(seed, 0.5, s)) << "seed " << seed;
+        EXPECT_GT(s.capacityMAh, 2900);
+        expectTruePeaks(s);
+    }
+}
+
+// Staged discharge: 1 A, then 0.2 A from 1800 mAh. IR compensation keeps the curve whole.
+TEST(IcaAnalyzer, CurrentStepKeepsPeaksInPlace) {
+    IcaSummary s;
+    ASSERT_TRUE(runDischarge(7, 1.0, s, 1800, 0.2));
+    expectTruePeaks(s);
+}
+
+TEST(IcaAnalyzer, ShortRunGivesNoSummary) {
+    IcaAnalyzer ica;
+    ica.begin();
+    for (int i = 0; i <= 100; i++) {
+        ica.addSample(4.1f - i * 0.005f, i * 2.0f);
+    }
+    IcaSummary s;
+    EXPECT_FALSE(ica.finish(200, s));
+    EXPECT_FALSE(ica.isActive());
+    EXPECT_FALSE(ica.finish(200, s));
+}
+
+TEST(IcaAnalyzer, BinCountReadsAsDqDv) {
+    // 500 mAh spread evenly over 4.0 V down to 3.5 V: a flat 1000 mAh/V
+    IcaAnalyzer ica;
+    ica.begin();
+    for (int i = 0; i <= 5000; i++) {
+        ica.addSample(4.0f - i * 0.0001f, i * 0.1f);
+    }
+    int16_t mid = (3750 - ICA_MIN_MV) / ICA_BIN_MV;
+    EXPECT_NEAR(ica.smoothedAt(mid), 1000, 20);
+    EXPECT_NEAR(ica.binCentreMV(mid), 3755, 0);
+}
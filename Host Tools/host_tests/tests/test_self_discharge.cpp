@@ -0,0 +1,107 @@
+// SelfDischargeTest over a simulated 72 h open-circuit rest: 2 h relaxation tail, linear
+// leakage and 1.5 mV gaussian read noise, read every 10 minutes as the sketch does
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+#include <random>
+
+#include "SelfDischargeTest.h"
+
+static const uint16_t HOURS = 72;
+static const float LIMIT_MV_DAY = 5.0f;
+static const int RUNS = 50;
+
+struct RunResult {
+    float slopeMvDay;    // Leakage as a positive mV/day
+    uint16_t fitted;
+    uint16_t postSettle; // Readings taken after the settle period
+    SdVerdict verdict;
+};
+
+// One monitor run: OCV = 4150 - 25 (1 - e^-t/1h) - leak t + noise (+ spikes)
+static RunResult runMonitor(float leakMvDay, uint32_t seed, float spikeMv = 0, uint16_t hours = HOURS) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> noise(0, 1.5f);
+    SelfDischargeTest test;
+    test.start(SD_DEFAULT_INTERVAL_MIN, hours, LIMIT_MV_DAY, false);
+    test.startMonitor(0);
+
+    RunResult r = {};
+    uint16_t readings = 0;
+    for (uint32_t now = 0; now <= hours * 3600000UL; now += 60000) {
+        if (!test.sampleDue(now)) continue;
+        float mv = 4150 - 25 * (1 - expf(-(float)now / 3600000.0f)) - leakMvDay * now / 86400000.0f + noise(rng);
+        if (spikeMv != 0 && ++readings % 50 == 0) mv += spikeMv;
+        if (now >= SD_SETTLE_MS) r.postSettle++;
+        test.addReading(now, mv / 1000.0f);
+    }
+    r.slopeMvDay = -test.getSlope();
+    r.fitted = test.getFitCount();
+    r.verdict = test.getVerdict();
+    return r;
+}
+
+class SelfDischargeLeak : public ::testing::TestWithParam<float> {};
+
+// A noisy early line must not lock out the rest of the run: every run keeps fitting,
+// lands near the true slope and gets the verdict right
+TEST_P(SelfDischargeLeak, FitTracksSlopeAcrossSeeds) {
+    float leak = GetParam();
+    SdVerdict expected = leak > LIMIT_MV_DAY ? SD_VERDICT_FAIL : SD_VERDICT_PASS;
+    float worst = 0;
+    for (int seed = 0; seed < RUNS; seed++) {
+        RunResult r = runMonitor(leak, seed);
+        EXPECT_GT(r.fitted, r.postSettle * 9 / 10) << "seed " << seed;
+        EXPECT_EQ(r.verdict, expected) << "seed " << seed << " slope " << r.slopeMvDay;
+        worst = std::max(worst, fabsf(r.slopeMvDay - leak));
+    }
+    EXPECT_LT(worst, 1.0f);
+}
+
+INSTANTIATE_TEST_SUITE_P(Cells, SelfDischargeLeak, ::testing::Values(1.0f, 8.0f));
+
+TEST(SelfDischarge, SpikesAreRejectedNotFitted) {
+    for (int seed = 0; seed < 10; seed++) {
+        RunResult r = runMonitor(1.0f, seed, 40.0f);
+        EXPECT_NEAR(r.slopeMvDay, 1.0f, 1.0f) << "seed " << seed;
+        EXPECT_EQ(r.verdict, SD_VERDICT_PASS) << "seed " << seed;
+    }
+    SelfDischargeTest test;
+    test.start(SD_DEFAULT_INTERVAL_MIN, HOURS, LIMIT_MV_DAY, false);
+    test.startMonitor(0);
+    for (uint32_t now = SD_SETTLE_MS; now < SD_SETTLE_MS + 20 * 600000UL; now += 600000) {
+        test.addReading(now, (now == SD_SETTLE_MS + 15 * 600000UL) ? 4.100f : 4.150f);
+    }
+    EXPECT_EQ(test.getOutliers(), 1u);
+}
+
+// A step in OCV (contact shifted, cell moved) is not a spike: after SD_MAX_REJECT_RUN
+// rejections the line is refitted and follows the data again
+TEST(SelfDischarge, PersistentShiftRefits) {
+    SelfDischargeTest test;
+    test.start(SD_DEFAULT_INTERVAL_MIN, HOURS, LIMIT_MV_DAY, false);
+    test.startMonitor(0);
+    uint32_t now = SD_SETTLE_MS;
+    for (int i = 0; i < 20; i++, now += 600000) test.addReading(now, 4.150f);
+    for (int i = 0; i < 20; i++, now += 600000) test.addReading(now, 4.130f);
+    EXPECT_LE(test.getOutliers(), SD_MAX_REJECT_RUN);
+    EXPECT_GE(test.getFitCount(), 30u);
+}
+
+// A run shorter than SD_MIN_HOURS ends without enough fitted data: no pass, no fail
+TEST(SelfDischarge, ShortRunEndsWithoutVerdict) {
+    const uint16_t durations[] = {1, 2, SD_MIN_HOURS - 1};
+    for (uint16_t hours : durations) {
+        SelfDischargeTest test;
+        test.start(SD_DEFAULT_INTERVAL_MIN, hours, LIMIT_MV_DAY, false);
+        test.startMonitor(0);
+        for (uint32_t now = 0; test.getPhase() != SD_PHASE_DONE; now += 60000) {
+            if (test.sampleDue(now)) test.addReading(now, 4.150f - now / 86400000.0f * 0.001f);
+        }
+        EXPECT_EQ(test.getVerdict(), SD_VERDICT_PENDING) << hours << " h";
+    }
+
+    // The shortest accepted run does reach a verdict
+    RunResult r = runMonitor(1.0f, 0, 0, SD_MIN_HOURS);
+    EXPECT_EQ(r.verdict, SD_VERDICT_PASS);
+}
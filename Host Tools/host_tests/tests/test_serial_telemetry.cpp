@@ -0,0 +1,185 @@
+// SerialTelemetry framing: command ACKs and the sequence counter across TX drops
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "SerialTelemetry.h"
+
+// In-memory port: bytes written are kept, bytes queued with feed() are read back
+class LoopbackPort : public Stream {
+public:
+    std::vector<uint8_t> tx;
+    std::vector<uint8_t> rx;
+    size_t rxPos = 0;
+    int room = 4096;
+
+    size_t write(uint8_t c) override {
+        tx.push_back(c);
+        return 1;
+    }
+    using Print::write;
+    int availableForWrite() override { return room; }
+    int available() override { return (int)(rx.size() - rxPos); }
+    int read() override { return rxPos < rx.size() ? rx[rxPos++] : -1; }
+};
+
+static uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+static void feedCommand(LoopbackPort& port, const std::string& json) {
+    std::vector<uint8_t> payload;
+    payload.push_back(TELEM_FRAME_COMMAND);
+    payload.insert(payload.end(), json.begin(), json.end());
+    uint16_t crc = crc16(payload.data(), payload.size());
+    payload.push_back(crc & 0xFF);
+    payload.push_back(crc >> 8);
+
+    // COBS (payloads here are under 254 bytes)
+    port.rx.push_back(0);
+    size_t codeIndex = port.rx.size();
+    port.rx.push_back(1);
+    for (uint8_t c : payload) {
+        if (c == 0) {
+            codeIndex = port.rx.size();
+            port.rx.push_back(1);
+        } else {
+            port.rx.push_back(c);
+            port.rx[codeIndex]++;
+        }
+    }
+    port.rx.push_back(0);
+}
+
+// Decoded payloads (CRC checked and stripped) of every frame written so far
+static std::vector<std::vector<uint8_t>> sentFrames(const LoopbackPort& port) {
+    std::vector<std::vector<uint8_t>> frames;
+    std::vector<uint8_t> encoded;
+    for (uint8_t c : port.tx) {
+        if (c != 0) {
+            encoded.push_back(c);
+            continue;
+        }
+        if (encoded.empty()) continue;
+        std::vector<uint8_t> out;
+        size_t i = 0;
+        while (i < encoded.size()) {
+            uint8_t code = encoded[i++];
+            for (uint8_t k = 1; k < code; k++) out.push_back(encoded[i++]);
+            if (code != 0xFF && i < encoded.size()) out.push_back(0);
+        }
+        encoded.clear();
+        uint16_t crc = out[out.size() - 2] | (out[out.size() - 1] << 8);
+        EXPECT_EQ(crc16(out.data(), out.size() - 2), crc);
+        out.resize(out.size() - 2);
+        frames.push_back(out);
+    }
+    return frames;
+}
+
+static uint32_t frameSeq(const std::vector<uint8_t>& f) {
+    return f[1] | (f[2] << 8) | (f[3] << 16) | ((uint32_t)f[4] << 24);
+}
+
+static std::string lastJson;
+
+static bool acceptAll(const char* json, size_t len) {
+    lastJson.assign(json, len);
+    return true;
+}
+
+TEST(SerialTelemetry, AckCarriesCommandName) {
+    LoopbackPort port;
+    SerialTelemetry link;
+    link.begin(port);
+    feedCommand(port, "{\"raw\":false, \"ticks\":true, \"cmd\" : \"telemetry\"}");
+    link.poll(acceptAll);
+
+    auto frames = sentFrames(port);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0][0], TELEM_FRAME_ACK);
+    EXPECT_EQ(frames[0][5], 1);
+    EXPECT_EQ(std::string(frames[0].begin() + 6, frames[0].end()), "telemetry");
+    EXPECT_EQ(lastJson, "{\"raw\":false, \"ticks\":true, \"cmd\" : \"telemetry\"}");
+}
+
+TEST(SerialTelemetry, AckWithoutCommandNameIsEmpty) {
+    LoopbackPort port;
+    SerialTelemetry link;
+    link.begin(port);
+    feedCommand(port, "{\"ticks\":true}");
+    link.poll(acceptAll);
+
+    auto frames = sentFrames(port);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(frames[0].size(), 6u);
+}
+
+TEST(SerialTelemetry, LongCommandNameIsTruncated) {
+    LoopbackPort port;
+    SerialTelemetry link;
+    link.begin(port);
+    feedCommand(port, "{\"cmd\":\"abcdefghijklmnopqrstuvwxyz\"}");
+    link.poll(acceptAll);
+
+    auto frames = sentFrames(port);
+    ASSERT_EQ(frames.size(), 1u);
+    EXPECT_EQ(std::string(frames[0].begin() + 6, frames[0].end()), "abcdefghijklmnopqrstuvw");
+}
+
+// Frames skipped for a full TX buffer still take a sequence number, so the host
+// sees the drop as a gap
+TEST(SerialTelemetry, DroppedFramesLeaveSequenceGaps) {
+    LoopbackPort port;
+    SerialTelemetry link;
+    link.begin(port);
+    link.setStreams(true, false);
+
+    link.sendTick(4, 3.7f, 500, 1.0f);
+    port.room = 0;
+    link.sendTick(4, 3.7f, 500, 1.1f);
+    link.sendTick(4, 3.7f, 500, 1.2f);
+    port.room = 4096;
+    link.sendTick(4, 3.7f, 500, 1.3f);
+
+    auto frames = sentFrames(port);
+    ASSERT_EQ(frames.size(), 2u);
+    EXPECT_EQ(frames[0].size(), 18u);
+    EXPECT_EQ(frameSeq(frames[1]) - frameSeq(frames[0]) - 1, 2u);
+    EXPECT_EQ(link.getFramesDropped(), 2u);
+    EXPECT_EQ(link.getFramesSent(), 2u);
+}
+
+TEST(SerialTelemetry, CorruptCommandIsCountedNotDispatched) {
+    LoopbackPort port;
+    SerialTelemetry link;
+    link.begin(port);
+    feedCommand(port, "{\"cmd\":\"telemetry\"}");
+    port.rx[4] ^= 0x01;
+    lastJson.clear();
+    link.poll(acceptAll);
+
+    EXPECT_TRUE(lastJson.empty());
+    EXPECT_TRUE(port.tx.empty());
+    EXPECT_EQ(link.getRxErrors(), 1u);
+}
+
+TEST(SerialTelemetry, TracksLastInboundByte) {
+    LoopbackPort port;
+    SerialTelemetry link;
+    link.begin(port);
+    host::setMicros(5000000);
+    link.poll(acceptAll);
+    EXPECT_EQ(link.getLastRxMs(), 0u);  // Nothing arrived
+
+    port.rx.push_back('x');  // Stray byte, not a frame
+    link.poll(acceptAll);
+    EXPECT_EQ(link.getLastRxMs(), 5000u);
+}
@@ -0,0 +1,199 @@
+// STATE_TABLE rows and the operation engine they drive, on the whole Web GUI sketch
+// compiled as one host translation unit (built only when ArduinoJson 6 is found)
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "Smart_Multipurpose_Battery_Tester_Modified_WebGUI.ino"
+
+// Battery channel counts for a cell voltage, scaled from one reading after setup()
+static const int REF_COUNTS = 1530;
+static float voltsPerCount = 0;
+static float cellVolts = 3.7f;
+
+static void bootSketch() {
+    static bool booted = false;
+    voltsPerCount = 0;
+    host::setAnalogRead([](uint8_t pin) {
+        if (pin != BAT_Pin) return 1560;   // Vref channel
+        return voltsPerCount > 0 ? (int)(cellVolts / voltsPerCount + 0.5f) : REF_COUNTS;
+    });
+    if (!booted) {
+        setup();
+        booted = true;
+    }
+    batteryFilter.reset();
+    voltsPerCount = measureBatteryVoltage() / REF_COUNTS;
+    resetToIdle();
+    currentState = STATE_MENU;
+    selectedMode = 0;
+}
+
+// One loop() pass per `stepMs` of simulated time
+static void runLoop(uint32_t stepMs) {
+    loop();
+    host::advanceMicros((uint64_t)stepMs * 1000);
+}
+
+static void pressAndRun(uint8_t pin) {
+    host::releaseButton(pin);
+    runLoop(50);
+}
+
+// One text frame as async_tcp delivers it (the handler terminates it in place)
+static void receiveWebSocketText(const char* json) {
+    static AsyncWebSocketClient client;
+    std::string frame(json);
+    AwsFrameInfo info = {};
+    info.final = 1;
+    info.opcode = WS_TEXT;
+    info.len = frame.size();
+    frame.push_back(0);
+    handleWebSocketMessage(&client, &info, (uint8_t*)&frame[0], info.len);
+}
+
+TEST(StateTable, EngineRowsAreConsistent) {
+    for (uint8_t i = 0; i < STATE_COUNT; i++) {
+        const StateDescriptor& row = STATE_TABLE[i];
+        SCOPED_TRACE(row.wireName);
+        ASSERT_NE(row.wireName, nullptr);
+        EXPECT_GT(strlen(row.wireName), 0u);
+        EXPECT_EQ(row.handler == nullptr, i == STATE_IDLE);
+        ASSERT_LT(row.next, STATE_COUNT);
+
+        if (row.termination != TERMINATE_NONE) {
+            // The engine integrates whatever drives the cell and ends on the matching condition
+            EXPECT_EQ(row.integrator, row.rig == RIG_CHARGER ? INTEGRATE_CHARGE : INTEGRATE_LOAD);
+            EXPECT_EQ(row.termination, row.rig == RIG_CHARGER ? TERMINATE_FULL : TERMINATE_CUTOFF);
+            EXPECT_NE(row.screen, SCREEN_HANDLER);
+            EXPECT_GT(strlen(row.title), 0u);
+            EXPECT_TRUE(row.flags & STATE_FLAG_ABORT);
+            EXPECT_TRUE(row.flags & STATE_FLAG_LOG);
+            EXPECT_NE(row.ruleScope, 0);
+            EXPECT_NE(row.next, row.state);
+            EXPECT_NE(describeState(row.next).handler, nullptr);
+        } else {
+            EXPECT_EQ(row.integrator, INTEGRATE_NONE);
+            EXPECT_EQ(row.ruleScope, 0);
+        }
+        if (row.flags & STATE_FLAG_IDLE) {
+            EXPECT_EQ(row.rig, RIG_NONE);
+            EXPECT_FALSE(row.flags & STATE_FLAG_ABORT);
+        }
+        if (row.flags & STATE_FLAG_DISMISS) {
+            // Result and info screens: nothing running, any button goes back
+            EXPECT_TRUE(row.flags & STATE_FLAG_IDLE);
+            EXPECT_EQ(row.next, STATE_MENU);
+        }
+    }
+    EXPECT_EQ(&describeState(STATE_COUNT), &STATE_TABLE[STATE_IDLE]);
+}
+
+TEST(StateTable, DischargeFromMenuRunsToCutoff) {
+    bootSketch();
+    cellVolts = 4.0f;
+    cutoffVoltage = 3.0f;
+
+    pressAndRun(DOWN_PIN);   // Menu item 1: Discharge
+    pressAndRun(MODE_PIN);
+    ASSERT_EQ(currentState, STATE_SELECT_CUTOFF);
+    pressAndRun(MODE_PIN);
+    ASSERT_EQ(currentState, STATE_SELECT_CURRENT);
+    pressAndRun(MODE_PIN);
+    ASSERT_EQ(currentState, STATE_DISCHARGING);
+
+    // Load on from the first tick, at the requested current
+    EXPECT_EQ(loadIndex, PWM_Index);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), PWM[loadIndex]);
+    EXPECT_EQ(getCurrentMA(), Current[PWM_Index]);
+    EXPECT_STREQ(describeState(currentState).wireName, "discharge");
+    EXPECT_FALSE(isIdleState(currentState));
+
+    // 4.0 V down to the cutoff over ten minutes
+    uint32_t startMs = millis();
+    uint32_t endMs = 0;
+    while (currentState == STATE_DISCHARGING && millis() - startMs < 900000) {
+        cellVolts = 4.0f - (millis() - startMs) / 600000.0f;
+        runLoop(100);
+        if (currentState != STATE_DISCHARGING && endMs == 0) endMs = millis();
+    }
+    ASSERT_EQ(currentState, STATE_COMPLETE);
+    EXPECT_NEAR(endMs - startMs, 600000, 10000);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), 0);
+    EXPECT_EQ(getCurrentMA(), 0);
+    EXPECT_TRUE(isIdleState(currentState));
+
+    float expected = (Current[PWM_Index] + currentOffset) * (endMs - startMs) / 3600000.0f;
+    EXPECT_NEAR(Capacity_f, expected, expected * 0.02f);
+
+    pressAndRun(MODE_PIN);
+    EXPECT_EQ(currentState, STATE_MENU);
+}
+
+TEST(StateTable, ModeButtonAbortsCharge) {
+    bootSketch();
+    cellVolts = 3.7f;
+
+    pressAndRun(MODE_PIN);   // Menu item 0: Charge
+    ASSERT_EQ(currentState, STATE_CHARGING);
+    EXPECT_EQ(host::getPinLevel(Mosfet_Pin), HIGH);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), 0);
+    EXPECT_STREQ(describeState(currentState).wireName, "charge");
+
+    for (int i = 0; i < 100; i++) runLoop(100);
+    EXPECT_EQ(currentState, STATE_CHARGING);
+    EXPECT_GT(Capacity_f, 0);
+
+    pressAndRun(MODE_PIN);
+    EXPECT_EQ(currentState, STATE_MENU);
+    EXPECT_EQ(host::getPinLevel(Mosfet_Pin), LOW);
+}
+
+TEST(StateTable, IrTestFollowsRowExits) {
+    bootSketch();
+    cellVolts = 3.9f;
+
+    // Mode aborts the measurement through the row's abort flag
+    for (int i = 0; i < 3; i++) pressAndRun(DOWN_PIN);   // Menu item 3: IR Test
+    pressAndRun(MODE_PIN);
+    ASSERT_EQ(currentState, STATE_IR_MEASURE);
+    runLoop(600);
+    runLoop(50);
+    EXPECT_GT(host::getPwmDuty(PWM_Pin), 0);
+    pressAndRun(MODE_PIN);
+    EXPECT_EQ(currentState, STATE_MENU);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), 0);
+
+    // Run to the result, which any button dismisses
+    pressAndRun(MODE_PIN);
+    ASSERT_EQ(currentState, STATE_IR_MEASURE);
+    for (int i = 0; i < 30 && currentState == STATE_IR_MEASURE; i++) runLoop(100);
+    ASSERT_EQ(currentState, STATE_IR_DISPLAY);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), 0);
+    runLoop(100);
+    EXPECT_EQ(currentState, STATE_IR_DISPLAY);
+    pressAndRun(UP_PIN);
+    EXPECT_EQ(currentState, STATE_MENU);
+}
+
+TEST(StateTable, WebCommandsRunOnLoopTask) {
+    bootSketch();
+    cellVolts = 4.0f;
+
+    // Queued by the WebSocket handler, nothing measured or started until loop() runs
+    receiveWebSocketText("{\"cmd\":\"start_discharge\",\"cutoff\":3.0,\"current\":500}");
+    EXPECT_EQ(currentState, STATE_MENU);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), 0);
+
+    runLoop(100);
+    ASSERT_EQ(currentState, STATE_DISCHARGING);
+    EXPECT_EQ(Current[PWM_Index], 500);
+
+    for (int i = 0; i < 10; i++) runLoop(100);
+    receiveWebSocketText("{\"cmd\":\"abort\"}");
+    EXPECT_EQ(currentState, STATE_DISCHARGING);
+    runLoop(100);
+    runLoop(100);
+    EXPECT_EQ(currentState, STATE_MENU);
+    EXPECT_EQ(host::getPwmDuty(PWM_Pin), 0);
+}
@@ -0,0 +1,98 @@
+// ThermalModel step loads on the default heatsink, driven the way the sketch drives it:
+// every tick the load is min(request, ceiling) and the model sees the applied current
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "ThermalModel.h"
+
+static const int CURRENTS[] = {0, 50, 100, 200, 300, 400, 500, 600, 700, 800, 900, 1000, 1500, 2000};
+static const uint8_t CURRENT_COUNT = sizeof(CURRENTS) / sizeof(CURRENTS[0]);
+static const uint8_t INDEX_1000MA = 11;
+static const uint8_t INDEX_2000MA = 13;
+
+struct StepResult {
+    float peakJunctionC = 0;
+    uint32_t firstDerateMs = 0;
+    float capacityMAh = 0;
+    int finalMA = 0;
+};
+
+// Hold `requested` for `seconds` at a fixed cell voltage
+static StepResult runStep(ThermalModel& model, uint8_t requested, uint32_t seconds, float volts = 3.7f,
+                          uint32_t startMs = 0) {
+    StepResult r;
+    for (uint32_t t = startMs + THERMAL_TICK_MS; t <= startMs + seconds * 1000; t += THERMAL_TICK_MS) {
+        uint8_t index = model.limitIndex(requested);
+        r.capacityMAh += CURRENTS[index] * THERMAL_TICK_MS / 3600000.0f;
+        model.update(t, volts, CURRENTS[index]);
+        r.peakJunctionC = std::max(r.peakJunctionC, model.getJunctionC());
+        if (r.firstDerateMs == 0 && model.isDerating(requested)) r.firstDerateMs = t - startMs;
+        r.finalMA = CURRENTS[index];
+    }
+    return r;
+}
+
+TEST(ThermalModel, SustainableLoadNeverDerates) {
+    ThermalModel model;
+    model.begin(CURRENTS, CURRENT_COUNT);
+    StepResult r = runStep(model, INDEX_1000MA, 4 * 3600);
+
+    EXPECT_EQ(r.firstDerateMs, 0u);
+    EXPECT_EQ(r.finalMA, 1000);
+    EXPECT_LT(r.peakJunctionC, THERMAL_DEFAULT_PARAMS.limitC);
+
+    // Steady state: T_j = T_amb + P (R_ha + R_jh), P = I (V - I R_sense)
+    const ThermalParams& p = THERMAL_DEFAULT_PARAMS;
+    float watts = 1.0f * (3.7f - 1.0f * p.senseOhms);
+    EXPECT_NEAR(model.getPowerW(), watts, 1e-3f);
+    EXPECT_NEAR(model.getJunctionC(), p.ambientC + watts * (p.rHaCW + p.rJhCW), 0.1f);
+    EXPECT_NEAR(model.getHeatsinkC(), p.ambientC + watts * p.rHaCW, 0.1f);
+}
+
+TEST(ThermalModel, HighLoadDeratesAndHoldsJunctionAtLimit) {
+    ThermalModel model;
+    model.begin(CURRENTS, CURRENT_COUNT);
+    StepResult r = runStep(model, INDEX_2000MA, 3600, 4.1f);
+
+    // The cold heatsink's thermal mass carries 2A for a few minutes
+    EXPECT_GT(r.firstDerateMs, 120000u);
+    EXPECT_LT(r.firstDerateMs, 600000u);
+    // One tick of overshoot at most before the ceiling steps down
+    EXPECT_LT(r.peakJunctionC, THERMAL_DEFAULT_PARAMS.limitC + 1.0f);
+    // Settles on a current that is safe indefinitely, below the request
+    EXPECT_LE(r.finalMA, 1000);
+    EXPECT_GE(r.finalMA, 500);
+    EXPECT_TRUE(model.isDerating(INDEX_2000MA));
+    // Capacity follows the current actually applied, not the 2A request
+    EXPECT_LT(r.capacityMAh, 2000.0f * 0.75f);
+    EXPECT_GT(r.capacityMAh, 900.0f);
+}
+
+TEST(ThermalModel, CeilingRecoversAfterCooling) {
+    ThermalModel model;
+    model.begin(CURRENTS, CURRENT_COUNT);
+    runStep(model, INDEX_2000MA, 1800, 4.1f);
+    ASSERT_TRUE(model.isDerating(INDEX_2000MA));
+
+    // Load off: the ceiling climbs back while each next step is safe in steady state.
+    // 1.5A and 2A are not, so it stops at 1A.
+    StepResult idle = runStep(model, 0, 1800, 4.1f, 1800 * 1000);
+    EXPECT_EQ(idle.finalMA, 0);
+    EXPECT_EQ(model.getCeilingMA(), 1000);
+    EXPECT_NEAR(model.getJunctionC(), THERMAL_DEFAULT_PARAMS.ambientC, 2.0f);
+}
+
+TEST(ThermalModel, RejectsImplausibleParams) {
+    ThermalParams p = THERMAL_DEFAULT_PARAMS;
+    EXPECT_TRUE(ThermalModel::paramsValid(p));
+    p.limitC = p.ambientC + 5;
+    EXPECT_FALSE(ThermalModel::paramsValid(p));
+    p = THERMAL_DEFAULT_PARAMS;
+    p.rHaCW = 0;
+    EXPECT_FALSE(ThermalModel::paramsValid(p));
+
+    ThermalModel model;
+    EXPECT_FALSE(model.setParams(p));
+    EXPECT_EQ(model.getParams().rHaCW, THERMAL_DEFAULT_PARAMS.rHaCW);
+}
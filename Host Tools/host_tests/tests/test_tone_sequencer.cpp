@@ -0,0 +1,102 @@
+// ToneSequencer note timing and queueing on the simulated esp_timer
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+
+#include "ToneSequencer.h"
+
+#define TEST_BUZZER_PIN 7
+
+class ToneSequencerTest : public ::testing::Test {
+protected:
+    ToneSequencer tones;
+
+    void SetUp() override {
+        host::reset();
+        tones.begin(TEST_BUZZER_PIN, 8);
+    }
+
+    void TearDown() override {
+        tones.stop();
+    }
+
+    static void advanceMs(uint32_t ms) {
+        host::advanceMicros((uint64_t)ms * 1000);
+    }
+
+    static bool sounding() {
+        return host::getPwmDuty(TEST_BUZZER_PIN) != 0;
+    }
+};
+
+TEST_F(ToneSequencerTest, PlaysSequenceWithItsDurations) {
+    static const ToneNote seq[] = {{440, 100}, {0, 50}, {880, 200}};
+    tones.play(seq, 3);
+    EXPECT_TRUE(tones.isPlaying());
+
+    advanceMs(0);  // First note is output from the timer task
+    EXPECT_TRUE(sounding());
+    EXPECT_EQ(host::getLedcFrequency(TEST_BUZZER_PIN), 440u);
+    EXPECT_EQ(host::getPwmDuty(TEST_BUZZER_PIN), 128);
+
+    advanceMs(100);
+    EXPECT_FALSE(sounding());  // Rest
+    advanceMs(50);
+    EXPECT_TRUE(sounding());
+    EXPECT_EQ(host::getLedcFrequency(TEST_BUZZER_PIN), 880u);
+
+    advanceMs(199);
+    EXPECT_TRUE(tones.isPlaying());
+    advanceMs(1);
+    EXPECT_FALSE(tones.isPlaying());
+    EXPECT_FALSE(sounding());
+}
+
+TEST_F(ToneSequencerTest, QueuedSequencesPlayBackToBack) {
+    tones.play(TONE_SEQUENCE(BEEP_ABORT));      // 300 ms
+    tones.play(TONE_SEQUENCE(CHIME_ERROR));     // 550 ms
+    tones.playTone(2000, 40);
+
+    advanceMs(300);
+    EXPECT_EQ(host::getLedcFrequency(TEST_BUZZER_PIN), 392u);  // Error chime started
+    advanceMs(550);
+    EXPECT_TRUE(sounding());
+    EXPECT_EQ(host::getLedcFrequency(TEST_BUZZER_PIN), 2000u);
+    advanceMs(40);
+    EXPECT_FALSE(tones.isPlaying());
+}
+
+TEST_F(ToneSequencerTest, FullQueueDropsOldestPending) {
+    tones.playTone(100, 10);
+    for (int i = 0; i < TONE_QUEUE_SIZE + 1; i++) {
+        tones.playTone(200 + i, 10);
+    }
+
+    // 200 was the oldest pending and is dropped
+    advanceMs(10);
+    EXPECT_EQ(host::getLedcFrequency(TEST_BUZZER_PIN), 201u);
+    advanceMs(10 * TONE_QUEUE_SIZE);
+    EXPECT_FALSE(tones.isPlaying());
+}
+
+TEST_F(ToneSequencerTest, PlayAfterFinishRestarts) {
+    tones.playTone(500, 20);
+    advanceMs(20);
+    EXPECT_FALSE(tones.isPlaying());
+
+    tones.playTone(600, 20);
+    advanceMs(0);
+    EXPECT_TRUE(sounding());
+    EXPECT_EQ(host::getLedcFrequency(TEST_BUZZER_PIN), 600u);
+}
+
+TEST_F(ToneSequencerTest, StopSilencesAndClearsQueue) {
+    tones.play(TONE_SEQUENCE(CHIME_STARTUP));
+    tones.play(TONE_SEQUENCE(CHIME_COMPLETE));
+    advanceMs(10);
+    tones.stop();
+    EXPECT_FALSE(tones.isPlaying());
+    EXPECT_FALSE(sounding());
+    advanceMs(2000);
+    EXPECT_FALSE(sounding());
+}
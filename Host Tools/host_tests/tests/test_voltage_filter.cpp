@@ -0,0 +1,131 @@
+// VoltageFilter on synthetic ADC blocks: noise, PWM ripple, spikes and load steps
+
+#include <Arduino.h>
+#include <gtest/gtest.h>
+#include <random>
+
+#include "VoltageFilter.h"
+
+static const double PI_D = 3.14159265358979;
+
+// One raw block as readAdcBlock() takes it: group g sits 1/8 of a PWM period after
+// group g-1, samples inside a group are one period apart (same ripple phase)
+struct BlockSource {
+    std::mt19937 rng{1};
+    std::normal_distribution<double> noise{0.0, 2.0};  // ~2 LSB rms, as on the ESP32-C3
+    double rippleLsb = 0;
+    double spikeChance = 0;                              // Per median group, one sample hit
+    double spikeLsb = 300;
+
+    void fill(double truth, uint16_t* raw) {
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        for (int g = 0; g < FILTER_DECIMATION; g++) {
+            double ripple = rippleLsb * sin(2 * PI_D * g / FILTER_DECIMATION);
+            int spiked = (u(rng) < spikeChance) ? (int)(u(rng) * FILTER_MEDIAN_N) : -1;
+            for (int k = 0; k < FILTER_MEDIAN_N; k++) {
+                double v = truth + ripple + noise(rng);
+                if (k == spiked) v += spikeLsb;
+                raw[g * FILTER_MEDIAN_N + k] = (uint16_t)constrain(lround(v), 0L, 4095L);
+            }
+        }
+    }
+};
+
+TEST(VoltageFilter, ConstantInputIsExact) {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    for (auto& r : raw) r = 1523;
+    VoltageFilter filter;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(filter.process(raw), 1523 << FILTER_FRAC_BITS);
+    }
+}
+
+TEST(VoltageFilter, MedianRejectsOneSpikePerGroup) {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    for (auto& r : raw) r = 1400;
+    for (int g = 0; g < FILTER_DECIMATION; g++) {
+        raw[g * FILTER_MEDIAN_N + g % FILTER_MEDIAN_N] = (g & 1) ? 4095 : 0;
+    }
+    EXPECT_EQ(VoltageFilter::decimate(raw), 1400 << FILTER_FRAC_BITS);
+}
+
+TEST(VoltageFilter, CicCancelsPwmRipple) {
+    BlockSource source;
+    source.noise = std::normal_distribution<double>(0.0, 0.0);
+    source.rippleLsb = 40;
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    source.fill(1700, raw);
+    // Rounding each sample to whole counts leaves at most 1/2 LSB of error
+    EXPECT_NEAR(VoltageFilter::decimate(raw) / 16.0, 1700.0, 0.5);
+}
+
+// The documented noise floor: ~2 LSB rms raw becomes ~0.2 LSB rms after the IIR
+TEST(VoltageFilter, ReducesNoiseRippleAndSpikes) {
+    BlockSource source;
+    source.rippleLsb = 25;
+    source.spikeChance = 0.05;
+    const double truth = 1700.3;
+
+    VoltageFilter filter;
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    double rawErr = 0;
+    double outErr = 0;
+    double maxErr = 0;
+    int n = 0;
+    for (int block = 0; block < 3000; block++) {
+        source.fill(truth, raw);
+        double out = filter.process(raw) / 16.0;
+        if (block < 50) continue;  // Settling
+        double r = raw[0] - truth;
+        rawErr += r * r;
+        outErr += (out - truth) * (out - truth);
+        maxErr = std::max(maxErr, fabs(out - truth));
+        n++;
+    }
+    double rawRms = sqrt(rawErr / n);
+    double outRms = sqrt(outErr / n);
+    EXPECT_GT(rawRms, 10.0);   // Ripple and spikes dominate the raw samples
+    EXPECT_LT(outRms, 0.4);
+    EXPECT_LT(maxErr, 1.5);
+}
+
+TEST(VoltageFilter, SnapsToLoadStep) {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    VoltageFilter filter;
+    for (auto& r : raw) r = 1700;
+    for (int i = 0; i < 20; i++) filter.process(raw);
+
+    for (auto& r : raw) r = 1600;
+    EXPECT_EQ(filter.process(raw), 1600 << FILTER_FRAC_BITS);
+}
+
+TEST(VoltageFilter, SmallDriftIsTrackedWithoutOvershoot) {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    VoltageFilter filter;
+    for (auto& r : raw) r = 1700;
+    for (int i = 0; i < 20; i++) filter.process(raw);
+
+    // 5 LSB: inside the track band, so smoothed rather than snapped
+    for (auto& r : raw) r = 1705;
+    int32_t first = filter.process(raw);
+    EXPECT_GT(first, 1700 << FILTER_FRAC_BITS);
+    EXPECT_LT(first, 1705 << FILTER_FRAC_BITS);
+    int32_t out = first;
+    for (int i = 0; i < 40; i++) {
+        out = filter.process(raw);
+        EXPECT_LE(out, 1705 << FILTER_FRAC_BITS);
+    }
+    // The slowest IIR step rounds to zero within 1/4 LSB of the input
+    EXPECT_NEAR(out, 1705 << FILTER_FRAC_BITS, 3);
+}
+
+TEST(VoltageFilter, ResetTakesNextReadingUnsmoothed) {
+    uint16_t raw[FILTER_RAW_SAMPLES];
+    VoltageFilter filter;
+    for (auto& r : raw) r = 1700;
+    for (int i = 0; i < 20; i++) filter.process(raw);
+
+    filter.reset();
+    for (auto& r : raw) r = 1702;
+    EXPECT_EQ(filter.process(raw), 1702 << FILTER_FRAC_BITS);
+}
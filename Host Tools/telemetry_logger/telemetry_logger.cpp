@@ -0,0 +1,298 @@
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+// Battery Tester - USB Serial Telemetry Logger (host side)
+// Companion to SerialTelemetry.h in the Web GUI firmware.
+// Decodes COBS/CRC16 frames from the tester's USB-CDC port and writes them to CSV.
+//
+// Build:  g++ -O2 -std=c++17 -o telemetry_logger telemetry_logger.cpp
+// Usage:  ./telemetry_logger /dev/ttyACM0 run.csv [--raw] [--no-ticks]
+//
+// Prints throughput and drop statistics once per second and a summary on Ctrl+C.
+//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+// ========================================= FRAME DEFINITIONS ========================================
+// Must match SerialTelemetry.h
+#define TELEM_FRAME_TICK    0x01
+#define TELEM_FRAME_ADC     0x02
+#define TELEM_FRAME_ACK     0x11
+#define TELEM_FRAME_COMMAND 0x10
+
+#define FRAME_HEADER_LEN 5  // type:1 seq:4
+
+// Smallest valid payload (header + body, before CRC) for each frame type
+static size_t minPayloadLength(uint8_t type) {
+    switch (type) {
+        case TELEM_FRAME_TICK: return FRAME_HEADER_LEN + 13;  // t_ms:4 state:1 mV:2 mA:2 cap:4
+        case TELEM_FRAME_ADC:  return FRAME_HEADER_LEN + 7;   // t_us:4 channel:1 raw:2
+        case TELEM_FRAME_ACK:  return FRAME_HEADER_LEN + 1;   // accepted:1 cmd:text
+        default:               return FRAME_HEADER_LEN;
+    }
+}
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+// ========================================= CRC / COBS ========================================
+static uint16_t crc16(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static size_t cobsEncode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t codeIndex = 0;
+    size_t outIndex = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[codeIndex] = code;
+            codeIndex = outIndex++;
+            code = 1;
+        } else {
+            out[outIndex++] = in[i];
+            if (++code == 0xFF) {
+                out[codeIndex] = code;
+                codeIndex = outIndex++;
+                code = 1;
+            }
+        }
+    }
+    out[codeIndex] = code;
+    return outIndex;
+}
+
+static size_t cobsDecode(const uint8_t* in, size_t len, uint8_t* out) {
+    size_t i = 0;
+    size_t o = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t k = 1; k < code; k++) {
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < len) {
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+static uint16_t getU16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// ========================================= SERIAL PORT ========================================
+static int openPort(const char* path) {
+    int fd = open(path, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, B115200);  // Ignored by USB-CDC, kept for USB-UART bridges
+    cfsetospeed(&tio, B115200);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 1;         // 100 ms read timeout so Ctrl+C is serviced promptly
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIFLUSH);
+    return fd;
+}
+
+static bool sendCommand(int fd, const std::string& json) {
+    std::vector<uint8_t> payload;
+    payload.push_back(TELEM_FRAME_COMMAND);
+    payload.insert(payload.end(), json.begin(), json.end());
+    uint16_t crc = crc16(payload.data(), payload.size());
+    payload.push_back(crc & 0xFF);
+    payload.push_back(crc >> 8);
+
+    std::vector<uint8_t> frame(payload.size() + payload.size() / 254 + 3);
+    frame[0] = 0;
+    size_t len = cobsEncode(payload.data(), payload.size(), frame.data() + 1) + 1;
+    frame[len++] = 0;
+    return write(fd, frame.data(), len) == (ssize_t)len;
+}
+
+static double nowSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ========================================= STATISTICS ========================================
+struct Stats {
+    uint64_t frames = 0;      // Valid frames decoded
+    uint64_t bytes = 0;       // Raw bytes read from the port
+    uint64_t lost = 0;        // Frames missing according to sequence gaps
+    uint64_t crcErrors = 0;   // Frames failing COBS, CRC or length checks (includes debug text)
+    bool haveSeq = false;
+    uint32_t lastSeq = 0;
+};
+
+static void printStats(const char* label, const Stats& s, double seconds) {
+    uint64_t expected = s.frames + s.lost;
+    double dropRate = expected ? 100.0 * s.lost / expected : 0.0;
+    fprintf(stderr, "%s %.1fs: %llu frames (%.0f/s), %.1f kB/s, lost %llu (%.3f%%), bad %llu\n",
+            label, seconds,
+            (unsigned long long)s.frames, seconds > 0 ? s.frames / seconds : 0.0,
+            seconds > 0 ? s.bytes / seconds / 1024.0 : 0.0,
+            (unsigned long long)s.lost, dropRate, (unsigned long long)s.crcErrors);
+}
+
+// ========================================= MAIN ========================================
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <serial device> <output.csv> [--raw] [--no-ticks]\n", argv[0]);
+        return 1;
+    }
+
+    bool ticks = true;
+    bool raw = false;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "--raw") == 0) raw = true;
+        else if (strcmp(argv[i], "--no-ticks") == 0) ticks = false;
+    }
+
+    int fd = openPort(argv[1]);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    FILE* out = fopen(argv[2], "w");
+    if (!out) {
+        fprintf(stderr, "Cannot create %s: %s\n", argv[2], strerror(errno));
+        close(fd);
+        return 1;
+    }
+    // Large stdio buffer so disk writes never throttle the reader
+    static char outBuffer[1 << 20];
+    setvbuf(out, outBuffer, _IOFBF, sizeof(outBuffer));
+    fprintf(out, "type,seq,time,a,b,c,d\n");
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::string enable = std::string("{\"cmd\":\"telemetry\",\"ticks\":") + (ticks ? "true" : "false") +
+                         ",\"raw\":" + (raw ? "true" : "false") + "}";
+    if (!sendCommand(fd, enable)) {
+        fprintf(stderr, "Failed to send enable command\n");
+    }
+
+    Stats total;
+    Stats window;
+    std::vector<uint8_t> frame;
+    frame.reserve(512);
+    uint8_t decoded[512];
+    uint8_t readBuffer[65536];
+
+    double startTime = nowSeconds();
+    double windowStart = startTime;
+
+    while (!stopRequested) {
+        ssize_t n = read(fd, readBuffer, sizeof(readBuffer));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Read error: %s\n", strerror(errno));
+            break;
+        }
+        total.bytes += n;
+        window.bytes += n;
+
+        for (ssize_t i = 0; i < n; i++) {
+            uint8_t c = readBuffer[i];
+            if (c != 0) {
+                if (frame.size() < sizeof(decoded)) frame.push_back(c);
+                continue;
+            }
+            if (frame.empty()) continue;  // Back-to-back delimiters
+
+            size_t len = frame.size() < sizeof(decoded) ? cobsDecode(frame.data(), frame.size(), decoded) : 0;
+            frame.clear();
+            if (len < FRAME_HEADER_LEN + 2 || crc16(decoded, len - 2) != getU16(decoded + len - 2) ||
+                len - 2 < minPayloadLength(decoded[0])) {
+                total.crcErrors++;
+                window.crcErrors++;
+                continue;
+            }
+
+            // Gaps are frames the device generated but dropped (TX buffer full) or that
+            // were corrupted on the wire; both count as lost
+
+            uint32_t seq = getU32(decoded + 1);
+            if (total.haveSeq) {
+                uint32_t gap = seq - total.lastSeq - 1;
+                if (gap < 0x80000000u) {  // Ignore device resets (sequence going backwards)
+                    total.lost += gap;
+                    window.lost += gap;
+                }
+            }
+            total.haveSeq = true;
+            total.lastSeq = seq;
+            total.frames++;
+            window.frames++;
+
+            const uint8_t* body = decoded + FRAME_HEADER_LEN;
+            switch (decoded[0]) {
+                case TELEM_FRAME_TICK:
+                    fprintf(out, "tick,%u,%u,%u,%u,%d,%u\n", seq, getU32(body), body[4],
+                            getU16(body + 5), (int16_t)getU16(body + 7), getU32(body + 9));
+                    break;
+                case TELEM_FRAME_ADC:
+                    fprintf(out, "adc,%u,%u,%u,%u,,\n", seq, getU32(body), body[4], getU16(body + 5));
+                    break;
+                case TELEM_FRAME_ACK:
+                    fprintf(stderr, "ACK (%s): %.*s\n", body[0] ? "accepted" : "rejected",
+                            (int)(len - 2 - FRAME_HEADER_LEN - 1), (const char*)body + 1);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        double now = nowSeconds();
+        if (now - windowStart >= 1.0) {
+            printStats("[rate]", window, now - windowStart);
+            window = Stats();
+            windowStart = now;
+        }
+    }
+
+    sendCommand(fd, "{\"cmd\":\"telemetry\",\"ticks\":false,\"raw\":false}");
+    fclose(out);
+    close(fd);
+
+    printStats("[total]", total, nowSeconds() - startTime);
+    return 0;
+}